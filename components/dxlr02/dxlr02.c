@@ -33,57 +33,235 @@ static dxlr02_status_t dxlr02_uart_send(dxlr02_t *module, const char *data, size
     return DXLR02_OK;
 }
 
+/****************************************** RX RING ******************************************/
+#define DXLR02_RX_RING_MASK (DXLR02_RX_RING_LEN - 1)
+
+_Static_assert((DXLR02_RX_RING_LEN & DXLR02_RX_RING_MASK) == 0, "DXLR02_RX_RING_LEN debe ser potencia de 2");
+
+// Agrega un byte de datos al ring. Devuelve true si con ese byte se completo un frame.
+static bool dxlr02_rx_push(dxlr02_t *module, char c){
+    dxlr02_rx_ring_t *ring = &module->rx;
+
+    if(ring->dropping){
+        if(c == '\0')
+            ring->dropping = false;
+        return false;
+    }
+
+    if(ring->wr - ring->rd >= DXLR02_RX_RING_LEN){
+        // No entra: se pierde el frame entero, no solo la cola
+        ring->wr = ring->commit;
+        ring->dropping = (c != '\0');
+        module->stats.frames_lost++;
+        return false;
+    }
+
+    ring->buf[ring->wr & DXLR02_RX_RING_MASK] = c;
+    ring->wr++;
+
+    if(c == '\0'){
+        ring->commit = ring->wr;
+        return true;
+    }
+    return false;
+}
+
+// Saca un byte del ring. Un frame parcial (sin '\0' todavia) tambien se entrega, el resto llega por UART.
+static bool dxlr02_rx_pop(dxlr02_t *module, char *c){
+    dxlr02_rx_ring_t *ring = &module->rx;
+
+    if(ring->rd == ring->wr)
+        return false;
+
+    bool partial = (ring->rd == ring->commit);
+    *c = ring->buf[ring->rd & DXLR02_RX_RING_MASK];
+    ring->rd++;
+    if(partial)
+        ring->commit = ring->rd;
+
+    return true;
+}
+
+// Devuelve al ring los ultimos k bytes sacados con dxlr02_rx_pop (siguen en el buffer mientras no haya un push)
+static void dxlr02_rx_unpop(dxlr02_t *module, size_t k){
+    dxlr02_rx_ring_t *ring = &module->rx;
+
+    bool partial = (ring->rd == ring->commit);
+    ring->rd -= k;
+    if(partial)
+        ring->commit = ring->rd;
+}
+
+// Descarta lo que queda del frame que no entro en el buffer del llamador: primero del ring y, si no
+// termina ahi, lo que siga llegando por la UART hasta el proximo '\0'
+static void dxlr02_rx_discard_frame(dxlr02_t *module){
+    char c;
+    module->stats.frames_lost++;
+    while(dxlr02_rx_pop(module, &c)){
+        if(c == '\0')
+            return;
+    }
+    module->rx.dropping = true;
+}
+
+// Saca de len bytes recien leidos de la UART la cola de un frame descartado. Devuelve cuantos quedan.
+static size_t dxlr02_rx_skip_dropped(dxlr02_t *module, char *data, size_t len){
+    if(!module->rx.dropping || len == 0)
+        return len;
+
+    char *end = memchr(data, '\0', len);
+    if(!end)
+        return 0;
+
+    module->rx.dropping = false;
+    size_t skip = (size_t)(end - data) + 1;
+    memmove(data, end + 1, len - skip);
+    return len - skip;
+}
+
+// Guarda en el ring bytes de datos que se leyeron fuera del camino normal de recepcion
+static void dxlr02_rx_push_all(dxlr02_t *module, const char *data, size_t len){
+    for(size_t k = 0; k < len; k++){
+        if(dxlr02_rx_push(module, data[k]))
+            module->stats.frames_recovered++;
+    }
+}
+
+// Espera de un byte sin pasarse del deadline de la lectura: nunca mas de TIMEOUT_ONE_BYTE_MS ni menos de un tick
+static TickType_t dxlr02_byte_wait(int64_t remaining_us){
+    int64_t ms = (remaining_us + 999) / 1000;
+    if(ms > TIMEOUT_ONE_BYTE_MS)
+        ms = TIMEOUT_ONE_BYTE_MS;
+    TickType_t ticks = ms > 0 ? pdMS_TO_TICKS(ms) : 0;
+    return ticks > 0 ? ticks : 1;
+}
+
+// Reemplaza a uart_flush_input: lo que quedo en el buffer de la UART antes de un comando AT se guarda
+// como datos, cortado solo en '\0' (un frame puede traer '\n'). El modulo manda cada frame de corrido:
+// si queda algo sin '\0' y la UART se calla, no era un frame sino una respuesta vieja y se descarta.
+static dxlr02_status_t dxlr02_rx_drain(dxlr02_t *module){
+    char chunk[32];
+
+    for(;;){
+        size_t pending = 0;
+        int read;
+        if(uart_get_buffered_data_len((uart_port_t)module->uart_port, &pending) != ESP_OK)
+            return DXLR02_ERR_UART;
+
+        if(pending > 0){
+            read = uart_read_bytes((uart_port_t)module->uart_port, chunk, pending < sizeof(chunk) ? pending : sizeof(chunk), 0);
+        } else if(module->rx.wr != module->rx.commit){
+            read = uart_read_bytes((uart_port_t)module->uart_port, chunk, 1, dxlr02_byte_wait((int64_t)DXLR02_RX_IDLE_MS * 1000));
+            if(read == 0){
+                module->rx.wr = module->rx.commit;
+                break;
+            }
+        } else {
+            break;
+        }
+        if(read < 0)
+            return DXLR02_ERR_UART;
+        if(read == 0)
+            break;
+
+        dxlr02_rx_push_all(module, chunk, (size_t)read);
+    }
+
+    return DXLR02_OK;
+}
+
+static void dxlr02_record_rtt(dxlr02_t *module, dxlr02_status_t st){
+    if(module->at_sent_us == 0)
+        return;
+
+    uint32_t rtt = (uint32_t)(esp_timer_get_time() - module->at_sent_us);
+    module->at_sent_us = 0;
+
+    dxlr02_stats_t *stats = &module->stats;
+    stats->at_round_trips++;
+    if(st != DXLR02_OK)
+        stats->at_errors++;
+    stats->at_time_us += rtt;
+    if(rtt > stats->at_rtt_max_us)
+        stats->at_rtt_max_us = rtt;
+
+    size_t bucket = 0;
+    for(uint32_t ms = rtt / 1000; ms > 0 && bucket < DXLR02_RTT_BUCKETS - 1; ms >>= 1)
+        bucket++;
+    stats->at_rtt_hist[bucket]++;
+}
+
+static dxlr02_status_t dxlr02_read_until_raw(dxlr02_t *module, char * response, size_t response_len, char delim, size_t times, uint32_t timeout_ms);
+
+// Todas las lecturas de respuestas AT pasan por aca: la primera despues de un comando cierra su round trip
 static dxlr02_status_t dxlr02_read_until(dxlr02_t *module, char * response, size_t response_len, char delim, size_t times, uint32_t timeout_ms){
     if(!module || !module->initialized)
         return DXLR02_ERR_NOT_INITIALIZED;
 
+    dxlr02_status_t st = dxlr02_read_until_raw(module, response, response_len, delim, times, timeout_ms);
+    dxlr02_record_rtt(module, st);
+    return st;
+}
+
+// Lo que llega despues del comando se separa por posicion: si el ring tiene un frame a medias, lo primero
+// es su cola; despues, lo que termina en '\0' es un frame (con los '\n' que traiga) y las respuestas AT son
+// lineas terminadas en "\r\n". Lo que no entra en response tampoco es una respuesta: va al ring como frame.
+static dxlr02_status_t dxlr02_read_until_raw(dxlr02_t *module, char * response, size_t response_len, char delim, size_t times, uint32_t timeout_ms){
+
     size_t i = 0, j = 0;
+    bool in_frame = (module->rx.wr != module->rx.commit) || module->rx.dropping;
     response[0] = '\0';
     int64_t init_time = esp_timer_get_time();
     int64_t timeout_us = (int64_t)timeout_ms * 1000;
-    bool delim_found = false;
-    for(j = 0; j < times; j++){
-        delim_found = false;
-        
-        while(i < response_len - 1){
-            if(esp_timer_get_time() - init_time > timeout_us){
-                return DXLR02_ERR_TIMEOUT;
-            }
+    if(module->at_deadline_us != 0 && init_time + timeout_us > module->at_deadline_us){
+        timeout_us = module->at_deadline_us - init_time;
+        if(timeout_us <= 0)
+            return DXLR02_ERR_TIMEOUT;
+    }
 
-            int read = uart_read_bytes((uart_port_t) module -> uart_port, response + i, 1, pdMS_TO_TICKS(TIMEOUT_ONE_BYTE_MS));
+    while(j < times){
+        int64_t remaining_us = timeout_us - (esp_timer_get_time() - init_time);
+        if(remaining_us < 0){
+            return DXLR02_ERR_TIMEOUT;
+        }
 
-            if(read < 0){
-                return DXLR02_ERR_UART;
-            }
-            else if(read == 0){
-                continue;
-            }
-            if(response[i] == delim){
-                
-                i++;
-                delim_found = true;
-                break;
-            } 
+        int read = uart_read_bytes((uart_port_t) module -> uart_port, response + i, 1, dxlr02_byte_wait(remaining_us));
 
-            i++;
+        if(read < 0){
+            return DXLR02_ERR_UART;
+        }
+        else if(read == 0){
+            continue;
         }
 
-        if(!delim_found){
-            response[i] = '\0';
-            return DXLR02_ERR_INVALID_RESPONSE;
+        char c = response[i];
+        if(in_frame){
+            dxlr02_rx_push_all(module, &c, 1);
+            in_frame = (c != '\0');
+            continue;
+        }
+        if(c == '\0'){
+            // Las respuestas AT nunca traen '\0': lo acumulado era un frame de datos
+            dxlr02_rx_push_all(module, response, i + 1);
+            i = 0;
+            j = 0;
+            continue;
         }
-    }
 
-    if(response[0] == '\0'){
-        return DXLR02_ERR_INVALID_RESPONSE;
+        i++;
+        if(c == delim && i >= 2 && response[i - 2] == '\r'){
+            j++;
+        } else if(i >= response_len - 1){
+            // Ninguna respuesta AT es tan larga: es el principio de un frame, el resto llega despues
+            dxlr02_rx_push_all(module, response, i);
+            in_frame = true;
+            i = 0;
+            j = 0;
+        }
     }
 
     response[i] = '\0';
-    if(j == times){
-        return DXLR02_OK;
-    }
-
-    return DXLR02_ERR_INVALID_RESPONSE;
+    return DXLR02_OK;
 }
 
 dxlr02_status_t dxlr02_send_cmd(dxlr02_t * module, const char * cmd){
@@ -91,274 +269,338 @@ dxlr02_status_t dxlr02_send_cmd(dxlr02_t * module, const char * cmd){
         return DXLR02_ERR_NOT_INITIALIZED;
     }
     
-    uart_flush_input((uart_port_t)module->uart_port);
+    dxlr02_status_t st = dxlr02_rx_drain(module);
+    if(st != DXLR02_OK)
+        return st;
     
+    module->at_sent_us = esp_timer_get_time();
     return dxlr02_uart_send(module, cmd, strlen(cmd)); 
 }
 
 /****************************************** AUXILIAR FUNCTIONS ******************************************/
 
-static dxlr02_status_t dxlr02_AT_mode(dxlr02_t * module){ 
+static bool dxlr02_is_power_on(const char * line){
+    return strcmp(line, "Power On\r\n") == 0 || strcmp(line, "Power on\r\n") == 0;
+}
+
+// Manda "+++" y mueve el estado segun lo que conteste el modulo. Al salir de AT el modulo reinicia y
+// aplica la configuracion; si habia un AT+BAUD pendiente el "Power On" ya llega con el baud nuevo.
+static dxlr02_status_t dxlr02_toggle_at(dxlr02_t * module){ 
     dxlr02_status_t st; 
     char response[25]; 
+    bool baud_change = (module->state == DXLR02_STATE_BAUD_CHANGE);
+
+    module->stats.at_toggles++;
     st = dxlr02_send_cmd(module, "+++\r\n");
-    if(st != DXLR02_OK) 
+    if(st != DXLR02_OK){
+        module->state = DXLR02_STATE_UNKNOWN;
         return st; 
+    }
 
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, pdMS_TO_TICKS(500)); 
-    
-    if(st != DXLR02_OK) 
+    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, DXLR02_AT_TIMEOUT_MS); 
+    if(st != DXLR02_OK){
+        module->state = DXLR02_STATE_UNKNOWN;
         return st; 
+    }
     
     if(strcmp(response, "Entry AT\r\n") == 0){ 
-        module -> mode_AT = true; 
+        module->state = DXLR02_STATE_AT; 
         return DXLR02_OK; 
-    } else if(strcmp(response, "Exit AT\r\n") == 0){ 
-        st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, pdMS_TO_TICKS(500)); 
-        if(st != DXLR02_OK) 
-        return st; 
-        
-        if(strcmp(response, "Power On\r\n") == 0 || strcmp(response, "Power on\r\n") == 0){
-            module -> mode_AT = false; 
+    }
+
+    if(strcmp(response, "Exit AT\r\n") == 0){ 
+        module->state = DXLR02_STATE_RESETTING;
+        if(baud_change && uart_set_baudrate((uart_port_t)module->uart_port, module->config.baudrate) != ESP_OK){
+            module->state = DXLR02_STATE_UNKNOWN;
+            return DXLR02_ERR_UART;
+        }
+
+        st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, DXLR02_AT_TIMEOUT_MS); 
+        if(st == DXLR02_OK && dxlr02_is_power_on(response)){
+            module->state = DXLR02_STATE_DATA; 
             return DXLR02_OK; 
         } 
     } 
     
-    return DXLR02_ERR_INVALID_RESPONSE; 
+    module->state = DXLR02_STATE_UNKNOWN;
+    return st != DXLR02_OK ? st : DXLR02_ERR_INVALID_RESPONSE; 
+}
+
+// Resincronizacion desde UNKNOWN: "+++" lo intercepta el modulo en los dos modos, asi que no sale nada por aire
+// (un "AT" en modo datos se transmitiria). Contesta "Entry AT" o "Exit AT" + "Power On" y el estado queda conocido.
+static dxlr02_status_t dxlr02_probe(dxlr02_t * module){
+    module->stats.probes++;
+    module->state = DXLR02_STATE_UNKNOWN;
+    return dxlr02_toggle_at(module);
 }
 
 dxlr02_status_t dxlr02_ensure_at(dxlr02_t* module){ 
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+
     dxlr02_status_t st; 
-    st = dxlr02_AT_mode(module); 
-    if(st != DXLR02_OK){
-        return st; 
+    if(module->state == DXLR02_STATE_UNKNOWN || module->state == DXLR02_STATE_RESETTING){
+        st = dxlr02_probe(module);
+        if(st != DXLR02_OK)
+            return st;
     }
-    if(!module->mode_AT){ 
-        st = dxlr02_AT_mode(module); 
-        if(st != DXLR02_OK) {
-            return st; 
-        }  
-    } 
-    return DXLR02_OK; 
+
+    if(module->state == DXLR02_STATE_AT || module->state == DXLR02_STATE_BAUD_CHANGE)
+        return DXLR02_OK;
+
+    st = dxlr02_toggle_at(module); 
+    if(st != DXLR02_OK)
+        return st; 
+
+    return module->state == DXLR02_STATE_AT ? DXLR02_OK : DXLR02_ERR_INVALID_RESPONSE; 
 } 
 
 dxlr02_status_t dxlr02_ensure_data_mode(dxlr02_t* module){ 
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+
     dxlr02_status_t st; 
-    st = dxlr02_AT_mode(module); 
+    if(module->state == DXLR02_STATE_UNKNOWN || module->state == DXLR02_STATE_RESETTING){
+        st = dxlr02_probe(module);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    if(module->state == DXLR02_STATE_DATA)
+        return DXLR02_OK;
+
+    st = dxlr02_toggle_at(module); 
     if(st != DXLR02_OK) 
         return st; 
     
-    if(module->mode_AT){ 
-        st = dxlr02_AT_mode(module); 
-        if(st != DXLR02_OK) 
-            return st; 
-    } 
-    
-    return DXLR02_OK; 
+    return module->state == DXLR02_STATE_DATA ? DXLR02_OK : DXLR02_ERR_INVALID_RESPONSE; 
 } 
 
+dxlr02_link_state_t dxlr02_get_state(const dxlr02_t * module){
+    if(!module || !module->initialized)
+        return DXLR02_STATE_UNKNOWN;
+    return module->state;
+}
 
+// Chequeo de vida: en modo datos el modulo no contesta nada, asi que la unica prueba es entrar y salir de AT.
+// Se olvida el estado conocido por si el modulo reinicio por su cuenta.
+dxlr02_status_t dxlr02_resync(dxlr02_t * module){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
 
-
-dxlr02_status_t dxlr02_set_baudrate(dxlr02_t * module, int baudrate){
+    module->state = DXLR02_STATE_UNKNOWN;
     dxlr02_status_t st = dxlr02_ensure_at(module);
     if(st != DXLR02_OK)
         return st;
 
-    switch(baudrate){
-        case 1200:
-        st = dxlr02_send_cmd(module, "AT+BAUD1\r\n");
-        break;
-
-        case 2400:
-            st = dxlr02_send_cmd(module, "AT+BAUD2\r\n");
-            break;
-
-        case 4800:
-            st = dxlr02_send_cmd(module, "AT+BAUD3\r\n");
-            break;
-
-        case 9600:
-            st = dxlr02_send_cmd(module, "AT+BAUD4\r\n");
-            break;
-
-        case 19200:
-            st = dxlr02_send_cmd(module, "AT+BAUD5\r\n");
-            break;
-
-        case 38400:
-            st = dxlr02_send_cmd(module, "AT+BAUD6\r\n");
-            break;
-
-        case 57600:
-            st = dxlr02_send_cmd(module, "AT+BAUD7\r\n");
-            break;
-
-        case 115200:
-            st = dxlr02_send_cmd(module, "AT+BAUD8\r\n");
-            break;
-
-        case 128000:
-            st = dxlr02_send_cmd(module, "AT+BAUD9\r\n");
-            break;
-
-        default:
-            st = DXLR02_ERR_INVALID_PARAMETER;
-            break;
-    }
+    return dxlr02_ensure_data_mode(module);
+}
 
-    if(st != DXLR02_OK)
-        return st;
+// Chequeo de vida sin reiniciar: en AT un "AT" (contesta "OK"); si no, se entra a AT y se queda ahi. El modulo
+// sigue recibiendo por aire y esos frames se guardan como en cualquier sesion AT; el reinicio llega recien con
+// el proximo dxlr02_ensure_data_mode (antes de mandar). Desde UNKNOWN el probe puede reiniciar igual.
+dxlr02_status_t dxlr02_ping(dxlr02_t * module){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(module->state != DXLR02_STATE_AT && module->state != DXLR02_STATE_BAUD_CHANGE)
+        return dxlr02_ensure_at(module);
 
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
+    dxlr02_status_t st = dxlr02_send_cmd(module, "AT\r\n");
     if(st != DXLR02_OK)
         return st;
 
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    st = dxlr02_ensure_data_mode(module);
+    char response[8];
+    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, DXLR02_AT_TIMEOUT_MS);
+    if(st == DXLR02_OK && strcmp(response, "OK\r\n") != 0)
+        st = DXLR02_ERR_INVALID_RESPONSE;
     if(st != DXLR02_OK)
-        return st;
-        
-    module->config.baudrate = baudrate;
-    return DXLR02_OK;
+        module->state = DXLR02_STATE_UNKNOWN;
+    return st;
 }
 
-dxlr02_status_t dxlr02_set_mode(dxlr02_t * module, uint8_t mode){
-    if(mode > 2)
-        return DXLR02_ERR_INVALID_PARAMETER;
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
+// AT+RESET y AT+DEFAULT contestan "OK" y reinician: el "Power On" llega con el baud que quede despues del reinicio
+static dxlr02_status_t dxlr02_restart_cmd(dxlr02_t * module, const char * cmd, int baudrate_after){
+    dxlr02_status_t st = dxlr02_send_cmd(module, cmd);
     if(st != DXLR02_OK)
         return st;
 
-    char cmd[12];
-    snprintf(cmd, sizeof(cmd), "AT+MODE%u\r\n", mode);
-
-    char expected_response[14];
-    snprintf(expected_response, sizeof(expected_response), "+MODE=%u\r\nOK\r\n", mode);
-
-    char response[14];
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
+    module->state = DXLR02_STATE_RESETTING;
 
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
+    char response[15];
+    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, DXLR02_AT_TIMEOUT_MS);
+    if(st != DXLR02_OK){
+        module->state = DXLR02_STATE_UNKNOWN;
         return st;
+    }
 
-    if(strcmp(response, expected_response) != 0)
+    if(strcmp(response, "OK\r\n") != 0){
+        module->state = DXLR02_STATE_UNKNOWN;
         return DXLR02_ERR_INVALID_RESPONSE;
+    }
 
-    module->config.working_mode = mode;
+    if(baudrate_after != module->config.baudrate && uart_set_baudrate((uart_port_t)module->uart_port, baudrate_after) != ESP_OK){
+        module->state = DXLR02_STATE_UNKNOWN;
+        return DXLR02_ERR_UART;
+    }
 
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-    
+    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, DXLR02_AT_TIMEOUT_MS);
+    if(st != DXLR02_OK || !dxlr02_is_power_on(response)){
+        module->state = DXLR02_STATE_UNKNOWN;
+        return st != DXLR02_OK ? st : DXLR02_ERR_INVALID_RESPONSE;
+    }
+
+    // Despues de reiniciar el modulo arranca en modo transmision
+    module->state = DXLR02_STATE_DATA;
     return DXLR02_OK;
 }
 
-dxlr02_status_t dxlr02_set_energy_mode(dxlr02_t * module, uint8_t mode){
-    // 1. Armo el string "AT+MODEx" con x: mode
-    if(mode > 2)
-        return DXLR02_ERR_INVALID_PARAMETER;
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[13];
-    snprintf(cmd, sizeof(cmd), "AT+SLEEP%u\r\n", mode);
+/****************************************** AT COMMAND TABLE ******************************************/
+
+typedef struct {
+    const char * cmd;           // "AT+KEY"
+    const char * echo;          // "+KEY="
+    uint8_t cmd_len;
+    uint8_t echo_len;
+    uint8_t min;
+    uint8_t max;
+    dxlr02_at_enc_t enc;
+    dxlr02_at_reply_t reply;
+} dxlr02_at_entry_t;
+
+static const dxlr02_at_entry_t dxlr02_at_table[DXLR02_AT_COUNT] = {
+#define DXLR02_AT_X_ENTRY(id, key, lo, hi, e, r) \
+    [DXLR02_AT_##id] = { "AT+" key, "+" key "=", sizeof("AT+" key) - 1, sizeof("+" key "=") - 1, lo, hi, e, r },
+    DXLR02_AT_TABLE(DXLR02_AT_X_ENTRY)
+#undef DXLR02_AT_X_ENTRY
+};
+
+// Indice = valor de AT+BAUD
+static const int dxlr02_baudrates[] = { 0, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 128000 };
+
+// Refleja en module->config un valor ya aceptado por el modulo
+static void dxlr02_at_apply(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value){
+    dxlr02_config_t * conf = &module->config;
+
+    switch(id){
+        case DXLR02_AT_BAUD:
+            // El baud nuevo se aplica cuando el modulo reinicia al salir de AT
+            conf->baudrate = dxlr02_baudrates[value];
+            module->state = DXLR02_STATE_BAUD_CHANGE;
+            break;
+        case DXLR02_AT_MODE:    conf->working_mode = value;     break;
+        case DXLR02_AT_SLEEP:   conf->energy_mode = value;      break;
+        case DXLR02_AT_STOP:    conf->stop_bit = value;         break;
+        case DXLR02_AT_PARI:    conf->parity = value;           break;
+        case DXLR02_AT_LEVEL:
+            // Un nivel fija SF = 12 - nivel y CR 4/6 (tabla de AT+LEVEL en la guia); un AT+SF / AT+CR
+            // posterior los pisa, igual que en el modulo
+            conf->rate_level = value;
+            conf->spread_factor = 12 - value;
+            conf->rf_coding_rate = 2;
+            break;
+        case DXLR02_AT_CHANNEL: conf->channel = value;          break;
+        case DXLR02_AT_MAC:     conf->address = value;          break;
+        case DXLR02_AT_POWE:    conf->transmit_power = value;   break;
+        case DXLR02_AT_CR:      conf->rf_coding_rate = value;   break;
+        case DXLR02_AT_SF:      conf->spread_factor = value;    break;
+        case DXLR02_AT_CRC:     conf->crc = value;              break;
+        case DXLR02_AT_IQ:      conf->iq_signal_flip = value;   break;
+        default:                                                break;
+    }
+}
 
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
+static bool dxlr02_at_valid(dxlr02_at_id_t id, uint8_t value){
+    return id < DXLR02_AT_COUNT && value >= dxlr02_at_table[id].min && value <= dxlr02_at_table[id].max;
+}
 
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
+dxlr02_status_t dxlr02_at_set(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value){
+    if(!dxlr02_at_valid(id, value))
+        return DXLR02_ERR_INVALID_PARAMETER;
 
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
+    const dxlr02_at_entry_t * entry = &dxlr02_at_table[id];
 
-    module->config.energy_mode = mode;
+    char cmd[DXLR02_AT_CMD_MAX];
+    size_t n = entry->cmd_len;
+    memcpy(cmd, entry->cmd, n);
+    n += dxlr02_at_encode(entry->enc, value, false, cmd + n);
+    memcpy(cmd + n, "\r\n", 3);
 
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
+    char expected[DXLR02_AT_REPLY_MAX];
+    if(entry->reply == DXLR02_AT_REPLY_ECHO){
+        n = entry->echo_len;
+        memcpy(expected, entry->echo, n);
+        n += dxlr02_at_encode(entry->enc, value, true, expected + n);
+        memcpy(expected + n, "\r\nOK\r\n", 7);
+    } else {
+        memcpy(expected, "OK\r\n", 5);
+    }
 
-    return DXLR02_OK;
+    return dxlr02_at_send_encoded(module, id, value, cmd, expected);
 }
 
-dxlr02_status_t dxlr02_set_stop_bit(dxlr02_t * module, uint8_t stop){       // stop es cantidad de bits de stop (0, 1 o 2)
-    if(stop > 2){
+dxlr02_status_t dxlr02_at_send_encoded(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value, const char * cmd, const char * expected){
+    if(id >= DXLR02_AT_COUNT || !cmd || !expected)
         return DXLR02_ERR_INVALID_PARAMETER;
-    }
 
     dxlr02_status_t st = dxlr02_ensure_at(module);
     if(st != DXLR02_OK)
         return st;
 
-    char cmd[12];
-    snprintf(cmd, sizeof(cmd), "AT+STOP%u\r\n", stop);
-
     st = dxlr02_send_cmd(module, cmd);
     if(st != DXLR02_OK)
         return st;
 
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.stop_bit = stop;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
+    size_t lines = dxlr02_at_table[id].reply == DXLR02_AT_REPLY_ECHO ? 2 : 1;
+    char response[DXLR02_AT_REPLY_MAX];
+    st = dxlr02_read_until(module, response, sizeof(response), '\n', lines, DXLR02_AT_TIMEOUT_MS);
+    if(st == DXLR02_OK && strcmp(response, expected) != 0)
+        st = DXLR02_ERR_INVALID_RESPONSE;
+    // Sin respuesta (o con otra) no se sabe si el modulo sigue en AT: el proximo uso hace el probe
+    if(st != DXLR02_OK){
+        module->state = DXLR02_STATE_UNKNOWN;
         return st;
+    }
 
+    dxlr02_at_apply(module, id, value);
     return DXLR02_OK;
 }
 
-dxlr02_status_t dxlr02_set_parity(dxlr02_t * module, uint8_t parity){
-    if(parity > 2){
+// Un cambio suelto: entra a AT, manda el comando y sale (el modulo reinicia y lo aplica)
+static dxlr02_status_t dxlr02_set_param(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value){
+    if(!dxlr02_at_valid(id, value))
         return DXLR02_ERR_INVALID_PARAMETER;
-    }
 
-    dxlr02_status_t st = dxlr02_ensure_at(module);
+    dxlr02_status_t st = dxlr02_at_set(module, id, value);
     if(st != DXLR02_OK)
         return st;
 
-    char cmd[12];
-    snprintf(cmd, sizeof(cmd), "AT+PARI%u\r\n", parity);
+    return dxlr02_ensure_data_mode(module);
+}
 
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
+/****************************************** SETTERS ******************************************/
 
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
+dxlr02_status_t dxlr02_set_baudrate(dxlr02_t * module, int baudrate){
+    for(uint8_t i = 1; i < sizeof(dxlr02_baudrates) / sizeof(dxlr02_baudrates[0]); i++){
+        if(dxlr02_baudrates[i] == baudrate)
+            return dxlr02_set_param(module, DXLR02_AT_BAUD, i);
+    }
+    return DXLR02_ERR_INVALID_PARAMETER;
+}
 
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
+dxlr02_status_t dxlr02_set_mode(dxlr02_t * module, uint8_t mode){
+    return dxlr02_set_param(module, DXLR02_AT_MODE, mode);
+}
 
-    module->config.parity = parity;
+dxlr02_status_t dxlr02_set_energy_mode(dxlr02_t * module, uint8_t mode){
+    return dxlr02_set_param(module, DXLR02_AT_SLEEP, mode);
+}
 
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
+dxlr02_status_t dxlr02_set_stop_bit(dxlr02_t * module, uint8_t stop){
+    return dxlr02_set_param(module, DXLR02_AT_STOP, stop);
+}
 
-    return DXLR02_OK;
+dxlr02_status_t dxlr02_set_parity(dxlr02_t * module, uint8_t parity){
+    return dxlr02_set_param(module, DXLR02_AT_PARI, parity);
 }
 
 dxlr02_status_t dxlr02_reset(dxlr02_t * module){
@@ -366,23 +608,7 @@ dxlr02_status_t dxlr02_reset(dxlr02_t * module){
     if(st != DXLR02_OK)
         return st;
 
-    st = dxlr02_send_cmd(module, "AT+RESET\r\n");
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[15];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, "OK\r\nPower On\r\n") != 0 && strcmp(response, "OK\r\nPower on\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_restart_cmd(module, "AT+RESET\r\n", module->config.baudrate);
 }
 
 dxlr02_status_t dxlr02_set_default(dxlr02_t * module){
@@ -391,18 +617,10 @@ dxlr02_status_t dxlr02_set_default(dxlr02_t * module){
         return st;
     }
 
-    st = dxlr02_send_cmd(module, "AT+DEFAULT\r\n");
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[15];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
+    st = dxlr02_restart_cmd(module, "AT+DEFAULT\r\n", 9600);
     if(st != DXLR02_OK)
         return st;
 
-    if(strcmp(response, "OK\r\nPower On\r\n") != 0 && strcmp(response, "OK\r\nPower on\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
     module->config.address = 0xff;
     module->config.baudrate = 9600;
     module->config.channel = 0;
@@ -417,288 +635,43 @@ dxlr02_status_t dxlr02_set_default(dxlr02_t * module){
     module->config.transmit_power = 22;
     module->config.working_mode = 0;
 
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
     return DXLR02_OK;
 }
 
 dxlr02_status_t dxlr02_set_level(dxlr02_t * module, uint8_t level){
-    if(level > 7){
-        return DXLR02_ERR_INVALID_PARAMETER;
-    }
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[13];
-    snprintf(cmd, sizeof(cmd), "AT+LEVEL%u\r\n", level);
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.rate_level = level;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_LEVEL, level);
 }
 
 dxlr02_status_t dxlr02_set_channel(dxlr02_t * module, uint8_t ch){
-    if(ch > 0x1E){
-        return DXLR02_ERR_INVALID_PARAMETER;
-    }
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[20];
-    snprintf(cmd, sizeof(cmd), "AT+CHANNEL%02X\r\n", ch);
-
-    char expected_response[20];
-    snprintf(expected_response, sizeof(expected_response), "+CHANNEL=%02X\r\nOK\r\n", ch);
- 
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[20];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, expected_response) != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-        
-    module->config.channel = ch;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_CHANNEL, ch);
 }
 
 dxlr02_status_t dxlr02_set_mac(dxlr02_t * module, uint8_t mac){
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-    
-    char high[3];
-    char low[3];
-
-    snprintf(high, sizeof(high), "%02X", (mac >> 4) & 0xFF);
-    snprintf(low, sizeof(low), "%02X", mac & 0xFF);
-
-    char cmd[20];
-    snprintf(cmd, sizeof(cmd), "AT+MAC%s,%s\r\n", high, low);
-    char expected_response[20];
-    snprintf(expected_response, sizeof(expected_response), "+MAC=%s%s\r\nOK\r\n", high, low);
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[20];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, expected_response) != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.address = mac;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_MAC, mac);
 }
 
-
 dxlr02_status_t dxlr02_set_transmit_power(dxlr02_t * module, uint8_t pow){
-    if(pow > 22){
-        return DXLR02_ERR_INVALID_PARAMETER;
-    }
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[20];
-    snprintf(cmd, sizeof(cmd), "AT+POWE%u\r\n", pow);
-
-    char expected_response[20];
-    snprintf(expected_response, sizeof(expected_response), "+POWE=%u\r\nOK\r\n", pow);
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    module->config.transmit_power = pow;
-
-    char response[20];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, expected_response) != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_POWE, pow);
 }
 
 dxlr02_status_t dxlr02_set_coding_rate(dxlr02_t * module, uint8_t four_of_x){ // 4/5, 4/6, 4/7, 4/8
     if(four_of_x < 5 || four_of_x > 8)
         return DXLR02_ERR_INVALID_PARAMETER;
 
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[10];
-    snprintf(cmd, sizeof(cmd), "AT+CR%u\r\n", four_of_x - 4);
-
-    char expected_response[20];
-    snprintf(expected_response, sizeof(expected_response), "+CR=%u\r\nOK\r\n", four_of_x - 4);
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[20];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, expected_response) != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.rf_coding_rate = four_of_x;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    // En config se guarda como AT+CR: 1 (4/5) .. 4 (4/8)
+    return dxlr02_set_param(module, DXLR02_AT_CR, four_of_x - 4);
 }
 
-
 dxlr02_status_t dxlr02_set_spread_factor(dxlr02_t * module, uint8_t sf){
-    if(sf < 5 || sf > 12){
-        return DXLR02_ERR_INVALID_PARAMETER;
-    }
-
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    char cmd[10];
-    snprintf(cmd, sizeof(cmd), "AT+SF%u\r\n", sf);
-
-    char expected_response[20];
-    snprintf(expected_response, sizeof(expected_response), "+SF=%u\r\nOK\r\n", sf);
-
-    st = dxlr02_send_cmd(module, cmd);
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[20];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 2, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, expected_response) != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.spread_factor = sf;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_SF, sf);
 }
 
 dxlr02_status_t dxlr02_set_crc(dxlr02_t * module, bool crc){
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(crc){
-        st = dxlr02_send_cmd(module, "AT+CRC1\r\n");
-    } else {
-        st = dxlr02_send_cmd(module, "AT+CRC0\r\n");
-    }
-
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.crc = crc;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_CRC, crc);
 }
 
 dxlr02_status_t dxlr02_set_iq_flip(dxlr02_t * module, bool flip){
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(flip){
-        st = dxlr02_send_cmd(module, "AT+IQ1\r\n");
-    } else {
-        st = dxlr02_send_cmd(module, "AT+IQ0\r\n");
-    }
-
-    if(st != DXLR02_OK)
-        return st;
-
-    char response[5];
-    st = dxlr02_read_until(module, response, sizeof(response), '\n', 1, 500);
-    if(st != DXLR02_OK)
-        return st;
-
-    if(strcmp(response, "OK\r\n") != 0)
-        return DXLR02_ERR_INVALID_RESPONSE;
-
-    module->config.iq_signal_flip = flip;
-
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
-
-    return DXLR02_OK;
+    return dxlr02_set_param(module, DXLR02_AT_IQ, flip);
 }
 
 /**********************************/
@@ -709,7 +682,12 @@ dxlr02_status_t dxlr02_init(dxlr02_t * module, uint8_t port, int baudrate){
     if(module -> initialized)
         return DXLR02_ERR_ALREADY_INIT;
     module -> uart_port = port;
-    module -> mode_AT = false;
+    module -> state = DXLR02_STATE_UNKNOWN;
+    module -> config.baudrate = baudrate;
+    memset(&module -> rx, 0, sizeof(module -> rx));
+    memset(&module -> stats, 0, sizeof(module -> stats));
+    module -> at_sent_us = 0;
+    module -> rx_last_us = 0;
 
     module -> initialized = true;
 
@@ -731,136 +709,172 @@ dxlr02_status_t dxlr02_init(dxlr02_t * module, uint8_t port, int baudrate){
 }
 
 dxlr02_status_t dxlr02_set_config(dxlr02_t * module, const dxlr02_config_t * conf){
-    dxlr02_status_t st = dxlr02_ensure_at(module);
-    if(st != DXLR02_OK)
-        return st;
+    if(!conf)
+        return DXLR02_ERR_INVALID_PARAMETER;
 
-    st = dxlr02_set_baudrate(module, conf -> baudrate);
-    if(st != DXLR02_OK){
-        return st;
+    uint8_t baud = 0;
+    for(uint8_t i = 1; i < sizeof(dxlr02_baudrates) / sizeof(dxlr02_baudrates[0]); i++){
+        if(dxlr02_baudrates[i] == conf -> baudrate)
+            baud = i;
     }
 
-    st = dxlr02_set_mode(module, conf -> working_mode);
-    if(st != DXLR02_OK){
-        return st;
+    const struct {
+        dxlr02_at_id_t id;
+        uint8_t value;
+    } steps[] = {
+        { DXLR02_AT_BAUD,    baud },
+        { DXLR02_AT_MODE,    conf -> working_mode },
+        { DXLR02_AT_SLEEP,   conf -> energy_mode },
+        { DXLR02_AT_STOP,    conf -> stop_bit },
+        { DXLR02_AT_PARI,    conf -> parity },
+        { DXLR02_AT_LEVEL,   conf -> rate_level },
+        { DXLR02_AT_CHANNEL, conf -> channel },
+        { DXLR02_AT_MAC,     conf -> address },
+        { DXLR02_AT_POWE,    conf -> transmit_power },
+        { DXLR02_AT_CR,      conf -> rf_coding_rate },
+        { DXLR02_AT_SF,      conf -> spread_factor },
+        { DXLR02_AT_CRC,     conf -> crc },
+        { DXLR02_AT_IQ,      conf -> iq_signal_flip },
+    };
+
+    // Se valida todo antes de tocar el modulo
+    for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++){
+        if(!dxlr02_at_valid(steps[i].id, steps[i].value))
+            return DXLR02_ERR_INVALID_PARAMETER;
     }
 
-    st = dxlr02_set_energy_mode(module, conf -> energy_mode);
-    if(st != DXLR02_OK){
-        return st;
+    // Una sola sesion AT: el modulo aplica todo junto al reiniciar cuando se sale
+    for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++){
+        dxlr02_status_t st = dxlr02_at_set(module, steps[i].id, steps[i].value);
+        if(st != DXLR02_OK)
+            return st;
     }
 
+    return dxlr02_ensure_data_mode(module);
+}
 
-    st = dxlr02_set_stop_bit(module, conf -> stop_bit);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_parity(module, conf -> parity);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_level(module, conf -> rate_level);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_channel(module, conf -> channel);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_mac(module, conf -> address);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_transmit_power(module, conf -> transmit_power);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_coding_rate(module, conf -> rf_coding_rate);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_spread_factor(module, conf -> spread_factor);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_crc(module, conf -> crc);
-    if(st != DXLR02_OK){
-        return st;
-    }
-    
-    st = dxlr02_set_iq_flip(module, conf -> iq_signal_flip);
-    if(st != DXLR02_OK){
-        return st;
-    }
 
-    st = dxlr02_ensure_data_mode(module);
-    if(st != DXLR02_OK)
-        return st;
 
+dxlr02_status_t dxlr02_get_config(dxlr02_t * module, dxlr02_config_t * conf){
+    // TO DO
     return DXLR02_OK;
 }
 
+// hdr: prefijo de direccionamiento que el modulo consume en modo fixed-point / broadcast (no sale por aire)
+static dxlr02_status_t dxlr02_send_framed(dxlr02_t *module, const char *hdr, size_t hdr_len, const char *data, size_t size){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(!data || size == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
 
+    int64_t t0 = esp_timer_get_time();
+    dxlr02_status_t st = DXLR02_OK;
 
-dxlr02_status_t dxlr02_get_config(dxlr02_t * module, dxlr02_config_t * conf){
-    // TO DO
-    return DXLR02_OK;
+    if(hdr_len > 0)
+        st = dxlr02_uart_send(module, hdr, hdr_len);
+
+    if(st == DXLR02_OK)
+        st = dxlr02_uart_send(module, data, size);
+
+    // Sin copia a un buffer auxiliar: el '\0' va en una segunda escritura al buffer de TX de la UART
+    if(st == DXLR02_OK && data[size - 1] != '\0')
+        st = dxlr02_uart_send(module, "", 1);
+
+    module->stats.tx_time_us += esp_timer_get_time() - t0;
+    if(st == DXLR02_OK){
+        module->stats.frames_tx++;
+        module->stats.bytes_tx += size;
+    }
+    return st;
 }
 
 dxlr02_status_t dxlr02_send_data(dxlr02_t *module, const char *data, size_t size){
     // En el flujo del programa se debe estar en data_mode, es responsabilidad de quien llama a esta función
     // Las cadenas se envian con un \0
 
+    return dxlr02_send_framed(module, NULL, 0, data, size);
+}
+
+dxlr02_status_t dxlr02_send_to(dxlr02_t *module, uint16_t address, uint8_t channel, const char *data, size_t size){
     if(!module || !module->initialized)
         return DXLR02_ERR_NOT_INITIALIZED;
-    if(!data || size == 0)
+    if(module->config.working_mode != 1 || channel > 0x1E)
         return DXLR02_ERR_INVALID_PARAMETER;
 
-    if (data[size - 1] == '\0')
-        return dxlr02_uart_send(module, data, size);
+    const char hdr[3] = { (char)(address >> 8), (char)(address & 0xFF), (char)channel };
+    return dxlr02_send_framed(module, hdr, sizeof(hdr), data, size);
+}
+
+dxlr02_status_t dxlr02_broadcast(dxlr02_t *module, uint8_t channel, const char *data, size_t size){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(module->config.working_mode != 2 || channel > 0x1E)
+        return DXLR02_ERR_INVALID_PARAMETER;
 
-    char aux[size + 1];
-    memcpy(aux, data, size);
-    aux[size] = '\0';
-    return dxlr02_uart_send(module, aux, size + 1);
+    const char hdr[1] = { (char)channel };
+    return dxlr02_send_framed(module, hdr, sizeof(hdr), data, size);
 }
 
 
-dxlr02_status_t dxlr02_receive_data(dxlr02_t * module, char * data, size_t max_size, size_t * eff_len){
-    // En el flujo del programa se debe estar en data_mode, es responsabilidad de quien llama a esta función
-    // Asume que las cadenas se envian con un \0
+static dxlr02_status_t dxlr02_receive_frame(dxlr02_t * module, char * data, size_t max_size, size_t * eff_len);
 
+dxlr02_status_t dxlr02_receive_data(dxlr02_t * module, char * data, size_t max_size, size_t * eff_len){
     if(!module || !module->initialized)
         return DXLR02_ERR_NOT_INITIALIZED;
 
+    size_t len = 0;
+    int64_t t0 = esp_timer_get_time();
+    dxlr02_status_t st = dxlr02_receive_frame(module, data, max_size, &len);
+
+    module->stats.rx_time_us += esp_timer_get_time() - t0;
+    if(st == DXLR02_OK){
+        module->stats.frames_rx++;
+        module->stats.bytes_rx += len;
+        if(eff_len)
+            *eff_len = len;
+    }
+    return st;
+}
+
+static dxlr02_status_t dxlr02_receive_frame(dxlr02_t * module, char * data, size_t max_size, size_t * eff_len){
+    // En el flujo del programa se debe estar en data_mode, es responsabilidad de quien llama a esta función
+    // Asume que las cadenas se envian con un \0
+
     if(!data || max_size == 0)
         return DXLR02_ERR_INVALID_PARAMETER;
 
     size_t i = 0;
     data[0] = '\0';
+
+    // Primero lo que se guardo durante la ultima sesion AT
+    while(i < max_size - 1 && dxlr02_rx_pop(module, data + i)){
+        if(data[i] == '\0'){
+            *eff_len = i;
+            return DXLR02_OK;
+        }
+        i++;
+    }
+
     int64_t init_time = esp_timer_get_time();
     int64_t timeout_us = (int64_t)TIMEOUT_READ_US;
 
     while(i < max_size - 1){
-        if(esp_timer_get_time() - init_time > timeout_us)
+        int64_t remaining_us = timeout_us - (esp_timer_get_time() - init_time);
+        if(remaining_us < 0)
             return DXLR02_ERR_TIMEOUT;
 
-        int read = uart_read_bytes((uart_port_t) module -> uart_port, data + i, 1, pdMS_TO_TICKS(TIMEOUT_ONE_BYTE_MS));
+        int read = uart_read_bytes((uart_port_t) module -> uart_port, data + i, 1, dxlr02_byte_wait(remaining_us));
 
         if(read < 0)
             return DXLR02_ERR_UART;
         else if(read == 0)
             continue;
+        module->stats.uart_rx_bytes++;
+        if(dxlr02_rx_skip_dropped(module, data + i, 1) == 0)
+            continue;
 
         if(data[i] == '\0'){
+            *eff_len = i;
             return DXLR02_OK;
         } 
 
@@ -868,7 +882,195 @@ dxlr02_status_t dxlr02_receive_data(dxlr02_t * module, char * data, size_t max_s
     }
 
     data[max_size - 1] = '\0';
+    dxlr02_rx_discard_frame(module);
     
     return DXLR02_ERR_OUT_OF_SPACE;
 
-}
\ No newline at end of file
+}
+
+dxlr02_status_t dxlr02_receive_batch(dxlr02_t * module, char * buf, size_t buf_len, dxlr02_frame_t * frames, size_t max_frames,
+                                     size_t min_frames, uint32_t max_wait_ms, size_t * n_frames){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(!buf || buf_len == 0 || !frames || max_frames == 0 || min_frames > max_frames || !n_frames)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline = t0 + (int64_t)max_wait_ms * 1000;
+    size_t n = 0, used = 0, start = 0;
+    dxlr02_status_t st = DXLR02_OK;
+    bool waited = false;
+
+    module->rx_last_us = 0;
+
+    // 1. Lo que quedo en el ring (sesiones AT o sobrante de la llamada anterior)
+    while(n < max_frames && used < buf_len && dxlr02_rx_pop(module, buf + used)){
+        used++;
+        if(buf[used - 1] == '\0'){
+            frames[n].data = buf + start;
+            frames[n].len = used - 1 - start;
+            n++;
+            start = used;
+        }
+    }
+
+    // 2. UART, de a bloques. Solo si el ring quedo vacio, para no desordenar
+    bool ring_empty = (module->rx.rd == module->rx.wr);
+    while(ring_empty && n < max_frames && used < buf_len){
+        size_t avail = 0;
+        if(uart_get_buffered_data_len((uart_port_t)module->uart_port, &avail) != ESP_OK){
+            st = DXLR02_ERR_UART;
+            break;
+        }
+
+        size_t want = buf_len - used;
+        TickType_t ticks = 0;
+        if(avail > 0){
+            if(want > avail)
+                want = avail;
+        } else {
+            int64_t remaining_us = deadline - esp_timer_get_time();
+            if(n >= min_frames || remaining_us <= 0)
+                break;
+            want = 1;
+            ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+            if(ticks == 0)
+                ticks = 1;
+        }
+
+        int read = uart_read_bytes((uart_port_t)module->uart_port, buf + used, want, ticks);
+        if(read < 0){
+            st = DXLR02_ERR_UART;
+            break;
+        }
+
+        // Despues de una espera con el buffer vacio, lo que se lee llego recien: el momento de la lectura es
+        // la llegada. Sin espera previa no se sabe cuanto hace que estaba ahi.
+        if(ticks > 0 && read > 0)
+            waited = true;
+        module->stats.uart_rx_bytes += (uint32_t)read;
+
+        size_t scan = used, before = n;
+        used += dxlr02_rx_skip_dropped(module, buf + used, (size_t)read);
+        while(n < max_frames){
+            char * end = memchr(buf + scan, '\0', used - scan);
+            if(!end)
+                break;
+            frames[n].data = buf + start;
+            frames[n].len = (size_t)(end - (buf + start));
+            n++;
+            start = scan = (size_t)(end - buf) + 1;
+        }
+        if(n > before)
+            module->rx_last_us = waited ? esp_timer_get_time() : 0;
+    }
+
+    // 3. Sobrante: vuelve al ring para la proxima llamada
+    if(start == 0 && used == buf_len && n == 0){
+        // Un solo frame no entra en buf: se descarta entero, como en dxlr02_receive_data. Si quedara la cola,
+        // la proxima llamada la entregaria como un frame.
+        st = DXLR02_ERR_OUT_OF_SPACE;
+        dxlr02_rx_discard_frame(module);
+    } else if(!ring_empty){
+        dxlr02_rx_unpop(module, used - start);
+    } else {
+        for(size_t k = start; k < used; k++)
+            dxlr02_rx_push(module, buf[k]);
+    }
+
+    module->stats.rx_time_us += esp_timer_get_time() - t0;
+    module->stats.frames_rx += n;
+    for(size_t k = 0; k < n; k++)
+        module->stats.bytes_rx += frames[k].len;
+
+    *n_frames = n;
+    if(st != DXLR02_OK)
+        return st;
+    return n > 0 ? DXLR02_OK : DXLR02_ERR_TIMEOUT;
+}
+
+dxlr02_status_t dxlr02_requeue_frame(dxlr02_t * module, const char * data, size_t len){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(!data && len > 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_rx_ring_t *ring = &module->rx;
+    if(ring->wr - ring->rd + len + 1 > DXLR02_RX_RING_LEN){
+        module->stats.frames_lost++;
+        return DXLR02_ERR_OUT_OF_SPACE;
+    }
+
+    // Delante de rd: no toca commit ni un frame parcial al final
+    ring->rd -= (uint32_t)len + 1;
+    for(size_t k = 0; k < len; k++)
+        ring->buf[(ring->rd + k) & DXLR02_RX_RING_MASK] = data[k];
+    ring->buf[(ring->rd + len) & DXLR02_RX_RING_MASK] = '\0';
+
+    // Se vuelve a contar cuando se entregue
+    if(module->stats.frames_rx > 0){
+        module->stats.frames_rx--;
+        module->stats.bytes_rx -= module->stats.bytes_rx >= len ? (uint32_t)len : module->stats.bytes_rx;
+    }
+    return DXLR02_OK;
+}
+
+uint32_t dxlr02_rx_activity(dxlr02_t * module){
+    if(!module || !module->initialized)
+        return 0;
+
+    // Primero la UART: si otra tarea lee entre las dos lecturas el resultado sobra, no falta
+    size_t pending = 0;
+    uart_get_buffered_data_len((uart_port_t)module->uart_port, &pending);
+    return module->stats.uart_rx_bytes + (uint32_t)pending;
+}
+
+dxlr02_status_t dxlr02_get_stats(const dxlr02_t * module, dxlr02_stats_t * stats){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(!stats)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    *stats = module->stats;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_reset_stats(dxlr02_t * module){
+    if(!module || !module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+
+    memset(&module->stats, 0, sizeof(module->stats));
+    return DXLR02_OK;
+}
+
+// Formato pensado para guardarlo por commit y comparar: todos los contadores tal cual, sin derivar nada
+dxlr02_status_t dxlr02_stats_to_json(const dxlr02_stats_t * stats, char * buf, size_t len){
+    if(!stats || !buf || len == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    int n = snprintf(buf, len,
+        "{\"frames_recovered\":%lu,\"frames_lost\":%lu,\"at_toggles\":%lu,\"probes\":%lu,"
+        "\"at_round_trips\":%lu,\"at_errors\":%lu,\"at_time_us\":%llu,\"at_rtt_max_us\":%lu,"
+        "\"frames_tx\":%lu,\"bytes_tx\":%lu,\"tx_time_us\":%llu,"
+        "\"frames_rx\":%lu,\"bytes_rx\":%lu,\"rx_time_us\":%llu,\"at_rtt_hist_ms\":[",
+        (unsigned long)stats->frames_recovered, (unsigned long)stats->frames_lost,
+        (unsigned long)stats->at_toggles, (unsigned long)stats->probes,
+        (unsigned long)stats->at_round_trips, (unsigned long)stats->at_errors,
+        (unsigned long long)stats->at_time_us, (unsigned long)stats->at_rtt_max_us,
+        (unsigned long)stats->frames_tx, (unsigned long)stats->bytes_tx, (unsigned long long)stats->tx_time_us,
+        (unsigned long)stats->frames_rx, (unsigned long)stats->bytes_rx, (unsigned long long)stats->rx_time_us);
+    if(n < 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    size_t used = (size_t)n;
+    for(size_t b = 0; b < DXLR02_RTT_BUCKETS && used < len; b++){
+        n = snprintf(buf + used, len - used, b == 0 ? "%lu" : ",%lu", (unsigned long)stats->at_rtt_hist[b]);
+        if(n < 0)
+            return DXLR02_ERR_INVALID_PARAMETER;
+        used += (size_t)n;
+    }
+    if(used < len)
+        used += (size_t)snprintf(buf + used, len - used, "]}");
+
+    return used < len ? DXLR02_OK : DXLR02_ERR_OUT_OF_SPACE;
+}
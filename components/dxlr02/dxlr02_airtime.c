@@ -0,0 +1,60 @@
+#include "dxlr02_airtime.h"
+#include <math.h>
+
+// Formula de time-on-air de Semtech (SX126x). Todo en cuartos de simbolo para no usar punto flotante.
+uint32_t dxlr02_time_on_air_us(const dxlr02_config_t * conf, size_t payload_len){
+    if(!conf)
+        return 0;
+
+    uint32_t sf = conf->spread_factor;
+    uint32_t cr = conf->rf_coding_rate;         // 1 (4/5) .. 4 (4/8)
+    if(sf < 5 || sf > 12 || cr < 1 || cr > 4)
+        return 0;
+
+    uint32_t symbol_us = (1000000u << sf) / DXLR02_BW_HZ;      // 2^SF / BW: 8 us * 2^SF a 125 kHz
+    bool ldro = symbol_us >= 16384;                             // low data rate optimize: SF11 y SF12
+    int32_t crc_bits = conf->crc ? 16 : 0;
+
+    int32_t bits;
+    uint32_t per_block;
+    uint32_t preamble_quarters;
+    if(sf <= 6){
+        bits = 8 * (int32_t)payload_len + crc_bits - 4 * (int32_t)sf + 20;
+        per_block = 4 * sf;
+        preamble_quarters = 4 * DXLR02_PREAMBLE_SYMBOLS + 25;      // + 6.25
+    } else {
+        bits = 8 * (int32_t)payload_len + crc_bits - 4 * (int32_t)sf + 8 + 20;
+        per_block = 4 * (ldro ? sf - 2 : sf);
+        preamble_quarters = 4 * DXLR02_PREAMBLE_SYMBOLS + 17;      // + 4.25
+    }
+
+    uint32_t blocks = bits > 0 ? ((uint32_t)bits + per_block - 1) / per_block : 0;
+    uint32_t payload_symbols = 8 + blocks * (cr + 4);
+
+    uint64_t quarters = preamble_quarters + 4 * (uint64_t)payload_symbols;
+    return (uint32_t)(quarters * symbol_us / 4);
+}
+
+uint32_t dxlr02_uart_time_us(const dxlr02_config_t * conf, size_t len){
+    if(!conf || conf->baudrate <= 0)
+        return 0;
+
+    uint32_t bits_per_byte = 1 + 8 + (conf->parity ? 1 : 0) + (conf->stop_bit ? 2 : 1);
+    return (uint32_t)(((uint64_t)len * bits_per_byte * 1000000u) / (uint32_t)conf->baudrate);
+}
+
+uint32_t dxlr02_channel_freq_khz(uint8_t channel){
+    return DXLR02_CH0_FREQ_KHZ + (uint32_t)channel * DXLR02_CH_STEP_KHZ;
+}
+
+float dxlr02_aloha_delivery_ratio(uint32_t nodes, uint32_t toa_us, uint32_t period_ms){
+    if(period_ms == 0)
+        return 0.0f;
+    if(nodes <= 1)
+        return 1.0f;
+
+    // Un paquete sobrevive si ninguno de los otros nodes - 1 empieza a transmitir en la ventana de 2 * toa
+    // que lo rodea (un nodo no se pisa a si mismo: el modulo transmite sus paquetes de a uno)
+    float load = (float)(nodes - 1) * (float)toa_us / ((float)period_ms * 1000.0f);
+    return expf(-2.0f * load);
+}
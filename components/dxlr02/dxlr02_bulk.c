@@ -0,0 +1,820 @@
+#include "dxlr02_bulk.h"
+#include "dxlr02_pool.h"
+#include "dxlr02_fec.h"
+#include "dxlr02_airtime.h"
+#include "dxlr02_storage.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#define DXLR02_BULK_CRC_LEN         2
+#define DXLR02_BULK_START_LEN       18
+#define DXLR02_BULK_ACK_LEN         11
+#define DXLR02_BULK_COPY_ENTRY      6
+#define DXLR02_BULK_ACK_MARGIN_MS   500         // procesamiento del receptor + cambio TX/RX
+#define DXLR02_BULK_DIFF_CHUNK      1024        // ventana de lectura de la imagen vieja en el diff
+
+static void dxlr02_put16(uint8_t * p, uint16_t v){
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static void dxlr02_put32(uint8_t * p, uint32_t v){
+    dxlr02_put16(p, v >> 16);
+    dxlr02_put16(p + 2, v & 0xFFFF);
+}
+
+static uint16_t dxlr02_get16(const uint8_t * p){
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t dxlr02_get32(const uint8_t * p){
+    return (uint32_t)dxlr02_get16(p) << 16 | dxlr02_get16(p + 2);
+}
+
+static bool dxlr02_bit(const uint8_t * map, uint32_t i){
+    return map[i >> 3] & (1 << (i & 7));
+}
+
+static void dxlr02_set_bit(uint8_t * map, uint32_t i){
+    map[i >> 3] |= 1 << (i & 7);
+}
+
+static uint32_t dxlr02_block_len(uint32_t size, uint16_t block_size, uint32_t index){
+    uint32_t off = index * block_size;
+    return size - off < block_size ? size - off : block_size;
+}
+
+size_t dxlr02_bulk_max_block(void){
+    return dxlr02_cobs_max_raw() - DXLR02_BULK_HEADER_LEN - 2 - DXLR02_BULK_CRC_LEN;
+}
+
+// crc32 de los primeros size bytes de la imagen
+static dxlr02_status_t dxlr02_image_crc(const dxlr02_bulk_image_t * img, uint32_t size, uint32_t * crc){
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    *crc = 0;
+    for(uint32_t off = 0; off < size && st == DXLR02_OK; off += DXLR02_POOL_BLOCK_SIZE){
+        size_t n = size - off < DXLR02_POOL_BLOCK_SIZE ? size - off : DXLR02_POOL_BLOCK_SIZE;
+        st = img->read(img->ctx, off, buf->data, n);
+        if(st == DXLR02_OK)
+            *crc = dxlr02_crc32(buf->data, n, *crc);
+    }
+
+    dxlr02_pool_release(buf);
+    return st;
+}
+
+// Arma y manda una trama; wire_len queda con lo que ocupo en la UART (con el terminador)
+static dxlr02_status_t dxlr02_bulk_emit(dxlr02_t * module, uint8_t type, uint16_t session,
+                                        const uint8_t * body, size_t len, size_t * wire_len){
+    dxlr02_buf_t * raw;
+    dxlr02_buf_t * wire;
+
+    if(DXLR02_BULK_HEADER_LEN + len + DXLR02_BULK_CRC_LEN > dxlr02_cobs_max_raw())
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_status_t st = dxlr02_pool_acquire(&raw);
+    if(st != DXLR02_OK)
+        return st;
+    st = dxlr02_pool_acquire(&wire);
+    if(st != DXLR02_OK){
+        dxlr02_pool_release(raw);
+        return st;
+    }
+
+    uint8_t * p = (uint8_t *)raw->data;
+    p[0] = DXLR02_BULK_MAGIC;
+    p[1] = type;
+    dxlr02_put16(p + 2, session);
+    if(len > 0)
+        memcpy(p + DXLR02_BULK_HEADER_LEN, body, len);
+    size_t n = DXLR02_BULK_HEADER_LEN + len;
+    dxlr02_put16(p + n, dxlr02_crc16(p, n, 0xFFFF));
+    n += DXLR02_BULK_CRC_LEN;
+
+    size_t w = dxlr02_cobs_encode(p, n, (uint8_t *)wire->data);
+    st = dxlr02_send_data(module, wire->data, w);
+    if(wire_len)
+        *wire_len = w + 1;
+
+    dxlr02_pool_release(wire);
+    dxlr02_pool_release(raw);
+    return st;
+}
+
+// Decodifica en buf y valida magic y crc. Devuelve el largo del cuerpo.
+static dxlr02_status_t dxlr02_bulk_parse(const char * frame, size_t len, dxlr02_buf_t * buf, size_t * body_len){
+    size_t n;
+    uint8_t * p = (uint8_t *)buf->data;
+
+    if(!frame || len == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    dxlr02_status_t st = dxlr02_cobs_decode((const uint8_t *)frame, len, p, DXLR02_POOL_BLOCK_SIZE, &n);
+    if(st != DXLR02_OK || n < DXLR02_BULK_HEADER_LEN + DXLR02_BULK_CRC_LEN || p[0] != DXLR02_BULK_MAGIC)
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    n -= DXLR02_BULK_CRC_LEN;
+    if(dxlr02_crc16(p, n, 0xFFFF) != dxlr02_get16(p + n))
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    *body_len = n - DXLR02_BULK_HEADER_LEN;
+    return DXLR02_OK;
+}
+
+/****************************************** DIFF ******************************************/
+
+// Hash debil de rsync: a = suma de bytes, b = suma de las a parciales, ambos mod 2^16
+static uint32_t dxlr02_weak(const uint8_t * p, size_t len){
+    uint16_t a = 0, b = 0;
+    for(size_t i = 0; i < len; i++){
+        a += p[i];
+        b += a;
+    }
+    return (uint32_t)b << 16 | a;
+}
+
+static uint32_t dxlr02_weak_bucket(uint32_t h, uint32_t mask){
+    return ((h * 0x9E3779B1u) >> 16) & mask;
+}
+
+dxlr02_status_t dxlr02_bulk_diff(const dxlr02_bulk_image_t * old, const dxlr02_bulk_image_t * img, uint16_t block_size,
+                                 uint32_t * plan, uint32_t * work, size_t work_words, uint32_t * copies){
+    if(!img || !plan || block_size == 0 || block_size > dxlr02_bulk_max_block() || img->size == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    uint32_t n_blocks = (img->size + block_size - 1) / block_size;
+    uint32_t full = img->size / block_size;
+    if(n_blocks > DXLR02_BULK_MAX_BLOCKS)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(old && (!work || work_words < DXLR02_BULK_DIFF_WORDS(n_blocks)))
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    for(uint32_t i = 0; i < n_blocks; i++)
+        plan[i] = DXLR02_BULK_SEND;
+    if(copies)
+        *copies = 0;
+    if(!old || old->size < block_size)
+        return DXLR02_OK;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+    uint8_t * blk = (uint8_t *)buf->data;
+
+    // work = weak[full] | next[full] | head[T], T potencia de 2 >= full
+    uint32_t t = 1;
+    while(t < full)
+        t <<= 1;
+    uint32_t * weak = work;
+    uint32_t * chain = work + full;
+    uint32_t * head = work + 2 * full;
+    for(uint32_t i = 0; i < t; i++)
+        head[i] = DXLR02_BULK_SEND;
+
+    for(uint32_t i = 0; i < full && st == DXLR02_OK; i++){
+        st = img->read(img->ctx, i * block_size, blk, block_size);
+        weak[i] = dxlr02_weak(blk, block_size);
+        uint32_t k = dxlr02_weak_bucket(weak[i], t - 1);
+        chain[i] = head[k];
+        head[k] = i;
+    }
+
+    // Ventana rodante sobre todos los offsets de la imagen vieja
+    uint8_t chunk[DXLR02_BULK_DIFF_CHUNK];
+    uint32_t pending = full;
+    uint32_t last = old->size - block_size;
+    uint32_t base = 0, have = 0;
+    uint16_t a = 0, b = 0;
+
+    for(uint32_t pos = 0; pos <= last && pending > 0 && st == DXLR02_OK; pos++){
+        if(pos + block_size > base + have){
+            // Recarga: el chunk arranca en pos y el hash se recalcula entero
+            base = pos;
+            have = old->size - base < sizeof(chunk) ? old->size - base : sizeof(chunk);
+            st = old->read(old->ctx, base, chunk, have);
+            if(st != DXLR02_OK)
+                break;
+            uint32_t h = dxlr02_weak(chunk, block_size);
+            a = h & 0xFFFF;
+            b = h >> 16;
+        } else {
+            uint8_t out = chunk[pos - 1 - base], in = chunk[pos + block_size - 1 - base];
+            a = a - out + in;
+            b = b - (uint16_t)(block_size * out) + a;
+        }
+
+        uint32_t h = (uint32_t)b << 16 | a;
+        for(uint32_t j = head[dxlr02_weak_bucket(h, t - 1)]; j != DXLR02_BULK_SEND && st == DXLR02_OK; j = chain[j]){
+            if(weak[j] != h || plan[j] != DXLR02_BULK_SEND)
+                continue;
+            st = img->read(img->ctx, j * block_size, blk, block_size);
+            if(st == DXLR02_OK && memcmp(blk, chunk + (pos - base), block_size) == 0){
+                plan[j] = pos;
+                pending--;
+            }
+        }
+    }
+
+    // Ultimo bloque incompleto: solo se prueba en el mismo offset
+    if(st == DXLR02_OK && full < n_blocks && img->size <= old->size){
+        uint32_t off = full * block_size, len = img->size - off;
+        st = img->read(img->ctx, off, blk, len);
+        if(st == DXLR02_OK)
+            st = old->read(old->ctx, off, chunk, len);
+        if(st == DXLR02_OK && memcmp(blk, chunk, len) == 0)
+            plan[full] = off;
+    }
+
+    dxlr02_pool_release(buf);
+
+    if(st == DXLR02_OK && copies)
+        for(uint32_t i = 0; i < n_blocks; i++)
+            if(plan[i] != DXLR02_BULK_SEND)
+                (*copies)++;
+    return st;
+}
+
+/****************************************** SENDER ******************************************/
+
+dxlr02_status_t dxlr02_bulk_sender_init(dxlr02_bulk_sender_t * s, dxlr02_t * module, const dxlr02_bulk_image_t * old,
+                                        const dxlr02_bulk_image_t * img, uint32_t * plan, uint16_t block_size, uint16_t session){
+    if(!s || !module || !img || !plan || block_size == 0 || block_size > dxlr02_bulk_max_block() || img->size == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    uint32_t n_blocks = (img->size + block_size - 1) / block_size;
+    if(n_blocks > DXLR02_BULK_MAX_BLOCKS)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(s, 0, sizeof(*s));
+    s->module = module;
+    s->image = img;
+    s->plan = plan;
+    s->session = session;
+    s->block_size = block_size;
+    s->n_blocks = (uint16_t)n_blocks;
+
+    dxlr02_status_t st = dxlr02_image_crc(img, img->size, &s->image_crc);
+    if(st != DXLR02_OK)
+        return st;
+
+    if(old){
+        s->base_size = old->size;
+        st = dxlr02_image_crc(old, old->size, &s->base_crc);
+        if(st != DXLR02_OK)
+            return st;
+    } else {
+        for(uint32_t i = 0; i < n_blocks; i++)
+            plan[i] = DXLR02_BULK_SEND;
+    }
+
+    s->state = DXLR02_BULK_STARTING;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_sender_emit(dxlr02_bulk_sender_t * s, uint8_t type, const uint8_t * body, size_t len){
+    size_t wire;
+    dxlr02_status_t st = dxlr02_bulk_emit(s->module, type, s->session, body, len, &wire);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint32_t toa = dxlr02_time_on_air_us(&s->module->config, wire);
+    s->stats.frames++;
+    s->stats.bytes += wire;
+    s->stats.airtime_us += toa;
+    s->next_tx_us = esp_timer_get_time() + dxlr02_uart_time_us(&s->module->config, wire) + toa;
+
+    if(type == DXLR02_BULK_START || type == DXLR02_BULK_POLL){
+        // La respuesta: ACK de 11 bytes de cuerpo, con COBS y terminador
+        size_t ack = DXLR02_BULK_HEADER_LEN + DXLR02_BULK_ACK_LEN + DXLR02_BULK_CRC_LEN + 2;
+        s->deadline_us = s->next_tx_us + dxlr02_uart_time_us(&s->module->config, ack)
+                       + dxlr02_time_on_air_us(&s->module->config, ack) + DXLR02_BULK_ACK_MARGIN_MS * 1000LL;
+    }
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_sender_start(dxlr02_bulk_sender_t * s){
+    uint8_t body[DXLR02_BULK_START_LEN];
+    dxlr02_put32(body, s->image->size);
+    dxlr02_put16(body + 4, s->block_size);
+    dxlr02_put32(body + 6, s->image_crc);
+    dxlr02_put32(body + 10, s->base_size);
+    dxlr02_put32(body + 14, s->base_crc);
+    return dxlr02_sender_emit(s, DXLR02_BULK_START, body, sizeof(body));
+}
+
+static dxlr02_status_t dxlr02_sender_data(dxlr02_bulk_sender_t * s, uint16_t index){
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint8_t * p = (uint8_t *)buf->data;
+    uint32_t len = dxlr02_block_len(s->image->size, s->block_size, index);
+    dxlr02_put16(p, index);
+    st = s->image->read(s->image->ctx, (uint32_t)index * s->block_size, p + 2, len);
+    if(st == DXLR02_OK)
+        st = dxlr02_sender_emit(s, DXLR02_BULK_DATA, p, 2 + len);
+    if(st == DXLR02_OK)
+        s->stats.data_blocks++;
+
+    dxlr02_pool_release(buf);
+    return st;
+}
+
+// Junta en un COPY los bloques seguidos de la ventana que estan en la imagen vieja
+static dxlr02_status_t dxlr02_sender_copy(dxlr02_bulk_sender_t * s, uint32_t end){
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint8_t * p = (uint8_t *)buf->data;
+    size_t max = (dxlr02_cobs_max_raw() - DXLR02_BULK_HEADER_LEN - DXLR02_BULK_CRC_LEN - 1) / DXLR02_BULK_COPY_ENTRY;
+    uint8_t count = 0;
+    uint32_t i = s->next;
+
+    for(; i < end && count < max; i++){
+        if(dxlr02_bit(s->acked, i))
+            continue;
+        if(s->plan[i] == DXLR02_BULK_SEND)
+            break;
+        dxlr02_put16(p + 1 + count * DXLR02_BULK_COPY_ENTRY, (uint16_t)i);
+        dxlr02_put32(p + 3 + count * DXLR02_BULK_COPY_ENTRY, s->plan[i]);
+        count++;
+    }
+    p[0] = count;
+
+    st = dxlr02_sender_emit(s, DXLR02_BULK_COPY, p, 1 + count * DXLR02_BULK_COPY_ENTRY);
+    if(st == DXLR02_OK){
+        s->stats.copy_blocks += count;
+        s->next = (uint16_t)i;
+    }
+
+    dxlr02_pool_release(buf);
+    return st;
+}
+
+dxlr02_status_t dxlr02_bulk_sender_poll(dxlr02_bulk_sender_t * s){
+    if(!s || !s->module)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(s->state == DXLR02_BULK_IDLE || s->state == DXLR02_BULK_DONE)
+        return DXLR02_OK;
+    if(s->state == DXLR02_BULK_FAILED)
+        return DXLR02_ERR_TIMEOUT;
+
+    int64_t now = esp_timer_get_time();
+    if(now < s->next_tx_us)
+        return DXLR02_OK;
+
+    if(s->state == DXLR02_BULK_STARTING || s->state == DXLR02_BULK_WAITING){
+        if(s->deadline_us != 0){
+            if(now < s->deadline_us)
+                return DXLR02_OK;
+            s->stats.timeouts++;
+            if(++s->retries > DXLR02_BULK_RETRIES){
+                s->state = DXLR02_BULK_FAILED;
+                return DXLR02_ERR_TIMEOUT;
+            }
+        }
+        return s->state == DXLR02_BULK_STARTING ? dxlr02_sender_start(s) : dxlr02_sender_emit(s, DXLR02_BULK_POLL, NULL, 0);
+    }
+
+    uint32_t end = (uint32_t)s->base + DXLR02_BULK_WINDOW;
+    if(end > s->n_blocks)
+        end = s->n_blocks;
+    while(s->next < end && dxlr02_bit(s->acked, s->next))
+        s->next++;
+
+    if(s->next >= end){
+        // Fin de la ventana: pedir el bitmap
+        s->state = DXLR02_BULK_WAITING;
+        return dxlr02_sender_emit(s, DXLR02_BULK_POLL, NULL, 0);
+    }
+    if(s->plan[s->next] == DXLR02_BULK_SEND){
+        dxlr02_status_t st = dxlr02_sender_data(s, s->next);
+        if(st == DXLR02_OK)
+            s->next++;
+        return st;
+    }
+    return dxlr02_sender_copy(s, end);
+}
+
+dxlr02_status_t dxlr02_bulk_sender_on_frame(dxlr02_bulk_sender_t * s, const char * frame, size_t len){
+    if(!s)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    size_t n;
+    const uint8_t * p = (const uint8_t *)buf->data;
+    st = dxlr02_bulk_parse(frame, len, buf, &n);
+    if(st != DXLR02_OK || p[1] != DXLR02_BULK_ACK || n != DXLR02_BULK_ACK_LEN){
+        dxlr02_pool_release(buf);
+        return st != DXLR02_OK ? st : DXLR02_ERR_INVALID_RESPONSE;
+    }
+    if(dxlr02_get16(p + 2) != s->session || s->state == DXLR02_BULK_IDLE || s->state == DXLR02_BULK_DONE
+       || s->state == DXLR02_BULK_FAILED){
+        dxlr02_pool_release(buf);
+        return DXLR02_OK;
+    }
+
+    const uint8_t * body = p + DXLR02_BULK_HEADER_LEN;
+    uint32_t ack_base = dxlr02_get16(body);
+    uint8_t flags = body[2];
+    s->stats.acks++;
+
+    // Todo lo anterior a la base del receptor ya esta, y el bitmap cubre los 64 siguientes
+    for(uint32_t i = s->base; i < ack_base && i < s->n_blocks; i++)
+        dxlr02_set_bit(s->acked, i);
+    for(uint32_t k = 0; k < DXLR02_BULK_ACK_SPAN && ack_base + k < s->n_blocks; k++)
+        if(dxlr02_bit(body + 3, k))
+            dxlr02_set_bit(s->acked, ack_base + k);
+    while(s->base < s->n_blocks && dxlr02_bit(s->acked, s->base))
+        s->base++;
+    dxlr02_pool_release(buf);
+
+    if(flags & DXLR02_BULK_ACK_NO_BASE){
+        // El receptor no tiene la imagen vieja que usamos para el diff: todo como DATA
+        for(uint32_t i = 0; i < s->n_blocks; i++)
+            s->plan[i] = DXLR02_BULK_SEND;
+    }
+
+    s->retries = 0;
+    s->deadline_us = 0;
+    s->next = s->base;
+    if(flags & DXLR02_BULK_ACK_DONE)
+        s->state = DXLR02_BULK_DONE;
+    else if(flags & DXLR02_BULK_ACK_FAILED)
+        s->state = DXLR02_BULK_FAILED;
+    else
+        s->state = DXLR02_BULK_SENDING;
+    return DXLR02_OK;
+}
+
+/****************************************** RECEIVER ******************************************/
+
+void dxlr02_bulk_receiver_init(dxlr02_bulk_receiver_t * r, dxlr02_t * module, const dxlr02_bulk_image_t * base_image,
+                               const dxlr02_bulk_sink_t * sink){
+    if(!r)
+        return;
+    memset(r, 0, sizeof(*r));
+    r->module = module;
+    r->base_image = base_image;
+    r->sink = sink;
+}
+
+static dxlr02_status_t dxlr02_receiver_ack(dxlr02_bulk_receiver_t * r){
+    uint8_t body[DXLR02_BULK_ACK_LEN];
+    memset(body, 0, sizeof(body));
+    dxlr02_put16(body, r->first_missing);
+    body[2] = r->flags;
+    for(uint32_t k = 0; k < DXLR02_BULK_ACK_SPAN && (uint32_t)r->first_missing + k < r->n_blocks; k++)
+        if(dxlr02_bit(r->have, r->first_missing + k))
+            dxlr02_set_bit(body + 3, k);
+    return dxlr02_bulk_emit(r->module, DXLR02_BULK_ACK, r->session, body, sizeof(body), NULL);
+}
+
+// Relee lo escrito y cierra el destino segun coincida el crc32
+static dxlr02_status_t dxlr02_receiver_finish(dxlr02_bulk_receiver_t * r){
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint32_t crc = 0;
+    for(uint32_t off = 0; off < r->size && st == DXLR02_OK; off += DXLR02_POOL_BLOCK_SIZE){
+        size_t n = r->size - off < DXLR02_POOL_BLOCK_SIZE ? r->size - off : DXLR02_POOL_BLOCK_SIZE;
+        st = r->sink->read(r->sink->ctx, off, buf->data, n);
+        if(st == DXLR02_OK)
+            crc = dxlr02_crc32(buf->data, n, crc);
+    }
+    dxlr02_pool_release(buf);
+
+    bool ok = st == DXLR02_OK && crc == r->crc;
+    if(r->sink->finish(r->sink->ctx, ok) != DXLR02_OK)
+        ok = false;
+    r->flags |= ok ? DXLR02_BULK_ACK_DONE : DXLR02_BULK_ACK_FAILED;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_receiver_store(dxlr02_bulk_receiver_t * r, uint32_t index, const void * data){
+    dxlr02_status_t st = r->sink->write(r->sink->ctx, index * r->block_size, data, dxlr02_block_len(r->size, r->block_size, index));
+    if(st != DXLR02_OK)
+        return st;
+
+    dxlr02_set_bit(r->have, index);
+    r->received++;
+    while(r->first_missing < r->n_blocks && dxlr02_bit(r->have, r->first_missing))
+        r->first_missing++;
+    if(r->received == r->n_blocks)
+        return dxlr02_receiver_finish(r);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_receiver_start(dxlr02_bulk_receiver_t * r, uint16_t session, const uint8_t * body){
+    uint32_t size = dxlr02_get32(body);
+    uint16_t block_size = dxlr02_get16(body + 4);
+    uint32_t crc = dxlr02_get32(body + 6);
+    uint32_t base_size = dxlr02_get32(body + 10);
+    uint32_t base_crc = dxlr02_get32(body + 14);
+
+    if(size == 0 || block_size == 0 || block_size > dxlr02_bulk_max_block())
+        return DXLR02_ERR_INVALID_RESPONSE;
+    uint32_t n_blocks = (size + block_size - 1) / block_size;
+    if(n_blocks > DXLR02_BULK_MAX_BLOCKS)
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    // La misma sesion sigue donde quedo
+    if(r->active && r->session == session && r->size == size && r->block_size == block_size && r->crc == crc)
+        return dxlr02_receiver_ack(r);
+
+    if(r->active && !(r->flags & (DXLR02_BULK_ACK_DONE | DXLR02_BULK_ACK_FAILED)))
+        r->sink->finish(r->sink->ctx, false);
+    r->active = false;
+
+    dxlr02_status_t st = r->sink->begin(r->sink->ctx, size);
+    if(st != DXLR02_OK)
+        return st;
+
+    r->active = true;
+    r->session = session;
+    r->size = size;
+    r->crc = crc;
+    r->block_size = block_size;
+    r->n_blocks = (uint16_t)n_blocks;
+    r->received = 0;
+    r->first_missing = 0;
+    r->flags = 0;
+    memset(r->have, 0, sizeof(r->have));
+
+    uint32_t have_crc = 0;
+    r->has_base = r->base_image && base_size > 0 && base_size <= r->base_image->size
+               && dxlr02_image_crc(r->base_image, base_size, &have_crc) == DXLR02_OK && have_crc == base_crc;
+    if(!r->has_base)
+        r->flags |= DXLR02_BULK_ACK_NO_BASE;
+
+    return dxlr02_receiver_ack(r);
+}
+
+static dxlr02_status_t dxlr02_receiver_copy(dxlr02_bulk_receiver_t * r, const uint8_t * body, size_t n){
+    if(n < 1 || n != 1 + (size_t)body[0] * DXLR02_BULK_COPY_ENTRY)
+        return DXLR02_ERR_INVALID_RESPONSE;
+    if(!r->has_base)
+        return DXLR02_OK;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    for(uint8_t k = 0; k < body[0] && st == DXLR02_OK; k++){
+        const uint8_t * e = body + 1 + k * DXLR02_BULK_COPY_ENTRY;
+        uint32_t index = dxlr02_get16(e);
+        uint32_t off = dxlr02_get32(e + 2);
+        if(index >= r->n_blocks || dxlr02_bit(r->have, index))
+            continue;
+        uint32_t len = dxlr02_block_len(r->size, r->block_size, index);
+        if(off > r->base_image->size || r->base_image->size - off < len)
+            continue;
+        st = r->base_image->read(r->base_image->ctx, off, buf->data, len);
+        if(st == DXLR02_OK)
+            st = dxlr02_receiver_store(r, index, buf->data);
+    }
+
+    dxlr02_pool_release(buf);
+    return st;
+}
+
+dxlr02_status_t dxlr02_bulk_receiver_on_frame(dxlr02_bulk_receiver_t * r, const char * frame, size_t len){
+    if(!r || !r->module || !r->sink)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    size_t n;
+    const uint8_t * p = (const uint8_t *)buf->data;
+    st = dxlr02_bulk_parse(frame, len, buf, &n);
+    if(st != DXLR02_OK){
+        dxlr02_pool_release(buf);
+        return st;
+    }
+
+    uint16_t session = dxlr02_get16(p + 2);
+    const uint8_t * body = p + DXLR02_BULK_HEADER_LEN;
+    bool current = r->active && session == r->session;
+    bool closed = r->flags & (DXLR02_BULK_ACK_DONE | DXLR02_BULK_ACK_FAILED);
+
+    switch(p[1]){
+    case DXLR02_BULK_START:
+        st = n == DXLR02_BULK_START_LEN ? dxlr02_receiver_start(r, session, body) : DXLR02_ERR_INVALID_RESPONSE;
+        break;
+    case DXLR02_BULK_DATA: {
+        if(!current || closed || n < 2)
+            break;
+        uint32_t index = dxlr02_get16(body);
+        if(index >= r->n_blocks || n - 2 != dxlr02_block_len(r->size, r->block_size, index))
+            st = DXLR02_ERR_INVALID_RESPONSE;
+        else if(!dxlr02_bit(r->have, index))
+            st = dxlr02_receiver_store(r, index, body + 2);
+        break;
+    }
+    case DXLR02_BULK_COPY:
+        if(current && !closed)
+            st = dxlr02_receiver_copy(r, body, n);
+        break;
+    case DXLR02_BULK_POLL:
+        if(current)
+            st = dxlr02_receiver_ack(r);
+        break;
+    default:
+        st = DXLR02_ERR_INVALID_RESPONSE;
+        break;
+    }
+
+    dxlr02_pool_release(buf);
+    return st;
+}
+
+/****************************************** BACKENDS ******************************************/
+
+#ifdef ESP_PLATFORM
+
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+
+static dxlr02_status_t dxlr02_part_read(void * ctx, uint32_t off, void * buf, size_t len){
+    return esp_partition_read((const esp_partition_t *)ctx, off, buf, len) == ESP_OK ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+dxlr02_status_t dxlr02_bulk_running_image(dxlr02_bulk_image_t * img){
+    if(!img)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    const esp_partition_t * part = esp_ota_get_running_partition();
+    if(!part)
+        return DXLR02_ERR_STORAGE;
+
+    // El largo es el del .bin (segmentos + checksum + hash), no el de la particion: lo que sigue es flash
+    // sin escribir o restos de una imagen anterior, que el emisor no tiene y cambiaria el crc32 de la base
+    const esp_partition_pos_t pos = { .offset = part->address, .size = part->size };
+    esp_image_metadata_t meta;
+    if(esp_image_get_metadata(&pos, &meta) != ESP_OK || meta.image_len == 0 || meta.image_len > part->size)
+        return DXLR02_ERR_STORAGE;
+
+    img->read = dxlr02_part_read;
+    img->size = meta.image_len;
+    img->ctx = (void *)part;
+    return DXLR02_OK;
+}
+
+// Una sola actualizacion OTA a la vez
+static struct {
+    const esp_partition_t * part;
+    esp_ota_handle_t handle;
+    bool open;
+} dxlr02_ota;
+
+static dxlr02_status_t dxlr02_ota_begin(void * ctx, uint32_t size){
+    if(dxlr02_ota.open){
+        esp_ota_abort(dxlr02_ota.handle);
+        dxlr02_ota.open = false;
+    }
+
+    dxlr02_ota.part = esp_ota_get_next_update_partition(NULL);
+    if(!dxlr02_ota.part || size > dxlr02_ota.part->size)
+        return DXLR02_ERR_STORAGE;
+    // Borra size bytes redondeado a sector: puede tardar varios cientos de ms
+    if(esp_ota_begin(dxlr02_ota.part, size, &dxlr02_ota.handle) != ESP_OK)
+        return DXLR02_ERR_STORAGE;
+    dxlr02_ota.open = true;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_ota_write(void * ctx, uint32_t off, const void * buf, size_t len){
+    if(!dxlr02_ota.open)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    return esp_ota_write_with_offset(dxlr02_ota.handle, buf, len, off) == ESP_OK ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t dxlr02_ota_read(void * ctx, uint32_t off, void * buf, size_t len){
+    if(!dxlr02_ota.part)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    return dxlr02_part_read((void *)dxlr02_ota.part, off, buf, len);
+}
+
+static dxlr02_status_t dxlr02_ota_finish(void * ctx, bool ok){
+    if(!dxlr02_ota.open)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    dxlr02_ota.open = false;
+
+    if(!ok){
+        esp_ota_abort(dxlr02_ota.handle);
+        return DXLR02_OK;
+    }
+    // esp_ota_end valida la imagen (cabecera, hash) antes de dejarla elegir para el arranque
+    if(esp_ota_end(dxlr02_ota.handle) != ESP_OK || esp_ota_set_boot_partition(dxlr02_ota.part) != ESP_OK)
+        return DXLR02_ERR_STORAGE;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_bulk_ota_sink(dxlr02_bulk_sink_t * sink){
+    if(!sink)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    sink->begin = dxlr02_ota_begin;
+    sink->write = dxlr02_ota_write;
+    sink->read = dxlr02_ota_read;
+    sink->finish = dxlr02_ota_finish;
+    sink->ctx = NULL;
+    return DXLR02_OK;
+}
+
+#else
+
+#include <stdio.h>
+#include <unistd.h>
+
+static dxlr02_status_t dxlr02_file_read(void * ctx, uint32_t off, void * buf, size_t len){
+    FILE * f = ctx;
+    if(fseek(f, off, SEEK_SET) != 0 || fread(buf, 1, len, f) != len)
+        return DXLR02_ERR_STORAGE;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_bulk_file_image(dxlr02_bulk_image_t * img, const char * path){
+    if(!img || !path)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    FILE * f = fopen(path, "rb");
+    if(!f)
+        return DXLR02_ERR_STORAGE;
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    if(size < 0 || size > (long)UINT32_MAX){
+        fclose(f);
+        return DXLR02_ERR_STORAGE;
+    }
+
+    img->read = dxlr02_file_read;
+    img->size = (uint32_t)size;
+    img->ctx = f;
+    return DXLR02_OK;
+}
+
+void dxlr02_bulk_file_image_close(dxlr02_bulk_image_t * img){
+    if(img && img->ctx){
+        fclose((FILE *)img->ctx);
+        img->ctx = NULL;
+    }
+}
+
+static dxlr02_status_t dxlr02_file_begin(void * ctx, uint32_t size){
+    FILE * f = ctx;
+    return ftruncate(fileno(f), 0) == 0 && ftruncate(fileno(f), size) == 0 ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t dxlr02_file_write(void * ctx, uint32_t off, const void * buf, size_t len){
+    FILE * f = ctx;
+    if(fseek(f, off, SEEK_SET) != 0 || fwrite(buf, 1, len, f) != len)
+        return DXLR02_ERR_STORAGE;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_file_finish(void * ctx, bool ok){
+    return fflush((FILE *)ctx) == 0 ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+dxlr02_status_t dxlr02_bulk_file_sink(dxlr02_bulk_sink_t * sink, const char * path){
+    if(!sink || !path)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    FILE * f = fopen(path, "w+b");
+    if(!f)
+        return DXLR02_ERR_STORAGE;
+
+    sink->begin = dxlr02_file_begin;
+    sink->write = dxlr02_file_write;
+    sink->read = dxlr02_file_read;
+    sink->finish = dxlr02_file_finish;
+    sink->ctx = f;
+    return DXLR02_OK;
+}
+
+void dxlr02_bulk_file_sink_close(dxlr02_bulk_sink_t * sink){
+    if(sink && sink->ctx){
+        fclose((FILE *)sink->ctx);
+        sink->ctx = NULL;
+    }
+}
+
+#endif
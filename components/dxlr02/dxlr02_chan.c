@@ -0,0 +1,236 @@
+#include "dxlr02_chan.h"
+#include "dxlr02_airtime.h"
+#include "dxlr02_pool.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_random.h"
+
+dxlr02_status_t dxlr02_chan_init(dxlr02_chan_t * ag, dxlr02_t * module, uint32_t mask, uint8_t max_backoffs){
+    if(!ag || !module)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    mask &= (1u << DXLR02_CHAN_COUNT) - 1;
+    if(mask == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(ag, 0, sizeof(*ag));
+    ag->module = module;
+    ag->mask = mask;
+    ag->max_backoffs = max_backoffs;
+    ag->peer = module->config.channel;
+    return DXLR02_OK;
+}
+
+void dxlr02_chan_attach(dxlr02_chan_t * ag, dxlr02_health_t * health){
+    if(ag)
+        ag->health = health;
+}
+
+static void dxlr02_chan_lock(dxlr02_chan_t * ag){
+    if(ag->health)
+        xSemaphoreTake(ag->health->lock, portMAX_DELAY);
+}
+
+static void dxlr02_chan_unlock(dxlr02_chan_t * ag){
+    if(ag->health)
+        xSemaphoreGive(ag->health->lock);
+}
+
+dxlr02_status_t dxlr02_chan_set_peer(dxlr02_chan_t * ag, uint8_t ch){
+    if(!ag || ch >= DXLR02_CHAN_COUNT)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    ag->peer = ch;
+    return DXLR02_OK;
+}
+
+// Con el lock tomado
+static dxlr02_status_t dxlr02_chan_retune(dxlr02_chan_t * ag, uint8_t ch){
+    dxlr02_t * module = ag->module;
+    if(module->config.channel == ch && dxlr02_get_state(module) == DXLR02_STATE_DATA)
+        return DXLR02_OK;
+
+    int64_t t0 = esp_timer_get_time();
+
+    // dxlr02_at_set no abre sesion si ya hay una: un solo comando y el toggle de salida
+    dxlr02_status_t st = dxlr02_at_set(module, DXLR02_AT_CHANNEL, ch);
+    if(st == DXLR02_OK)
+        st = dxlr02_ensure_data_mode(module);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    ag->stats.switches++;
+    ag->stats.switch_us_total += us;
+    if(us > ag->stats.switch_us_max)
+        ag->stats.switch_us_max = us;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_chan_switch(dxlr02_chan_t * ag, uint8_t ch){
+    if(!ag || ch >= DXLR02_CHAN_COUNT)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_chan_lock(ag);
+    dxlr02_status_t st = dxlr02_chan_retune(ag, ch);
+    dxlr02_chan_unlock(ag);
+    return st;
+}
+
+dxlr02_status_t dxlr02_chan_scan(dxlr02_chan_t * ag, uint32_t dwell_ms){
+    if(!ag || dwell_ms == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // buf recibe; keep guarda los frames como en el ring ('\0' al final de cada uno) para devolverlos
+    dxlr02_buf_t * buf, * keep;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+    st = dxlr02_pool_acquire(&keep);
+    if(st != DXLR02_OK){
+        dxlr02_pool_release(buf);
+        return st;
+    }
+
+    dxlr02_t * module = ag->module;
+    size_t kept = 0;
+
+    dxlr02_chan_lock(ag);
+    uint8_t home = module->config.channel;
+
+    for(uint8_t ch = 0; ch < DXLR02_CHAN_COUNT; ch++){
+        if(!(ag->mask & (1u << ch)))
+            continue;
+
+        st = dxlr02_chan_retune(ag, ch);
+        if(st != DXLR02_OK)
+            break;
+
+        uint64_t busy_us = 0;
+        int64_t end = esp_timer_get_time() + (int64_t)dwell_ms * 1000;
+        for(int64_t now = esp_timer_get_time(); now < end; now = esp_timer_get_time()){
+            dxlr02_frame_t frames[4];
+            size_t n = 0;
+            uint32_t wait_ms = (uint32_t)((end - now + 999) / 1000);
+            if(dxlr02_receive_batch(module, buf->data, DXLR02_POOL_BLOCK_SIZE, frames, 4, 1, wait_ms, &n) != DXLR02_OK)
+                continue;
+            for(size_t i = 0; i < n; i++){
+                busy_us += dxlr02_time_on_air_us(&module->config, frames[i].len + 1);
+                ag->stats.scan_frames++;
+                if(kept + frames[i].len + 1 > DXLR02_POOL_BLOCK_SIZE){
+                    ag->stats.scan_dropped++;
+                    continue;
+                }
+                memcpy(keep->data + kept, frames[i].data, frames[i].len + 1);
+                kept += frames[i].len + 1;
+            }
+        }
+
+        uint64_t occ = busy_us / dwell_ms;     // us / ms = por mil
+        ag->occupancy[ch] = occ > 1000 ? 1000 : (uint16_t)occ;
+    }
+
+    dxlr02_status_t back = dxlr02_chan_retune(ag, home);
+
+    // Al frente de la lectura, del ultimo al primero: quedan en orden y antes de lo que llego al volver
+    while(kept > 0){
+        size_t start = kept - 1;
+        while(start > 0 && keep->data[start - 1] != '\0')
+            start--;
+        if(dxlr02_requeue_frame(module, keep->data + start, kept - 1 - start) != DXLR02_OK)
+            ag->stats.scan_dropped++;
+        kept = start;
+    }
+    dxlr02_chan_unlock(ag);
+    dxlr02_pool_release(keep);
+    dxlr02_pool_release(buf);
+
+    if(st != DXLR02_OK)
+        return st;
+    ag->stats.scans++;
+    return back;
+}
+
+uint8_t dxlr02_chan_pick(dxlr02_chan_t * ag){
+    if(!ag)
+        return 0;
+
+    uint8_t cur = ag->module->config.channel;
+    uint8_t best = cur;
+    uint16_t min = UINT16_MAX;
+    for(uint8_t ch = 0; ch < DXLR02_CHAN_COUNT; ch++){
+        if((ag->mask & (1u << ch)) && ag->occupancy[ch] < min){
+            min = ag->occupancy[ch];
+            best = ch;
+        }
+    }
+
+    // Moverse cuesta una resintonia y avisarle a los pares: solo si la diferencia vale la pena
+    if(cur < DXLR02_CHAN_COUNT && (ag->mask & (1u << cur)) && ag->occupancy[cur] <= min + DXLR02_CHAN_OCC_SLACK)
+        return cur;
+    return best;
+}
+
+dxlr02_status_t dxlr02_chan_lbt(dxlr02_chan_t * ag){
+    if(!ag)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // El modulo entrega un paquete a la UART recien cuando termina de recibirlo: la ventana tiene que
+    // cubrir al menos un frame corto para ver algo
+    TickType_t window = pdMS_TO_TICKS((dxlr02_time_on_air_us(&ag->module->config, DXLR02_CHAN_LBT_FRAME_LEN) + 999) / 1000);
+    if(window == 0)
+        window = 1;
+
+    // No alcanza con la UART: con una tarea de RX leyendo el buffer siempre esta vacio
+    for(uint8_t attempt = 0; attempt <= ag->max_backoffs; attempt++){
+        uint32_t before = dxlr02_rx_activity(ag->module);
+        vTaskDelay(window);
+        if(dxlr02_rx_activity(ag->module) == before)
+            return DXLR02_OK;
+
+        ag->stats.lbt_busy++;
+        uint8_t exp = attempt < DXLR02_CHAN_MAX_BACKOFF_EXP ? attempt + 1 : DXLR02_CHAN_MAX_BACKOFF_EXP;
+        uint32_t slots = esp_random() % (1u << exp);
+        vTaskDelay(slots * window);
+    }
+
+    ag->stats.lbt_gave_up++;
+    return DXLR02_ERR_CHANNEL_BUSY;
+}
+
+dxlr02_status_t dxlr02_chan_send(dxlr02_chan_t * ag, uint16_t address, const char * data, size_t size){
+    if(!ag || !data || size == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_t * module = ag->module;
+    uint8_t ch = ag->peer;
+    dxlr02_status_t st;
+
+    // Modo 0: el canal de TX es el de RX. Resintoniza solo cuando cambia el peer, no en cada envio.
+    if(module->config.working_mode == 0){
+        dxlr02_chan_lock(ag);
+        st = dxlr02_chan_retune(ag, ch);
+        dxlr02_chan_unlock(ag);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    // El LBT solo escucha el canal de RX. Va sin el lock: la tarea de RX tiene que poder leer. El envio tampoco
+    // lo necesita (como en dxlr02_health, la UART tiene lados independientes).
+    if(ag->max_backoffs > 0 && ch == module->config.channel){
+        st = dxlr02_chan_lbt(ag);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    switch(module->config.working_mode){
+        case 1:  st = dxlr02_send_to(module, address, ch, data, size);  break;
+        case 2:  st = dxlr02_broadcast(module, ch, data, size);         break;
+        default: st = dxlr02_send_data(module, data, size);             break;
+    }
+
+    if(st == DXLR02_OK)
+        ag->stats.sent[ch]++;
+    return st;
+}
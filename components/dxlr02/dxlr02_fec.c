@@ -0,0 +1,463 @@
+#include "dxlr02_fec.h"
+#include "dxlr02_airtime.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/****************************************** GF(256) ******************************************/
+// Polinomio 0x11D. exp esta duplicada para sumar logaritmos sin hacer modulo 255.
+
+static uint8_t dxlr02_gf_exp[512];
+static uint8_t dxlr02_gf_log[256];
+static bool dxlr02_gf_ready = false;
+
+static void dxlr02_gf_init(void){
+    if(dxlr02_gf_ready)
+        return;
+
+    uint16_t x = 1;
+    for(int i = 0; i < 255; i++){
+        dxlr02_gf_exp[i] = (uint8_t)x;
+        dxlr02_gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if(x & 0x100)
+            x ^= 0x11D;
+    }
+    for(int i = 255; i < 512; i++)
+        dxlr02_gf_exp[i] = dxlr02_gf_exp[i - 255];
+
+    dxlr02_gf_ready = true;
+}
+
+static uint8_t dxlr02_gf_mul(uint8_t a, uint8_t b){
+    if(a == 0 || b == 0)
+        return 0;
+    return dxlr02_gf_exp[dxlr02_gf_log[a] + dxlr02_gf_log[b]];
+}
+
+static uint8_t dxlr02_gf_inv(uint8_t a){
+    return dxlr02_gf_exp[255 - dxlr02_gf_log[a]];
+}
+
+// dst ^= c * src, byte a byte con las tablas (el log de c se busca una sola vez por fila)
+static void dxlr02_gf_mul_add(uint8_t * dst, const uint8_t * src, uint8_t c, size_t len){
+    if(c == 0)
+        return;
+
+    const uint8_t * exp_c = dxlr02_gf_exp + dxlr02_gf_log[c];
+    for(size_t i = 0; i < len; i++){
+        if(src[i])
+            dst[i] ^= exp_c[dxlr02_gf_log[src[i]]];
+    }
+}
+
+// Coeficiente de la fila de paridad row (k..k+m-1) para el shard de datos col (0..k-1): Cauchy 1 / (row + col).
+// Filas y columnas son conjuntos disjuntos, asi que cualquier submatriz cuadrada es invertible.
+static uint8_t dxlr02_fec_coef(uint8_t row, uint8_t col){
+    return dxlr02_gf_inv(row ^ col);
+}
+
+// Gauss-Jordan sobre una matriz k x k; inv queda con la inversa
+static bool dxlr02_gf_invert(uint8_t a[DXLR02_FEC_MAX_K][DXLR02_FEC_MAX_K], uint8_t inv[DXLR02_FEC_MAX_K][DXLR02_FEC_MAX_K], uint8_t k){
+    for(uint8_t r = 0; r < k; r++){
+        memset(inv[r], 0, k);
+        inv[r][r] = 1;
+    }
+
+    for(uint8_t col = 0; col < k; col++){
+        uint8_t pivot = col;
+        while(pivot < k && a[pivot][col] == 0)
+            pivot++;
+        if(pivot == k)
+            return false;
+
+        if(pivot != col){
+            for(uint8_t c = 0; c < k; c++){
+                uint8_t t = a[col][c]; a[col][c] = a[pivot][c]; a[pivot][c] = t;
+                t = inv[col][c]; inv[col][c] = inv[pivot][c]; inv[pivot][c] = t;
+            }
+        }
+
+        uint8_t scale = dxlr02_gf_inv(a[col][col]);
+        for(uint8_t c = 0; c < k; c++){
+            a[col][c] = dxlr02_gf_mul(a[col][c], scale);
+            inv[col][c] = dxlr02_gf_mul(inv[col][c], scale);
+        }
+
+        for(uint8_t r = 0; r < k; r++){
+            uint8_t f = a[r][col];
+            if(r == col || f == 0)
+                continue;
+            for(uint8_t c = 0; c < k; c++){
+                a[r][c] ^= dxlr02_gf_mul(f, a[col][c]);
+                inv[r][c] ^= dxlr02_gf_mul(f, inv[col][c]);
+            }
+        }
+    }
+    return true;
+}
+
+/****************************************** COBS / CRC ******************************************/
+
+size_t dxlr02_cobs_encode(const uint8_t * in, size_t len, uint8_t * out){
+    size_t code_pos = 0, n = 1;
+    uint8_t code = 1;
+
+    for(size_t i = 0; i < len; i++){
+        if(in[i] != 0){
+            out[n++] = in[i];
+            code++;
+        }
+        if(in[i] == 0 || code == 0xFF){
+            out[code_pos] = code;
+            code_pos = n++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return n;
+}
+
+dxlr02_status_t dxlr02_cobs_decode(const uint8_t * in, size_t len, uint8_t * out, size_t out_len, size_t * out_n){
+    size_t i = 0, n = 0;
+
+    while(i < len){
+        uint8_t code = in[i++];
+        if(code == 0 || i + code - 1 > len)
+            return DXLR02_ERR_INVALID_RESPONSE;
+
+        for(uint8_t j = 1; j < code; j++){
+            if(n >= out_len)
+                return DXLR02_ERR_OUT_OF_SPACE;
+            out[n++] = in[i++];
+        }
+        if(code != 0xFF && i < len){
+            if(n >= out_len)
+                return DXLR02_ERR_OUT_OF_SPACE;
+            out[n++] = 0;
+        }
+    }
+
+    *out_n = n;
+    return DXLR02_OK;
+}
+
+size_t dxlr02_cobs_max_raw(void){
+    // COBS agrega 1 byte mas 1 por cada 254 sin ceros y el '\0' otro: raw + 2 + raw / 254 <= bloque
+    return DXLR02_POOL_BLOCK_SIZE - 2 - (DXLR02_POOL_BLOCK_SIZE - 1) / 255;
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t dxlr02_crc16(const uint8_t * data, size_t len, uint16_t crc){
+    for(size_t i = 0; i < len; i++){
+        crc ^= (uint16_t)data[i] << 8;
+        for(int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/****************************************** ENCODER ******************************************/
+
+size_t dxlr02_fec_max_payload(void){
+    return dxlr02_cobs_max_raw() - DXLR02_FEC_HEADER_LEN - DXLR02_FEC_LEN_BYTES;
+}
+
+dxlr02_status_t dxlr02_fec_encoder_init(dxlr02_fec_encoder_t * enc, dxlr02_t * module, uint8_t k, uint8_t m, size_t max_payload){
+    if(!enc || !module || k == 0 || m == 0 || k > DXLR02_FEC_MAX_K || k + m > DXLR02_FEC_MAX_SHARDS)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(max_payload == 0 || max_payload > dxlr02_fec_max_payload())
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_gf_init();
+    memset(enc, 0, sizeof(*enc));
+    enc->module = module;
+    enc->k = k;
+    enc->m = m;
+    enc->shard_len = (uint16_t)(max_payload + DXLR02_FEC_LEN_BYTES);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_fec_emit(dxlr02_fec_encoder_t * enc, uint8_t index, uint8_t k, const uint8_t * shard, size_t len){
+    dxlr02_buf_t * raw;
+    dxlr02_buf_t * wire;
+
+    dxlr02_status_t st = dxlr02_pool_acquire(&raw);
+    if(st != DXLR02_OK)
+        return st;
+    st = dxlr02_pool_acquire(&wire);
+    if(st != DXLR02_OK){
+        dxlr02_pool_release(raw);
+        return st;
+    }
+
+    uint8_t * p = (uint8_t *)raw->data;
+    p[0] = DXLR02_FEC_MAGIC;
+    p[1] = enc->block;
+    p[2] = index;
+    p[3] = (uint8_t)(k << 4 | enc->m);
+    memcpy(p + DXLR02_FEC_HEADER_LEN, shard, len);
+    uint16_t crc = dxlr02_crc16(p, 4, 0xFFFF);
+    crc = dxlr02_crc16(shard, len, crc);
+    p[4] = crc >> 8;
+    p[5] = crc & 0xFF;
+
+    size_t n = dxlr02_cobs_encode(p, DXLR02_FEC_HEADER_LEN + len, (uint8_t *)wire->data);
+    st = dxlr02_send_data(enc->module, wire->data, n);
+
+    dxlr02_pool_release(wire);
+    dxlr02_pool_release(raw);
+    return st;
+}
+
+// El modulo arma un paquete con lo que llega a la UART sin silencio: sin esta pausa la paridad saldria en el
+// mismo paquete de radio que el ultimo dato y una sola perdida se llevaria a los dos
+static void dxlr02_fec_gap(const dxlr02_fec_encoder_t * enc){
+    size_t raw = DXLR02_FEC_HEADER_LEN + enc->shard_len;
+    size_t wire = raw + raw / 254 + 1 + 1;      // COBS + '\0'
+    uint32_t ms = (dxlr02_uart_time_us(&enc->module->config, wire) + 999) / 1000;
+    vTaskDelay(pdMS_TO_TICKS(ms) + 1);
+}
+
+// Paridad de los k_eff shards guardados; despues libera el bloque
+static dxlr02_status_t dxlr02_fec_emit_parity(dxlr02_fec_encoder_t * enc){
+    uint8_t k_eff = enc->count;
+    dxlr02_status_t st = DXLR02_OK;
+
+    for(uint8_t j = 0; j < enc->m && st == DXLR02_OK; j++){
+        dxlr02_buf_t * parity;
+        st = dxlr02_pool_acquire(&parity);
+        if(st != DXLR02_OK)
+            break;
+
+        memset(parity->data, 0, enc->shard_len);
+        for(uint8_t i = 0; i < k_eff; i++)
+            dxlr02_gf_mul_add((uint8_t *)parity->data, (const uint8_t *)enc->shards[i]->data, dxlr02_fec_coef(k_eff + j, i), enc->shard_len);
+
+        dxlr02_fec_gap(enc);
+        st = dxlr02_fec_emit(enc, k_eff + j, k_eff, (const uint8_t *)parity->data, enc->shard_len);
+        dxlr02_pool_release(parity);
+    }
+
+    for(uint8_t i = 0; i < k_eff; i++){
+        dxlr02_pool_release(enc->shards[i]);
+        enc->shards[i] = NULL;
+    }
+    enc->count = 0;
+    enc->block++;
+    return st;
+}
+
+dxlr02_status_t dxlr02_fec_send(dxlr02_fec_encoder_t * enc, const char * data, size_t len){
+    if(!enc || !enc->module || (!data && len > 0))
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(len + DXLR02_FEC_LEN_BYTES > enc->shard_len)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * shard;
+    dxlr02_status_t st = dxlr02_pool_acquire(&shard);
+    if(st != DXLR02_OK)
+        return st;
+
+    shard->data[0] = (char)(len >> 8);
+    shard->data[1] = (char)(len & 0xFF);
+    memcpy(shard->data + DXLR02_FEC_LEN_BYTES, data, len);
+    memset(shard->data + DXLR02_FEC_LEN_BYTES + len, 0, enc->shard_len - DXLR02_FEC_LEN_BYTES - len);
+    shard->len = (uint16_t)(len + DXLR02_FEC_LEN_BYTES);
+
+    // Sistematico: el dato sale ya, sin esperar al resto del bloque
+    st = dxlr02_fec_emit(enc, enc->count, enc->k, (const uint8_t *)shard->data, shard->len);
+    enc->shards[enc->count++] = shard;
+
+    if(enc->count == enc->k){
+        dxlr02_status_t pst = dxlr02_fec_emit_parity(enc);
+        if(st == DXLR02_OK)
+            st = pst;
+    }
+    return st;
+}
+
+dxlr02_status_t dxlr02_fec_flush(dxlr02_fec_encoder_t * enc){
+    if(!enc || !enc->module)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(enc->count == 0)
+        return DXLR02_OK;
+
+    // La paridad lleva k = paquetes realmente mandados; el decoder achica el bloque al verla
+    return dxlr02_fec_emit_parity(enc);
+}
+
+/****************************************** DECODER ******************************************/
+
+void dxlr02_fec_decoder_init(dxlr02_fec_decoder_t * dec, dxlr02_fec_deliver_t deliver, void * ctx){
+    if(!dec)
+        return;
+
+    dxlr02_gf_init();
+    memset(dec, 0, sizeof(*dec));
+    dec->deliver = deliver;
+    dec->ctx = ctx;
+}
+
+static void dxlr02_fec_release_all(dxlr02_fec_decoder_t * dec){
+    for(int i = 0; i < DXLR02_FEC_MAX_SHARDS; i++){
+        if(dec->shards[i]){
+            dxlr02_pool_release(dec->shards[i]);
+            dec->shards[i] = NULL;
+        }
+    }
+    dec->have = 0;
+}
+
+static void dxlr02_fec_deliver_shard(dxlr02_fec_decoder_t * dec, uint8_t index, const uint8_t * shard, size_t len){
+    dec->delivered |= 1u << index;
+    if(len < DXLR02_FEC_LEN_BYTES)
+        return;
+
+    size_t payload = (size_t)shard[0] << 8 | shard[1];
+    if(payload + DXLR02_FEC_LEN_BYTES > len)
+        return;
+    if(dec->deliver && payload > 0)
+        dec->deliver(dec->ctx, (const char *)shard + DXLR02_FEC_LEN_BYTES, payload);
+}
+
+void dxlr02_fec_decoder_flush(dxlr02_fec_decoder_t * dec){
+    if(!dec || !dec->active)
+        return;
+
+    // Los indices que nunca salieron (bloque cerrado antes con dxlr02_fec_flush) no son perdidas
+    for(uint8_t i = 0; i < dec->sent && i < dec->k; i++){
+        if(!(dec->delivered & (1u << i)))
+            dec->stats.lost++;
+    }
+    dxlr02_fec_release_all(dec);
+    dec->active = false;
+}
+
+// Con k shards cualquiera se despeja lo que falta: D = A^-1 * R
+static void dxlr02_fec_recover(dxlr02_fec_decoder_t * dec){
+    uint8_t k = dec->k;
+    uint8_t rows[DXLR02_FEC_MAX_K];
+    uint8_t n = 0;
+
+    for(uint8_t idx = 0; idx < DXLR02_FEC_MAX_SHARDS && n < k; idx++){
+        if(dec->shards[idx])
+            rows[n++] = idx;
+    }
+    if(n < k)
+        return;
+
+    uint8_t a[DXLR02_FEC_MAX_K][DXLR02_FEC_MAX_K];
+    uint8_t inv[DXLR02_FEC_MAX_K][DXLR02_FEC_MAX_K];
+    for(uint8_t r = 0; r < k; r++){
+        for(uint8_t c = 0; c < k; c++)
+            a[r][c] = rows[r] < k ? (rows[r] == c) : dxlr02_fec_coef(rows[r], c);
+    }
+    if(!dxlr02_gf_invert(a, inv, k))
+        return;
+
+    // Los shards de datos llegan recortados: se completan con ceros hasta el largo de la paridad
+    for(uint8_t r = 0; r < k; r++){
+        dxlr02_buf_t * s = dec->shards[rows[r]];
+        if(s->len < dec->shard_len){
+            memset(s->data + s->len, 0, dec->shard_len - s->len);
+            s->len = dec->shard_len;
+        }
+    }
+
+    for(uint8_t i = 0; i < k; i++){
+        if(dec->delivered & (1u << i))
+            continue;
+
+        dxlr02_buf_t * out;
+        if(dxlr02_pool_acquire(&out) != DXLR02_OK)
+            return;
+
+        memset(out->data, 0, dec->shard_len);
+        for(uint8_t r = 0; r < k; r++)
+            dxlr02_gf_mul_add((uint8_t *)out->data, (const uint8_t *)dec->shards[rows[r]]->data, inv[i][r], dec->shard_len);
+
+        dec->stats.recovered++;
+        dxlr02_fec_deliver_shard(dec, i, (const uint8_t *)out->data, dec->shard_len);
+        dxlr02_pool_release(out);
+    }
+}
+
+dxlr02_status_t dxlr02_fec_on_frame(dxlr02_fec_decoder_t * dec, const char * frame, size_t len){
+    if(!dec || !frame)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(len < DXLR02_FEC_HEADER_LEN + 1)
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    size_t n;
+    uint8_t * p = (uint8_t *)buf->data;
+    st = dxlr02_cobs_decode((const uint8_t *)frame, len, p, DXLR02_POOL_BLOCK_SIZE, &n);
+    if(st != DXLR02_OK || n <= DXLR02_FEC_HEADER_LEN || p[0] != DXLR02_FEC_MAGIC){
+        dxlr02_pool_release(buf);
+        return DXLR02_ERR_INVALID_RESPONSE;
+    }
+
+    dec->stats.shards_rx++;
+
+    uint16_t crc = dxlr02_crc16(p, 4, 0xFFFF);
+    crc = dxlr02_crc16(p + DXLR02_FEC_HEADER_LEN, n - DXLR02_FEC_HEADER_LEN, crc);
+    uint8_t block = p[1], index = p[2], k = p[3] >> 4, m = p[3] & 0x0F;
+    if(crc != ((uint16_t)p[4] << 8 | p[5]) || k == 0 || k > DXLR02_FEC_MAX_K || index >= k + m || k + m > DXLR02_FEC_MAX_SHARDS){
+        // Corrupto: cuenta como borradura, la paridad lo cubre
+        dec->stats.crc_errors++;
+        dxlr02_pool_release(buf);
+        return DXLR02_OK;
+    }
+
+    if(!dec->active || block != dec->block){
+        dxlr02_fec_decoder_flush(dec);
+        dec->active = true;
+        dec->block = block;
+        dec->k = k;
+        dec->m = m;
+        dec->shard_len = 0;
+        dec->delivered = 0;
+        dec->sent = 0;
+    }
+
+    // La paridad de un bloque cerrado con dxlr02_fec_flush trae un k menor
+    if(k < dec->k)
+        dec->k = k;
+    if(index >= k)
+        dec->sent = k;
+    else if(index + 1 > dec->sent)
+        dec->sent = index + 1;
+
+    // Shard sin payload util: bloque ya resuelto o repetido
+    uint32_t all = (1u << dec->k) - 1;
+    if((dec->delivered & all) == all || dec->shards[index] || (index < dec->k && (dec->delivered & (1u << index)))){
+        dxlr02_pool_release(buf);
+        return DXLR02_OK;
+    }
+
+    // Se guarda sin el header
+    size_t shard_len = n - DXLR02_FEC_HEADER_LEN;
+    memmove(p, p + DXLR02_FEC_HEADER_LEN, shard_len);
+    buf->len = (uint16_t)shard_len;
+    if(shard_len > dec->shard_len)
+        dec->shard_len = (uint16_t)shard_len;
+
+    dec->shards[index] = buf;
+    dec->have++;
+
+    if(index < dec->k)
+        dxlr02_fec_deliver_shard(dec, index, p, shard_len);
+
+    if((dec->delivered & all) != all && dec->have >= dec->k)
+        dxlr02_fec_recover(dec);
+
+    if((dec->delivered & all) == all)
+        dxlr02_fec_release_all(dec);
+
+    return DXLR02_OK;
+}
@@ -0,0 +1,323 @@
+#include "dxlr02_flood.h"
+#include "dxlr02_fec.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include <string.h>
+
+_Static_assert(DXLR02_FLOOD_CACHE_SIZE > 0 && DXLR02_FLOOD_CACHE_SIZE < DXLR02_FLOOD_NONE, "indices de 8 bits");
+
+/****************************************** CACHE ******************************************/
+
+static uint32_t dxlr02_flood_bucket(uint32_t key){
+    return ((key * 0x9E3779B1u) >> 16) % DXLR02_FLOOD_CACHE_SIZE;
+}
+
+static uint8_t dxlr02_cache_find(dxlr02_flood_t * fl, uint32_t key){
+    uint8_t i = fl->buckets[dxlr02_flood_bucket(key)];
+    while(i != DXLR02_FLOOD_NONE && fl->cache[i].key != key)
+        i = fl->cache[i].chain;
+    return i;
+}
+
+static void dxlr02_lru_unlink(dxlr02_flood_t * fl, uint8_t i){
+    dxlr02_flood_entry_t * e = &fl->cache[i];
+    if(e->older != DXLR02_FLOOD_NONE)
+        fl->cache[e->older].newer = e->newer;
+    else
+        fl->oldest = e->newer;
+    if(e->newer != DXLR02_FLOOD_NONE)
+        fl->cache[e->newer].older = e->older;
+    else
+        fl->newest = e->older;
+}
+
+static void dxlr02_lru_push(dxlr02_flood_t * fl, uint8_t i){
+    fl->cache[i].older = fl->newest;
+    fl->cache[i].newer = DXLR02_FLOOD_NONE;
+    if(fl->newest != DXLR02_FLOOD_NONE)
+        fl->cache[fl->newest].newer = i;
+    else
+        fl->oldest = i;
+    fl->newest = i;
+}
+
+static void dxlr02_cache_touch(dxlr02_flood_t * fl, uint8_t i){
+    if(fl->newest == i)
+        return;
+    dxlr02_lru_unlink(fl, i);
+    dxlr02_lru_push(fl, i);
+}
+
+static void dxlr02_cache_insert(dxlr02_flood_t * fl, uint32_t key, uint8_t hops){
+    uint8_t i;
+
+    if(fl->count < DXLR02_FLOOD_CACHE_SIZE){
+        i = fl->count++;
+    } else {
+        // Lleno: se reusa el menos usado, sacandolo de su bucket
+        i = fl->oldest;
+        uint8_t * link = &fl->buckets[dxlr02_flood_bucket(fl->cache[i].key)];
+        while(*link != i)
+            link = &fl->cache[*link].chain;
+        *link = fl->cache[i].chain;
+        dxlr02_lru_unlink(fl, i);
+        fl->stats.evictions++;
+    }
+
+    uint8_t * head = &fl->buckets[dxlr02_flood_bucket(key)];
+    fl->cache[i].key = key;
+    fl->cache[i].heard = 1;
+    fl->cache[i].hops = hops;
+    fl->cache[i].chain = *head;
+    *head = i;
+    dxlr02_lru_push(fl, i);
+}
+
+/****************************************** TX ******************************************/
+
+size_t dxlr02_flood_max_payload(void){
+    return dxlr02_cobs_max_raw() - DXLR02_FLOOD_HEADER_LEN;
+}
+
+static dxlr02_status_t dxlr02_flood_transmit(dxlr02_flood_t * fl, const dxlr02_buf_t * wire){
+    dxlr02_t * module = fl->module;
+    size_t prefix = 0;
+    dxlr02_status_t st;
+
+    if(module->config.working_mode == 2){
+        st = dxlr02_broadcast(module, module->config.channel, wire->data, wire->len);
+        prefix = 1;
+    } else {
+        st = dxlr02_send_data(module, wire->data, wire->len);
+    }
+
+    size_t n = prefix + wire->len + 1;
+    fl->next_tx_us = esp_timer_get_time() + dxlr02_uart_time_us(&module->config, n) + dxlr02_time_on_air_us(&module->config, n);
+    return st;
+}
+
+// Arma la trama y la deja codificada en un bloque nuevo del pool
+static dxlr02_status_t dxlr02_flood_build(uint16_t origin, uint16_t seq, uint8_t ttl, uint8_t hops,
+                                          const uint8_t * payload, size_t len, dxlr02_buf_t ** wire){
+    dxlr02_buf_t * raw;
+    dxlr02_status_t st = dxlr02_pool_acquire(&raw);
+    if(st != DXLR02_OK)
+        return st;
+    st = dxlr02_pool_acquire(wire);
+    if(st != DXLR02_OK){
+        dxlr02_pool_release(raw);
+        return st;
+    }
+
+    uint8_t * p = (uint8_t *)raw->data;
+    p[0] = DXLR02_FLOOD_MAGIC;
+    p[1] = origin >> 8;
+    p[2] = origin & 0xFF;
+    p[3] = seq >> 8;
+    p[4] = seq & 0xFF;
+    p[5] = ttl;
+    p[6] = hops;
+    memcpy(p + DXLR02_FLOOD_HEADER_LEN, payload, len);
+    uint16_t crc = dxlr02_crc16(p, 7, 0xFFFF);
+    crc = dxlr02_crc16(payload, len, crc);
+    p[7] = crc >> 8;
+    p[8] = crc & 0xFF;
+
+    (*wire)->len = (uint16_t)dxlr02_cobs_encode(p, DXLR02_FLOOD_HEADER_LEN + len, (uint8_t *)(*wire)->data);
+    dxlr02_pool_release(raw);
+    return DXLR02_OK;
+}
+
+static dxlr02_flood_pending_t * dxlr02_flood_free_slot(dxlr02_flood_t * fl){
+    for(int i = 0; i < DXLR02_FLOOD_PENDING; i++)
+        if(!fl->pending[i].frame)
+            return &fl->pending[i];
+    return NULL;
+}
+
+dxlr02_status_t dxlr02_flood_send(dxlr02_flood_t * fl, const char * data, size_t len){
+    if(!fl || !fl->module || (!data && len > 0))
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(len > dxlr02_flood_max_payload())
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // Mismo turno que las repeticiones: sin pisar la trama anterior en la cola del modulo
+    int64_t now = esp_timer_get_time();
+    dxlr02_flood_pending_t * slot = NULL;
+    if(now < fl->next_tx_us){
+        slot = dxlr02_flood_free_slot(fl);
+        if(!slot)
+            return DXLR02_ERR_OUT_OF_SPACE;
+    }
+
+    uint16_t seq = fl->seq++;
+    uint32_t key = (uint32_t)fl->node_id << 16 | seq;
+    dxlr02_buf_t * wire;
+    dxlr02_status_t st = dxlr02_flood_build(fl->node_id, seq, fl->ttl, 0, (const uint8_t *)data, len, &wire);
+    if(st != DXLR02_OK)
+        return st;
+
+    // Las copias que vuelvan de los vecinos son duplicados
+    dxlr02_cache_insert(fl, key, 0);
+
+    if(slot){
+        slot->frame = wire;
+        slot->key = key;
+        slot->due_us = fl->next_tx_us;
+        slot->origin = true;
+        fl->stats.originated++;
+        return DXLR02_OK;
+    }
+
+    st = dxlr02_flood_transmit(fl, wire);
+    if(st == DXLR02_OK)
+        fl->stats.originated++;
+    dxlr02_pool_release(wire);
+    return st;
+}
+
+/****************************************** RX ******************************************/
+
+// Agenda la repeticion tras 1 a slots slots de time-on-air de la propia trama
+static void dxlr02_flood_schedule(dxlr02_flood_t * fl, uint32_t key, const uint8_t * p, size_t n){
+    dxlr02_flood_pending_t * slot = dxlr02_flood_free_slot(fl);
+    if(!slot){
+        fl->stats.dropped++;
+        return;
+    }
+
+    dxlr02_buf_t * wire;
+    if(dxlr02_flood_build((uint16_t)(key >> 16), (uint16_t)key, p[5] - 1, p[6] + 1, p + DXLR02_FLOOD_HEADER_LEN,
+                          n - DXLR02_FLOOD_HEADER_LEN, &wire) != DXLR02_OK){
+        fl->stats.dropped++;
+        return;
+    }
+
+    const dxlr02_config_t * conf = &fl->module->config;
+    size_t air = (conf->working_mode == 2) + wire->len + 1;
+    int64_t slot_us = dxlr02_uart_time_us(conf, air) + dxlr02_time_on_air_us(conf, air);
+
+    slot->frame = wire;
+    slot->key = key;
+    slot->due_us = esp_timer_get_time() + (1 + (fl->slots ? esp_random() % fl->slots : 0)) * slot_us;
+    slot->origin = false;
+}
+
+dxlr02_status_t dxlr02_flood_on_frame(dxlr02_flood_t * fl, const char * frame, size_t len){
+    if(!fl || !frame)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * buf;
+    dxlr02_status_t st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    size_t n;
+    uint8_t * p = (uint8_t *)buf->data;
+    st = dxlr02_cobs_decode((const uint8_t *)frame, len, p, DXLR02_POOL_BLOCK_SIZE, &n);
+    if(st != DXLR02_OK || n < DXLR02_FLOOD_HEADER_LEN || p[0] != DXLR02_FLOOD_MAGIC){
+        dxlr02_pool_release(buf);
+        return DXLR02_ERR_INVALID_RESPONSE;
+    }
+
+    uint16_t crc = dxlr02_crc16(p, 7, 0xFFFF);
+    crc = dxlr02_crc16(p + DXLR02_FLOOD_HEADER_LEN, n - DXLR02_FLOOD_HEADER_LEN, crc);
+    if(crc != ((uint16_t)p[7] << 8 | p[8])){
+        fl->stats.crc_errors++;
+        dxlr02_pool_release(buf);
+        return DXLR02_OK;
+    }
+
+    uint16_t origin = (uint16_t)(p[1] << 8 | p[2]);
+    uint32_t key = (uint32_t)origin << 16 | (uint32_t)(p[3] << 8 | p[4]);
+    uint8_t i = dxlr02_cache_find(fl, key);
+    if(i != DXLR02_FLOOD_NONE || origin == fl->node_id){
+        fl->stats.duplicates++;
+        if(i != DXLR02_FLOOD_NONE){
+            if(p[6] > fl->cache[i].hops && fl->cache[i].heard < UINT8_MAX)
+                fl->cache[i].heard++;
+            dxlr02_cache_touch(fl, i);
+        }
+        dxlr02_pool_release(buf);
+        return DXLR02_OK;
+    }
+
+    dxlr02_cache_insert(fl, key, p[6]);
+    fl->stats.received++;
+    if(fl->deliver)
+        fl->deliver(fl->ctx, origin, p[6] + 1, (const char *)p + DXLR02_FLOOD_HEADER_LEN, n - DXLR02_FLOOD_HEADER_LEN);
+
+    if(p[5] > 1)
+        dxlr02_flood_schedule(fl, key, p, n);
+    else
+        fl->stats.expired++;
+
+    dxlr02_pool_release(buf);
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_flood_poll(dxlr02_flood_t * fl){
+    if(!fl || !fl->module)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    int64_t now = esp_timer_get_time();
+    if(now < fl->next_tx_us)
+        return DXLR02_OK;
+
+    for(;;){
+        dxlr02_flood_pending_t * due = NULL;
+        for(int i = 0; i < DXLR02_FLOOD_PENDING; i++)
+            if(fl->pending[i].frame && fl->pending[i].due_us <= now && (!due || fl->pending[i].due_us < due->due_us))
+                due = &fl->pending[i];
+        if(!due)
+            return DXLR02_OK;
+
+        dxlr02_buf_t * wire = due->frame;
+        due->frame = NULL;
+
+        // Si ya se escucharon suficientes copias, los vecinos estan cubiertos
+        uint8_t i = dxlr02_cache_find(fl, due->key);
+        if(!due->origin && fl->suppress && i != DXLR02_FLOOD_NONE && fl->cache[i].heard >= fl->suppress){
+            fl->stats.suppressed++;
+            dxlr02_pool_release(wire);
+            continue;
+        }
+
+        dxlr02_status_t st = dxlr02_flood_transmit(fl, wire);
+        if(st == DXLR02_OK && !due->origin)
+            fl->stats.relayed++;
+        dxlr02_pool_release(wire);
+        return st;
+    }
+}
+
+dxlr02_status_t dxlr02_flood_init(dxlr02_flood_t * fl, dxlr02_t * module, uint16_t node_id, dxlr02_flood_deliver_t deliver, void * ctx){
+    if(!fl || !module)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(fl, 0, sizeof(*fl));
+    fl->module = module;
+    fl->node_id = node_id;
+    fl->seq = (uint16_t)esp_random();
+    fl->ttl = DXLR02_FLOOD_TTL;
+    fl->suppress = DXLR02_FLOOD_SUPPRESS;
+    fl->slots = DXLR02_FLOOD_SLOTS;
+    fl->newest = DXLR02_FLOOD_NONE;
+    fl->oldest = DXLR02_FLOOD_NONE;
+    memset(fl->buckets, DXLR02_FLOOD_NONE, sizeof(fl->buckets));
+    fl->deliver = deliver;
+    fl->ctx = ctx;
+    return DXLR02_OK;
+}
+
+void dxlr02_flood_deinit(dxlr02_flood_t * fl){
+    if(!fl)
+        return;
+    for(int i = 0; i < DXLR02_FLOOD_PENDING; i++){
+        if(fl->pending[i].frame){
+            dxlr02_pool_release(fl->pending[i].frame);
+            fl->pending[i].frame = NULL;
+        }
+    }
+}
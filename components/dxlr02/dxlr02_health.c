@@ -0,0 +1,375 @@
+#include "dxlr02_health.h"
+#include <string.h>
+#include "driver/uart.h"
+
+#define DXLR02_FACTORY_BAUD         9600
+#define DXLR02_HEALTH_RECHECK_MS    1000
+
+// Peor caso de cada escalon en lecturas AT (cada una hasta DXLR02_AT_TIMEOUT_MS), siguiendo las llamadas reales:
+//   entrar a AT desde UNKNOWN: probe ("Exit AT" + "Power On") + "+++" ("Entry AT")      3
+//   entrar a AT desde modo datos: "Entry AT"                                              1
+//   salir de AT: "Exit AT" + "Power On"                                                   2
+//   AT+RESET / AT+DEFAULT: "OK" + "Power On"                                              2
+//   comando de la tabla: una lectura                                                       1
+// Un AT+DEFAULT a un baud (o dxlr02_init) es entrar + AT+DEFAULT + AT+BAUD en su propia sesion; FACTORY son dos
+// de esos y la configuracion entera en una sesion. Sirve para no empezar un escalon que no termina: el tope duro
+// es module->at_deadline_us.
+#define DXLR02_READS_ENTER          3
+#define DXLR02_READS_ENTER_DATA     1
+#define DXLR02_READS_EXIT           2
+#define DXLR02_READS_RESTART        2
+#define DXLR02_READS_DEFAULT_AT     (DXLR02_READS_ENTER + DXLR02_READS_RESTART + DXLR02_READS_ENTER_DATA + 1 + DXLR02_READS_EXIT)
+
+static const uint32_t dxlr02_recover_worst_ms[DXLR02_RECOVER_LEVELS] = {
+    [DXLR02_RECOVER_RESYNC]  = (DXLR02_READS_ENTER + DXLR02_READS_EXIT) * DXLR02_AT_TIMEOUT_MS,
+    [DXLR02_RECOVER_RESET]   = (DXLR02_READS_ENTER + DXLR02_READS_RESTART) * DXLR02_AT_TIMEOUT_MS,
+    [DXLR02_RECOVER_FACTORY] = (2 * DXLR02_READS_DEFAULT_AT + DXLR02_READS_ENTER_DATA + DXLR02_AT_COUNT + DXLR02_READS_EXIT)
+                               * DXLR02_AT_TIMEOUT_MS,
+};
+
+dxlr02_status_t dxlr02_health_init(dxlr02_health_t * h, dxlr02_t * module, uint8_t port, int baudrate,
+                                   const dxlr02_config_t * desired, const dxlr02_health_config_t * conf){
+    if(!h || !module || baudrate <= 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(h, 0, sizeof(*h));
+    h->module = module;
+    h->port = port;
+    h->baudrate = baudrate;
+    if(desired){
+        h->desired = *desired;
+        h->desired.baudrate = baudrate;
+        h->has_desired = true;
+    }
+
+    const dxlr02_health_config_t def = DXLR02_HEALTH_CONFIG_DEFAULT();
+    h->conf = conf ? *conf : def;
+    if(h->conf.max_failures == 0)
+        h->conf.max_failures = 1;
+
+    h->tx = xQueueCreateStatic(DXLR02_HEALTH_TX_DEPTH, sizeof(dxlr02_buf_t *), (uint8_t *)h->tx_items, &h->tx_queue);
+    h->lock = xSemaphoreCreateMutexStatic(&h->lock_buf);
+    if(!h->tx || !h->lock)
+        return DXLR02_ERR_OUT_OF_SPACE;
+
+    int64_t now = esp_timer_get_time();
+    h->next_check_us = now + (int64_t)h->conf.check_ms * 1000;
+    h->last_rx_ms = (uint32_t)(now / 1000) - h->conf.check_ms;
+    h->runtime_at_us = now;
+    h->state = module->initialized ? DXLR02_HEALTH_OK : DXLR02_HEALTH_RECOVERING;
+    return DXLR02_OK;
+}
+
+void dxlr02_health_set_rx(dxlr02_health_t * h, dxlr02_health_rx_cb_t cb, void * ctx){
+    if(!h)
+        return;
+    h->rx_ctx = ctx;
+    h->on_rx = cb;
+}
+
+dxlr02_status_t dxlr02_health_send(dxlr02_health_t * h, const char * data, size_t len){
+    if(!h || !data || len == 0 || len > DXLR02_POOL_BLOCK_SIZE)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * buf;
+    if(dxlr02_pool_acquire(&buf) != DXLR02_OK){
+        h->stats.tx_dropped++;
+        return DXLR02_ERR_OUT_OF_SPACE;
+    }
+
+    memcpy(buf->data, data, len);
+    buf->len = len;
+    if(xQueueSend(h->tx, &buf, 0) != pdTRUE){
+        dxlr02_pool_release(buf);
+        h->stats.tx_dropped++;
+        return DXLR02_ERR_OUT_OF_SPACE;
+    }
+    return DXLR02_OK;
+}
+
+dxlr02_health_state_t dxlr02_health_get_state(const dxlr02_health_t * h){
+    return h ? h->state : DXLR02_HEALTH_FAILED;
+}
+
+// Solo cuentan los errores que dicen algo del modulo; los de parametros son del llamador
+static void dxlr02_health_note(dxlr02_health_t * h, dxlr02_status_t st){
+    if(st == DXLR02_OK){
+        h->consecutive = 0;
+        if(h->state == DXLR02_HEALTH_SUSPECT)
+            h->state = DXLR02_HEALTH_OK;
+        return;
+    }
+    if(st != DXLR02_ERR_TIMEOUT && st != DXLR02_ERR_INVALID_RESPONSE && st != DXLR02_ERR_UART &&
+       st != DXLR02_ERR_MODULE_NOT_RESPONDING && st != DXLR02_ERR_NOT_INITIALIZED)
+        return;
+
+    h->stats.failures++;
+    if(++h->consecutive >= h->conf.max_failures)
+        h->state = DXLR02_HEALTH_RECOVERING;
+    else if(h->state == DXLR02_HEALTH_OK)
+        h->state = DXLR02_HEALTH_SUSPECT;
+}
+
+/****************************************** RECOVERY ******************************************/
+
+// AT+DEFAULT hablandole al modulo a host_baud; deja el modulo en 9600 y el host igual
+static dxlr02_status_t dxlr02_health_default_at(dxlr02_health_t * h, int host_baud){
+    dxlr02_t * module = h->module;
+
+    if(uart_set_baudrate((uart_port_t)h->port, host_baud) != ESP_OK)
+        return DXLR02_ERR_UART;
+    if(!module->initialized)
+        return dxlr02_init(module, h->port, host_baud);
+
+    module->config.baudrate = host_baud;
+    module->state = DXLR02_STATE_UNKNOWN;
+    dxlr02_status_t st = dxlr02_set_default(module);
+    if(st != DXLR02_OK)
+        return st;
+    return dxlr02_set_baudrate(module, host_baud);
+}
+
+static dxlr02_status_t dxlr02_health_factory(dxlr02_health_t * h){
+    // El modulo puede seguir en el baud de trabajo o haber vuelto solo a fabrica
+    dxlr02_status_t st = dxlr02_health_default_at(h, h->baudrate);
+    if(st != DXLR02_OK && h->baudrate != DXLR02_FACTORY_BAUD)
+        st = dxlr02_health_default_at(h, DXLR02_FACTORY_BAUD);
+    if(st != DXLR02_OK)
+        return st;
+
+    if(h->has_desired)
+        return dxlr02_set_config(h->module, &h->desired);
+    if(h->module->config.baudrate != h->baudrate)
+        return dxlr02_set_baudrate(h->module, h->baudrate);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_health_run(dxlr02_health_t * h, dxlr02_recover_level_t level){
+    switch(level){
+        case DXLR02_RECOVER_RESYNC:  return dxlr02_resync(h->module);
+        case DXLR02_RECOVER_RESET:   return dxlr02_reset(h->module);
+        case DXLR02_RECOVER_FACTORY: return dxlr02_health_factory(h);
+        default:                     return DXLR02_ERR_INVALID_PARAMETER;
+    }
+}
+
+static void dxlr02_health_recover(dxlr02_health_t * h){
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline = t0 + (int64_t)h->conf.budget_ms * 1000;
+    dxlr02_status_t st = DXLR02_ERR_MODULE_NOT_RESPONDING;
+
+    h->state = DXLR02_HEALTH_RECOVERING;
+    h->module->at_deadline_us = deadline;
+
+    int level;
+    for(level = 0; level < DXLR02_RECOVER_LEVELS; level++){
+        // Sin init previo solo sirve el escalon de fabrica
+        if(!h->module->initialized && level != DXLR02_RECOVER_FACTORY)
+            continue;
+        if(esp_timer_get_time() + (int64_t)dxlr02_recover_worst_ms[level] * 1000 > deadline)
+            break;
+
+        st = dxlr02_health_run(h, level);
+        if(st == DXLR02_OK)
+            break;
+    }
+
+    h->module->at_deadline_us = 0;
+
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed_ms = (uint32_t)((now - t0) / 1000);
+    h->stats.last_recovery_ms = elapsed_ms;
+    if(elapsed_ms > h->stats.max_recovery_ms)
+        h->stats.max_recovery_ms = elapsed_ms;
+
+    if(st != DXLR02_OK){
+        h->stats.recoveries_failed++;
+        h->state = DXLR02_HEALTH_FAILED;
+        h->retry_at_us = now + (int64_t)h->conf.retry_ms * 1000;
+        return;
+    }
+
+    h->stats.recoveries++;
+    h->stats.level_ok[level]++;
+    h->consecutive = 0;
+    h->state = DXLR02_HEALTH_OK;
+    h->next_check_us = now + (int64_t)h->conf.check_ms * 1000;
+}
+
+/****************************************** SUPERVISOR ******************************************/
+
+// Una lectura de RX. Los callbacks corren fuera del lock para no demorar una sesion AT del supervisor.
+// ts: metricas de la tarea de RX (NULL si la hace el supervisor)
+static void dxlr02_health_rx(dxlr02_health_t * h, uint32_t wait_ms, dxlr02_task_stats_t * ts){
+    dxlr02_buf_t * buf;
+    if(dxlr02_pool_acquire(&buf) != DXLR02_OK){
+        vTaskDelay(1);
+        return;
+    }
+
+    size_t buffered = 0;
+    if(uart_get_buffered_data_len((uart_port_t)h->port, &buffered) == ESP_OK && buffered > h->stats.rx_buffered_max)
+        h->stats.rx_buffered_max = buffered;
+
+    dxlr02_frame_t frames[DXLR02_HEALTH_RX_FRAMES];
+    size_t n = 0;
+    int64_t deadline = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+    dxlr02_status_t st = dxlr02_receive_batch(h->module, buf->data, DXLR02_POOL_BLOCK_SIZE, frames, DXLR02_HEALTH_RX_FRAMES,
+                                              wait_ms > 0 ? 1 : 0, wait_ms, &n);
+    xSemaphoreGive(h->lock);
+
+    int64_t now = esp_timer_get_time();
+    if(ts){
+        ts->loops++;
+        if(st == DXLR02_ERR_TIMEOUT && now - deadline > ts->late_max_us)
+            ts->late_max_us = (uint32_t)(now - deadline);
+    }
+
+    if(st == DXLR02_OK && n > 0){
+        // Llego algo: el modulo esta vivo
+        h->last_rx_ms = (uint32_t)(now / 1000);
+        if(h->on_rx){
+            for(size_t i = 0; i < n; i++)
+                h->on_rx(h->rx_ctx, frames[i].data, frames[i].len);
+        }
+    }
+    dxlr02_pool_release(buf);
+}
+
+void dxlr02_health_poll(dxlr02_health_t * h, uint32_t wait_ms){
+    if(!h)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    if(h->state == DXLR02_HEALTH_RECOVERING || (h->state == DXLR02_HEALTH_FAILED && now >= h->retry_at_us)){
+        xSemaphoreTake(h->lock, portMAX_DELAY);
+        dxlr02_health_recover(h);
+        xSemaphoreGive(h->lock);
+    }
+
+    // Caido: los productores siguen encolando hasta llenar la cola, no se manda nada
+    if(h->state == DXLR02_HEALTH_FAILED){
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        return;
+    }
+
+    // El envio no compite con la RX (la UART tiene lados independientes), no hace falta el lock. Salvo para
+    // salir de AT si el ultimo chequeo de vida dejo el modulo ahi.
+    dxlr02_buf_t * buf;
+    if(xQueueReceive(h->tx, &buf, pdMS_TO_TICKS(wait_ms)) == pdTRUE){
+        dxlr02_status_t st = DXLR02_OK;
+        if(dxlr02_get_state(h->module) != DXLR02_STATE_DATA){
+            xSemaphoreTake(h->lock, portMAX_DELAY);
+            st = dxlr02_ensure_data_mode(h->module);
+            xSemaphoreGive(h->lock);
+        }
+        if(st == DXLR02_OK)
+            st = dxlr02_send_data(h->module, buf->data, buf->len);
+        dxlr02_health_note(h, st);
+        dxlr02_pool_release(buf);
+    }
+    h->task_stats[0].loops++;
+
+    if(!h->rx_task && h->on_rx)
+        dxlr02_health_rx(h, 0, NULL);
+
+    now = esp_timer_get_time();
+    if(h->state != DXLR02_HEALTH_RECOVERING && now >= h->next_check_us){
+        // Trafico RX reciente ya prueba que el modulo vive; si no, dxlr02_ping (no lo reinicia)
+        if((uint32_t)(now / 1000) - h->last_rx_ms < h->conf.check_ms){
+            dxlr02_health_note(h, DXLR02_OK);
+        } else {
+            h->stats.checks++;
+            xSemaphoreTake(h->lock, portMAX_DELAY);
+            dxlr02_health_note(h, dxlr02_ping(h->module));
+            xSemaphoreGive(h->lock);
+        }
+
+        // Con fallas se vuelve a chequear enseguida para llegar al umbral sin esperar check_ms cada vez
+        uint32_t next_ms = h->state == DXLR02_HEALTH_OK ? h->conf.check_ms : DXLR02_HEALTH_RECHECK_MS;
+        h->next_check_us = esp_timer_get_time() + (int64_t)next_ms * 1000;
+    }
+}
+
+static void dxlr02_health_task(void * arg){
+    dxlr02_health_t * h = arg;
+    for(;;)
+        dxlr02_health_poll(h, DXLR02_HEALTH_POLL_MS);
+}
+
+static void dxlr02_health_rx_task(void * arg){
+    dxlr02_health_t * h = arg;
+    for(;;){
+        // Durante la recuperacion el modulo es del supervisor
+        if(h->state == DXLR02_HEALTH_RECOVERING || h->state == DXLR02_HEALTH_FAILED){
+            vTaskDelay(pdMS_TO_TICKS(DXLR02_HEALTH_POLL_MS));
+            continue;
+        }
+        dxlr02_health_rx(h, DXLR02_HEALTH_POLL_MS, &h->task_stats[1]);
+    }
+}
+
+dxlr02_status_t dxlr02_health_start(dxlr02_health_t * h, UBaseType_t priority, uint32_t stack){
+    if(!h || !h->tx)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(h->task)
+        return DXLR02_ERR_ALREADY_INIT;
+
+    if(xTaskCreate(dxlr02_health_task, "dxlr02_health", stack, h, priority, &h->task) != pdPASS)
+        return DXLR02_ERR_OUT_OF_SPACE;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_health_start_layout(dxlr02_health_t * h, const dxlr02_health_layout_t * layout){
+    if(!h || !h->tx)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(h->task)
+        return DXLR02_ERR_ALREADY_INIT;
+
+    const dxlr02_health_layout_t def = DXLR02_HEALTH_LAYOUT_DEFAULT();
+    if(!layout)
+        layout = &def;
+
+    // La RX arranca primero: el supervisor ya la encuentra y no la hace el
+    if(xTaskCreatePinnedToCore(dxlr02_health_rx_task, "dxlr02_rx", layout->rx_stack, h, layout->rx_priority,
+                               &h->rx_task, layout->rx_core) != pdPASS)
+        return DXLR02_ERR_OUT_OF_SPACE;
+
+    if(xTaskCreatePinnedToCore(dxlr02_health_task, "dxlr02_health", layout->tx_stack, h, layout->tx_priority,
+                               &h->task, layout->tx_core) != pdPASS)
+        return DXLR02_ERR_OUT_OF_SPACE;
+    return DXLR02_OK;
+}
+
+void dxlr02_health_task_stats(dxlr02_health_t * h, dxlr02_task_stats_t * supervisor, dxlr02_task_stats_t * rx){
+    if(!h)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    TaskHandle_t tasks[2] = { h->task, h->rx_task };
+
+    for(int i = 0; i < 2; i++){
+        if(!tasks[i])
+            continue;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        // Con el contador en esp_timer las unidades son us, igual que elapsed
+        uint64_t elapsed = (uint64_t)(now - h->runtime_at_us);
+        uint64_t runtime = ulTaskGetRunTimeCounter(tasks[i]);
+        h->task_stats[i].cpu_permille = elapsed ? (uint32_t)((runtime - h->runtime_prev[i]) * 1000 / elapsed) : 0;
+        h->runtime_prev[i] = runtime;
+#endif
+        h->task_stats[i].stack_free = uxTaskGetStackHighWaterMark(tasks[i]);     // en ESP-IDF ya viene en bytes
+    }
+    h->runtime_at_us = now;
+
+    if(supervisor)
+        *supervisor = h->task_stats[0];
+    if(rx){
+        if(h->rx_task)
+            *rx = h->task_stats[1];
+        else
+            memset(rx, 0, sizeof(*rx));
+    }
+}
@@ -0,0 +1,89 @@
+#include "dxlr02_pool.h"
+#include "freertos/FreeRTOS.h"
+
+_Static_assert(DXLR02_POOL_BLOCK_COUNT <= 255, "el indice del bloque es de 8 bits");
+
+static dxlr02_buf_t dxlr02_pool_blocks[DXLR02_POOL_BLOCK_COUNT];
+
+// Pila de indices libres. Los bloques que nunca se usaron se toman en orden con fresh, asi no hace
+// falta inicializar nada al arrancar.
+static uint8_t dxlr02_pool_free[DXLR02_POOL_BLOCK_COUNT];
+static uint16_t dxlr02_pool_free_top = 0;
+static uint16_t dxlr02_pool_fresh = 0;
+
+static dxlr02_pool_stats_t dxlr02_pool_stats = {
+    .block_size = DXLR02_POOL_BLOCK_SIZE,
+    .block_count = DXLR02_POOL_BLOCK_COUNT,
+};
+
+static portMUX_TYPE dxlr02_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+dxlr02_status_t dxlr02_pool_acquire(dxlr02_buf_t ** buf){
+    if(!buf)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_buf_t * block = NULL;
+
+    portENTER_CRITICAL(&dxlr02_pool_lock);
+    if(dxlr02_pool_free_top > 0){
+        block = &dxlr02_pool_blocks[dxlr02_pool_free[--dxlr02_pool_free_top]];
+    } else if(dxlr02_pool_fresh < DXLR02_POOL_BLOCK_COUNT){
+        block = &dxlr02_pool_blocks[dxlr02_pool_fresh];
+        block->index = dxlr02_pool_fresh++;
+    }
+
+    if(block){
+        block->refs = 1;
+        block->len = 0;
+        dxlr02_pool_stats.acquires++;
+        dxlr02_pool_stats.in_use++;
+        if(dxlr02_pool_stats.in_use > dxlr02_pool_stats.high_water)
+            dxlr02_pool_stats.high_water = dxlr02_pool_stats.in_use;
+    } else {
+        dxlr02_pool_stats.failures++;
+    }
+    portEXIT_CRITICAL(&dxlr02_pool_lock);
+
+    *buf = block;
+    return block ? DXLR02_OK : DXLR02_ERR_OUT_OF_SPACE;
+}
+
+dxlr02_status_t dxlr02_pool_retain(dxlr02_buf_t * buf){
+    if(!buf)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_status_t st = DXLR02_OK;
+    portENTER_CRITICAL(&dxlr02_pool_lock);
+    // refs == 0: el bloque ya volvio al pool. En UINT8_MAX no se suma: el release que la equilibra lo liberaria antes de tiempo
+    if(buf->refs == 0)
+        st = DXLR02_ERR_INVALID_PARAMETER;
+    else if(buf->refs == UINT8_MAX)
+        st = DXLR02_ERR_OUT_OF_SPACE;
+    else
+        buf->refs++;
+    portEXIT_CRITICAL(&dxlr02_pool_lock);
+    return st;
+}
+
+void dxlr02_pool_release(dxlr02_buf_t * buf){
+    if(!buf)
+        return;
+
+    portENTER_CRITICAL(&dxlr02_pool_lock);
+    // refs == 0: release de mas, se ignora para no meter el bloque dos veces en la pila
+    if(buf->refs > 0 && --buf->refs == 0){
+        dxlr02_pool_free[dxlr02_pool_free_top++] = buf->index;
+        dxlr02_pool_stats.in_use--;
+    }
+    portEXIT_CRITICAL(&dxlr02_pool_lock);
+}
+
+dxlr02_status_t dxlr02_pool_get_stats(dxlr02_pool_stats_t * stats){
+    if(!stats)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    portENTER_CRITICAL(&dxlr02_pool_lock);
+    *stats = dxlr02_pool_stats;
+    portEXIT_CRITICAL(&dxlr02_pool_lock);
+    return DXLR02_OK;
+}
@@ -0,0 +1,521 @@
+#include "dxlr02_queue.h"
+#include "dxlr02_airtime.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_random.h"
+
+#define DXLR02_QUEUE_MAGIC      0x3151524Cu     // "LRQ1"
+#define DXLR02_REC_FREE         0xFF
+#define DXLR02_REC_WRITTEN      0xFE
+#define DXLR02_REC_CONSUMED     0xFC            // entregado, junto con todo lo anterior
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t crc;
+} dxlr02_seg_hdr_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t reserved;
+    uint16_t len;
+    uint32_t crc;
+} dxlr02_rec_hdr_t;
+
+_Static_assert(sizeof(dxlr02_seg_hdr_t) == DXLR02_QUEUE_SEG_HDR_LEN, "header de segmento");
+_Static_assert(sizeof(dxlr02_rec_hdr_t) == DXLR02_QUEUE_REC_HDR_LEN, "header de registro");
+
+static uint32_t dxlr02_rec_size(size_t len){
+    return (DXLR02_QUEUE_REC_HDR_LEN + len + 3) & ~3u;
+}
+
+static uint32_t dxlr02_rec_crc(uint16_t len, const void * data){
+    return dxlr02_crc32(data, len, dxlr02_crc32(&len, sizeof(len), 0));
+}
+
+static uint32_t dxlr02_seg_addr(const dxlr02_queue_t * q, uint16_t seg){
+    return (uint32_t)seg * q->storage.sector_size;
+}
+
+static bool dxlr02_seg_read_hdr(dxlr02_queue_t * q, uint16_t seg, dxlr02_seg_hdr_t * hdr){
+    if(q->storage.read(q->storage.ctx, dxlr02_seg_addr(q, seg), hdr, sizeof(*hdr)) != DXLR02_OK)
+        return false;
+    return hdr->magic == DXLR02_QUEUE_MAGIC && hdr->crc == dxlr02_crc32(hdr, 12, 0);
+}
+
+// Borra el segmento y lo abre como el mas nuevo del log
+static dxlr02_status_t dxlr02_seg_format(dxlr02_queue_t * q, uint16_t seg){
+    dxlr02_seg_hdr_t hdr;
+    uint32_t erase_count = dxlr02_seg_read_hdr(q, seg, &hdr) ? hdr.erase_count : 0;
+
+    dxlr02_status_t st = q->storage.erase(q->storage.ctx, dxlr02_seg_addr(q, seg), q->storage.sector_size);
+    if(st != DXLR02_OK)
+        return st;
+    q->stats.erases++;
+
+    hdr.magic = DXLR02_QUEUE_MAGIC;
+    hdr.seq = q->next_seq++;
+    hdr.erase_count = erase_count + 1;
+    hdr.crc = dxlr02_crc32(&hdr, 12, 0);
+    if(hdr.erase_count > q->stats.max_erase_count)
+        q->stats.max_erase_count = hdr.erase_count;
+
+    st = q->storage.write(q->storage.ctx, dxlr02_seg_addr(q, seg), &hdr, sizeof(hdr));
+    if(st != DXLR02_OK)
+        return st;
+
+    q->head_seg = seg;
+    q->head_off = DXLR02_QUEUE_SEG_HDR_LEN;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_queue_rotate(dxlr02_queue_t * q){
+    uint16_t next = (q->head_seg + 1) % q->n_segments;
+    if(next == q->tail_seg)
+        return DXLR02_ERR_OUT_OF_SPACE;
+    return dxlr02_seg_format(q, next);
+}
+
+// Lee y valida el registro en (seg, off). false: no hay registro valido ahi.
+static bool dxlr02_rec_read(dxlr02_queue_t * q, uint16_t seg, uint32_t off, dxlr02_rec_hdr_t * hdr, dxlr02_buf_t * buf, bool * torn){
+    *torn = false;
+    if(off + DXLR02_QUEUE_REC_HDR_LEN > q->storage.sector_size)
+        return false;
+    if(q->storage.read(q->storage.ctx, dxlr02_seg_addr(q, seg) + off, hdr, sizeof(*hdr)) != DXLR02_OK)
+        return false;
+    if(hdr->state == DXLR02_REC_FREE)
+        return false;
+
+    if((hdr->state != DXLR02_REC_WRITTEN && hdr->state != DXLR02_REC_CONSUMED) || hdr->len > DXLR02_POOL_BLOCK_SIZE ||
+       off + dxlr02_rec_size(hdr->len) > q->storage.sector_size){
+        *torn = true;
+        return false;
+    }
+
+    if(q->storage.read(q->storage.ctx, dxlr02_seg_addr(q, seg) + off + DXLR02_QUEUE_REC_HDR_LEN, buf->data, hdr->len) != DXLR02_OK)
+        return false;
+    if(dxlr02_rec_crc(hdr->len, buf->data) != hdr->crc){
+        *torn = true;
+        return false;
+    }
+
+    buf->len = hdr->len;
+    return true;
+}
+
+dxlr02_status_t dxlr02_queue_open(dxlr02_queue_t * q, const dxlr02_storage_t * storage, uint16_t node_id){
+    if(!q || !storage || storage->sector_size < 256 || storage->size / storage->sector_size < 2)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    int64_t t0 = esp_timer_get_time();
+    memset(q, 0, sizeof(*q));
+    q->storage = *storage;
+    q->n_segments = storage->size / storage->sector_size;
+    q->node_id = node_id;
+    q->session = (uint16_t)esp_random();        // el gateway ve el reinicio y se vuelve a sincronizar
+    q->tail_tx_seq = (uint16_t)esp_random();
+
+    // Los segmentos validos forman una ronda contigua de oldest a newest
+    bool any = false;
+    uint32_t oldest_seq = UINT32_MAX, newest_seq = 0;
+    uint16_t oldest = 0, newest = 0;
+    for(uint16_t seg = 0; seg < q->n_segments; seg++){
+        dxlr02_seg_hdr_t hdr;
+        if(!dxlr02_seg_read_hdr(q, seg, &hdr))
+            continue;
+        any = true;
+        if(hdr.seq < oldest_seq){ oldest_seq = hdr.seq; oldest = seg; }
+        if(hdr.seq >= newest_seq){ newest_seq = hdr.seq; newest = seg; }
+        if(hdr.erase_count > q->stats.max_erase_count)
+            q->stats.max_erase_count = hdr.erase_count;
+    }
+
+    dxlr02_status_t st;
+    if(!any){
+        q->next_seq = 1;
+        st = dxlr02_seg_format(q, 0);
+        q->tail_seg = q->send_seg = 0;
+        q->tail_off = q->send_off = DXLR02_QUEUE_SEG_HDR_LEN;
+        q->stats.recovery_us = (uint32_t)(esp_timer_get_time() - t0);
+        return st;
+    }
+
+    q->next_seq = newest_seq + 1;
+    q->head_seg = newest;
+    q->tail_seg = oldest;
+    q->tail_off = DXLR02_QUEUE_SEG_HDR_LEN;
+
+    dxlr02_buf_t * buf;
+    st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    bool head_torn = false;
+    for(uint16_t seg = oldest; ; seg = (seg + 1) % q->n_segments){
+        uint32_t off = DXLR02_QUEUE_SEG_HDR_LEN;
+        dxlr02_rec_hdr_t hdr;
+        bool torn;
+
+        while(dxlr02_rec_read(q, seg, off, &hdr, buf, &torn)){
+            off += dxlr02_rec_size(hdr.len);
+            if(hdr.state == DXLR02_REC_CONSUMED){
+                q->pending = 0;
+                q->tail_seg = seg;
+                q->tail_off = off;
+            } else {
+                q->pending++;
+            }
+        }
+        if(torn){
+            q->stats.torn++;
+            if(seg == newest)
+                head_torn = true;
+        }
+        if(seg == newest){
+            q->head_off = off;
+            break;
+        }
+    }
+    dxlr02_pool_release(buf);
+
+    q->stats.recovered = q->pending;
+    q->send_seg = q->tail_seg;
+    q->send_off = q->tail_off;
+
+    // Despues de una escritura cortada el resto del sector no esta en 0xFF: se sigue en uno nuevo.
+    // Si la cola esta llena el segmento queda cerrado y el proximo append rota cuando se drene.
+    if(head_torn){
+        st = dxlr02_queue_rotate(q);
+        if(st == DXLR02_ERR_OUT_OF_SPACE){
+            q->head_off = q->storage.sector_size;
+            st = DXLR02_OK;
+        }
+    }
+
+    q->stats.recovery_us = (uint32_t)(esp_timer_get_time() - t0);
+    return st;
+}
+
+dxlr02_status_t dxlr02_queue_commit(dxlr02_queue_t * q){
+    if(!q)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(!q->batch || q->batch_len == 0)
+        return DXLR02_OK;
+
+    dxlr02_status_t st = q->storage.write(q->storage.ctx, dxlr02_seg_addr(q, q->head_seg) + q->head_off, q->batch->data, q->batch_len);
+    if(st != DXLR02_OK)
+        return st;
+
+    q->head_off += q->batch_len;
+    q->batch_len = 0;
+    q->stats.commits++;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_queue_append(dxlr02_queue_t * q, const char * data, size_t len){
+    if(!q || !data || len == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // Tiene que entrar en el bloque y en el ring de RX del gateway como frame, con su header y el '\0'
+    uint32_t rec = dxlr02_rec_size(len);
+    if(DXLR02_QUEUE_FRAME_HDR_LEN + len + 1 > DXLR02_POOL_BLOCK_SIZE || rec > DXLR02_POOL_BLOCK_SIZE ||
+       rec > q->storage.sector_size - DXLR02_QUEUE_SEG_HDR_LEN)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_status_t st;
+    if(!q->batch){
+        st = dxlr02_pool_acquire(&q->batch);
+        if(st != DXLR02_OK)
+            return st;
+        q->batch_len = 0;
+    }
+
+    if(q->batch_len + rec > DXLR02_POOL_BLOCK_SIZE){
+        st = dxlr02_queue_commit(q);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    if(q->head_off + q->batch_len + rec > q->storage.sector_size){
+        st = dxlr02_queue_commit(q);
+        if(st != DXLR02_OK)
+            return st;
+        st = dxlr02_queue_rotate(q);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    char * p = q->batch->data + q->batch_len;
+    dxlr02_rec_hdr_t hdr = {
+        .state = DXLR02_REC_WRITTEN,
+        .reserved = 0xFF,
+        .len = (uint16_t)len,
+        .crc = dxlr02_rec_crc((uint16_t)len, data),
+    };
+    memcpy(p, &hdr, sizeof(hdr));
+    memcpy(p + sizeof(hdr), data, len);
+    memset(p + sizeof(hdr) + len, 0xFF, rec - sizeof(hdr) - len);
+
+    q->batch_len += rec;
+    q->pending++;
+    q->stats.appended++;
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t dxlr02_queue_mark(dxlr02_queue_t * q){
+    if(q->unmarked == 0)
+        return DXLR02_OK;
+
+    const uint8_t consumed = DXLR02_REC_CONSUMED;
+    dxlr02_status_t st = q->storage.write(q->storage.ctx, q->last_acked, &consumed, 1);
+    if(st == DXLR02_OK){
+        q->unmarked = 0;
+        q->stats.marks++;
+    }
+    return st;
+}
+
+static bool dxlr02_queue_hex(const char * src, uint16_t * value){
+    char field[5];
+    char * end;
+
+    memcpy(field, src, 4);
+    field[4] = '\0';
+    *value = (uint16_t)strtoul(field, &end, 16);
+    return *end == '\0';
+}
+
+// Vuelve al primero sin confirmar y cierra la ventana
+static void dxlr02_queue_rewind(dxlr02_queue_t * q){
+    q->send_seg = q->tail_seg;
+    q->send_off = q->tail_off;
+    q->in_flight = 0;
+    q->stats.rewinds++;
+}
+
+dxlr02_status_t dxlr02_queue_drain(dxlr02_queue_t * q, dxlr02_t * module, uint32_t max_records, uint32_t * sent){
+    if(!q || !module || !sent)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    *sent = 0;
+    dxlr02_status_t st = dxlr02_queue_commit(q);
+    if(st != DXLR02_OK)
+        return st;
+
+    // Ventana sin confirmar: se espera el ACK; vencido el plazo se repite desde el primero
+    if(q->in_flight > 0){
+        if(esp_timer_get_time() < q->ack_deadline_us)
+            return DXLR02_OK;
+        q->stats.timeouts++;
+        dxlr02_queue_rewind(q);
+    }
+
+    dxlr02_buf_t * buf;
+    st = dxlr02_pool_acquire(&buf);
+    if(st != DXLR02_OK)
+        return st;
+
+    uint32_t window = max_records < DXLR02_QUEUE_WINDOW ? max_records : DXLR02_QUEUE_WINDOW;
+    if(window > q->pending)
+        window = q->pending;
+
+    while(q->in_flight < window){
+        dxlr02_rec_hdr_t hdr;
+        bool torn;
+
+        if(!dxlr02_rec_read(q, q->send_seg, q->send_off, &hdr, buf, &torn)){
+            // Fin del segmento: el siguiente ya esta escrito
+            if(q->send_seg == q->head_seg){
+                q->pending = q->in_flight;
+                break;
+            }
+            q->send_seg = (q->send_seg + 1) % q->n_segments;
+            q->send_off = DXLR02_QUEUE_SEG_HDR_LEN;
+            continue;
+        }
+
+        // El registro entra en el bloque con el header del frame: lo controla dxlr02_queue_append
+        char tag[DXLR02_QUEUE_FRAME_HDR_LEN + 1];
+        int type = q->in_flight == 0 ? DXLR02_QUEUE_TAG_SYNC : DXLR02_QUEUE_TAG_DATA;
+        if(q->in_flight + 1u == window)
+            type |= DXLR02_QUEUE_TAG_POLL;
+        snprintf(tag, sizeof(tag), "%c%04X%04X%04X", type, q->node_id, q->session, (uint16_t)(q->tail_tx_seq + q->in_flight));
+        memmove(buf->data + DXLR02_QUEUE_FRAME_HDR_LEN, buf->data, buf->len);
+        memcpy(buf->data, tag, DXLR02_QUEUE_FRAME_HDR_LEN);
+        size_t frame_len = buf->len + DXLR02_QUEUE_FRAME_HDR_LEN;
+
+        int64_t wait = q->next_tx_us - esp_timer_get_time();
+        if(wait > 0)
+            vTaskDelay(pdMS_TO_TICKS((wait + 999) / 1000));
+
+        st = dxlr02_send_data(module, buf->data, frame_len);
+        if(st != DXLR02_OK)
+            break;
+
+        q->next_tx_us = esp_timer_get_time() + dxlr02_uart_time_us(&module->config, frame_len + 1)
+                      + dxlr02_time_on_air_us(&module->config, frame_len + 1);
+
+        // El ACK: header solo, ida por la UART del gateway y vuelta por el aire
+        size_t ack = DXLR02_QUEUE_FRAME_HDR_LEN + 1;
+        q->ack_deadline_us = q->next_tx_us + 2 * dxlr02_uart_time_us(&module->config, ack)
+                           + dxlr02_time_on_air_us(&module->config, ack) + DXLR02_QUEUE_ACK_MARGIN_MS * 1000LL;
+
+        q->in_flight_addr[q->in_flight++] = dxlr02_seg_addr(q, q->send_seg) + q->send_off;
+        q->send_off += dxlr02_rec_size(hdr.len);
+        q->stats.drained++;
+        (*sent)++;
+    }
+    dxlr02_pool_release(buf);
+
+    dxlr02_status_t mst = dxlr02_queue_mark(q);
+    return st != DXLR02_OK ? st : mst;
+}
+
+// [tipo][nodo][sesion][seq]
+static bool dxlr02_queue_parse(const char * frame, uint16_t * node, uint16_t * session, uint16_t * seq){
+    return dxlr02_queue_hex(frame + 1, node) && dxlr02_queue_hex(frame + 5, session) && dxlr02_queue_hex(frame + 9, seq);
+}
+
+dxlr02_status_t dxlr02_queue_on_frame(dxlr02_queue_t * q, const char * frame, size_t len){
+    uint16_t node, session, seq;
+    if(!q || !frame)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(len != DXLR02_QUEUE_FRAME_HDR_LEN || frame[0] != DXLR02_QUEUE_TAG_ACK || !dxlr02_queue_parse(frame, &node, &session, &seq))
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    // El gateway le contesta a todos por el mismo canal: lo que no es para esta sesion no se mira
+    if(node != q->node_id || session != q->session)
+        return DXLR02_OK;
+
+    // Confirma de tail hasta seq; el resto de la ventana no llego en orden y se repite. Sin ventana abierta
+    // (o con un seq que no cae en ella) es un ACK viejo o repetido.
+    uint16_t n = (uint16_t)(seq - q->tail_tx_seq + 1);
+    if(q->in_flight == 0 || n > q->in_flight)
+        return DXLR02_OK;
+
+    if(n > 0){
+        q->last_acked = q->in_flight_addr[n - 1];
+        uint32_t next = n < q->in_flight ? q->in_flight_addr[n] : dxlr02_seg_addr(q, q->send_seg) + q->send_off;
+        q->tail_seg = next / q->storage.sector_size;
+        q->tail_off = next % q->storage.sector_size;
+        q->tail_tx_seq += n;
+        q->pending -= n;
+        q->unmarked += n;
+        q->stats.acked += n;
+    }
+    if(n < q->in_flight)
+        dxlr02_queue_rewind(q);
+    q->in_flight = 0;
+
+    if(q->unmarked >= DXLR02_QUEUE_MARK_EVERY)
+        return dxlr02_queue_mark(q);
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_queue_close(dxlr02_queue_t * q){
+    if(!q)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    dxlr02_status_t st = dxlr02_queue_commit(q);
+    if(st == DXLR02_OK)
+        st = dxlr02_queue_mark(q);
+
+    if(q->batch){
+        dxlr02_pool_release(q->batch);
+        q->batch = NULL;
+    }
+    return st;
+}
+
+uint32_t dxlr02_queue_pending(const dxlr02_queue_t * q){
+    return q ? q->pending : 0;
+}
+
+void dxlr02_queue_receiver_init(dxlr02_queue_receiver_t * r){
+    if(r)
+        memset(r, 0, sizeof(*r));
+}
+
+// Estado del nodo, o NULL si no se lo sigue
+static dxlr02_queue_source_t * dxlr02_queue_find(dxlr02_queue_receiver_t * r, uint16_t node){
+    for(int i = 0; i < DXLR02_QUEUE_SOURCES; i++)
+        if(r->sources[i].used && r->sources[i].node == node)
+            return &r->sources[i];
+    return NULL;
+}
+
+// Lugar para un nodo nuevo: uno libre o el del que hace mas que no manda
+static dxlr02_queue_source_t * dxlr02_queue_take(dxlr02_queue_receiver_t * r, uint16_t node){
+    dxlr02_queue_source_t * victim = &r->sources[0];
+    for(int i = 1; i < DXLR02_QUEUE_SOURCES && victim->used; i++)
+        if(!r->sources[i].used || r->sources[i].last_rx < victim->last_rx)
+            victim = &r->sources[i];
+
+    if(victim->used)
+        r->evictions++;
+    memset(victim, 0, sizeof(*victim));
+    victim->used = true;
+    victim->node = node;
+    return victim;
+}
+
+dxlr02_status_t dxlr02_queue_receive(dxlr02_queue_receiver_t * r, dxlr02_t * module, const char * frame, size_t len,
+                                     const char ** data, size_t * data_len, uint16_t * node){
+    uint16_t from, session, seq;
+    if(!r || !module || !frame || !data || !data_len)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    *data = NULL;
+    *data_len = 0;
+    if(len < DXLR02_QUEUE_FRAME_HDR_LEN)
+        return DXLR02_ERR_INVALID_RESPONSE;
+    int type = frame[0] & ~DXLR02_QUEUE_TAG_POLL;
+    if((type != DXLR02_QUEUE_TAG_SYNC && type != DXLR02_QUEUE_TAG_DATA) || !dxlr02_queue_parse(frame, &from, &session, &seq))
+        return DXLR02_ERR_INVALID_RESPONSE;
+    if(node)
+        *node = from;
+
+    // Sesion nueva: el nodo se reinicio (o es la primera vez que se lo ve) y su seq no tiene nada que ver con
+    // el de antes. Se espera su SYNC.
+    dxlr02_queue_source_t * src = dxlr02_queue_find(r, from);
+    if(!src || src->session != session){
+        if(!src)
+            src = dxlr02_queue_take(r, from);
+        src->session = session;
+        src->synced = false;
+        r->sessions++;
+    }
+    src->last_rx = ++r->clock;
+
+    // SYNC: primero de una ventana, su seq es la base. Salvo que sea la repeticion de una ventana ya entregada
+    // (se perdio el ACK): eso se descarta como cualquier frame viejo.
+    uint16_t behind = (uint16_t)(src->expected - seq);
+    if(type == DXLR02_QUEUE_TAG_SYNC && !(src->synced && behind > 0 && behind <= DXLR02_QUEUE_WINDOW)){
+        src->expected = seq;
+        src->synced = true;
+    }
+    if(!src->synced){
+        r->dropped++;
+        return DXLR02_OK;
+    }
+
+    if(seq == src->expected){
+        src->expected++;
+        r->delivered++;
+        *data = frame + DXLR02_QUEUE_FRAME_HDR_LEN;
+        *data_len = len - DXLR02_QUEUE_FRAME_HDR_LEN;
+    } else {
+        r->dropped++;
+    }
+    if(!(frame[0] & DXLR02_QUEUE_TAG_POLL))
+        return DXLR02_OK;
+
+    r->acks++;
+    char ack[DXLR02_QUEUE_FRAME_HDR_LEN + 1];
+    snprintf(ack, sizeof(ack), "%c%04X%04X%04X", DXLR02_QUEUE_TAG_ACK, from, session, (uint16_t)(src->expected - 1));
+    return dxlr02_send_data(module, ack, DXLR02_QUEUE_FRAME_HDR_LEN);
+}
@@ -0,0 +1,130 @@
+#include "dxlr02_storage.h"
+#include <string.h>
+
+// CRC-32 (IEEE) con tabla de nibbles: 64 bytes de tabla en vez de 1 KB
+uint32_t dxlr02_crc32(const void * data, size_t len, uint32_t crc){
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t * p = data;
+
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++){
+        crc = table[(crc ^ p[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (p[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+#ifdef ESP_PLATFORM
+
+#include "esp_partition.h"
+
+static dxlr02_status_t dxlr02_partition_read(void * ctx, uint32_t addr, void * buf, size_t len){
+    return esp_partition_read((const esp_partition_t *)ctx, addr, buf, len) == ESP_OK ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t dxlr02_partition_write(void * ctx, uint32_t addr, const void * buf, size_t len){
+    return esp_partition_write((const esp_partition_t *)ctx, addr, buf, len) == ESP_OK ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t dxlr02_partition_erase(void * ctx, uint32_t addr, size_t len){
+    return esp_partition_erase_range((const esp_partition_t *)ctx, addr, len) == ESP_OK ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+dxlr02_status_t dxlr02_storage_partition(dxlr02_storage_t * storage, const char * label){
+    if(!storage || !label)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    const esp_partition_t * part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if(!part)
+        return DXLR02_ERR_NOT_INITIALIZED;
+
+    storage->read = dxlr02_partition_read;
+    storage->write = dxlr02_partition_write;
+    storage->erase = dxlr02_partition_erase;
+    storage->size = part->size;
+    storage->sector_size = SPI_FLASH_SEC_SIZE;
+    storage->ctx = (void *)part;
+    return DXLR02_OK;
+}
+
+#else
+
+#include <stdio.h>
+
+#define DXLR02_FILE_SECTOR 4096
+
+static dxlr02_status_t dxlr02_file_read(void * ctx, uint32_t addr, void * buf, size_t len){
+    FILE * f = ctx;
+    if(fseek(f, addr, SEEK_SET) != 0 || fread(buf, 1, len, f) != len)
+        return DXLR02_ERR_STORAGE;
+    return DXLR02_OK;
+}
+
+// Como en flash: lo escrito es AND con lo que ya habia
+static dxlr02_status_t dxlr02_file_write(void * ctx, uint32_t addr, const void * buf, size_t len){
+    FILE * f = ctx;
+    const uint8_t * src = buf;
+    uint8_t chunk[64];
+
+    for(size_t done = 0; done < len; done += sizeof(chunk)){
+        size_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+        if(dxlr02_file_read(ctx, addr + done, chunk, n) != DXLR02_OK)
+            return DXLR02_ERR_STORAGE;
+        for(size_t i = 0; i < n; i++)
+            chunk[i] &= src[done + i];
+        if(fseek(f, addr + done, SEEK_SET) != 0 || fwrite(chunk, 1, n, f) != n)
+            return DXLR02_ERR_STORAGE;
+    }
+    return fflush(f) == 0 ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t dxlr02_file_erase(void * ctx, uint32_t addr, size_t len){
+    FILE * f = ctx;
+    uint8_t ff[256];
+    memset(ff, 0xFF, sizeof(ff));
+
+    if(fseek(f, addr, SEEK_SET) != 0)
+        return DXLR02_ERR_STORAGE;
+    for(size_t done = 0; done < len; done += sizeof(ff)){
+        size_t n = len - done < sizeof(ff) ? len - done : sizeof(ff);
+        if(fwrite(ff, 1, n, f) != n)
+            return DXLR02_ERR_STORAGE;
+    }
+    return fflush(f) == 0 ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+dxlr02_status_t dxlr02_storage_file(dxlr02_storage_t * storage, const char * path, uint32_t size){
+    if(!storage || !path || size == 0 || size % DXLR02_FILE_SECTOR != 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    FILE * f = fopen(path, "r+b");
+    if(!f){
+        f = fopen(path, "w+b");
+        if(!f)
+            return DXLR02_ERR_STORAGE;
+        if(dxlr02_file_erase(f, 0, size) != DXLR02_OK){
+            fclose(f);
+            return DXLR02_ERR_STORAGE;
+        }
+    }
+
+    storage->read = dxlr02_file_read;
+    storage->write = dxlr02_file_write;
+    storage->erase = dxlr02_file_erase;
+    storage->size = size;
+    storage->sector_size = DXLR02_FILE_SECTOR;
+    storage->ctx = f;
+    return DXLR02_OK;
+}
+
+void dxlr02_storage_file_close(dxlr02_storage_t * storage){
+    if(storage && storage->ctx){
+        fclose((FILE *)storage->ctx);
+        storage->ctx = NULL;
+    }
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include "dxlr02_tdma.h"
+#include "dxlr02_airtime.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define DXLR02_TDMA_TICK_US     (portTICK_PERIOD_MS * 1000)
+#define DXLR02_TDMA_LATE_MAX_US 0xFFFF      // atraso del beacon que entra en su campo
+
+uint32_t dxlr02_tdma_slot_us(const dxlr02_config_t * conf, size_t max_payload, uint32_t guard_us){
+    // + '\0', + 3 bytes de direccion/canal que solo viajan por la UART
+    return dxlr02_uart_time_us(conf, max_payload + 1 + 3) + dxlr02_time_on_air_us(conf, max_payload + 1) + 2 * guard_us;
+}
+
+// Desde que el gateway escribe el beacon hasta que llega el '\0' al nodo
+static uint32_t dxlr02_tdma_beacon_latency_us(const dxlr02_config_t * conf){
+    return dxlr02_uart_time_us(conf, 1 + DXLR02_TDMA_BEACON_LEN + 1)
+         + dxlr02_time_on_air_us(conf, DXLR02_TDMA_BEACON_LEN + 1)
+         + dxlr02_uart_time_us(conf, DXLR02_TDMA_BEACON_LEN + 1);
+}
+
+// Nunca vuelve antes de target. vTaskDelay(n) despierta en el n-esimo borde de tick, que puede caer antes de
+// now + n ticks, asi que se repite hasta pasar target: el atraso queda por debajo de un tick.
+static void dxlr02_tdma_wait_until(int64_t target_us){
+    for(;;){
+        int64_t wait = target_us - esp_timer_get_time();
+        if(wait <= 0)
+            return;
+        TickType_t ticks = (TickType_t)(wait / DXLR02_TDMA_TICK_US);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+// Promedio de las primeras DXLR02_TDMA_MIN_SAMPLES muestras y despues decaimiento con ese peso
+static int32_t dxlr02_tdma_smooth(int32_t avg, int32_t sample, uint32_t samples){
+    int32_t k = samples < DXLR02_TDMA_MIN_SAMPLES ? (int32_t)samples : DXLR02_TDMA_MIN_SAMPLES;
+    return avg + (sample - avg) / k;
+}
+
+static bool dxlr02_tdma_hex(const char * src, size_t digits, unsigned long * value){
+    char field[9];
+    char * end;
+
+    memcpy(field, src, digits);
+    field[digits] = '\0';
+    *value = strtoul(field, &end, 16);
+    return *end == '\0';
+}
+
+static dxlr02_status_t dxlr02_tdma_layout(dxlr02_tdma_t * tdma, uint32_t guard_us){
+    uint32_t slot_us = dxlr02_tdma_slot_us(&tdma->module->config, tdma->max_payload, guard_us);
+    if(slot_us == 0 || slot_us > 0xFFFFFF)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    tdma->guard_us = guard_us;
+    tdma->slot_us = slot_us;
+    tdma->superframe_us = slot_us * (tdma->n_slots + 1u);
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_tdma_gateway_init(dxlr02_tdma_t * tdma, dxlr02_t * module, uint8_t n_slots, size_t max_payload){
+    if(!tdma || !module || n_slots == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(!module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(module->config.working_mode != 2)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(tdma, 0, sizeof(*tdma));
+    tdma->module = module;
+    tdma->n_slots = n_slots;
+    tdma->max_payload = max_payload;
+    return dxlr02_tdma_layout(tdma, DXLR02_TDMA_GUARD_INIT_US);
+}
+
+dxlr02_status_t dxlr02_tdma_node_init(dxlr02_tdma_t * tdma, dxlr02_t * module, uint8_t slot){
+    if(!tdma || !module || slot == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(!module->initialized)
+        return DXLR02_ERR_NOT_INITIALIZED;
+    if(module->config.working_mode != 1)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    memset(tdma, 0, sizeof(*tdma));
+    tdma->module = module;
+    tdma->slot = slot;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_tdma_beacon(dxlr02_tdma_t * tdma){
+    if(!tdma || !tdma->module || tdma->slot != 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // El proximo superframe sale del anterior, no de ahora: una vuelta que despierta antes o despues no corre
+    // el esquema ni repite un beacon
+    int64_t now = esp_timer_get_time();
+    int64_t next = now;
+    if(tdma->synced){
+        next = tdma->epoch_us + tdma->superframe_us;
+        if(now - next > DXLR02_TDMA_LATE_MAX_US)
+            next += ((now - next) / tdma->superframe_us + 1) * tdma->superframe_us;
+    }
+
+    // El guard nuevo rige desde este superframe
+    uint32_t prev_slot_us = tdma->slot_us, prev_guard_us = tdma->guard_us;
+    if(tdma->samples >= DXLR02_TDMA_MIN_SAMPLES){
+        uint32_t guard = (uint32_t)abs(tdma->late_mean_us) + 4 * tdma->late_dev_us;
+        if(guard < DXLR02_TDMA_GUARD_MIN_US)
+            guard = DXLR02_TDMA_GUARD_MIN_US;
+        if(guard > DXLR02_TDMA_GUARD_MAX_US)
+            guard = DXLR02_TDMA_GUARD_MAX_US;
+        dxlr02_status_t st = dxlr02_tdma_layout(tdma, guard);
+        if(st != DXLR02_OK)
+            return st;
+    }
+
+    dxlr02_tdma_wait_until(next);
+    int64_t late = esp_timer_get_time() - next;
+    if(late > DXLR02_TDMA_LATE_MAX_US)
+        late = DXLR02_TDMA_LATE_MAX_US;
+
+    char beacon[DXLR02_TDMA_BEACON_LEN + 1];
+    snprintf(beacon, sizeof(beacon), "@%02X%06lX%04X%04X", tdma->n_slots, (unsigned long)tdma->slot_us & 0xFFFFFF,
+             (unsigned)tdma->guard_us & 0xFFFF, (unsigned)late & 0xFFFF);
+
+    dxlr02_status_t st = dxlr02_broadcast(tdma->module, tdma->module->config.channel, beacon, sizeof(beacon));
+    if(st == DXLR02_OK){
+        tdma->prev_epoch_us = tdma->synced ? tdma->epoch_us : 0;
+        tdma->prev_slot_us = prev_slot_us;
+        tdma->prev_guard_us = prev_guard_us;
+        tdma->epoch_us = next;
+        tdma->synced = true;
+        tdma->beacons++;
+    }
+    return st;
+}
+
+// Atraso de un frame que el nodo empezo a escribir en tx_us respecto de su slot en el superframe que empieza
+// en epoch_us. false si no cae en el slot de un nodo.
+static bool dxlr02_tdma_slot_late(const dxlr02_tdma_t * tdma, int64_t tx_us, int64_t epoch_us, uint32_t slot_us,
+                                  uint32_t guard_us, int32_t * late){
+    int64_t tx = tx_us - epoch_us - guard_us;
+    if(slot_us == 0 || tx < (int64_t)slot_us / 2)
+        return false;
+
+    int64_t slot = (tx + slot_us / 2) / slot_us;
+    if(slot > tdma->n_slots)
+        return false;
+
+    *late = (int32_t)(tx - slot * slot_us);
+    return true;
+}
+
+dxlr02_status_t dxlr02_tdma_gateway_on_frame(dxlr02_tdma_t * tdma, size_t len, int64_t rx_us){
+    if(!tdma || !tdma->module || tdma->slot != 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(!tdma->synced || rx_us <= 0)
+        return DXLR02_ERR_NOT_SYNCED;
+
+    // Cuando empezo a escribirlo el nodo
+    const dxlr02_config_t * conf = &tdma->module->config;
+    int64_t tx_us = rx_us - dxlr02_uart_time_us(conf, len + 1 + 3) - dxlr02_time_on_air_us(conf, len + 1) - dxlr02_uart_time_us(conf, len + 1);
+
+    int32_t late;
+    bool ok = tx_us >= tdma->epoch_us
+            ? dxlr02_tdma_slot_late(tdma, tx_us, tdma->epoch_us, tdma->slot_us, tdma->guard_us, &late)
+            : tdma->prev_epoch_us > 0 && dxlr02_tdma_slot_late(tdma, tx_us, tdma->prev_epoch_us, tdma->prev_slot_us, tdma->prev_guard_us, &late);
+    if(!ok)
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    tdma->samples++;
+    tdma->late_mean_us = dxlr02_tdma_smooth(tdma->late_mean_us, late, tdma->samples);
+    tdma->late_dev_us = (uint32_t)dxlr02_tdma_smooth((int32_t)tdma->late_dev_us, abs(late - tdma->late_mean_us), tdma->samples);
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_tdma_on_frame(dxlr02_tdma_t * tdma, const char * frame, size_t len, int64_t rx_us){
+    if(!tdma || !tdma->module || !frame)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(len != DXLR02_TDMA_BEACON_LEN || frame[0] != '@')
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    unsigned long n_slots, slot_us, guard_us, late_us;
+    if(!dxlr02_tdma_hex(frame + 1, 2, &n_slots) || !dxlr02_tdma_hex(frame + 3, 6, &slot_us) ||
+       !dxlr02_tdma_hex(frame + 9, 4, &guard_us) || !dxlr02_tdma_hex(frame + 13, 4, &late_us))
+        return DXLR02_ERR_INVALID_RESPONSE;
+    if(slot_us == 0 || n_slots == 0 || 2 * guard_us >= slot_us)
+        return DXLR02_ERR_INVALID_RESPONSE;
+
+    if(tdma->slot > n_slots)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(rx_us <= 0)
+        return DXLR02_ERR_NOT_SYNCED;
+
+    int64_t start = rx_us - dxlr02_tdma_beacon_latency_us(&tdma->module->config) - (int64_t)late_us;
+    uint32_t superframe_us = (uint32_t)slot_us * (uint32_t)(n_slots + 1);
+
+    // Con el mismo esquema, el inicio medido deberia caer en un multiplo del superframe anterior
+    if(tdma->synced && tdma->superframe_us == superframe_us && start > tdma->epoch_us){
+        int64_t k = (start - tdma->epoch_us + superframe_us / 2) / superframe_us;
+        int64_t err = start - tdma->epoch_us - k * superframe_us;
+        if(k > 0 && llabs(err) < superframe_us / 2){
+            tdma->samples++;
+            tdma->jitter_us = (uint32_t)dxlr02_tdma_smooth((int32_t)tdma->jitter_us, (int32_t)llabs(err), tdma->samples);
+        }
+    }
+
+    tdma->n_slots = (uint8_t)n_slots;
+    tdma->slot_us = (uint32_t)slot_us;
+    tdma->guard_us = (uint32_t)guard_us;
+    tdma->superframe_us = superframe_us;
+    tdma->epoch_us = start;
+    tdma->synced = true;
+    tdma->beacons++;
+    return DXLR02_OK;
+}
+
+dxlr02_status_t dxlr02_tdma_send(dxlr02_tdma_t * tdma, uint16_t gateway, const char * data, size_t size){
+    if(!tdma || !tdma->module || tdma->slot == 0 || !data || size == 0)
+        return DXLR02_ERR_INVALID_PARAMETER;
+    if(!tdma->synced)
+        return DXLR02_ERR_NOT_SYNCED;
+
+    const dxlr02_config_t * conf = &tdma->module->config;
+    uint32_t tx_us = dxlr02_uart_time_us(conf, size + 1 + 3) + dxlr02_time_on_air_us(conf, size + 1);
+    if(tx_us + 2 * tdma->guard_us > tdma->slot_us)
+        return DXLR02_ERR_INVALID_PARAMETER;
+
+    // Solo en el superframe del ultimo beacon: el siguiente puede traer otro guard y otro largo de slot
+    int64_t tx_at = tdma->epoch_us + (int64_t)tdma->slot * tdma->slot_us + tdma->guard_us;
+    if(esp_timer_get_time() > tx_at)
+        return DXLR02_ERR_NOT_SYNCED;
+
+    uint64_t drift = (uint64_t)(tx_at - tdma->epoch_us) * DXLR02_TDMA_DRIFT_PPM / 1000000u;
+    if(drift + 4 * tdma->jitter_us > tdma->guard_us)
+        return DXLR02_ERR_NOT_SYNCED;
+
+    dxlr02_tdma_wait_until(tx_at);
+    return dxlr02_send_to(tdma->module, gateway, conf->channel, data, size);
+}
@@ -5,6 +5,12 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "esp_timer.h"
+#include "sdkconfig.h"
+#include "dxlr02_at.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 
 // --- CONFIGURACIÓN DEBUG (UART 1 REMAPEADA) ---
@@ -20,6 +26,14 @@ void debug_print(const char* str);
 #define MAX_BUFFER_LEN 50
 #define TIMEOUT_ONE_BYTE_MS 500
 #define TIMEOUT_READ_US 10000
+#ifndef CONFIG_DXLR02_POOL_BLOCK_SIZE
+#define CONFIG_DXLR02_POOL_BLOCK_SIZE 256
+#endif
+// Potencia de 2 donde entra un frame del largo de un bloque del pool: uno mas largo se descarta entero
+#define DXLR02_RX_RING_LEN (CONFIG_DXLR02_POOL_BLOCK_SIZE <= 256 ? 256 : CONFIG_DXLR02_POOL_BLOCK_SIZE <= 512 ? 512 : 1024)
+#define DXLR02_AT_TIMEOUT_MS 500
+#define DXLR02_RX_IDLE_MS 10           // silencio que separa un frame a medias de una respuesta AT vieja
+#define DXLR02_RTT_BUCKETS 12       // histograma de round trips AT: <1 ms, <2 ms, <4 ms ... >=1024 ms
 
 
 typedef enum {
@@ -32,6 +46,9 @@ typedef enum {
     DXLR02_ERR_INVALID_PARAMETER,
     DXLR02_ERR_ALREADY_INIT,
     DXLR02_ERR_OUT_OF_SPACE,
+    DXLR02_ERR_NOT_SYNCED,
+    DXLR02_ERR_STORAGE,
+    DXLR02_ERR_CHANNEL_BUSY,
     DXLR02_ERR_COUNT                        // do not use
 } dxlr02_status_t;
 
@@ -39,7 +56,7 @@ typedef struct {
     uint8_t working_mode;   // 0 (transparent), 1 (fixed-point), 2 (broadcast)
     uint8_t energy_mode;    // 0 (sleep), 1 (over-the-air wake-up), 2 (high-efficiency)
     int baudrate;       // 1 (1200), 2 (2400), 3 (4800), 4 (9600), 5 (19200), 6 (38400), 7 (57600), 8 (115200), 9 (128000)
-    uint8_t rate_level;     // 0-7
+    uint8_t rate_level;     // 0-7: fija spread_factor = 12 - rate_level y rf_coding_rate = 2 (4/6)
     uint8_t stop_bit;        // 0 (1 SB), 1 (2 SB)
     uint8_t parity;         // 0 (no validation), 1 (odd check), 2 (even check) 
     uint8_t channel;        // frequency band (0-19, 0A-1E)
@@ -51,22 +68,124 @@ typedef struct {
     bool iq_signal_flip;    // on-off
 } dxlr02_config_t;
 
+// Un frame recibido por dxlr02_receive_batch: apunta dentro del buffer del llamador (terminado en '\0')
+typedef struct {
+    const char * data;
+    size_t len;             // sin el '\0'
+} dxlr02_frame_t;
+
+// Estado del enlace UART con el modulo. "+++" es un toggle, asi que solo se manda cuando el estado es conocido;
+// desde UNKNOWN el probe es un "+++" cuya respuesta dice en que modo quedo.
+typedef enum {
+    DXLR02_STATE_UNKNOWN = 0,
+    DXLR02_STATE_DATA,
+    DXLR02_STATE_AT,
+    DXLR02_STATE_RESETTING,     // AT+RESET / AT+DEFAULT enviado, esperando "Power On"
+    DXLR02_STATE_BAUD_CHANGE,   // en AT con un AT+BAUD pendiente: al salir el modulo reinicia con el baud nuevo
+} dxlr02_link_state_t;
+
+// Frames de datos (terminados en '\0') que llegan mientras el driver habla en modo AT.
+// Se guardan aca en lugar de descartarlos y dxlr02_receive_data los entrega primero.
+typedef struct {
+    char buf[DXLR02_RX_RING_LEN];
+    uint32_t rd;            // proximo byte a entregar
+    uint32_t commit;        // fin del ultimo frame completo
+    uint32_t wr;            // fin de lo recibido (incluye un frame parcial)
+    bool dropping;          // descartando el resto de un frame que no entro
+} dxlr02_rx_ring_t;
+
+typedef struct {
+    uint32_t frames_recovered;  // frames rescatados durante sesiones AT
+    uint32_t frames_lost;       // frames descartados por falta de espacio (en el ring o en el buffer del llamador)
+    uint32_t at_toggles;        // "+++" enviados
+    uint32_t probes;            // probes de resincronizacion desde UNKNOWN
+    uint32_t at_round_trips;    // comando enviado -> primera respuesta leida (o error)
+    uint32_t at_errors;         // round trips que terminaron en timeout o respuesta invalida
+    uint64_t at_time_us;        // tiempo total esperando respuestas AT
+    uint32_t at_rtt_max_us;
+    uint32_t at_rtt_hist[DXLR02_RTT_BUCKETS];
+    uint32_t frames_tx;
+    uint32_t bytes_tx;
+    uint64_t tx_time_us;        // tiempo dentro de dxlr02_send_data
+    uint32_t frames_rx;
+    uint32_t bytes_rx;
+    uint64_t rx_time_us;        // tiempo dentro de dxlr02_receive_data (incluye la espera)
+    uint32_t uart_rx_bytes;     // bytes de datos sacados de la UART, los lea quien los lea
+} dxlr02_stats_t;
+
 typedef struct {
     uint8_t uart_port;
     bool initialized;
     dxlr02_config_t config;
-    bool mode_AT;
+    dxlr02_link_state_t state;
+    dxlr02_rx_ring_t rx;
+    dxlr02_stats_t stats;
+    int64_t at_sent_us;     // momento del ultimo comando AT sin respuesta (0: ninguno)
+    int64_t rx_last_us;     // llegada del ultimo frame de dxlr02_receive_batch (0: ya estaba en el buffer, no se sabe)
+    int64_t at_deadline_us; // ninguna espera de respuesta AT pasa de este momento (0: sin limite). dxlr02_init no lo toca.
 } dxlr02_t;
 
 
 
 dxlr02_status_t dxlr02_init(dxlr02_t * module, uint8_t port, int baudrate);
+dxlr02_status_t dxlr02_ensure_at(dxlr02_t* module);
 dxlr02_status_t dxlr02_ensure_data_mode(dxlr02_t* module);
+dxlr02_link_state_t dxlr02_get_state(const dxlr02_t * module);
+dxlr02_status_t dxlr02_resync(dxlr02_t * module);
+dxlr02_status_t dxlr02_ping(dxlr02_t * module);
 dxlr02_status_t dxlr02_set_config(dxlr02_t * module, const dxlr02_config_t * conf);
 dxlr02_status_t dxlr02_get_config(dxlr02_t * module, dxlr02_config_t * conf);
 
+// Cada setter abre y cierra su propia sesion AT (el modulo reinicia al salir y aplica el cambio)
+dxlr02_status_t dxlr02_set_baudrate(dxlr02_t * module, int baudrate);
+dxlr02_status_t dxlr02_set_mode(dxlr02_t * module, uint8_t mode);
+dxlr02_status_t dxlr02_set_energy_mode(dxlr02_t * module, uint8_t mode);
+dxlr02_status_t dxlr02_set_stop_bit(dxlr02_t * module, uint8_t stop);
+dxlr02_status_t dxlr02_set_parity(dxlr02_t * module, uint8_t parity);
+dxlr02_status_t dxlr02_set_level(dxlr02_t * module, uint8_t level);
+dxlr02_status_t dxlr02_set_channel(dxlr02_t * module, uint8_t ch);
+dxlr02_status_t dxlr02_set_mac(dxlr02_t * module, uint8_t mac);
+dxlr02_status_t dxlr02_set_transmit_power(dxlr02_t * module, uint8_t pow);
+dxlr02_status_t dxlr02_set_coding_rate(dxlr02_t * module, uint8_t four_of_x);   // 5 (4/5) .. 8 (4/8)
+dxlr02_status_t dxlr02_set_spread_factor(dxlr02_t * module, uint8_t sf);
+dxlr02_status_t dxlr02_set_crc(dxlr02_t * module, bool crc);
+dxlr02_status_t dxlr02_set_iq_flip(dxlr02_t * module, bool flip);
+dxlr02_status_t dxlr02_reset(dxlr02_t * module);
+dxlr02_status_t dxlr02_set_default(dxlr02_t * module);
+
+// Manda un comando de la tabla dentro de la sesion AT actual (entra si hace falta, no sale) y actualiza
+// module->config. Sirve para encadenar varios cambios con un solo reinicio.
+dxlr02_status_t dxlr02_at_set(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value);
+
+// Igual que dxlr02_at_set con el comando y la respuesta esperada ya armados (dxlr02.hpp los arma en
+// compilacion). No valida ni codifica: value tiene que ser el que va en cmd.
+dxlr02_status_t dxlr02_at_send_encoded(dxlr02_t * module, dxlr02_at_id_t id, uint8_t value, const char * cmd, const char * expected);
+
 dxlr02_status_t dxlr02_send_data(dxlr02_t * module, const char * data, size_t size);
+// working_mode 1 (fixed-point): el modulo recibe [direccion (2 bytes)][canal] + datos
+dxlr02_status_t dxlr02_send_to(dxlr02_t * module, uint16_t address, uint8_t channel, const char * data, size_t size);
+// working_mode 2 (broadcast): el modulo recibe [canal] + datos
+dxlr02_status_t dxlr02_broadcast(dxlr02_t * module, uint8_t channel, const char * data, size_t size);
 dxlr02_status_t dxlr02_receive_data(dxlr02_t * module, char * data, size_t max_size, size_t * eff_len);  // bytes leidos
+// Llena frames[] con todos los frames completos disponibles (hasta max_frames), copiandolos una sola vez a buf.
+// Espera hasta max_wait_ms solo mientras haya menos de min_frames; con min_frames = 0 no bloquea.
+// Lo que sobra (frame parcial o frames de mas) queda guardado para la proxima llamada.
+// Deja en module->rx_last_us la llegada del ultimo frame entregado si llego durante la espera (para TDMA).
+dxlr02_status_t dxlr02_receive_batch(dxlr02_t * module, char * buf, size_t buf_len, dxlr02_frame_t * frames, size_t max_frames,
+                                     size_t min_frames, uint32_t max_wait_ms, size_t * n_frames);
+// Devuelve un frame ya entregado al frente de lo guardado: la proxima lectura lo entrega primero. Para
+// devolver varios, del ultimo al primero. DXLR02_ERR_OUT_OF_SPACE si no entra (se cuenta en frames_lost).
+dxlr02_status_t dxlr02_requeue_frame(dxlr02_t * module, const char * data, size_t len);
+// Contador de bytes que llegaron del modulo, esten todavia en la UART o ya los haya leido otra tarea. Solo
+// sirve para comparar dos lecturas: si cambio, llego algo.
+uint32_t dxlr02_rx_activity(dxlr02_t * module);
+dxlr02_status_t dxlr02_get_stats(const dxlr02_t * module, dxlr02_stats_t * stats);
+dxlr02_status_t dxlr02_reset_stats(dxlr02_t * module);
+dxlr02_status_t dxlr02_stats_to_json(const dxlr02_stats_t * stats, char * buf, size_t len);  // una linea JSON
+
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,327 @@
+#ifndef DXLR02_HPP
+#define DXLR02_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+#include "dxlr02.h"
+
+// Capa C++17 sobre el driver C, solo header. No agrega estado ni copias: todo termina en las mismas
+// llamadas de dxlr02.h. Sin excepciones (el proyecto compila con -fno-exceptions): se devuelve dxlr02_status_t.
+//
+//  - dxlr02::profile<...>: configuracion completa validada con static_assert contra la misma tabla AT del
+//    driver, con los 13 comandos y sus respuestas ya armados en compilacion.
+//  - dxlr02::at_session: sesion AT con RAII; al destruirse sale de AT (el modulo reinicia y aplica).
+//  - dxlr02::span: I/O sin copia sobre buffers del llamador.
+
+namespace dxlr02 {
+
+using status = dxlr02_status_t;
+
+/****************************************** SPAN ******************************************/
+
+// std::span recien esta en C++20: vista minima puntero + largo, que acepta arrays, std::array y std::span
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T * data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    constexpr span(T (&arr)[N]) noexcept : data_(arr), size_(N) {}
+
+    template <typename U, std::size_t N, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(std::array<U, N> & arr) noexcept : data_(arr.data()), size_(N) {}
+
+    template <typename U, std::size_t N, typename = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    constexpr span(const std::array<U, N> & arr) noexcept : data_(arr.data()), size_(N) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U> & other) noexcept : data_(other.data()), size_(other.size()) {}
+
+#ifdef __cpp_lib_span
+    template <typename U, std::size_t E, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(std::span<U, E> other) noexcept : data_(other.data()), size_(other.size()) {}
+#endif
+
+    constexpr T * data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T * begin() const noexcept { return data_; }
+    constexpr T * end() const noexcept { return data_ + size_; }
+    constexpr T & operator[](std::size_t i) const noexcept { return data_[i]; }
+
+    constexpr span first(std::size_t n) const noexcept { return span(data_, n < size_ ? n : size_); }
+    constexpr span subspan(std::size_t offset) const noexcept {
+        return offset < size_ ? span(data_ + offset, size_ - offset) : span();
+    }
+
+private:
+    T * data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/****************************************** AT TABLE ******************************************/
+
+enum class mode : std::uint8_t { transparent = 0, fixed_point = 1, broadcast = 2 };
+
+struct at_spec {
+    const char * key;
+    std::uint8_t min;
+    std::uint8_t max;
+    dxlr02_at_enc_t enc;
+    dxlr02_at_reply_t reply;
+};
+
+// La misma tabla que usa dxlr02.c, en el orden de dxlr02_at_id_t
+inline constexpr at_spec at_specs[DXLR02_AT_COUNT] = {
+#define DXLR02_AT_X_SPEC(id, key, lo, hi, e, r) { key, lo, hi, e, r },
+    DXLR02_AT_TABLE(DXLR02_AT_X_SPEC)
+#undef DXLR02_AT_X_SPEC
+};
+
+// Indice = valor de AT+BAUD; 0 si el baud no existe
+constexpr std::uint8_t baud_code(int baudrate) {
+    constexpr int rates[] = { 0, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 128000 };
+    for(std::uint8_t i = 1; i < sizeof(rates) / sizeof(rates[0]); i++){
+        if(rates[i] == baudrate)
+            return i;
+    }
+    return 0;
+}
+
+constexpr bool at_valid(dxlr02_at_id_t id, unsigned value) {
+    return id < DXLR02_AT_COUNT && value >= at_specs[id].min && value <= at_specs[id].max;
+}
+
+// Comando listo para dxlr02_at_send_encoded
+struct at_command {
+    dxlr02_at_id_t id;
+    std::uint8_t value;
+    char cmd[DXLR02_AT_CMD_MAX];
+    char expected[DXLR02_AT_REPLY_MAX];
+};
+
+namespace detail {
+
+constexpr std::size_t append(char * out, std::size_t n, const char * s) {
+    while(*s)
+        out[n++] = *s++;
+    out[n] = '\0';
+    return n;
+}
+
+// dxlr02_at_encode de dxlr02_at.h (el mismo que usa dxlr02.c) mas el terminador
+constexpr std::size_t encode(dxlr02_at_enc_t enc, std::uint8_t value, bool echo, char * out, std::size_t n) {
+    n += dxlr02_at_encode(enc, value, echo, out + n);
+    out[n] = '\0';
+    return n;
+}
+
+constexpr bool equal(const char * a, const char * b) {
+    while(*a && *a == *b){
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+} // namespace detail
+
+constexpr at_command make_command(dxlr02_at_id_t id, std::uint8_t value) {
+    at_command c{ id, value, {}, {} };
+    const at_spec & spec = at_specs[id];
+
+    std::size_t n = detail::append(c.cmd, 0, "AT+");
+    n = detail::append(c.cmd, n, spec.key);
+    n = detail::encode(spec.enc, value, false, c.cmd, n);
+    detail::append(c.cmd, n, "\r\n");
+
+    if(spec.reply == DXLR02_AT_REPLY_ECHO){
+        n = detail::append(c.expected, 0, "+");
+        n = detail::append(c.expected, n, spec.key);
+        n = detail::append(c.expected, n, "=");
+        n = detail::encode(spec.enc, value, true, c.expected, n);
+        detail::append(c.expected, n, "\r\nOK\r\n");
+    } else {
+        detail::append(c.expected, 0, "OK\r\n");
+    }
+    return c;
+}
+
+static_assert(detail::equal(make_command(DXLR02_AT_CHANNEL, 0x0A).cmd, "AT+CHANNEL0A\r\n"), "encoder HEX2");
+static_assert(detail::equal(make_command(DXLR02_AT_MAC, 0xAB).expected, "+MAC=0AAB\r\nOK\r\n"), "encoder MAC");
+static_assert(detail::equal(make_command(DXLR02_AT_MAC, 0xAB).cmd, "AT+MAC0A,AB\r\n"), "encoder MAC");
+static_assert(detail::equal(make_command(DXLR02_AT_POWE, 22).expected, "+POWE=22\r\nOK\r\n"), "encoder DEC");
+
+// Un solo parametro fijo: se valida y se arma en compilacion
+template <dxlr02_at_id_t Id, std::uint8_t Value>
+struct command {
+    static_assert(at_valid(Id, Value), "dxlr02::command: valor fuera del rango de la tabla AT");
+    static constexpr at_command value = make_command(Id, Value);
+};
+
+/****************************************** PROFILE ******************************************/
+
+// Configuracion completa. Un valor invalido no compila; config y commands son constantes en flash.
+template <mode Mode, int Baudrate, std::uint8_t Level, std::uint8_t Channel,
+          std::uint8_t Address = 0xFF, std::uint8_t Power = 22, std::uint8_t SpreadFactor = 12,
+          std::uint8_t CodingRate = 2, bool Crc = false, bool IqFlip = false,
+          std::uint8_t Energy = 2, std::uint8_t StopBit = 0, std::uint8_t Parity = 0>
+struct profile {
+    static_assert(baud_code(Baudrate) != 0, "dxlr02::profile: baudrate no soportado por AT+BAUD");
+    static_assert(at_valid(DXLR02_AT_LEVEL, Level), "dxlr02::profile: LEVEL fuera de 0-7");
+    static_assert(at_valid(DXLR02_AT_CHANNEL, Channel), "dxlr02::profile: canal fuera de 0x00-0x1E");
+    static_assert(at_valid(DXLR02_AT_POWE, Power), "dxlr02::profile: potencia fuera de 0-22 dBm");
+    static_assert(at_valid(DXLR02_AT_SF, SpreadFactor), "dxlr02::profile: SF fuera de 5-12");
+    static_assert(at_valid(DXLR02_AT_CR, CodingRate), "dxlr02::profile: CR fuera de 1 (4/5) - 4 (4/8)");
+    static_assert(at_valid(DXLR02_AT_SLEEP, Energy), "dxlr02::profile: modo de energia fuera de 0-2");
+    static_assert(at_valid(DXLR02_AT_STOP, StopBit), "dxlr02::profile: stop bit fuera de 0-1");
+    static_assert(at_valid(DXLR02_AT_PARI, Parity), "dxlr02::profile: paridad fuera de 0-2");
+
+    static constexpr dxlr02_config_t config = {
+        static_cast<std::uint8_t>(Mode), Energy, Baudrate, Level, StopBit, Parity, Channel,
+        Address, Power, CodingRate, SpreadFactor, Crc, IqFlip,
+    };
+
+    // Mismo orden que dxlr02_set_config
+    static constexpr std::array<at_command, DXLR02_AT_COUNT> commands = {{
+        make_command(DXLR02_AT_BAUD, baud_code(Baudrate)),
+        make_command(DXLR02_AT_MODE, static_cast<std::uint8_t>(Mode)),
+        make_command(DXLR02_AT_SLEEP, Energy),
+        make_command(DXLR02_AT_STOP, StopBit),
+        make_command(DXLR02_AT_PARI, Parity),
+        make_command(DXLR02_AT_LEVEL, Level),
+        make_command(DXLR02_AT_CHANNEL, Channel),
+        make_command(DXLR02_AT_MAC, Address),
+        make_command(DXLR02_AT_POWE, Power),
+        make_command(DXLR02_AT_CR, CodingRate),
+        make_command(DXLR02_AT_SF, SpreadFactor),
+        make_command(DXLR02_AT_CRC, Crc),
+        make_command(DXLR02_AT_IQ, IqFlip),
+    }};
+};
+
+/****************************************** AT SESSION ******************************************/
+
+// Entra a AT al construirse y sale al destruirse. Despues del primer error no se manda nada mas y el
+// error queda en get_status(); close() sale y devuelve el resultado, cosa que el destructor no puede.
+class at_session {
+public:
+    explicit at_session(dxlr02_t & module) noexcept : module_(&module), status_(dxlr02_ensure_at(&module)) {}
+    ~at_session() { close(); }
+
+    at_session(const at_session &) = delete;
+    at_session & operator=(const at_session &) = delete;
+
+    status get_status() const noexcept { return status_; }
+    explicit operator bool() const noexcept { return status_ == DXLR02_OK; }
+
+    status set(dxlr02_at_id_t id, std::uint8_t value) noexcept {
+        if(module_ && status_ == DXLR02_OK)
+            status_ = dxlr02_at_set(module_, id, value);
+        return status_;
+    }
+
+    status run(const at_command & c) noexcept {
+        if(module_ && status_ == DXLR02_OK)
+            status_ = dxlr02_at_send_encoded(module_, c.id, c.value, c.cmd, c.expected);
+        return status_;
+    }
+
+    template <std::size_t N>
+    status run(const std::array<at_command, N> & sequence) noexcept {
+        for(const at_command & c : sequence)
+            run(c);
+        return status_;
+    }
+
+    template <dxlr02_at_id_t Id, std::uint8_t Value>
+    status set() noexcept { return run(command<Id, Value>::value); }
+
+    status close() noexcept {
+        if(!module_)
+            return status_;
+        status st = dxlr02_ensure_data_mode(module_);
+        module_ = nullptr;
+        return status_ != DXLR02_OK ? status_ : st;
+    }
+
+private:
+    dxlr02_t * module_;
+    status status_;
+};
+
+/****************************************** RADIO ******************************************/
+
+class radio {
+public:
+    status init(std::uint8_t port, int baudrate) noexcept { return dxlr02_init(&module_, port, baudrate); }
+
+    // Toda la configuracion en una sola sesion AT (un reinicio), con los comandos ya armados
+    template <typename Profile>
+    status configure() noexcept {
+        at_session session(module_);
+        session.run(Profile::commands);
+        return session.close();
+    }
+
+    status send(span<const char> data) noexcept {
+        return dxlr02_send_data(&module_, data.data(), data.size());
+    }
+
+    status send_to(std::uint16_t address, std::uint8_t channel, span<const char> data) noexcept {
+        return dxlr02_send_to(&module_, address, channel, data.data(), data.size());
+    }
+
+    template <std::uint8_t Channel>
+    status send_to(std::uint16_t address, span<const char> data) noexcept {
+        static_assert(at_valid(DXLR02_AT_CHANNEL, Channel), "dxlr02::radio: canal fuera de 0x00-0x1E");
+        return dxlr02_send_to(&module_, address, Channel, data.data(), data.size());
+    }
+
+    status broadcast(std::uint8_t channel, span<const char> data) noexcept {
+        return dxlr02_broadcast(&module_, channel, data.data(), data.size());
+    }
+
+    template <std::uint8_t Channel>
+    status broadcast(span<const char> data) noexcept {
+        static_assert(at_valid(DXLR02_AT_CHANNEL, Channel), "dxlr02::radio: canal fuera de 0x00-0x1E");
+        return dxlr02_broadcast(&module_, Channel, data.data(), data.size());
+    }
+
+    // frame queda apuntando dentro de buf (sin el '\0')
+    status receive(span<char> buf, span<const char> & frame) noexcept {
+        std::size_t len = 0;
+        status st = dxlr02_receive_data(&module_, buf.data(), buf.size(), &len);
+        frame = st == DXLR02_OK ? span<const char>(buf.data(), len) : span<const char>();
+        return st;
+    }
+
+    // got queda con los frames recibidos (prefijo de frames), que apuntan dentro de buf
+    status receive_batch(span<char> buf, span<dxlr02_frame_t> frames, std::size_t min_frames,
+                         std::uint32_t max_wait_ms, span<dxlr02_frame_t> & got) noexcept {
+        std::size_t n = 0;
+        status st = dxlr02_receive_batch(&module_, buf.data(), buf.size(), frames.data(), frames.size(),
+                                         min_frames, max_wait_ms, &n);
+        got = frames.first(n);
+        return st;
+    }
+
+    dxlr02_link_state_t state() const noexcept { return dxlr02_get_state(&module_); }
+    const dxlr02_config_t & config() const noexcept { return module_.config; }
+
+    // Para usar el resto de la API C (pool, FEC, TDMA, ...) sobre el mismo modulo
+    dxlr02_t & handle() noexcept { return module_; }
+
+private:
+    dxlr02_t module_{};
+};
+
+} // namespace dxlr02
+
+#endif
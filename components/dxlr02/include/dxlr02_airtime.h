@@ -0,0 +1,30 @@
+#ifndef DXLR02_AIRTIME_H
+#define DXLR02_AIRTIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dxlr02.h"
+
+// Modelo del enlace para planificar capacidad. El modulo usa siempre BW 125 kHz (AT+BW), preambulo de
+// 8 simbolos y header explicito; SF y CR salen de config. AT+LEVEL los fija (SF = 12 - nivel, CR 4/6) y
+// AT+SF / AT+CR mandados despues los pisan; el driver refleja las dos cosas en config.
+
+#define DXLR02_BW_HZ            125000
+#define DXLR02_PREAMBLE_SYMBOLS 8
+#define DXLR02_CH0_FREQ_KHZ     433000
+#define DXLR02_CH_STEP_KHZ      1400
+
+// Tiempo en el aire de un paquete de payload_len bytes (contando el '\0' que agrega dxlr02_send_data)
+uint32_t dxlr02_time_on_air_us(const dxlr02_config_t * conf, size_t payload_len);
+
+// Tiempo que tardan len bytes en pasar por la UART con el formato de config (start + 8 + paridad + stop)
+uint32_t dxlr02_uart_time_us(const dxlr02_config_t * conf, size_t len);
+
+// Frecuencia central del canal (AT+CHANNEL): 433 MHz + 1.4 MHz por canal
+uint32_t dxlr02_channel_freq_khz(uint8_t channel);
+
+// Entrega esperada con ALOHA puro: nodes nodos en el mismo canal, cada uno mandando un paquete de
+// toa_us cada period_ms. Es e^(-2G) con G = carga ofrecida por los otros nodes - 1.
+float dxlr02_aloha_delivery_ratio(uint32_t nodes, uint32_t toa_us, uint32_t period_ms);
+
+#endif
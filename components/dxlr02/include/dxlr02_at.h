@@ -0,0 +1,102 @@
+#ifndef DXLR02_AT_H
+#define DXLR02_AT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Como se escribe el valor en el comando
+typedef enum {
+    DXLR02_AT_ENC_DEC = 0,  // decimal sin ceros: "AT+POWE10"
+    DXLR02_AT_ENC_HEX2,     // dos digitos hex: "AT+CHANNEL0A"
+    DXLR02_AT_ENC_MAC,      // "AT+MAC0A,AB" -> "+MAC=0AAB"
+} dxlr02_at_enc_t;
+
+// Que contesta el modulo cuando acepta el valor
+typedef enum {
+    DXLR02_AT_REPLY_OK = 0,     // "OK\r\n"
+    DXLR02_AT_REPLY_ECHO,       // "+KEY=<valor>\r\nOK\r\n"
+} dxlr02_at_reply_t;
+
+// Tabla de comandos de configuracion. Todo lo demas (enum, plantillas, largos de buffer, validacion)
+// se genera a partir de aca; un comando nuevo es una linea.
+//  X(id,      key,       min,  max,  encoding,           reply)
+#define DXLR02_AT_TABLE(X) \
+    X(BAUD,    "BAUD",    1,    9,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(MODE,    "MODE",    0,    2,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_ECHO) \
+    X(SLEEP,   "SLEEP",   0,    2,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(STOP,    "STOP",    0,    1,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(PARI,    "PARI",    0,    2,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(LEVEL,   "LEVEL",   0,    7,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(CHANNEL, "CHANNEL", 0,    0x1E, DXLR02_AT_ENC_HEX2, DXLR02_AT_REPLY_ECHO) \
+    X(MAC,     "MAC",     0,    0xFF, DXLR02_AT_ENC_MAC,  DXLR02_AT_REPLY_ECHO) \
+    X(POWE,    "POWE",    0,    22,   DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_ECHO) \
+    X(CR,      "CR",      1,    4,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_ECHO) \
+    X(SF,      "SF",      5,    12,   DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_ECHO) \
+    X(CRC,     "CRC",     0,    1,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)   \
+    X(IQ,      "IQ",      0,    1,    DXLR02_AT_ENC_DEC,  DXLR02_AT_REPLY_OK)
+
+typedef enum {
+#define DXLR02_AT_X_ID(id, key, min, max, enc, reply) DXLR02_AT_##id,
+    DXLR02_AT_TABLE(DXLR02_AT_X_ID)
+#undef DXLR02_AT_X_ID
+    DXLR02_AT_COUNT                         // do not use
+} dxlr02_at_id_t;
+
+// Largo maximo de un comando y de su respuesta, calculado sobre la tabla. El valor ocupa a lo sumo
+// 5 caracteres ("0A,AB") y el eco 4.
+typedef union {
+#define DXLR02_AT_X_CMD(id, key, min, max, enc, reply) char id[sizeof("AT+" key) + 5 + 2];
+    DXLR02_AT_TABLE(DXLR02_AT_X_CMD)
+#undef DXLR02_AT_X_CMD
+} dxlr02_at_cmd_buf_t;
+
+typedef union {
+#define DXLR02_AT_X_REPLY(id, key, min, max, enc, reply) char id[sizeof("+" key "=") + 4 + sizeof("\r\nOK\r\n") - 1];
+    DXLR02_AT_TABLE(DXLR02_AT_X_REPLY)
+#undef DXLR02_AT_X_REPLY
+} dxlr02_at_reply_buf_t;
+
+#define DXLR02_AT_CMD_MAX   sizeof(dxlr02_at_cmd_buf_t)
+#define DXLR02_AT_REPLY_MAX sizeof(dxlr02_at_reply_buf_t)
+
+#ifdef __cplusplus
+#define DXLR02_AT_CONSTEXPR constexpr
+#else
+#define DXLR02_AT_CONSTEXPR
+#endif
+
+// Escribe value como lo pide enc (echo: como aparece en "+KEY=") y devuelve cuantos caracteres puso, sin
+// terminar la cadena. Es el unico lugar con el formato: lo usan dxlr02.c y, en compilacion, dxlr02.hpp.
+static inline DXLR02_AT_CONSTEXPR size_t dxlr02_at_encode(dxlr02_at_enc_t enc, uint8_t value, bool echo, char * out){
+    size_t n = 0;
+
+    switch(enc){
+        case DXLR02_AT_ENC_DEC:
+            if(value >= 100)
+                out[n++] = (char)('0' + value / 100);
+            if(value >= 10)
+                out[n++] = (char)('0' + (value / 10) % 10);
+            out[n++] = (char)('0' + value % 10);
+            break;
+
+        case DXLR02_AT_ENC_HEX2:
+            out[n++] = "0123456789ABCDEF"[value >> 4];
+            out[n++] = "0123456789ABCDEF"[value & 0x0F];
+            break;
+
+        case DXLR02_AT_ENC_MAC:
+            // Mismo formato que usaba dxlr02_set_mac: "%02X,%02X" con (mac >> 4) y mac
+            out[n++] = '0';
+            out[n++] = "0123456789ABCDEF"[value >> 4];
+            if(!echo)
+                out[n++] = ',';
+            out[n++] = "0123456789ABCDEF"[value >> 4];
+            out[n++] = "0123456789ABCDEF"[value & 0x0F];
+            break;
+    }
+
+    return n;
+}
+
+#endif
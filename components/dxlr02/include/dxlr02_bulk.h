@@ -0,0 +1,158 @@
+#ifndef DXLR02_BULK_H
+#define DXLR02_BULK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dxlr02.h"
+
+// Transferencia de imagenes grandes (firmware) por diferencia de bloques. La imagen nueva se parte en
+// bloques de block_size bytes; el emisor busca cada bloque dentro de la imagen vieja que ya tiene el
+// receptor (hash rodante tipo rsync sobre todos los offsets, confirmado byte a byte) y solo manda por
+// aire los que no encuentra. Los encontrados viajan como COPY: indice + offset en la imagen vieja, 6 bytes.
+//
+// Los bloques se mandan en ventanas; al final de cada ventana el emisor pide un ACK y el receptor
+// contesta con un bitmap de 64 bloques a partir del primero que le falta. Solo se reenvia lo que
+// el bitmap marca como faltante. El receptor guarda su bitmap mientras dure la sesion: si el emisor
+// se reinicia y repite el START con la misma sesion, la transferencia sigue donde quedo. El bitmap esta
+// solo en RAM: si el que se reinicia es el receptor, la sesion vuelve a empezar desde el bloque 0.
+//
+// En el aire: COBS( magic | tipo | sesion (2) | cuerpo | crc16 (2) )
+//   START  tamanio (4) | block_size (2) | crc32 (4) | tamanio viejo (4) | crc32 viejo (4)
+//   DATA   bloque (2) | bytes
+//   COPY   n (1) | n x ( bloque (2) | offset viejo (4) )
+//   POLL   -
+//   ACK    base (2) | flags (1) | bitmap (8)
+
+#define DXLR02_BULK_MAGIC           0xB7
+#define DXLR02_BULK_HEADER_LEN      4
+#define DXLR02_BULK_MAX_BLOCKS      16384       // con bloques de 128 bytes alcanza para 2 MB
+#define DXLR02_BULK_WINDOW          32          // bloques por ventana, <= 64 (lo que cubre un ACK)
+#define DXLR02_BULK_ACK_SPAN        64
+#define DXLR02_BULK_RETRIES         8           // ACKs perdidos seguidos antes de abandonar
+#define DXLR02_BULK_SEND            0xFFFFFFFFu // entrada del plan: el bloque va completo
+
+// Palabras de trabajo que necesita dxlr02_bulk_diff para n_blocks bloques
+#define DXLR02_BULK_DIFF_WORDS(n_blocks) (4 * (size_t)(n_blocks) + 1)
+
+typedef enum {
+    DXLR02_BULK_START = 1,
+    DXLR02_BULK_DATA,
+    DXLR02_BULK_COPY,
+    DXLR02_BULK_POLL,
+    DXLR02_BULK_ACK,
+} dxlr02_bulk_type_t;
+
+// Flags del ACK
+#define DXLR02_BULK_ACK_DONE        0x01        // imagen completa y verificada
+#define DXLR02_BULK_ACK_FAILED      0x02        // completa pero el crc32 no coincide
+#define DXLR02_BULK_ACK_NO_BASE     0x04        // la imagen vieja no es la esperada: no acepta COPY
+
+// Imagen de solo lectura (la vieja o la nueva)
+typedef struct {
+    dxlr02_status_t (*read)(void * ctx, uint32_t off, void * buf, size_t len);
+    uint32_t size;
+    void * ctx;
+} dxlr02_bulk_image_t;
+
+// Destino de la imagen nueva. write llega en cualquier orden; read se usa para verificar al final.
+typedef struct {
+    dxlr02_status_t (*begin)(void * ctx, uint32_t size);
+    dxlr02_status_t (*write)(void * ctx, uint32_t off, const void * buf, size_t len);
+    dxlr02_status_t (*read)(void * ctx, uint32_t off, void * buf, size_t len);
+    dxlr02_status_t (*finish)(void * ctx, bool ok);
+    void * ctx;
+} dxlr02_bulk_sink_t;
+
+typedef enum {
+    DXLR02_BULK_IDLE = 0,
+    DXLR02_BULK_STARTING,       // START mandado, esperando el primer ACK
+    DXLR02_BULK_SENDING,
+    DXLR02_BULK_WAITING,        // POLL mandado, esperando ACK
+    DXLR02_BULK_DONE,
+    DXLR02_BULK_FAILED,
+} dxlr02_bulk_state_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;             // bytes por la UART, con COBS y terminador
+    uint64_t airtime_us;
+    uint32_t data_blocks;       // DATA mandados, contando reenvios
+    uint32_t copy_blocks;       // entradas COPY mandadas, contando reenvios
+    uint32_t acks;
+    uint32_t timeouts;
+} dxlr02_bulk_stats_t;
+
+typedef struct {
+    dxlr02_t * module;
+    const dxlr02_bulk_image_t * image;
+    uint32_t * plan;
+    uint32_t image_crc;
+    uint32_t base_size;
+    uint32_t base_crc;
+    uint16_t session;
+    uint16_t block_size;
+    uint16_t n_blocks;
+    uint16_t base;              // primer bloque sin confirmar
+    uint16_t next;              // proximo bloque a mirar dentro de la ventana
+    uint8_t retries;
+    dxlr02_bulk_state_t state;
+    int64_t next_tx_us;
+    int64_t deadline_us;
+    uint8_t acked[DXLR02_BULK_MAX_BLOCKS / 8];
+    dxlr02_bulk_stats_t stats;
+} dxlr02_bulk_sender_t;
+
+typedef struct {
+    dxlr02_t * module;
+    const dxlr02_bulk_image_t * base_image;
+    const dxlr02_bulk_sink_t * sink;
+    bool active;
+    bool has_base;
+    uint8_t flags;
+    uint16_t session;
+    uint32_t size;
+    uint32_t crc;
+    uint16_t block_size;
+    uint16_t n_blocks;
+    uint16_t received;
+    uint16_t first_missing;
+    uint8_t have[DXLR02_BULK_MAX_BLOCKS / 8];
+} dxlr02_bulk_receiver_t;
+
+// Mayor block_size cuyo DATA, codificado y con su '\0', entra en un bloque del pool y en el ring de RX
+size_t dxlr02_bulk_max_block(void);
+
+// Arma el plan: plan[i] = offset en old del bloque i de new, o DXLR02_BULK_SEND. work debe tener
+// DXLR02_BULK_DIFF_WORDS(n_blocks) palabras. copies (opcional) = bloques que no viajan completos.
+dxlr02_status_t dxlr02_bulk_diff(const dxlr02_bulk_image_t * old, const dxlr02_bulk_image_t * img, uint16_t block_size,
+                                 uint32_t * plan, uint32_t * work, size_t work_words, uint32_t * copies);
+
+// old puede ser NULL (no hay base: todo va como DATA). plan tiene que seguir vivo hasta el final.
+dxlr02_status_t dxlr02_bulk_sender_init(dxlr02_bulk_sender_t * s, dxlr02_t * module, const dxlr02_bulk_image_t * old,
+                                        const dxlr02_bulk_image_t * img, uint32_t * plan, uint16_t block_size, uint16_t session);
+// Manda lo que toque sin bloquear (respeta el tiempo en aire de lo anterior) y maneja los timeouts
+dxlr02_status_t dxlr02_bulk_sender_poll(dxlr02_bulk_sender_t * s);
+// frame: tal cual lo entrega dxlr02_receive_data / dxlr02_receive_batch. DXLR02_ERR_INVALID_RESPONSE si no es bulk.
+dxlr02_status_t dxlr02_bulk_sender_on_frame(dxlr02_bulk_sender_t * s, const char * frame, size_t len);
+
+// base_image: la imagen que esta corriendo (origen de los COPY)
+void dxlr02_bulk_receiver_init(dxlr02_bulk_receiver_t * r, dxlr02_t * module, const dxlr02_bulk_image_t * base_image,
+                               const dxlr02_bulk_sink_t * sink);
+dxlr02_status_t dxlr02_bulk_receiver_on_frame(dxlr02_bulk_receiver_t * r, const char * frame, size_t len);
+
+#ifdef ESP_PLATFORM
+// Imagen de la app que esta corriendo, con el largo de su cabecera: son los mismos bytes que el .bin que
+// se grabo, que es lo que el emisor tiene que usar como old. Destino en la proxima particion OTA (necesita
+// una tabla con ota_0/ota_1, como partitions.csv del proyecto). finish(ok) la marca para el proximo
+// arranque; el reinicio queda a cargo de la app.
+dxlr02_status_t dxlr02_bulk_running_image(dxlr02_bulk_image_t * img);
+dxlr02_status_t dxlr02_bulk_ota_sink(dxlr02_bulk_sink_t * sink);
+#else
+dxlr02_status_t dxlr02_bulk_file_image(dxlr02_bulk_image_t * img, const char * path);
+void dxlr02_bulk_file_image_close(dxlr02_bulk_image_t * img);
+dxlr02_status_t dxlr02_bulk_file_sink(dxlr02_bulk_sink_t * sink, const char * path);
+void dxlr02_bulk_file_sink_close(dxlr02_bulk_sink_t * sink);
+#endif
+
+#endif
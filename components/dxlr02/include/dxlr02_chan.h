@@ -0,0 +1,81 @@
+#ifndef DXLR02_CHAN_H
+#define DXLR02_CHAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dxlr02.h"
+#include "dxlr02_health.h"
+
+// Agilidad de canal. El modulo solo resintoniza la radio al salir de AT (reinicia), asi que:
+//  - En fixed-point (modo 1) y broadcast (modo 2) el canal de TX va en el prefijo de cada paquete:
+//    cambiar de canal para transmitir no cuesta ningun comando.
+//  - El canal de RX (config.channel) se cambia con un solo AT+CHANNEL; si ya hay una sesion AT abierta
+//    se aprovecha y el cambio se aplica al cerrarla. En modo 0 tambien es el canal de TX.
+//  - Se transmite en el canal donde escucha el par (peer). Saltar de canal por paquete solo sirve si los
+//    dos lados siguen la misma secuencia: quien la tenga acordada llama a dxlr02_chan_set_peer antes de
+//    cada envio. En modo 0 cambiar de peer cuesta una resintonia (dos toggles y un reinicio).
+//  - No hay RSSI ni CAD por AT: la ocupacion se mide escuchando cada canal dwell_ms y sumando el
+//    time-on-air de lo que llega, y el LBT mira si llegan bytes del modulo (solo vale para el canal de RX).
+//  - Con el supervisor de dxlr02_health corriendo, su tarea de RX lee la UART: switch, scan y el cambio de
+//    canal de send toman su lock (dxlr02_chan_attach) como sus propias sesiones AT. Sin attach nadie mas
+//    puede estar leyendo el modulo.
+
+#define DXLR02_CHAN_COUNT           31      // 0x00 - 0x1E
+#define DXLR02_CHAN_LBT_FRAME_LEN   16      // la ventana de escucha es el time-on-air de un frame de este largo
+#define DXLR02_CHAN_MAX_BACKOFF_EXP 5
+#define DXLR02_CHAN_OCC_SLACK       50      // por mil: el canal de RX actual se queda si no esta peor que min + esto
+
+typedef struct {
+    uint32_t switches;              // resintonias de RX
+    uint32_t switch_us_total;
+    uint32_t switch_us_max;
+    uint32_t scans;
+    uint32_t lbt_busy;              // ventanas con actividad
+    uint32_t lbt_gave_up;
+    uint32_t scan_frames;           // frames recibidos durante los scans, devueltos a la lectura
+    uint32_t scan_dropped;          // los que no entraron para devolver
+    uint32_t sent[DXLR02_CHAN_COUNT];
+} dxlr02_chan_stats_t;
+
+typedef struct {
+    dxlr02_t * module;
+    uint32_t mask;                          // bit n: canal n habilitado
+    uint16_t occupancy[DXLR02_CHAN_COUNT];  // por mil, del ultimo scan
+    uint8_t peer;                           // canal de TX: donde escucha el otro lado
+    uint8_t max_backoffs;                   // 0: sin LBT
+    dxlr02_health_t * health;               // NULL: nadie mas lee el modulo
+    dxlr02_chan_stats_t stats;
+} dxlr02_chan_t;
+
+// El peer arranca en el canal de RX propio
+dxlr02_status_t dxlr02_chan_init(dxlr02_chan_t * ag, dxlr02_t * module, uint32_t mask, uint8_t max_backoffs);
+
+// Comparte el modulo con el supervisor: las sesiones AT y las lecturas de switch / scan / send van con su lock.
+// El scan lo tiene todo el recorrido (la RX del supervisor espera y despues lee los frames devueltos); el LBT
+// no, para que la tarea de RX siga leyendo y se vea la actividad.
+void dxlr02_chan_attach(dxlr02_chan_t * ag, dxlr02_health_t * health);
+
+// Canal de TX de los proximos envios
+dxlr02_status_t dxlr02_chan_set_peer(dxlr02_chan_t * ag, uint8_t ch);
+
+// Canal de RX. No hace nada si ya esta ahi.
+dxlr02_status_t dxlr02_chan_switch(dxlr02_chan_t * ag, uint8_t ch);
+
+// Escucha dwell_ms cada canal habilitado y vuelve al canal de RX original. Los frames que llegan durante
+// el scan se cuentan y vuelven a la lectura (hasta un bloque del pool; el resto va a scan_dropped).
+dxlr02_status_t dxlr02_chan_scan(dxlr02_chan_t * ag, uint32_t dwell_ms);
+
+// Canal de RX recomendado despues de un scan: el menos ocupado, o el actual si esta cerca del minimo.
+// Cambiarlo es cosa del que lo llama (y de avisarle a los pares).
+uint8_t dxlr02_chan_pick(dxlr02_chan_t * ag);
+
+// Espera a que no llegue nada durante una ventana, con backoff exponencial aleatorio entre intentos. Mira
+// dxlr02_rx_activity, asi que ve tambien lo que consume una tarea de RX. DXLR02_ERR_CHANNEL_BUSY si sigue
+// ocupado despues de max_backoffs.
+dxlr02_status_t dxlr02_chan_lbt(dxlr02_chan_t * ag);
+
+// LBT (si el peer escucha en el canal de RX propio) + envio en el canal del peer. address se usa solo en modo 1.
+dxlr02_status_t dxlr02_chan_send(dxlr02_chan_t * ag, uint16_t address, const char * data, size_t size);
+
+#endif
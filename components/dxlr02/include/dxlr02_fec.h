@@ -0,0 +1,85 @@
+#ifndef DXLR02_FEC_H
+#define DXLR02_FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dxlr02.h"
+#include "dxlr02_pool.h"
+
+// FEC a nivel aplicacion. Cada k paquetes de datos se mandan m paquetes de paridad Reed-Solomon (matriz
+// de Cauchy sobre GF(256)); el receptor reconstruye hasta m paquetes perdidos o corruptos del bloque sin
+// retransmitir. El codigo va por columnas: el byte b de cada paquete forma una palabra de codigo, asi que
+// perder un paquete es una sola borradura por palabra (interleaving sobre la rafaga).
+//
+// Los paquetes son binarios: en la UART viajan codificados con COBS, que no deja ningun '\0' adentro.
+//
+// En el aire: COBS( magic | bloque | indice | k << 4 | m | crc16 (2) | shard )
+// Shard de datos: largo (2, big endian) + payload. Los de datos se mandan sin el relleno final, los de paridad
+// completos.
+
+#define DXLR02_FEC_MAX_SHARDS   16          // k + m
+#define DXLR02_FEC_MAX_K        12
+#define DXLR02_FEC_HEADER_LEN   6
+#define DXLR02_FEC_MAGIC        0xFC
+#define DXLR02_FEC_LEN_BYTES    2           // largo del payload al principio de cada shard de datos
+
+// COBS: out necesita len + len / 254 + 1 bytes
+size_t dxlr02_cobs_encode(const uint8_t * in, size_t len, uint8_t * out);
+dxlr02_status_t dxlr02_cobs_decode(const uint8_t * in, size_t len, uint8_t * out, size_t out_len, size_t * out_n);
+// Mayor trama cruda que, codificada y con el '\0' que la cierra, entra en un bloque del pool y en el ring de RX
+size_t dxlr02_cobs_max_raw(void);
+// CRC-16/CCITT-FALSE encadenable: crc = 0xFFFF para empezar
+uint16_t dxlr02_crc16(const uint8_t * data, size_t len, uint16_t crc);
+
+typedef struct {
+    dxlr02_t * module;
+    uint8_t k;
+    uint8_t m;
+    uint8_t block;
+    uint8_t count;                      // paquetes de datos ya mandados en el bloque actual
+    uint16_t shard_len;                 // DXLR02_FEC_LEN_BYTES + payload maximo
+    dxlr02_buf_t * shards[DXLR02_FEC_MAX_K];
+} dxlr02_fec_encoder_t;
+
+typedef void (*dxlr02_fec_deliver_t)(void * ctx, const char * data, size_t len);
+
+typedef struct {
+    uint32_t shards_rx;
+    uint32_t crc_errors;
+    uint32_t recovered;                 // paquetes de datos reconstruidos con paridad
+    uint32_t lost;                      // paquetes de datos irrecuperables
+} dxlr02_fec_stats_t;
+
+typedef struct {
+    bool active;
+    uint8_t block;
+    uint8_t k;
+    uint8_t m;
+    uint16_t shard_len;
+    uint8_t have;                       // shards guardados
+    uint8_t sent;                       // datos que se sabe que salieron: el k de una paridad o el mayor indice visto + 1
+    uint32_t delivered;                 // bitmap de datos ya entregados
+    dxlr02_buf_t * shards[DXLR02_FEC_MAX_SHARDS];
+    dxlr02_fec_deliver_t deliver;
+    void * ctx;
+    dxlr02_fec_stats_t stats;
+} dxlr02_fec_decoder_t;
+
+// Largo maximo de payload por paquete que entra en un bloque del pool ya codificado
+size_t dxlr02_fec_max_payload(void);
+
+dxlr02_status_t dxlr02_fec_encoder_init(dxlr02_fec_encoder_t * enc, dxlr02_t * module, uint8_t k, uint8_t m, size_t max_payload);
+// Manda el paquete enseguida; cuando se completan k manda tambien las m paridades
+dxlr02_status_t dxlr02_fec_send(dxlr02_fec_encoder_t * enc, const char * data, size_t len);
+// Cierra un bloque incompleto (rellena con paquetes vacios virtuales) y manda su paridad
+dxlr02_status_t dxlr02_fec_flush(dxlr02_fec_encoder_t * enc);
+
+void dxlr02_fec_decoder_init(dxlr02_fec_decoder_t * dec, dxlr02_fec_deliver_t deliver, void * ctx);
+// frame: tal cual lo entrega dxlr02_receive_data / dxlr02_receive_batch. DXLR02_ERR_INVALID_RESPONSE si no es FEC.
+dxlr02_status_t dxlr02_fec_on_frame(dxlr02_fec_decoder_t * dec, const char * frame, size_t len);
+// Da por terminado el bloque actual (por ejemplo tras un timeout) y cuenta lo que no se pudo recuperar. Solo
+// cuenta lo que se sabe que salio: sin ninguna paridad, los datos del final de un bloque corto no se ven.
+void dxlr02_fec_decoder_flush(dxlr02_fec_decoder_t * dec);
+
+#endif
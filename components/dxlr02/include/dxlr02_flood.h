@@ -0,0 +1,102 @@
+#ifndef DXLR02_FLOOD_H
+#define DXLR02_FLOOD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "dxlr02.h"
+#include "dxlr02_pool.h"
+
+// Flooding administrado sobre el modo broadcast (2) para que los nodos se repitan los paquetes entre si.
+// Cada paquete lleva origen + secuencia; los nodos recuerdan los ultimos vistos en un cache fijo (hash con
+// desalojo LRU) y solo repiten la primera copia. La repeticion espera un numero aleatorio de slots de
+// time-on-air; si mientras tanto se escuchan suppress copias del mismo paquete que vienen de mas saltos
+// que la nuestra (vecinos a la misma distancia del origen ya lo llevaron hacia afuera), se cancela. Las
+// copias que vienen de atras no cuentan: no dicen nada de los vecinos que estan mas lejos. El TTL limita
+// cuantos saltos puede dar.
+//
+// En el aire: COBS( magic | origen (2) | secuencia (2) | ttl (1) | saltos (1) | crc16 (2) | payload )
+// En modo 2 se transmite en config.channel; en modo 0 va tal cual.
+
+#ifndef CONFIG_DXLR02_FLOOD_CACHE_SIZE
+#define CONFIG_DXLR02_FLOOD_CACHE_SIZE 64
+#endif
+
+#define DXLR02_FLOOD_CACHE_SIZE     CONFIG_DXLR02_FLOOD_CACHE_SIZE     // < 255: los indices son de 8 bits
+#define DXLR02_FLOOD_MAGIC          0xF1
+#define DXLR02_FLOOD_HEADER_LEN     9
+#define DXLR02_FLOOD_PENDING        4       // repeticiones esperando su turno
+#define DXLR02_FLOOD_TTL            7       // tiene que ser al menos el diametro de la malla en saltos
+#define DXLR02_FLOOD_SLOTS          16      // la espera es de 1 a slots slots
+#define DXLR02_FLOOD_SUPPRESS       3       // copias escuchadas (contando la primera) que cancelan; 2 ahorra mas en mallas densas
+#define DXLR02_FLOOD_NONE           0xFF
+
+typedef void (*dxlr02_flood_deliver_t)(void * ctx, uint16_t origin, uint8_t hops, const char * data, size_t len);
+
+typedef struct {
+    uint32_t originated;
+    uint32_t received;          // primeras copias, entregadas
+    uint32_t duplicates;
+    uint32_t relayed;
+    uint32_t suppressed;        // repeticiones canceladas por copias escuchadas
+    uint32_t expired;           // no se repiten por TTL
+    uint32_t dropped;           // sin lugar para la repeticion
+    uint32_t evictions;
+    uint32_t crc_errors;
+} dxlr02_flood_stats_t;
+
+typedef struct {
+    uint32_t key;               // origen << 16 | secuencia
+    uint8_t chain;              // siguiente en el mismo bucket
+    uint8_t older;              // lista LRU
+    uint8_t newer;
+    uint8_t heard;              // copias que vienen de mas lejos que la primera
+    uint8_t hops;               // saltos de la primera copia
+} dxlr02_flood_entry_t;
+
+typedef struct {
+    dxlr02_buf_t * frame;       // ya codificado, con el TTL descontado
+    uint32_t key;
+    int64_t due_us;
+    bool origin;                // originado aca: sale aunque se escuchen copias
+} dxlr02_flood_pending_t;
+
+typedef struct {
+    dxlr02_t * module;
+    uint16_t node_id;
+    uint16_t seq;
+    uint8_t ttl;                        // de los paquetes que origina este nodo
+    uint8_t suppress;                   // 0: repetir siempre
+    uint8_t slots;
+    uint8_t count;
+    uint8_t newest;
+    uint8_t oldest;
+    uint8_t buckets[DXLR02_FLOOD_CACHE_SIZE];
+    dxlr02_flood_entry_t cache[DXLR02_FLOOD_CACHE_SIZE];
+    dxlr02_flood_pending_t pending[DXLR02_FLOOD_PENDING];
+    int64_t next_tx_us;
+    dxlr02_flood_deliver_t deliver;
+    void * ctx;
+    dxlr02_flood_stats_t stats;
+} dxlr02_flood_t;
+
+// Mayor payload cuya trama, codificada y con su '\0', entra en un bloque del pool y en el ring de RX
+size_t dxlr02_flood_max_payload(void);
+
+dxlr02_status_t dxlr02_flood_init(dxlr02_flood_t * fl, dxlr02_t * module, uint16_t node_id, dxlr02_flood_deliver_t deliver, void * ctx);
+
+// Origina un paquete. Sale enseguida si el aire esta libre de la trama anterior; si no, queda pendiente y
+// lo manda dxlr02_flood_poll. DXLR02_ERR_OUT_OF_SPACE si no hay lugar para dejarlo pendiente.
+dxlr02_status_t dxlr02_flood_send(dxlr02_flood_t * fl, const char * data, size_t len);
+
+// frame: tal cual lo entrega dxlr02_receive_data / dxlr02_receive_batch. DXLR02_ERR_INVALID_RESPONSE si no es flood.
+dxlr02_status_t dxlr02_flood_on_frame(dxlr02_flood_t * fl, const char * frame, size_t len);
+
+// Transmite la repeticion que ya cumplio su espera, si hay, sin pisar el time-on-air de la anterior
+dxlr02_status_t dxlr02_flood_poll(dxlr02_flood_t * fl);
+
+// Libera las repeticiones pendientes
+void dxlr02_flood_deinit(dxlr02_flood_t * fl);
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef DXLR02_HEALTH_H
+#define DXLR02_HEALTH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "dxlr02.h"
+#include "dxlr02_pool.h"
+
+// Supervisor del modulo. Una vez arrancado es el unico que toca el dxlr02_t: los productores encolan con
+// dxlr02_health_send (nunca bloquea) y los frames recibidos llegan por callback desde su tarea.
+//
+// Cuenta fallas consecutivas; al llegar a max_failures escala:
+//   1. resync: probe + entrar/salir de AT
+//   2. AT+RESET
+//   3. AT+DEFAULT (probando tambien 9600, el baud de fabrica) y se restaura la configuracion
+// Un escalon solo se intenta si su peor caso entra en lo que queda de budget_ms, y durante el episodio ninguna
+// espera AT pasa del final del budget (dxlr02_t.at_deadline_us), asi que nunca dura mas que eso. Si no
+// alcanza, el estado queda en FAILED y se reintenta cada retry_ms.
+//
+// Sin trafico RX durante check_ms el chequeo de vida es dxlr02_ping: entra a AT y ahi se queda (sigue recibiendo)
+// hasta el proximo envio, asi que un nodo callado no reinicia el modulo. Uno que solo transmite paga un reinicio
+// por chequeo, al salir de AT para mandar.
+//
+// Con dxlr02_health_start_layout la RX va en una tarea aparte, fija a un core y con prioridad alta, para que la
+// aplicacion no la deje sin CPU; el supervisor (TX, chequeos, recuperacion) queda en el otro core. Un mutex
+// evita que la tarea de RX se coma las respuestas AT del supervisor.
+
+#ifndef CONFIG_DXLR02_RX_TASK_CORE
+#define CONFIG_DXLR02_RX_TASK_CORE 1
+#endif
+#ifndef CONFIG_DXLR02_RX_TASK_PRIORITY
+#define CONFIG_DXLR02_RX_TASK_PRIORITY 20
+#endif
+#ifndef CONFIG_DXLR02_TX_TASK_CORE
+#define CONFIG_DXLR02_TX_TASK_CORE 0
+#endif
+#ifndef CONFIG_DXLR02_TX_TASK_PRIORITY
+#define CONFIG_DXLR02_TX_TASK_PRIORITY 5
+#endif
+
+#define DXLR02_HEALTH_TX_DEPTH  8
+#define DXLR02_HEALTH_POLL_MS   20
+#define DXLR02_HEALTH_RX_FRAMES 4
+
+typedef enum {
+    DXLR02_HEALTH_OK = 0,
+    DXLR02_HEALTH_SUSPECT,          // hubo fallas, todavia bajo el umbral
+    DXLR02_HEALTH_RECOVERING,
+    DXLR02_HEALTH_FAILED,
+} dxlr02_health_state_t;
+
+typedef enum {
+    DXLR02_RECOVER_RESYNC = 0,
+    DXLR02_RECOVER_RESET,
+    DXLR02_RECOVER_FACTORY,
+    DXLR02_RECOVER_LEVELS,
+} dxlr02_recover_level_t;
+
+typedef struct {
+    uint8_t max_failures;           // fallas consecutivas antes de recuperar
+    uint32_t check_ms;              // chequeo de vida si no llego nada por RX en este tiempo
+    uint32_t budget_ms;             // duracion maxima de un episodio de recuperacion
+    uint32_t retry_ms;              // espera despues de un episodio fallido
+} dxlr02_health_config_t;
+
+#define DXLR02_HEALTH_CONFIG_DEFAULT() { .max_failures = 3, .check_ms = 60000, .budget_ms = 20000, .retry_ms = 30000 }
+
+typedef struct {
+    uint32_t failures;
+    uint32_t checks;
+    uint32_t recoveries;
+    uint32_t recoveries_failed;
+    uint32_t level_ok[DXLR02_RECOVER_LEVELS];   // en que escalon termino cada recuperacion
+    uint32_t last_recovery_ms;
+    uint32_t max_recovery_ms;
+    uint32_t tx_dropped;            // dxlr02_health_send con la cola llena
+    uint32_t rx_buffered_max;       // bytes esperando en el driver de la UART; cerca de su buffer hay perdidas
+} dxlr02_health_stats_t;
+
+typedef struct {
+    BaseType_t rx_core;
+    UBaseType_t rx_priority;
+    uint32_t rx_stack;
+    BaseType_t tx_core;             // supervisor: TX, chequeos y recuperacion
+    UBaseType_t tx_priority;
+    uint32_t tx_stack;
+} dxlr02_health_layout_t;
+
+#define DXLR02_HEALTH_LAYOUT_DEFAULT() { \
+    .rx_core = CONFIG_DXLR02_RX_TASK_CORE, .rx_priority = CONFIG_DXLR02_RX_TASK_PRIORITY, .rx_stack = 3072, \
+    .tx_core = CONFIG_DXLR02_TX_TASK_CORE, .tx_priority = CONFIG_DXLR02_TX_TASK_PRIORITY, .tx_stack = 4096 }
+
+typedef struct {
+    uint32_t loops;
+    uint32_t late_max_us;           // atraso maximo de una vuelta respecto de su plazo: hambre de CPU
+    uint32_t cpu_permille;          // del core, desde la lectura anterior (0 sin FREERTOS_GENERATE_RUN_TIME_STATS)
+    uint32_t stack_free;            // minimo historico, en bytes
+} dxlr02_task_stats_t;
+
+typedef void (*dxlr02_health_rx_cb_t)(void * ctx, const char * data, size_t len);
+
+typedef struct {
+    dxlr02_t * module;
+    uint8_t port;
+    int baudrate;                   // baud de trabajo
+    dxlr02_config_t desired;        // se restaura despues de AT+DEFAULT
+    bool has_desired;
+    dxlr02_health_config_t conf;
+    volatile dxlr02_health_state_t state;
+    uint8_t consecutive;
+    int64_t next_check_us;
+    volatile uint32_t last_rx_ms;   // lo escribe solo quien hace la RX
+    int64_t retry_at_us;
+    dxlr02_health_rx_cb_t on_rx;
+    void * rx_ctx;
+    QueueHandle_t tx;
+    StaticQueue_t tx_queue;
+    dxlr02_buf_t * tx_items[DXLR02_HEALTH_TX_DEPTH];
+    SemaphoreHandle_t lock;         // sesiones AT vs lecturas de RX
+    StaticSemaphore_t lock_buf;
+    TaskHandle_t task;
+    TaskHandle_t rx_task;           // NULL: la RX la hace el supervisor
+    dxlr02_task_stats_t task_stats[2];      // 0: supervisor, 1: RX
+    uint64_t runtime_prev[2];
+    int64_t runtime_at_us;
+    dxlr02_health_stats_t stats;
+} dxlr02_health_t;
+
+// module puede no estar inicializado (dxlr02_init fallo): el supervisor lo inicializa en la primera recuperacion.
+// desired es la configuracion que se restaura despues de AT+DEFAULT; con NULL el modulo queda de fabrica salvo
+// el baud. conf NULL usa DXLR02_HEALTH_CONFIG_DEFAULT.
+dxlr02_status_t dxlr02_health_init(dxlr02_health_t * h, dxlr02_t * module, uint8_t port, int baudrate,
+                                   const dxlr02_config_t * desired, const dxlr02_health_config_t * conf);
+void dxlr02_health_set_rx(dxlr02_health_t * h, dxlr02_health_rx_cb_t cb, void * ctx);
+
+// Copia a un bloque del pool y encola sin esperar. DXLR02_ERR_OUT_OF_SPACE si la cola o el pool estan llenos.
+dxlr02_status_t dxlr02_health_send(dxlr02_health_t * h, const char * data, size_t len);
+
+// Una vuelta del supervisor: recuperacion si hace falta, TX pendiente (espera hasta wait_ms), RX y chequeo de vida.
+// dxlr02_health_start la llama en loop desde su propia tarea.
+void dxlr02_health_poll(dxlr02_health_t * h, uint32_t wait_ms);
+dxlr02_status_t dxlr02_health_start(dxlr02_health_t * h, UBaseType_t priority, uint32_t stack);
+dxlr02_status_t dxlr02_health_start_layout(dxlr02_health_t * h, const dxlr02_health_layout_t * layout);
+
+// supervisor y rx pueden ser NULL; rx queda en cero si no hay tarea de RX aparte
+void dxlr02_health_task_stats(dxlr02_health_t * h, dxlr02_task_stats_t * supervisor, dxlr02_task_stats_t * rx);
+
+dxlr02_health_state_t dxlr02_health_get_state(const dxlr02_health_t * h);
+
+#endif
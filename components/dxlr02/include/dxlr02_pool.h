@@ -0,0 +1,43 @@
+#ifndef DXLR02_POOL_H
+#define DXLR02_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "dxlr02.h"
+
+#ifndef CONFIG_DXLR02_POOL_BLOCK_SIZE
+#define CONFIG_DXLR02_POOL_BLOCK_SIZE 256
+#endif
+#ifndef CONFIG_DXLR02_POOL_BLOCK_COUNT
+#define CONFIG_DXLR02_POOL_BLOCK_COUNT 16
+#endif
+
+#define DXLR02_POOL_BLOCK_SIZE  CONFIG_DXLR02_POOL_BLOCK_SIZE
+#define DXLR02_POOL_BLOCK_COUNT CONFIG_DXLR02_POOL_BLOCK_COUNT
+
+// Bloque del pool. Se comparte por referencia: quien lo guarda hace retain, quien termina hace release;
+// vuelve al pool cuando refs llega a 0.
+typedef struct {
+    uint16_t len;           // bytes validos en data
+    uint8_t refs;
+    uint8_t index;          // posicion en el pool, uso interno
+    char data[DXLR02_POOL_BLOCK_SIZE];
+} dxlr02_buf_t;
+
+typedef struct {
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t in_use;
+    uint16_t high_water;        // maximo de bloques tomados a la vez
+    uint32_t acquires;
+    uint32_t failures;          // acquire sin bloques libres
+} dxlr02_pool_stats_t;
+
+// O(1), sin heap, se puede llamar desde cualquier tarea o core
+dxlr02_status_t dxlr02_pool_acquire(dxlr02_buf_t ** buf);      // refs = 1, len = 0
+dxlr02_status_t dxlr02_pool_retain(dxlr02_buf_t * buf);         // ERR_OUT_OF_SPACE con refs = 255; sin retain no hay release
+void dxlr02_pool_release(dxlr02_buf_t * buf);
+dxlr02_status_t dxlr02_pool_get_stats(dxlr02_pool_stats_t * stats);
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef DXLR02_QUEUE_H
+#define DXLR02_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dxlr02.h"
+#include "dxlr02_pool.h"
+#include "dxlr02_storage.h"
+
+// Cola de salida persistente (store-and-forward). Log de solo-agregar sobre dxlr02_storage:
+//
+//  - Cada sector es un segmento con header { magic, seq, erase_count, crc }. Los segmentos se usan en
+//    ronda, asi que todos se borran la misma cantidad de veces.
+//  - Registro: { estado, 0xFF, largo, crc32(largo + datos) } + datos, alineado a 4. Al abrir, un registro
+//    con CRC invalido es una escritura cortada por un corte de energia y marca el fin del log.
+//  - Los appends se juntan en un bloque del pool y van a flash en una sola escritura (commit).
+//  - En el aire cada registro va como [tipo][nodo][sesion][seq] (4 hex cada uno) + datos, en ventanas de
+//    hasta DXLR02_QUEUE_WINDOW. La sesion es aleatoria en cada dxlr02_queue_open. El ultimo de la ventana
+//    pide ACK (como en dxlr02_bulk: el modulo es half-duplex, un ACK por frame chocaria con el frame
+//    siguiente) y el gateway contesta [ACK][nodo][sesion][seq] con el ultimo que recibio en orden. El nodo
+//    ignora los ACKs de otro nodo o de otra sesion. Un registro se da por entregado solo con ese ACK; lo que
+//    no cubre se vuelve a mandar desde el primero sin confirmar (go-back-N), igual que si el ACK no llega a
+//    tiempo. El primero de cada ventana va como SYNC.
+//  - El gateway lleva el estado de cada nodo por separado (hasta DXLR02_QUEUE_SOURCES, desalojando el que
+//    hace mas que no manda). Una sesion nueva (el nodo se reinicio) se sincroniza con su primer SYNC. En la
+//    misma sesion, un SYNC repite una ventana que ya se entrego (se perdio el ACK) y se descarta como
+//    cualquier frame viejo.
+//  - Lo confirmado no se reescribe: cada DXLR02_QUEUE_MARK_EVERY registros confirmados (y al final de cada
+//    drain) se baja un bit del estado del ultimo; todo lo anterior a esa marca esta entregado. Entrega "al
+//    menos una vez": tras un corte se repiten hasta DXLR02_QUEUE_MARK_EVERY registros ya confirmados.
+
+#define DXLR02_QUEUE_SEG_HDR_LEN    16
+#define DXLR02_QUEUE_REC_HDR_LEN    8
+#define DXLR02_QUEUE_MARK_EVERY     16
+#define DXLR02_QUEUE_WINDOW         8           // registros mandados sin confirmar
+#define DXLR02_QUEUE_ACK_MARGIN_MS  500         // procesamiento del gateway + cambio TX/RX
+#define DXLR02_QUEUE_FRAME_HDR_LEN  13          // tipo + nodo + sesion + seq
+
+#ifndef CONFIG_DXLR02_QUEUE_SOURCES
+#define CONFIG_DXLR02_QUEUE_SOURCES 8
+#endif
+#define DXLR02_QUEUE_SOURCES        CONFIG_DXLR02_QUEUE_SOURCES     // nodos que sigue un gateway
+
+// Primer byte de cada frame: caracteres de control, no chocan con datos de texto
+#define DXLR02_QUEUE_TAG_SYNC       0x01
+#define DXLR02_QUEUE_TAG_DATA       0x02
+#define DXLR02_QUEUE_TAG_ACK        0x06
+#define DXLR02_QUEUE_TAG_POLL       0x10        // en SYNC / DATA: el ultimo de la ventana, pide ACK
+
+typedef struct {
+    uint32_t appended;
+    uint32_t commits;           // escrituras a flash de lotes de appends
+    uint32_t drained;           // frames mandados, contando reenvios
+    uint32_t acked;
+    uint32_t timeouts;          // ventanas sin ACK a tiempo
+    uint32_t rewinds;           // ventanas que se repiten desde el primero sin confirmar (ACK parcial o timeout)
+    uint32_t marks;
+    uint32_t erases;
+    uint32_t torn;              // registros descartados al abrir
+    uint32_t recovered;         // registros pendientes encontrados al abrir
+    uint32_t recovery_us;       // lo que tardo dxlr02_queue_open
+    uint32_t max_erase_count;
+} dxlr02_queue_stats_t;
+
+typedef struct {
+    dxlr02_storage_t storage;
+    uint16_t n_segments;
+    uint16_t head_seg;          // donde se escribe
+    uint32_t head_off;
+    uint16_t tail_seg;          // primer registro sin confirmar
+    uint32_t tail_off;
+    uint16_t send_seg;          // proximo registro a mandar
+    uint32_t send_off;
+    uint32_t next_seq;
+    uint16_t node_id;
+    uint16_t session;           // aleatoria en cada open: el gateway distingue un reinicio
+    uint32_t pending;           // registros sin confirmar (incluye el lote sin commit y los en vuelo)
+    uint16_t tail_tx_seq;       // seq en el aire del registro de tail
+    uint16_t in_flight;         // mandados en la ventana actual; mientras haya, no se manda mas
+    uint32_t in_flight_addr[DXLR02_QUEUE_WINDOW];
+    int64_t ack_deadline_us;
+    uint32_t last_acked;        // direccion del ultimo registro confirmado sin marcar
+    uint16_t unmarked;
+    dxlr02_buf_t * batch;
+    uint16_t batch_len;
+    int64_t next_tx_us;         // para no escribirle al modulo mas rapido de lo que transmite
+    dxlr02_queue_stats_t stats;
+} dxlr02_queue_t;
+
+// Recupera el estado del log (o lo formatea si esta vacio). node_id identifica al nodo ante el gateway.
+dxlr02_status_t dxlr02_queue_open(dxlr02_queue_t * q, const dxlr02_storage_t * storage, uint16_t node_id);
+dxlr02_status_t dxlr02_queue_close(dxlr02_queue_t * q);
+
+// Encola; queda en RAM hasta el proximo commit (automatico cuando se llena el lote)
+dxlr02_status_t dxlr02_queue_append(dxlr02_queue_t * q, const char * data, size_t len);
+dxlr02_status_t dxlr02_queue_commit(dxlr02_queue_t * q);
+
+// Manda una ventana de hasta max_records (y DXLR02_QUEUE_WINDOW) registros con dxlr02_send_data, a la
+// velocidad del enlace (time-on-air). No espera el ACK: mientras la ventana no se confirme (o venza el plazo
+// y se repita) no manda nada. Se detiene en el primer error de envio.
+dxlr02_status_t dxlr02_queue_drain(dxlr02_queue_t * q, dxlr02_t * module, uint32_t max_records, uint32_t * sent);
+
+// Frame recibido del gateway. DXLR02_ERR_INVALID_RESPONSE si no es un ACK de la cola; el ACK de otro nodo o
+// de otra sesion devuelve DXLR02_OK sin tocar nada.
+dxlr02_status_t dxlr02_queue_on_frame(dxlr02_queue_t * q, const char * frame, size_t len);
+
+uint32_t dxlr02_queue_pending(const dxlr02_queue_t * q);
+
+// Lado del gateway
+
+typedef struct {
+    bool used;
+    bool synced;
+    uint16_t node;
+    uint16_t session;
+    uint16_t expected;          // proximo seq en orden
+    uint32_t last_rx;           // reloj del receptor en el ultimo frame, para desalojar
+} dxlr02_queue_source_t;
+
+typedef struct {
+    dxlr02_queue_source_t sources[DXLR02_QUEUE_SOURCES];
+    uint32_t clock;
+    uint32_t delivered;
+    uint32_t dropped;           // fuera de orden o antes del primer SYNC de la sesion
+    uint32_t acks;
+    uint32_t sessions;          // sesiones nuevas (primer frame de un nodo o reinicio)
+    uint32_t evictions;
+} dxlr02_queue_receiver_t;
+
+void dxlr02_queue_receiver_init(dxlr02_queue_receiver_t * r);
+
+// Frame recibido de un nodo: contesta el ACK por module si lo pide y, si el registro va en orden, deja en *data /
+// *data_len lo que hay que entregar (*data_len = 0: nada) y en *node quien lo mando (puede ser NULL).
+// DXLR02_ERR_INVALID_RESPONSE si no es de la cola.
+dxlr02_status_t dxlr02_queue_receive(dxlr02_queue_receiver_t * r, dxlr02_t * module, const char * frame, size_t len,
+                                     const char ** data, size_t * data_len, uint16_t * node);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef DXLR02_STORAGE_H
+#define DXLR02_STORAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dxlr02.h"
+
+// Memoria no volatil con semantica de flash NOR: erase pone sectores enteros en 0xFF y write solo
+// puede bajar bits. En el ESP32 es una particion de datos; en Linux un archivo que emula lo mismo.
+typedef struct {
+    dxlr02_status_t (*read)(void * ctx, uint32_t addr, void * buf, size_t len);
+    dxlr02_status_t (*write)(void * ctx, uint32_t addr, const void * buf, size_t len);
+    dxlr02_status_t (*erase)(void * ctx, uint32_t addr, size_t len);   // alineado a sector_size
+    uint32_t size;
+    uint32_t sector_size;
+    void * ctx;
+} dxlr02_storage_t;
+
+// CRC-32 (IEEE) encadenable: crc = 0 para empezar
+uint32_t dxlr02_crc32(const void * data, size_t len, uint32_t crc);
+
+#ifdef ESP_PLATFORM
+// Particion de datos por label (por ejemplo una entrada "lora_q, data, 0x40, , 64K" en partitions.csv)
+dxlr02_status_t dxlr02_storage_partition(dxlr02_storage_t * storage, const char * label);
+#else
+// Archivo de size bytes (multiplo de 4096); se crea borrado si no existe
+dxlr02_status_t dxlr02_storage_file(dxlr02_storage_t * storage, const char * path, uint32_t size);
+void dxlr02_storage_file_close(dxlr02_storage_t * storage);
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef DXLR02_TDMA_H
+#define DXLR02_TDMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dxlr02.h"
+
+// TDMA sobre el canal de config. El gateway (working_mode 2) manda un beacon al principio de cada
+// superframe; los nodos (working_mode 1) se sincronizan con el y transmiten solo en su slot.
+//
+//   | slot 0: beacon | slot 1 | slot 2 | ... | slot n_slots |
+//
+// El beacon marca el inicio del superframe y trae n_slots, el largo de slot, el guard y cuanto tarde lo
+// escribio el gateway. El nodo descuenta ese atraso y la latencia UART + aire calculada con dxlr02_airtime.
+// Un nodo solo transmite en el superframe del ultimo beacon que recibio: si se perdio uno, espera al siguiente.
+//
+// El guard sale de lo medido: el gateway compara cuando llega cada frame de un nodo con cuando deberia haber
+// llegado y usa atraso medio + 4 desvios medios (los dos con decaimiento). Hasta juntar
+// DXLR02_TDMA_MIN_SAMPLES usa DXLR02_TDMA_GUARD_INIT_US.
+
+#define DXLR02_TDMA_GUARD_INIT_US   50000   // hasta medir: un tick de cada lado + latencias del modulo
+#define DXLR02_TDMA_GUARD_MIN_US    2000
+#define DXLR02_TDMA_GUARD_MAX_US    0xFFFF  // entra en 4 hex
+#define DXLR02_TDMA_MIN_SAMPLES     8
+#define DXLR02_TDMA_DRIFT_PPM       50      // deriva de reloj asumida dentro de un superframe
+#define DXLR02_TDMA_BEACON_LEN      17      // "@" + 2 hex n_slots + 6 hex slot_us + 4 hex guard_us + 4 hex atraso_us
+
+typedef struct {
+    dxlr02_t * module;
+    uint8_t n_slots;            // slots para nodos, sin contar el del beacon
+    uint8_t slot;               // slot propio (1..n_slots); 0 en el gateway
+    uint32_t slot_us;
+    uint32_t guard_us;
+    uint32_t superframe_us;
+    int64_t epoch_us;           // inicio del superframe del ultimo beacon, en el reloj local
+    bool synced;
+    uint32_t beacons;
+    uint32_t jitter_us;         // nodo: desvio medio (con decaimiento) del inicio medido respecto del esperado
+    size_t max_payload;         // gateway
+    int64_t prev_epoch_us;      // gateway: superframe anterior, para los frames del ultimo slot que llegan
+    uint32_t prev_slot_us;      // despues del beacon siguiente
+    uint32_t prev_guard_us;
+    int32_t late_mean_us;       // gateway: atraso medio de los frames de los nodos respecto de su slot
+    uint32_t late_dev_us;       // gateway: desvio medio de ese atraso
+    uint32_t samples;           // muestras de late_* en el gateway, de jitter_us en el nodo
+} dxlr02_tdma_t;
+
+// Largo de slot para payloads de hasta max_payload bytes con la configuracion actual y guard_us por lado
+uint32_t dxlr02_tdma_slot_us(const dxlr02_config_t * conf, size_t max_payload, uint32_t guard_us);
+
+dxlr02_status_t dxlr02_tdma_gateway_init(dxlr02_tdma_t * tdma, dxlr02_t * module, uint8_t n_slots, size_t max_payload);
+dxlr02_status_t dxlr02_tdma_node_init(dxlr02_tdma_t * tdma, dxlr02_t * module, uint8_t slot);
+
+// Gateway: espera el inicio del proximo superframe (nunca antes) y manda el beacon con el guard actualizado
+dxlr02_status_t dxlr02_tdma_beacon(dxlr02_tdma_t * tdma);
+
+// Gateway: pasarle cada frame de un nodo con su llegada (dxlr02_t.rx_last_us) para medir el guard. Un frame
+// del ultimo slot puede leerse despues del beacon siguiente: se mide contra el superframe anterior.
+// DXLR02_ERR_NOT_SYNCED sin beacon previo o sin llegada conocida, DXLR02_ERR_INVALID_RESPONSE si no cae en
+// el slot de un nodo.
+dxlr02_status_t dxlr02_tdma_gateway_on_frame(dxlr02_tdma_t * tdma, size_t len, int64_t rx_us);
+
+// Nodo: pasarle cada frame recibido con su llegada (dxlr02_t.rx_last_us, no el momento en que se leyo).
+// DXLR02_OK si era un beacon, DXLR02_ERR_INVALID_RESPONSE si no, DXLR02_ERR_NOT_SYNCED si era un beacon
+// pero la llegada no se conoce (ya estaba en el buffer): no sirve para sincronizar.
+dxlr02_status_t dxlr02_tdma_on_frame(dxlr02_tdma_t * tdma, const char * frame, size_t len, int64_t rx_us);
+
+// Nodo: bloquea hasta el slot propio del superframe actual y manda al gateway. DXLR02_ERR_NOT_SYNCED si el
+// slot ya paso (hay que esperar el proximo beacon) o si el jitter medido no entra en el guard.
+dxlr02_status_t dxlr02_tdma_send(dxlr02_tdma_t * tdma, uint16_t gateway, const char * data, size_t size);
+
+#endif
@@ -4,6 +4,7 @@
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "dxlr02.h"
+#include "dxlr02_health.h"
 
 
 // --- CONFIGURACIÓN LO-RA (UART 2) ---
@@ -12,6 +13,24 @@
 #define LORA_RX_PIN     16
 #define LORA_BAUD       9600
 
+// Configuracion de trabajo del modulo: se aplica al arrancar y el supervisor la restaura despues de un
+// AT+DEFAULT (sin ella solo volveria el baud)
+static const dxlr02_config_t lora_config = {
+    .working_mode = 0,
+    .energy_mode = 2,
+    .baudrate = LORA_BAUD,
+    .rate_level = 0,
+    .stop_bit = 0,
+    .parity = 0,
+    .channel = 0,
+    .address = 0xff,
+    .transmit_power = 22,
+    .rf_coding_rate = 2,
+    .spread_factor = 12,
+    .crc = false,
+    .iq_signal_flip = false,
+};
+
 static void uart_init_lora(void)
 {
     uart_config_t cfg = {
@@ -67,26 +86,26 @@ void app_main(void)
     // 2. Iniciamos LoRa en UART2
     uart_init_lora();
 
-    dxlr02_t mod = {0};
-
-
+    static dxlr02_t mod = {0};
+    static dxlr02_health_t health;
 
-    if (dxlr02_init(&mod, LORA_PORT, LORA_BAUD) != DXLR02_OK) {
-        while (1) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
+    // Si el init falla no se queda colgado: el supervisor lo reintenta (AT+DEFAULT, tambien a 9600)
+    if (dxlr02_init(&mod, LORA_PORT, LORA_BAUD) == DXLR02_OK) {
+        // Deja el modulo en Data Mode
+        dxlr02_set_config(&mod, &lora_config);
     }
-    
-    
-    // Cambiar a Data Mode explícitamente por si acaso
-    dxlr02_ensure_data_mode(&mod);
+
+    // Desde aca solo el supervisor toca el modulo: RX fija en el core 1 con prioridad alta,
+    // supervisor/TX en el core 0 junto con esta tarea (ver menuconfig "DX-LR02 LoRa driver")
+    dxlr02_health_init(&health, &mod, LORA_PORT, LORA_BAUD, &lora_config, NULL);
+    dxlr02_health_start_layout(&health, NULL);
     
     //int i = 0;
     //char buf[32];
 
     while (1) {
-        // Enviar por LoRa
-        dxlr02_send_data(&mod, "hola", 5); 
+        // Enviar por LoRa (no bloquea aunque el modulo este en recuperacion)
+        dxlr02_health_send(&health, "hola", 5); 
         
         // Reportar por Debug
         //snprintf(buf, sizeof(buf), "Loop %d: Enviado 'hola'", i++);
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+
+// dxlr02_receive_batch con frames que no entran en el buffer del llamador. El emisor alterna frames de
+// 20, 40 y 100 bytes; el receptor lee con buffers de distinto tamanio. Un frame que no entra tiene que
+// perderse entero: si su cola llega como frame aparte cuenta como corrupto. Una linea JSON por tamanio.
+//
+//   bench_batch            barrido completo
+//   bench_batch --quick    buffer de 64 bytes, falla si hay frames corruptos
+
+#define BENCH_POLL_US   20000
+
+static const size_t bench_sizes[] = { 20, 40, 100 };
+#define BENCH_SIZES     (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+typedef struct {
+    dxlr02_t tx;
+    dxlr02_t rx;
+    size_t buf_len;
+    size_t total;
+    size_t sent;
+    size_t ok;
+    size_t corrupt;
+    size_t oversize;
+    size_t calls;
+    int64_t period_us;
+    int64_t first_us;
+    int64_t last_us;
+    uint64_t driver_ns;
+} bench_t;
+
+static uint64_t bench_cpu_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_send(void * ctx){
+    bench_t * b = ctx;
+    char msg[128];
+    size_t len = bench_sizes[b->sent % BENCH_SIZES];
+
+    snprintf(msg, sizeof(msg), "F%08zx", b->sent);
+    memset(msg + 9, 'a', len - 10);
+    msg[len - 1] = 'E';
+    if(dxlr02_send_data(&b->tx, msg, len) == DXLR02_OK && b->sent++ == 0)
+        b->first_us = esp_timer_get_time();
+
+    if(b->sent < b->total)
+        sim_at(esp_timer_get_time() + b->period_us, bench_send, b);
+}
+
+static bool bench_valid(const dxlr02_frame_t * f){
+    char hex[9] = { 0 };
+    if(f->len < 10 || f->data[0] != 'F' || f->data[f->len - 1] != 'E')
+        return false;
+    memcpy(hex, f->data + 1, 8);
+    return f->len == bench_sizes[strtoul(hex, NULL, 16) % BENCH_SIZES];
+}
+
+static void bench_poll(void * ctx){
+    bench_t * b = ctx;
+    char buf[256];
+    dxlr02_frame_t frames[8];
+    size_t n = 0;
+
+    uint64_t w = sim_world_cpu_ns(), t = bench_cpu_ns();
+    dxlr02_status_t st = dxlr02_receive_batch(&b->rx, buf, b->buf_len, frames, 8, 0, 0, &n);
+    b->driver_ns += (bench_cpu_ns() - t) - (sim_world_cpu_ns() - w);
+    b->calls++;
+
+    if(st == DXLR02_ERR_OUT_OF_SPACE)
+        b->oversize++;
+    for(size_t k = 0; k < n; k++){
+        if(bench_valid(&frames[k]))
+            b->ok++;
+        else
+            b->corrupt++;
+        b->last_us = esp_timer_get_time();
+    }
+
+    sim_at(esp_timer_get_time() + BENCH_POLL_US, bench_poll, b);
+}
+
+static int bench_run(size_t buf_len, size_t total){
+    sim_init(NULL);
+
+    static bench_t b;
+    memset(&b, 0, sizeof(b));
+    b.buf_len = buf_len;
+    b.total = total;
+    int tx_port = sim_add_node(0, 0);
+    int rx_port = sim_add_node(100, 0);
+
+    if(dxlr02_init(&b.tx, tx_port, 57600) != DXLR02_OK || dxlr02_init(&b.rx, rx_port, 57600) != DXLR02_OK ||
+       dxlr02_set_spread_factor(&b.tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&b.rx, 7) != DXLR02_OK){
+        fprintf(stderr, "bench_batch: no se pudo configurar\n");
+        sim_free();
+        return -1;
+    }
+    dxlr02_reset_stats(&b.rx);
+
+    b.period_us = dxlr02_time_on_air_us(&b.tx.config, 101) + 20000;
+    int64_t t0 = esp_timer_get_time() + 10000;
+    sim_at(t0, bench_send, &b);
+    sim_at(t0, bench_poll, &b);
+    sim_run(t0 + (int64_t)total * b.period_us + 1000000);
+
+    // Los que entran en buf_len (con el '\0') tienen que llegar todos
+    size_t fit = 0;
+    for(size_t k = 0; k < b.sent; k++)
+        fit += bench_sizes[k % BENCH_SIZES] + 1 <= buf_len;
+
+    double elapsed_s = (double)(b.last_us - b.first_us) / 1e6;
+    printf("{\"buf_len\":%zu,\"sent\":%zu,\"fit\":%zu,\"ok\":%zu,\"corrupt\":%zu,\"out_of_space\":%zu,"
+           "\"frames_lost\":%lu,\"msgs_per_s\":%.3f,\"cpu_us_per_call\":%.3f}\n",
+           buf_len, b.sent, fit, b.ok, b.corrupt, b.oversize, (unsigned long)b.rx.stats.frames_lost,
+           elapsed_s > 0 ? (double)b.ok / elapsed_s : 0.0,
+           b.calls ? (double)b.driver_ns / 1000.0 / (double)b.calls : 0.0);
+
+    sim_free();
+    return (b.corrupt == 0 && b.ok == fit) ? 0 : -1;
+}
+
+int main(int argc, char ** argv){
+    static const size_t bufs[] = { 48, 64, 128, 256 };
+    int fails = 0;
+
+    if(argc > 1 && strcmp(argv[1], "--quick") == 0)
+        return bench_run(64, 30) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for(size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++)
+        fails += bench_run(bufs[i], 300) != 0;
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_bulk.h"
+#include "esp_timer.h"
+
+// Transferencia por diferencia de bloques sobre el simulador: imagen sin cambios, imagen editada (insercion
+// de 37 bytes, parche de 1 KiB y 3 KiB agregados al final), la editada con 10% de perdida y la completa sin
+// base. Una linea JSON por caso con los bytes que el emisor puso en la UART sobre el tamanio de la imagen.
+//
+//   bench_bulk            imagen de 200 KiB
+//   bench_bulk --quick    20 KiB; falla si alguna transferencia no termina verificada
+
+#define BENCH_BLOCK     128
+#define BENCH_POLL_US   5000
+
+typedef struct {
+    uint8_t * data;
+    uint32_t size;
+} mem_t;
+
+static dxlr02_status_t mem_read(void * ctx, uint32_t off, void * buf, size_t len){
+    mem_t * m = ctx;
+    if(off > m->size || len > m->size - off)
+        return DXLR02_ERR_STORAGE;
+    memcpy(buf, m->data + off, len);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t mem_begin(void * ctx, uint32_t size){
+    mem_t * m = ctx;
+    free(m->data);
+    m->data = calloc(1, size ? size : 1);
+    m->size = size;
+    return m->data ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t mem_write(void * ctx, uint32_t off, const void * buf, size_t len){
+    mem_t * m = ctx;
+    if(off > m->size || len > m->size - off)
+        return DXLR02_ERR_STORAGE;
+    memcpy(m->data + off, buf, len);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t mem_finish(void * ctx, bool ok){
+    (void)ctx; (void)ok;
+    return DXLR02_OK;
+}
+
+static dxlr02_bulk_image_t mem_image(mem_t * m){
+    dxlr02_bulk_image_t img = { .read = mem_read, .size = m->size, .ctx = m };
+    return img;
+}
+
+// Bytes sin estructura, como el codigo de un firmware: ninguna coincidencia fuera de lo que se copia a proposito
+static void fill_random(uint8_t * p, size_t len, uint32_t * state){
+    for(size_t i = 0; i < len; i++){
+        *state = *state * 1664525u + 1013904223u;
+        p[i] = (uint8_t)(*state >> 24);
+    }
+}
+
+static mem_t make_base(uint32_t size){
+    mem_t m = { malloc(size), size };
+    uint32_t state = 1;
+    fill_random(m.data, size, &state);
+    return m;
+}
+
+// Insercion de 37 bytes al 25%, parche de 1 KiB al 60% y 3 KiB al final
+static mem_t make_edited(const mem_t * base){
+    mem_t m = { malloc(base->size + 37 + 3072), base->size + 37 + 3072 };
+    uint32_t state = 99;
+    uint32_t ins = base->size / 4, patch = base->size * 3 / 5;
+
+    memcpy(m.data, base->data, ins);
+    fill_random(m.data + ins, 37, &state);
+    memcpy(m.data + ins + 37, base->data + ins, base->size - ins);
+    fill_random(m.data + patch, 1024, &state);
+    fill_random(m.data + base->size + 37, 3072, &state);
+    return m;
+}
+
+static int bench_case(const char * name, const mem_t * old, const mem_t * img, double loss){
+    static dxlr02_t tx, rx;
+    static dxlr02_bulk_sender_t s;
+    static dxlr02_bulk_receiver_t r;
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.loss = loss;
+    params.seed = 7;
+    sim_init(&params);
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    if(dxlr02_init(&tx, sim_add_node(0, 0), 57600) != DXLR02_OK || dxlr02_init(&rx, sim_add_node(100, 0), 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&rx, 7) != DXLR02_OK)
+        return -1;
+
+    mem_t old_copy = old ? *old : (mem_t){ NULL, 0 }, img_copy = *img, out = { NULL, 0 };
+    dxlr02_bulk_image_t old_img = mem_image(&old_copy), new_img = mem_image(&img_copy), rx_base = mem_image(&old_copy);
+    dxlr02_bulk_sink_t sink = { mem_begin, mem_write, mem_read, mem_finish, &out };
+
+    uint16_t block = dxlr02_bulk_max_block() < BENCH_BLOCK ? (uint16_t)dxlr02_bulk_max_block() : BENCH_BLOCK;
+    uint32_t n_blocks = (img->size + block - 1) / block;
+    uint32_t * plan = malloc(n_blocks * sizeof(uint32_t));
+    uint32_t * work = malloc(DXLR02_BULK_DIFF_WORDS(n_blocks) * sizeof(uint32_t));
+    uint32_t copies = 0;
+
+    if(old && dxlr02_bulk_diff(&old_img, &new_img, block, plan, work, DXLR02_BULK_DIFF_WORDS(n_blocks), &copies) != DXLR02_OK)
+        return -1;
+    if(dxlr02_bulk_sender_init(&s, &tx, old ? &old_img : NULL, &new_img, plan, block, 0x1234) != DXLR02_OK)
+        return -1;
+    dxlr02_bulk_receiver_init(&r, &rx, &rx_base, &sink);
+
+    char buf[1024];
+    dxlr02_frame_t frames[16];
+    int64_t t0 = esp_timer_get_time();
+    while(s.state != DXLR02_BULK_DONE && s.state != DXLR02_BULK_FAILED && esp_timer_get_time() < t0 + 3600000000LL){
+        dxlr02_bulk_sender_poll(&s);
+        sim_wait_until(esp_timer_get_time() + BENCH_POLL_US);
+
+        size_t n = 0;
+        dxlr02_receive_batch(&rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_bulk_receiver_on_frame(&r, frames[k].data, frames[k].len);
+        n = 0;
+        dxlr02_receive_batch(&tx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_bulk_sender_on_frame(&s, frames[k].data, frames[k].len);
+    }
+
+    bool ok = s.state == DXLR02_BULK_DONE && out.size == img->size && memcmp(out.data, img->data, img->size) == 0;
+    printf("{\"case\":\"%s\",\"image\":%u,\"block\":%u,\"loss\":%.2f,\"copy_planned\":%u,\"blocks\":%u,\"uart_bytes\":%u,"
+           "\"uart_pct\":%.1f,\"frames\":%u,\"data_blocks\":%u,\"copy_blocks\":%u,\"timeouts\":%u,\"seconds\":%.1f,\"ok\":%s}\n",
+           name, img->size, block, loss, copies, n_blocks, s.stats.bytes, 100.0 * s.stats.bytes / img->size, s.stats.frames,
+           s.stats.data_blocks, s.stats.copy_blocks, s.stats.timeouts, (esp_timer_get_time() - t0) / 1e6, ok ? "true" : "false");
+
+    free(out.data);
+    free(plan);
+    free(work);
+    sim_free();
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char ** argv){
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    uint32_t size = quick ? 20 * 1024 : 200 * 1024;
+    int fails = 0;
+
+    mem_t base = make_base(size);
+    mem_t edited = make_edited(&base);
+
+    fails += bench_case("unchanged", &base, &base, 0.0) != 0;
+    fails += bench_case("edited", &base, &edited, 0.0) != 0;
+    fails += bench_case("edited_loss", &base, &edited, 0.1) != 0;
+    fails += bench_case("full", NULL, &edited, 0.0) != 0;
+
+    free(base.data);
+    free(edited.data);
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_fec.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+
+// FEC contra ARQ sobre el simulador, con la misma perdida en el aire: k = 4, m = 2 sin confirmaciones
+// contra retransmitir cada paquete hasta que llegue su ACK. Una linea JSON por combinacion con lo entregado
+// y el goodput: bytes de payload entregados por segundo de aire (los dos nodos, ACKs incluidos).
+//
+//   bench_fec            200 paquetes por combinacion
+//   bench_fec --quick    24; falla si el ARQ no entrega todo o alguno entrega algo distinto
+
+#define BENCH_PAYLOAD       100
+#define BENCH_K             4
+#define BENCH_M             2
+#define BENCH_POLL_US       10000
+#define BENCH_MARGIN_US     200000
+#define BENCH_MAX_TRIES     16
+
+typedef struct {
+    dxlr02_t tx;
+    dxlr02_t rx;
+    int tx_port;
+    int rx_port;
+    uint32_t expected;          // ARQ: siguiente paquete que el receptor tiene que entregar
+    uint32_t delivered;
+    uint32_t corrupt;
+} bench_t;
+
+static bench_t b;
+
+// Payload: secuencia (4 hex) + texto que depende de ella. Sin '\0', para que el ARQ lo mande tal cual.
+static void make_payload(char * data, uint32_t seq){
+    char hex[5];
+    snprintf(hex, sizeof(hex), "%04x", (unsigned)(seq & 0xFFFF));
+    memcpy(data, hex, 4);
+    for(size_t i = 4; i < BENCH_PAYLOAD; i++)
+        data[i] = (char)('a' + (i + seq) % 26);
+}
+
+// Secuencia del payload, o -1 si no es uno de los que se mandaron
+static int payload_seq(const char * data, size_t len){
+    char want[BENCH_PAYLOAD];
+    unsigned seq;
+    if(len != BENCH_PAYLOAD || sscanf(data, "%4x", &seq) != 1)
+        return -1;
+    make_payload(want, seq);
+    return memcmp(data, want, BENCH_PAYLOAD) == 0 ? (int)seq : -1;
+}
+
+static int bench_setup(double loss){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.loss = loss;
+    params.seed = 11;
+    sim_init(&params);
+    memset(&b, 0, sizeof(b));
+    b.tx_port = sim_add_node(0, 0);
+    b.rx_port = sim_add_node(100, 0);
+    if(dxlr02_init(&b.tx, b.tx_port, 57600) != DXLR02_OK || dxlr02_init(&b.rx, b.rx_port, 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&b.tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&b.rx, 7) != DXLR02_OK)
+        return -1;
+    return 0;
+}
+
+static int64_t frame_us(const dxlr02_config_t * conf, size_t len){
+    return dxlr02_uart_time_us(conf, len + 1) + dxlr02_time_on_air_us(conf, len + 1);
+}
+
+/****************************************** FEC ******************************************/
+
+static void fec_deliver(void * ctx, const char * data, size_t len){
+    (void)ctx;
+    b.delivered++;
+    b.corrupt += payload_seq(data, len) < 0;
+}
+
+static void fec_poll(dxlr02_fec_decoder_t * dec, int64_t until){
+    char buf[1024];
+    dxlr02_frame_t frames[16];
+    while(esp_timer_get_time() < until){
+        sim_wait_until(esp_timer_get_time() + BENCH_POLL_US);
+        size_t n = 0;
+        dxlr02_receive_batch(&b.rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_fec_on_frame(dec, frames[k].data, frames[k].len);
+    }
+}
+
+static void fec_run(uint32_t packets){
+    dxlr02_fec_encoder_t enc;
+    dxlr02_fec_decoder_t dec;
+    char data[BENCH_PAYLOAD];
+    int64_t shard = frame_us(&b.tx.config, 2 * (DXLR02_FEC_HEADER_LEN + DXLR02_FEC_LEN_BYTES + BENCH_PAYLOAD));
+
+    dxlr02_fec_encoder_init(&enc, &b.tx, BENCH_K, BENCH_M, BENCH_PAYLOAD);
+    dxlr02_fec_decoder_init(&dec, fec_deliver, NULL);
+    for(uint32_t i = 0; i < packets; i++){
+        make_payload(data, i);
+        dxlr02_fec_send(&enc, data, BENCH_PAYLOAD);
+        // Al completar el bloque salen tambien las m paridades
+        int frames = (i % BENCH_K == BENCH_K - 1) ? 1 + BENCH_M : 1;
+        fec_poll(&dec, esp_timer_get_time() + frames * shard + BENCH_MARGIN_US);
+    }
+    dxlr02_fec_flush(&enc);
+    fec_poll(&dec, esp_timer_get_time() + (1 + BENCH_M) * shard + BENCH_MARGIN_US);
+    dxlr02_fec_decoder_flush(&dec);
+}
+
+/****************************************** ARQ ******************************************/
+
+// Datos: 'D' + payload (empieza con la secuencia). ACK: 'A' + secuencia.
+static void arq_rx_poll(void){
+    char buf[1024];
+    dxlr02_frame_t frames[16];
+    size_t n = 0;
+    dxlr02_receive_batch(&b.rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+    for(size_t k = 0; k < n; k++){
+        if(frames[k].len < 1 || frames[k].data[0] != 'D')
+            continue;
+        int seq = payload_seq(frames[k].data + 1, frames[k].len - 1);
+        if(seq < 0){
+            b.corrupt++;
+            continue;
+        }
+        if((uint32_t)seq == (b.expected & 0xFFFF)){
+            b.delivered++;
+            b.expected++;
+        }
+        // Repetido (se perdio el ACK): se vuelve a confirmar
+        char ack[16];
+        snprintf(ack, sizeof(ack), "A%04x", (unsigned)seq);
+        dxlr02_send_data(&b.rx, ack, 5);
+    }
+}
+
+static bool arq_acked(uint32_t seq){
+    char buf[256];
+    dxlr02_frame_t frames[8];
+    size_t n = 0;
+    bool acked = false;
+    dxlr02_receive_batch(&b.tx, buf, sizeof(buf), frames, 8, 0, 0, &n);
+    for(size_t k = 0; k < n; k++){
+        unsigned got;
+        acked |= frames[k].len == 5 && frames[k].data[0] == 'A' && sscanf(frames[k].data + 1, "%4x", &got) == 1 && got == (seq & 0xFFFF);
+    }
+    return acked;
+}
+
+static uint32_t arq_run(uint32_t packets){
+    char msg[1 + BENCH_PAYLOAD];
+    int64_t timeout = frame_us(&b.tx.config, sizeof(msg)) + frame_us(&b.rx.config, 5) + BENCH_MARGIN_US;
+    uint32_t retries = 0;
+
+    for(uint32_t i = 0; i < packets; i++){
+        msg[0] = 'D';
+        make_payload(msg + 1, i);
+        bool acked = false;
+        for(int t = 0; t < BENCH_MAX_TRIES && !acked; t++){
+            retries += t > 0;
+            dxlr02_send_data(&b.tx, msg, sizeof(msg));
+            int64_t end = esp_timer_get_time() + timeout;
+            while(!acked && esp_timer_get_time() < end){
+                sim_wait_until(esp_timer_get_time() + BENCH_POLL_US);
+                arq_rx_poll();
+                acked = arq_acked(i);
+            }
+        }
+    }
+    return retries;
+}
+
+static int bench_case(const char * mode, double loss, uint32_t packets){
+    if(bench_setup(loss) != 0)
+        return -1;
+
+    uint64_t air0 = sim_node_stats(b.tx_port)->tx_air_us + sim_node_stats(b.rx_port)->tx_air_us;
+    uint32_t frames0 = sim_node_stats(b.tx_port)->tx_packets + sim_node_stats(b.rx_port)->tx_packets;
+    int64_t t0 = esp_timer_get_time();
+    uint32_t retries = 0;
+    if(strcmp(mode, "fec") == 0)
+        fec_run(packets);
+    else
+        retries = arq_run(packets);
+
+    double air_s = (double)(sim_node_stats(b.tx_port)->tx_air_us + sim_node_stats(b.rx_port)->tx_air_us - air0) / 1e6;
+    uint32_t frames = sim_node_stats(b.tx_port)->tx_packets + sim_node_stats(b.rx_port)->tx_packets - frames0;
+    printf("{\"mode\":\"%s\",\"loss\":%.2f,\"packets\":%u,\"payload\":%d,\"delivered\":%u,\"delivered_pct\":%.1f,"
+           "\"frames\":%u,\"retries\":%u,\"air_s\":%.2f,\"goodput_Bps\":%.1f,\"seconds\":%.1f,\"corrupt\":%u}\n",
+           mode, loss, packets, BENCH_PAYLOAD, b.delivered, 100.0 * b.delivered / packets, frames, retries, air_s,
+           air_s > 0 ? (double)b.delivered * BENCH_PAYLOAD / air_s : 0.0, (esp_timer_get_time() - t0) / 1e6, b.corrupt);
+
+    bool ok = b.corrupt == 0 && (strcmp(mode, "arq") != 0 || b.delivered == packets);
+    sim_free();
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char ** argv){
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    static const double losses[] = { 0.0, 0.05, 0.1, 0.2, 0.3 };
+    uint32_t packets = quick ? 24 : 200;
+    int fails = 0;
+
+    for(size_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++){
+        fails += bench_case("fec", losses[i], packets) != 0;
+        fails += bench_case("arq", losses[i], packets) != 0;
+    }
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_flood.h"
+#include "esp_timer.h"
+
+// Flooding administrado contra flooding puro sobre el simulador: nodos en modo 2 y SF7 repartidos al azar
+// en una franja larga (malla dispersa, muchos saltos) y en un rectangulo mas chico (densa), con la primera
+// semilla que deje la malla conexa (enlace: RSSI medio sobre la sensibilidad). El TTL es el diametro de la
+// malla en saltos + 1. Cada nodo corre su vuelta de aplicacion cada 10 ms (receive_batch sin esperar,
+// on_frame, poll) y origenes al azar mandan un paquete cada 10 s. Una linea JSON por caso con la cobertura
+// y las transmisiones por paquete.
+//
+//   bench_flood            40 nodos, 60 paquetes
+//   bench_flood --quick    10 paquetes; falla si el administrado no cubre el 90% o no ahorra
+
+#define BENCH_POLL_US       10000
+#define BENCH_PERIOD_US     10000000
+#define BENCH_PAYLOAD       16
+
+typedef struct {
+    const char * name;
+    int nodes;
+    double width_m;
+    double height_m;
+} bench_layout_t;
+
+typedef struct {
+    uint32_t seed;
+    int degree_sum;
+    int diameter;
+} bench_mesh_t;
+
+static dxlr02_t nodes[SIM_MAX_NODES];
+static dxlr02_flood_t fls[SIM_MAX_NODES];
+static int n_nodes;
+static uint64_t * seen;         // por paquete, un bit por nodo que lo recibio
+static uint32_t hops_sum;
+static int sent;
+
+static void deliver(void * ctx, uint16_t origin, uint8_t hops, const char * data, size_t len){
+    (void)origin; (void)len;
+    int k;
+    if(sscanf(data, "flood-%d", &k) == 1 && k >= 0 && k < sent){
+        seen[k] |= 1ull << (intptr_t)ctx;
+        hops_sum += hops;
+    }
+}
+
+static void node_app(void * ctx){
+    intptr_t i = (intptr_t)ctx;
+    char buf[512];
+    dxlr02_frame_t frames[8];
+    size_t n = 0;
+
+    dxlr02_receive_batch(&nodes[i], buf, sizeof(buf), frames, 8, 0, 0, &n);
+    for(size_t f = 0; f < n; f++)
+        dxlr02_flood_on_frame(&fls[i], frames[f].data, frames[f].len);
+    dxlr02_flood_poll(&fls[i]);
+    sim_at(esp_timer_get_time() + BENCH_POLL_US, node_app, ctx);
+}
+
+static void originate(void * ctx){
+    (void)ctx;
+    char msg[BENCH_PAYLOAD + 1];
+    int origin = (int)(sim_random() % n_nodes);
+    snprintf(msg, sizeof(msg), "flood-%04d......", sent);
+    seen[sent] |= 1ull << origin;
+    sent++;
+    dxlr02_flood_send(&fls[origin], msg, BENCH_PAYLOAD);
+}
+
+// Nodos en el rectangulo con la semilla dada; -1 si la malla no es conexa
+static int place(const bench_layout_t * lay, uint32_t seed, bench_mesh_t * mesh){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.seed = seed;
+    sim_init(&params);
+    for(int i = 0; i < lay->nodes; i++)
+        sim_add_node(sim_uniform() * lay->width_m, sim_uniform() * lay->height_m);
+
+    // BFS desde cada nodo: grado medio y diametro en saltos
+    double sens = sim_sensitivity_dbm(7);
+    int dist[SIM_MAX_NODES], queue[SIM_MAX_NODES];
+    mesh->seed = seed;
+    mesh->degree_sum = 0;
+    mesh->diameter = 0;
+    for(int s = 0; s < lay->nodes; s++){
+        int head = 0, tail = 0, reached = 1;
+        for(int i = 0; i < lay->nodes; i++)
+            dist[i] = -1;
+        dist[s] = 0;
+        queue[tail++] = s;
+        while(head < tail){
+            int u = queue[head++];
+            for(int v = 0; v < lay->nodes; v++){
+                if(v == u || sim_link_rssi(u, v) < sens || sim_link_rssi(v, u) < sens)
+                    continue;
+                if(u == s)
+                    mesh->degree_sum++;
+                if(dist[v] < 0){
+                    dist[v] = dist[u] + 1;
+                    if(dist[v] > mesh->diameter)
+                        mesh->diameter = dist[v];
+                    queue[tail++] = v;
+                    reached++;
+                }
+            }
+        }
+        if(reached < lay->nodes)
+            return -1;
+    }
+    return 0;
+}
+
+static int bench_case(const bench_layout_t * lay, const bench_mesh_t * mesh, const char * flood, uint8_t suppress,
+                      int packets, double * coverage, double * tx_per_packet){
+    bench_mesh_t again;
+    if(place(lay, mesh->seed, &again) != 0)
+        return -1;
+
+    uint8_t ttl = (uint8_t)(mesh->diameter + 1);
+    n_nodes = lay->nodes;
+    for(int i = 0; i < n_nodes; i++){
+        memset(&nodes[i], 0, sizeof(nodes[i]));
+        if(dxlr02_init(&nodes[i], (uint8_t)i, 57600) != DXLR02_OK)
+            return -1;
+        if(dxlr02_at_set(&nodes[i], DXLR02_AT_MODE, 2) != DXLR02_OK || dxlr02_at_set(&nodes[i], DXLR02_AT_SF, 7) != DXLR02_OK ||
+           dxlr02_ensure_data_mode(&nodes[i]) != DXLR02_OK)
+            return -1;
+        if(dxlr02_flood_init(&fls[i], &nodes[i], (uint16_t)(i + 1), deliver, (void *)(intptr_t)i) != DXLR02_OK)
+            return -1;
+        fls[i].ttl = ttl;
+        fls[i].suppress = suppress;
+    }
+
+    seen = calloc(packets, sizeof(uint64_t));
+    hops_sum = 0;
+    sent = 0;
+    int64_t t0 = esp_timer_get_time();
+    for(int i = 0; i < n_nodes; i++)
+        sim_at(t0 + (int64_t)i * BENCH_POLL_US / n_nodes, node_app, (void *)(intptr_t)i);
+    for(int k = 0; k < packets; k++)
+        sim_at(t0 + 1000000 + (int64_t)k * BENCH_PERIOD_US, originate, NULL);
+    sim_run(t0 + 1000000 + (int64_t)packets * BENCH_PERIOD_US);
+
+    uint32_t reached = 0, tx = 0, collisions = 0, relayed = 0, suppressed = 0, dropped = 0;
+    for(int k = 0; k < sent; k++)
+        reached += __builtin_popcountll(seen[k]) - 1;
+    for(int i = 0; i < n_nodes; i++){
+        tx += sim_node_stats(i)->tx_packets;
+        collisions += sim_node_stats(i)->rx_collision;
+        relayed += fls[i].stats.relayed;
+        suppressed += fls[i].stats.suppressed;
+        dropped += fls[i].stats.dropped;
+    }
+
+    *coverage = sent ? (double)reached / ((double)sent * (n_nodes - 1)) : 0.0;
+    *tx_per_packet = sent ? (double)tx / sent : 0.0;
+    printf("{\"layout\":\"%s\",\"flood\":\"%s\",\"nodes\":%d,\"area_m\":\"%.0fx%.0f\",\"seed\":%u,\"avg_degree\":%.1f,\"diameter\":%d,"
+           "\"ttl\":%u,\"suppress\":%u,\"packets\":%d,\"coverage\":%.3f,\"tx_per_packet\":%.1f,\"relayed\":%u,\"suppressed\":%u,"
+           "\"dropped\":%u,\"avg_hops\":%.2f,\"collisions\":%u}\n",
+           lay->name, flood, n_nodes, lay->width_m, lay->height_m, mesh->seed, (double)mesh->degree_sum / n_nodes, mesh->diameter, ttl,
+           suppress, sent, *coverage, *tx_per_packet, relayed, suppressed, dropped, reached ? (double)hops_sum / reached : 0.0,
+           collisions);
+
+    for(int i = 0; i < n_nodes; i++)
+        dxlr02_flood_deinit(&fls[i]);
+    free(seen);
+    sim_free();
+    return 0;
+}
+
+int main(int argc, char ** argv){
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int packets = quick ? 10 : 60;
+    bench_layout_t layouts[] = {
+        { "sparse", 40, 14000.0, 1500.0 },
+        { "dense", 40, 6000.0, 2000.0 },
+    };
+    int fails = 0;
+
+    for(size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++){
+        bench_mesh_t mesh;
+        uint32_t seed = 1;
+        while(place(&layouts[l], seed, &mesh) != 0){
+            sim_free();
+            seed++;
+        }
+        sim_free();
+
+        double managed_cov, managed_tx, pure_cov, pure_tx;
+        if(bench_case(&layouts[l], &mesh, "managed", DXLR02_FLOOD_SUPPRESS, packets, &managed_cov, &managed_tx) != 0 ||
+           bench_case(&layouts[l], &mesh, "pure", 0, packets, &pure_cov, &pure_tx) != 0){
+            fails++;
+            continue;
+        }
+        fails += quick && (managed_cov < 0.9 || managed_tx > pure_tx);
+    }
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
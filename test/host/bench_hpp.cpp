@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "sim.h"
+#include "dxlr02.hpp"
+#include "esp_timer.h"
+
+// dxlr02.hpp contra la API C sobre el simulador: CPU del host dentro del driver (descontado el simulador),
+// comandos y toggles por configuracion completa, y CPU por envio con span contra dxlr02_send_data. Una linea
+// JSON por camino.
+//
+//   bench_hpp            100 configuraciones y 2000 envios por camino
+//   bench_hpp --quick    5 y 100; falla si los dos caminos no mandan lo mismo al modulo
+
+using bench_profile = dxlr02::profile<dxlr02::mode::broadcast, 57600, 0, 0x0A, 0x21, 14, 7, 3, true, false>;
+
+static std::uint64_t bench_cpu_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+struct bench_result {
+    std::uint64_t driver_ns = 0;
+    std::uint32_t at_commands = 0;
+    std::uint32_t toggles = 0;
+    std::uint32_t failures = 0;
+};
+
+// CPU del host en una llamada al driver, sin lo que el simulador gasto adentro
+template <typename Fn>
+static dxlr02::status bench_timed(bench_result & r, Fn && call){
+    std::uint64_t w = sim_world_cpu_ns(), t = bench_cpu_ns();
+    dxlr02::status st = call();
+    r.driver_ns += (bench_cpu_ns() - t) - (sim_world_cpu_ns() - w);
+    r.failures += st != DXLR02_OK;
+    return st;
+}
+
+static bench_result bench_configure(bool hpp, int reps){
+    bench_result r;
+    sim_init(nullptr);
+    dxlr02::radio radio;
+    int port = sim_add_node(0, 0);
+    if(radio.init(static_cast<std::uint8_t>(port), 57600) != DXLR02_OK){
+        r.failures++;
+        sim_free();
+        return r;
+    }
+
+    sim_node_stats_t s0 = *sim_node_stats(port);
+    for(int i = 0; i < reps; i++){
+        if(hpp)
+            bench_timed(r, [&]{ return radio.configure<bench_profile>(); });
+        else
+            bench_timed(r, [&]{ return dxlr02_set_config(&radio.handle(), &bench_profile::config); });
+    }
+    r.at_commands = sim_node_stats(port)->at_commands - s0.at_commands;
+    r.toggles = sim_node_stats(port)->toggles - s0.toggles;
+    sim_free();
+    return r;
+}
+
+static bench_result bench_send(bool hpp, int reps){
+    bench_result r;
+    sim_init(nullptr);
+    dxlr02::radio radio;
+    int port = sim_add_node(0, 0);
+    if(radio.init(static_cast<std::uint8_t>(port), 57600) != DXLR02_OK || radio.configure<bench_profile>() != DXLR02_OK){
+        r.failures++;
+        sim_free();
+        return r;
+    }
+
+    char msg[32];
+    std::memset(msg, 'x', sizeof(msg));
+    for(int i = 0; i < reps; i++){
+        if(hpp)
+            bench_timed(r, [&]{ return radio.broadcast<0x0A>(msg); });
+        else
+            bench_timed(r, [&]{ return dxlr02_broadcast(&radio.handle(), 0x0A, msg, sizeof(msg)); });
+        sim_wait_until(esp_timer_get_time() + 200000);
+    }
+    sim_free();
+    return r;
+}
+
+static void bench_print(const char * op, const char * api, int reps, const bench_result & r){
+    std::printf("{\"op\":\"%s\",\"api\":\"%s\",\"reps\":%d,\"driver_us_per_op\":%.3f,\"at_commands_per_op\":%.1f,"
+                "\"toggles_per_op\":%.1f,\"failures\":%u}\n",
+                op, api, reps, static_cast<double>(r.driver_ns) / 1000.0 / reps, static_cast<double>(r.at_commands) / reps,
+                static_cast<double>(r.toggles) / reps, r.failures);
+}
+
+int main(int argc, char ** argv){
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    int configs = quick ? 5 : 100, sends = quick ? 100 : 2000;
+
+    bench_result c_conf = bench_configure(false, configs);
+    bench_result h_conf = bench_configure(true, configs);
+    bench_result c_send = bench_send(false, sends);
+    bench_result h_send = bench_send(true, sends);
+
+    bench_print("configure", "c", configs, c_conf);
+    bench_print("configure", "hpp", configs, h_conf);
+    bench_print("broadcast", "c", sends, c_send);
+    bench_print("broadcast", "hpp", sends, h_send);
+
+    bool fail = c_conf.failures || h_conf.failures || c_send.failures || h_send.failures ||
+                c_conf.at_commands != h_conf.at_commands || c_conf.toggles != h_conf.toggles;
+    return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+
+// Benchmark del enlace punto a punto sobre el simulador: barre baud de la UART, largo del payload y
+// perdida en el aire. Por cada combinacion imprime una linea JSON con mensajes por segundo, latencia
+// p50/p99 (send_data -> receive_batch, en tiempo simulado), CPU del host dentro del driver por mensaje
+// (descontado el simulador) y los contadores de dxlr02_stats_to_json de los dos lados.
+//
+//   bench_link            barrido completo
+//   bench_link --quick    una combinacion, para ctest
+
+#define BENCH_MAX_MSGS      400
+#define BENCH_POLL_US       5000
+#define BENCH_MARGIN_US     20000
+
+typedef struct {
+    dxlr02_t tx;
+    dxlr02_t rx;
+    int tx_port;
+    int rx_port;
+    size_t payload;
+    size_t total;
+    size_t sent;
+    size_t received;
+    int64_t period_us;
+    int64_t sent_us[BENCH_MAX_MSGS];
+    int64_t latency_us[BENCH_MAX_MSGS];
+    int64_t first_us;
+    int64_t last_rx_us;
+    uint64_t driver_ns;
+} bench_t;
+
+static uint64_t bench_cpu_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// CPU del host en una llamada al driver, sin lo que el simulador gasto adentro
+#define BENCH_TIMED(b, call) do { \
+    uint64_t _w = sim_world_cpu_ns(), _t = bench_cpu_ns(); \
+    call; \
+    (b)->driver_ns += (bench_cpu_ns() - _t) - (sim_world_cpu_ns() - _w); \
+} while(0)
+
+static void bench_send(void * ctx){
+    bench_t * b = ctx;
+    char msg[256];
+
+    snprintf(msg, sizeof(msg), "%08zx", b->sent);
+    memset(msg + 8, 'x', b->payload - 8);
+    b->sent_us[b->sent] = esp_timer_get_time();
+
+    dxlr02_status_t st;
+    BENCH_TIMED(b, st = dxlr02_send_data(&b->tx, msg, b->payload));
+    if(st == DXLR02_OK && b->sent++ == 0)
+        b->first_us = b->sent_us[0];
+
+    if(b->sent < b->total)
+        sim_at(esp_timer_get_time() + b->period_us, bench_send, b);
+}
+
+static void bench_poll(void * ctx){
+    bench_t * b = ctx;
+    char buf[1024];
+    dxlr02_frame_t frames[8];
+    size_t n = 0;
+
+    BENCH_TIMED(b, dxlr02_receive_batch(&b->rx, buf, sizeof(buf), frames, 8, 0, 0, &n));
+    int64_t now = esp_timer_get_time();
+    for(size_t k = 0; k < n; k++){
+        char hex[9] = { 0 };
+        if(frames[k].len < 8)
+            continue;
+        memcpy(hex, frames[k].data, 8);
+        size_t seq = strtoul(hex, NULL, 16);
+        if(seq >= b->sent)
+            continue;
+        b->latency_us[b->received++] = now - b->sent_us[seq];
+        b->last_rx_us = now;
+    }
+
+    sim_at(now + BENCH_POLL_US, bench_poll, b);
+}
+
+static int bench_cmp(const void * a, const void * b){
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_percentile_ms(const int64_t * sorted, size_t n, double p){
+    if(n == 0)
+        return 0.0;
+    size_t k = (size_t)(p * (double)(n - 1) + 0.5);
+    return (double)sorted[k] / 1000.0;
+}
+
+static int bench_run(int baud, size_t payload, double loss, size_t total){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.loss = loss;
+    sim_init(&params);
+
+    static bench_t b;
+    memset(&b, 0, sizeof(b));
+    b.payload = payload;
+    b.total = total;
+    b.tx_port = sim_add_node(0, 0);
+    b.rx_port = sim_add_node(200, 0);
+
+    if(dxlr02_init(&b.tx, b.tx_port, baud) != DXLR02_OK || dxlr02_init(&b.rx, b.rx_port, baud) != DXLR02_OK ||
+       dxlr02_set_spread_factor(&b.tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&b.rx, 7) != DXLR02_OK){
+        fprintf(stderr, "bench_link: no se pudo configurar a %d baud\n", baud);
+        sim_free();
+        return -1;
+    }
+    dxlr02_reset_stats(&b.tx);
+    dxlr02_reset_stats(&b.rx);
+
+    // Un mensaje por time-on-air (mas la UART y un margen): mide el driver, no la cola del modulo
+    b.period_us = dxlr02_time_on_air_us(&b.tx.config, payload + 1) + dxlr02_uart_time_us(&b.tx.config, payload + 1) + BENCH_MARGIN_US;
+    int64_t t0 = esp_timer_get_time() + 10000;
+    sim_at(t0, bench_send, &b);
+    sim_at(t0, bench_poll, &b);
+    sim_run(t0 + (int64_t)total * b.period_us + 2000000);
+
+    qsort(b.latency_us, b.received, sizeof(b.latency_us[0]), bench_cmp);
+    double elapsed_s = b.received > 0 ? (double)(b.last_rx_us - b.first_us) / 1e6 : 0.0;
+
+    char tx_json[512], rx_json[512];
+    dxlr02_stats_to_json(&b.tx.stats, tx_json, sizeof(tx_json));
+    dxlr02_stats_to_json(&b.rx.stats, rx_json, sizeof(rx_json));
+
+    printf("{\"baud\":%d,\"payload\":%zu,\"loss\":%.2f,\"sent\":%zu,\"received\":%zu,"
+           "\"msgs_per_s\":%.3f,\"p50_ms\":%.2f,\"p99_ms\":%.2f,\"cpu_us_per_msg\":%.3f,"
+           "\"tx_stats\":%s,\"rx_stats\":%s}\n",
+           baud, payload, loss, b.sent, b.received,
+           elapsed_s > 0 ? (double)b.received / elapsed_s : 0.0,
+           bench_percentile_ms(b.latency_us, b.received, 0.50), bench_percentile_ms(b.latency_us, b.received, 0.99),
+           b.sent + b.received > 0 ? (double)b.driver_ns / 1000.0 / (double)(b.sent + b.received) : 0.0,
+           tx_json, rx_json);
+
+    sim_free();
+    return (loss == 0.0 && b.received != b.sent) ? -1 : 0;
+}
+
+int main(int argc, char ** argv){
+    static const int bauds[] = { 9600, 57600, 115200 };
+    static const size_t payloads[] = { 16, 64, 200 };
+    static const double losses[] = { 0.0, 0.1, 0.3 };
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int fails = 0;
+
+    if(quick)
+        return bench_run(9600, 32, 0.0, 20) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for(size_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++)
+        for(size_t j = 0; j < sizeof(payloads) / sizeof(payloads[0]); j++)
+            for(size_t k = 0; k < sizeof(losses) / sizeof(losses[0]); k++)
+                fails += bench_run(bauds[i], payloads[j], losses[k], 200) != 0;
+
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_queue.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+
+// Cola persistente: append y recuperacion tras un corte sobre el backend de archivo (operaciones de flash
+// contadas, que es lo que cuesta en el ESP32) y drain por el simulador contra un gateway que confirma.
+// Una linea JSON por corrida.
+//
+//   bench_queue            barrido completo
+//   bench_queue --quick    200 registros; falla si la recuperacion o la entrega pierden algo
+
+#define BENCH_FILE      "bench_queue.bin"
+#define BENCH_SIZE      (64 * 4096)
+#define BENCH_PAYLOAD   32
+
+typedef struct {
+    dxlr02_storage_t file;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+} counted_t;
+
+static dxlr02_status_t counted_read(void * ctx, uint32_t addr, void * buf, size_t len){
+    counted_t * c = ctx;
+    c->reads++;
+    c->read_bytes += len;
+    return c->file.read(c->file.ctx, addr, buf, len);
+}
+
+static dxlr02_status_t counted_write(void * ctx, uint32_t addr, const void * buf, size_t len){
+    counted_t * c = ctx;
+    c->writes++;
+    c->write_bytes += len;
+    return c->file.write(c->file.ctx, addr, buf, len);
+}
+
+static dxlr02_status_t counted_erase(void * ctx, uint32_t addr, size_t len){
+    counted_t * c = ctx;
+    c->erases++;
+    return c->file.erase(c->file.ctx, addr, len);
+}
+
+static int counted_open(counted_t * c, dxlr02_storage_t * storage){
+    memset(c, 0, sizeof(*c));
+    if(dxlr02_storage_file(&c->file, BENCH_FILE, BENCH_SIZE) != DXLR02_OK)
+        return -1;
+    *storage = c->file;
+    storage->read = counted_read;
+    storage->write = counted_write;
+    storage->erase = counted_erase;
+    storage->ctx = c;
+    return 0;
+}
+
+static uint64_t bench_cpu_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_record(char * msg, uint32_t i){
+    snprintf(msg, BENCH_PAYLOAD + 1, "R%07u", (unsigned)i);
+    memset(msg + 8, 'x', BENCH_PAYLOAD - 8);
+}
+
+// Append de n registros, commit y corte de energia (el archivo se cierra sin dxlr02_queue_close)
+static int bench_flash(uint32_t n){
+    counted_t c;
+    dxlr02_storage_t storage;
+    dxlr02_queue_t q;
+    char msg[BENCH_PAYLOAD + 1];
+
+    remove(BENCH_FILE);
+    if(counted_open(&c, &storage) != 0 || dxlr02_queue_open(&q, &storage, 1) != DXLR02_OK)
+        return -1;
+
+    uint64_t t = bench_cpu_ns();
+    for(uint32_t i = 0; i < n; i++){
+        bench_record(msg, i);
+        if(dxlr02_queue_append(&q, msg, BENCH_PAYLOAD) != DXLR02_OK)
+            return -1;
+    }
+    dxlr02_queue_commit(&q);
+    uint64_t append_ns = bench_cpu_ns() - t;
+    uint32_t writes = c.writes, erases = c.erases;
+    uint64_t write_bytes = c.write_bytes;
+    dxlr02_storage_file_close(&c.file);
+
+    if(counted_open(&c, &storage) != 0)
+        return -1;
+    t = bench_cpu_ns();
+    dxlr02_status_t st = dxlr02_queue_open(&q, &storage, 1);
+    uint64_t open_ns = bench_cpu_ns() - t;
+
+    printf("{\"records\":%u,\"payload\":%d,\"append_us_per_record\":%.3f,\"flash_writes\":%u,\"flash_write_bytes\":%llu,"
+           "\"erases\":%u,\"recovered\":%u,\"recovery_reads\":%u,\"recovery_read_bytes\":%llu,\"recovery_cpu_us\":%.1f}\n",
+           n, BENCH_PAYLOAD, (double)append_ns / 1000.0 / n, writes, (unsigned long long)write_bytes, erases,
+           q.stats.recovered, c.reads, (unsigned long long)c.read_bytes, (double)open_ns / 1000.0);
+
+    int fail = st != DXLR02_OK || q.stats.recovered != n;
+    dxlr02_queue_close(&q);
+    dxlr02_storage_file_close(&c.file);
+    return fail ? -1 : 0;
+}
+
+typedef struct {
+    dxlr02_t node;
+    dxlr02_t gw;
+    dxlr02_queue_t q;
+    dxlr02_queue_receiver_t r;
+    uint32_t delivered;
+    bool done;
+} bench_link_t;
+
+static void bench_node(void * ctx){
+    bench_link_t * b = ctx;
+    char buf[256];
+    dxlr02_frame_t frames[4];
+
+    while(dxlr02_queue_pending(&b->q) > 0){
+        uint32_t sent;
+        size_t n = 0;
+        dxlr02_queue_drain(&b->q, &b->node, DXLR02_QUEUE_WINDOW, &sent);
+        dxlr02_receive_batch(&b->node, buf, sizeof(buf), frames, 4, 1, 100, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_queue_on_frame(&b->q, frames[k].data, frames[k].len);
+    }
+    b->done = true;
+}
+
+static void bench_gateway(void * ctx){
+    bench_link_t * b = ctx;
+    char buf[256];
+    dxlr02_frame_t frames[4];
+
+    for(;;){
+        size_t n = 0;
+        if(dxlr02_receive_batch(&b->gw, buf, sizeof(buf), frames, 4, 1, 1000, &n) != DXLR02_OK)
+            continue;
+        for(size_t k = 0; k < n; k++){
+            const char * data;
+            size_t len;
+            if(dxlr02_queue_receive(&b->r, &b->gw, frames[k].data, frames[k].len, &data, &len, NULL) == DXLR02_OK && len > 0)
+                b->delivered++;
+        }
+    }
+}
+
+// Drain de n registros ya encolados hasta que el gateway confirma todos
+static int bench_drain(uint32_t n, int baud, double loss){
+    static bench_link_t b;
+    counted_t c;
+    dxlr02_storage_t storage;
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    char msg[BENCH_PAYLOAD + 1];
+
+    params.loss = loss;
+    sim_init(&params);
+    memset(&b, 0, sizeof(b));
+    remove(BENCH_FILE);
+    if(dxlr02_init(&b.node, sim_add_node(0, 0), baud) != DXLR02_OK || dxlr02_init(&b.gw, sim_add_node(200, 0), baud) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&b.node, 7) != DXLR02_OK || dxlr02_set_spread_factor(&b.gw, 7) != DXLR02_OK)
+        return -1;
+    if(counted_open(&c, &storage) != 0 || dxlr02_queue_open(&b.q, &storage, 1) != DXLR02_OK)
+        return -1;
+    for(uint32_t i = 0; i < n; i++){
+        bench_record(msg, i);
+        dxlr02_queue_append(&b.q, msg, BENCH_PAYLOAD);
+    }
+    dxlr02_queue_receiver_init(&b.r);
+
+    int64_t t0 = esp_timer_get_time(), t = t0;
+    sim_spawn(t0, bench_node, &b);
+    sim_spawn(t0, bench_gateway, &b);
+    while(!b.done && t < t0 + (int64_t)n * 5000000){
+        t += 100000;
+        sim_run(t);
+    }
+    double elapsed_s = (t - t0) / 1e6;
+
+    // Techo: un frame a la vez, UART + aire, sin ACKs
+    size_t frame = BENCH_PAYLOAD + DXLR02_QUEUE_FRAME_HDR_LEN + 1;
+    double ceiling = 1e6 / (dxlr02_uart_time_us(&b.node.config, frame) + dxlr02_time_on_air_us(&b.node.config, frame));
+
+    printf("{\"records\":%u,\"baud\":%d,\"loss\":%.2f,\"delivered\":%u,\"acked\":%u,\"frames\":%u,\"rewinds\":%u,"
+           "\"timeouts\":%u,\"marks\":%u,\"records_per_s\":%.3f,\"ceiling_per_s\":%.3f}\n",
+           n, baud, loss, b.delivered, b.q.stats.acked, b.q.stats.drained, b.q.stats.rewinds, b.q.stats.timeouts,
+           b.q.stats.marks, elapsed_s > 0 ? b.q.stats.acked / elapsed_s : 0.0, ceiling);
+
+    int fail = !b.done || b.q.stats.acked != n || b.delivered < n;
+    dxlr02_queue_close(&b.q);
+    dxlr02_storage_file_close(&c.file);
+    sim_free();
+    return fail ? -1 : 0;
+}
+
+int main(int argc, char ** argv){
+    static const uint32_t fills[] = { 100, 1000, 5000 };
+    static const double losses[] = { 0.0, 0.1, 0.2 };
+    int fails = 0;
+
+    if(argc > 1 && strcmp(argv[1], "--quick") == 0){
+        fails += bench_flash(200) != 0;
+        fails += bench_drain(50, 57600, 0.1) != 0;
+        remove(BENCH_FILE);
+        return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    for(size_t i = 0; i < sizeof(fills) / sizeof(fills[0]); i++)
+        fails += bench_flash(fills[i]) != 0;
+    for(size_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++){
+        fails += bench_drain(200, 9600, losses[i]) != 0;
+        fails += bench_drain(200, 57600, losses[i]) != 0;
+    }
+    remove(BENCH_FILE);
+    return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
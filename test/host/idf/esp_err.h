@@ -0,0 +1,7 @@
+#pragma once
+
+// Host: lo minimo de ESP-IDF que usa el componente, implementado sobre el simulador (sim/idf.c)
+typedef int esp_err_t;
+
+#define ESP_OK      0
+#define ESP_FAIL    -1
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Generador del simulador: misma semilla, misma corrida
+uint32_t esp_random(void);
+
+#ifdef __cplusplus
+}
+#endif
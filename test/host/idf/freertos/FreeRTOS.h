@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host: una sola tarea. Los bloqueos avanzan el reloj del simulador hasta el borde de tick, como en el target.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ          100
+#define portTICK_PERIOD_MS          (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFFu)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000u))
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      pdTRUE
+#define pdFAIL                      pdFALSE
+
+// Spinlock de verdad, como en el target: los tests de estres llaman al pool desde varios hilos
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         do { } while(__atomic_exchange_n(&(mux)->owner, 1, __ATOMIC_ACQUIRE))
+#define portEXIT_CRITICAL(mux)          __atomic_store_n(&(mux)->owner, 0, __ATOMIC_RELEASE)
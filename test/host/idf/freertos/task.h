@@ -0,0 +1,26 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sim_task * TaskHandle_t;
+typedef void (*TaskFunction_t)(void * arg);
+
+#define tskNO_AFFINITY  0x7FFFFFFF
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+// Las tareas se registran pero no corren: los tests llaman a las funciones de una vuelta (dxlr02_health_poll)
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stack, void * arg, UBaseType_t prio, TaskHandle_t * handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stack, void * arg, UBaseType_t prio,
+                                   TaskHandle_t * handle, BaseType_t core);
+uint64_t ulTaskGetRunTimeCounter(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host: las opciones de Kconfig llegan como -D desde CMakeLists.txt; el resto toma los defaults del componente
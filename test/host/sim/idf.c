@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_internal.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// API de ESP-IDF / FreeRTOS que usa el componente, sobre el reloj y los modulos del simulador.
+// Toda espera pasa por sim_wait_until: desde una tarea de sim_spawn cede el control a las demas; desde un
+// callback de sim_at o desde el test avanza solo el mundo.
+
+/****************************************** TIEMPO ******************************************/
+
+int64_t esp_timer_get_time(void){
+    return sim_now();
+}
+
+uint32_t esp_random(void){
+    return sim_random();
+}
+
+void vTaskDelay(TickType_t ticks){
+    sim_wait_until(sim_tick_deadline(ticks));
+}
+
+TickType_t xTaskGetTickCount(void){
+    return (TickType_t)(sim_now() / SIM_TICK_US);
+}
+
+/****************************************** TAREAS ******************************************/
+
+struct sim_task {
+    TaskFunction_t fn;
+    void * arg;
+};
+
+static BaseType_t sim_task_create(TaskFunction_t fn, void * arg, TaskHandle_t * handle){
+    struct sim_task * t = calloc(1, sizeof(*t));
+    if(!t)
+        return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    if(handle)
+        *handle = t;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stack, void * arg, UBaseType_t prio, TaskHandle_t * handle){
+    (void)name; (void)stack; (void)prio;
+    return sim_task_create(fn, arg, handle);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stack, void * arg, UBaseType_t prio,
+                                   TaskHandle_t * handle, BaseType_t core){
+    (void)name; (void)stack; (void)prio; (void)core;
+    return sim_task_create(fn, arg, handle);
+}
+
+uint64_t ulTaskGetRunTimeCounter(TaskHandle_t task){
+    (void)task;
+    return 0;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task){
+    (void)task;
+    return 0;
+}
+
+/****************************************** COLAS ******************************************/
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t * storage, StaticQueue_t * queue){
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t ticks_to_wait){
+    (void)ticks_to_wait;
+    if(queue->count == queue->length)
+        return pdFALSE;
+    UBaseType_t k = (queue->head + queue->count++) % queue->length;
+    memcpy(queue->storage + k * queue->item_size, item, queue->item_size);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t ticks_to_wait){
+    if(queue->count == 0){
+        // Nadie mas puede llenarla mientras esperamos
+        sim_wait_until(sim_tick_deadline(ticks_to_wait));
+        return pdFALSE;
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue){
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t * buffer){
+    buffer->taken = 0;
+    buffer->owner = NULL;
+    return buffer;
+}
+
+// Entre tareas de sim_spawn espera de verdad a que lo suelte la otra, tick a tick. Desde el test no hay a quien
+// ceder: lo toma igual. La misma tarea lo puede volver a tomar (en FreeRTOS se trabaria).
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait){
+    void * self = sim_current_task();
+    for(TickType_t waited = 0; self && sem->taken && sem->owner != self; waited++){
+        if(ticks_to_wait != portMAX_DELAY && waited >= ticks_to_wait)
+            return pdFALSE;
+        vTaskDelay(1);
+    }
+    if(sem->taken++ == 0)
+        sem->owner = self;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem){
+    if(sem->taken == 0)
+        return pdFALSE;
+    if(--sem->taken == 0)
+        sem->owner = NULL;
+    return pdTRUE;
+}
+
+/****************************************** UART ******************************************/
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size, void * queue, int intr_flags){
+    (void)rx_buffer_size; (void)tx_buffer_size; (void)queue_size; (void)queue; (void)intr_flags;
+    return sim_port_valid(port) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t * conf){
+    if(!sim_port_valid(port))
+        return ESP_FAIL;
+    sim_uart_set_baud(port, (uint32_t)conf->baud_rate);
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts){
+    (void)tx; (void)rx; (void)rts; (void)cts;
+    return sim_port_valid(port) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baudrate){
+    if(!sim_port_valid(port))
+        return ESP_FAIL;
+    sim_uart_set_baud(port, baudrate);
+    return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t port, const void * src, size_t size){
+    if(!sim_port_valid(port))
+        return -1;
+    sim_uart_write(port, src, size);
+    return (int)size;
+}
+
+int uart_read_bytes(uart_port_t port, void * buf, uint32_t length, TickType_t ticks_to_wait){
+    if(!sim_port_valid(port))
+        return -1;
+
+    // Como el driver de IDF: vuelve con length bytes o al vencer la espera, lo que pase primero
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    while(sim_uart_ready(port) < length && sim_now() < deadline){
+        int64_t next = sim_uart_next_ready(port);
+        int64_t ev = sim_next_world_event();
+        if(ev < next)
+            next = ev;
+        if(next > deadline)
+            next = deadline;
+        sim_wait_event(next);
+    }
+    return (int)sim_uart_take(port, buf, length);
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t * size){
+    if(!sim_port_valid(port))
+        return ESP_FAIL;
+    *size = sim_uart_ready(port);
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port){
+    if(!sim_port_valid(port))
+        return ESP_FAIL;
+    sim_uart_flush(port);
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks_to_wait){
+    if(!sim_port_valid(port))
+        return ESP_FAIL;
+    int64_t done = sim_uart_tx_done(port);
+    int64_t deadline = sim_tick_deadline(ticks_to_wait);
+    sim_wait_until(done < deadline ? done : deadline);
+    return done <= deadline ? ESP_OK : ESP_FAIL;
+}
+
+/****************************************** GPIO ******************************************/
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level){
+    (void)gpio; (void)level;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio){
+    (void)gpio;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode){
+    (void)gpio; (void)mode;
+    return ESP_OK;
+}
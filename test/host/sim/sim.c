@@ -0,0 +1,940 @@
+#include "sim.h"
+#include "sim_internal.h"
+#include "dxlr02.h"
+#include "dxlr02_airtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <ucontext.h>
+
+/****************************************** EVENTOS ******************************************/
+
+typedef enum {
+    SIM_EV_APP = 0,
+    SIM_EV_IDLE,            // silencio en la UART: cierra el paquete en modo datos
+    SIM_EV_RESTART_DONE,
+    SIM_EV_TX_START,
+    SIM_EV_TX_END,
+    SIM_EV_RESUME,          // vuelve a una tarea de sim_spawn (arg: generacion de la espera)
+} sim_ev_type_t;
+
+typedef struct {
+    int64_t t;
+    uint64_t seq;
+    sim_ev_type_t type;
+    int node;
+    uint32_t arg;
+    sim_app_fn_t fn;
+    void * ctx;
+} sim_event_t;
+
+typedef struct {
+    sim_event_t * v;
+    size_t n;
+    size_t cap;
+} sim_heap_t;
+
+static bool sim_ev_before(const sim_event_t * a, const sim_event_t * b){
+    return a->t != b->t ? a->t < b->t : a->seq < b->seq;
+}
+
+static void sim_heap_push(sim_heap_t * h, sim_event_t ev){
+    if(h->n == h->cap){
+        h->cap = h->cap ? 2 * h->cap : 256;
+        h->v = realloc(h->v, h->cap * sizeof(*h->v));
+        if(!h->v){
+            fprintf(stderr, "sim: sin memoria\n");
+            abort();
+        }
+    }
+    size_t i = h->n++;
+    while(i > 0){
+        size_t p = (i - 1) / 2;
+        if(!sim_ev_before(&ev, &h->v[p]))
+            break;
+        h->v[i] = h->v[p];
+        i = p;
+    }
+    h->v[i] = ev;
+}
+
+static sim_event_t sim_heap_pop(sim_heap_t * h){
+    sim_event_t top = h->v[0];
+    sim_event_t last = h->v[--h->n];
+    size_t i = 0;
+    for(;;){
+        size_t c = 2 * i + 1;
+        if(c >= h->n)
+            break;
+        if(c + 1 < h->n && sim_ev_before(&h->v[c + 1], &h->v[c]))
+            c++;
+        if(!sim_ev_before(&h->v[c], &last))
+            break;
+        h->v[i] = h->v[c];
+        i = c;
+    }
+    if(h->n > 0)
+        h->v[i] = last;
+    return top;
+}
+
+/****************************************** ESTADO ******************************************/
+
+#define SIM_TXQ_LEN     8
+#define SIM_AIR_LEN     1024
+#define SIM_LINE_MAX    128
+
+typedef struct {
+    uint8_t data[SIM_UART_BUF];
+    int64_t ready[SIM_UART_BUF];
+    size_t head;
+    size_t count;
+} sim_fifo_t;
+
+typedef struct {
+    double x, y;
+
+    // Lado host de la UART
+    uint32_t host_baud;
+    int64_t host_tx_free;
+    sim_fifo_t rx;
+
+    // Modulo
+    sim_module_config_t active;
+    sim_module_config_t pending;        // se aplica al reiniciar
+    bool at;
+    bool hung;
+    bool restarting;
+    int64_t off_start;                  // ultimo reinicio: la radio no escucha en [off_start, off_end]
+    int64_t off_end;
+    int64_t out_free;
+    char line[SIM_LINE_MAX];
+    size_t line_len;
+    uint8_t chunk[SIM_MAX_PACKET + 8];
+    size_t chunk_len;
+    int64_t chunk_last;
+    uint32_t idle_gen;
+
+    // Radio
+    sim_packet_t txq[SIM_TXQ_LEN];
+    int64_t txq_ready[SIM_TXQ_LEN];
+    size_t txq_head;
+    size_t txq_count;
+    int64_t radio_free;
+    bool tx_pending;                    // hay un SIM_EV_TX_START agendado
+
+    sim_node_stats_t stats;
+} sim_node_t;
+
+static struct {
+    sim_params_t p;
+    int64_t now;
+    uint64_t seq;
+    uint64_t rng;
+    sim_heap_t world;
+    sim_heap_t apps;
+    struct sim_coro * coros;
+    struct sim_coro * current;          // tarea que esta corriendo (NULL: sim_run o el test)
+    ucontext_t sched;
+    sim_node_t * nodes;
+    int n_nodes;
+    sim_packet_t air[SIM_AIR_LEN];
+    uint32_t air_next;
+    sim_air_hook_t air_hook;
+    void * air_ctx;
+    sim_rx_hook_t rx_hook;
+    void * rx_ctx;
+    uint64_t world_cpu_ns;
+} sim;
+
+static const uint32_t sim_bauds[] = { 0, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 128000 };
+
+static const sim_module_config_t sim_factory = {
+    .mode = 0, .level = 0, .channel = 0, .mac = 0xFFFF, .power_dbm = 22, .cr = 2, .sf = 12,
+    .crc = false, .iq = false, .baud = 4, .stop = 0, .parity = 0, .sleep = 2,
+};
+
+/****************************************** AZAR ******************************************/
+
+static uint64_t sim_splitmix(uint64_t x){
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint32_t sim_random(void){
+    sim.rng ^= sim.rng >> 12;
+    sim.rng ^= sim.rng << 25;
+    sim.rng ^= sim.rng >> 27;
+    return (uint32_t)((sim.rng * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+double sim_uniform(void){
+    uint64_t hi = sim_random(), lo = sim_random();
+    return (double)(((hi << 21) ^ lo) & ((1ull << 53) - 1)) / 9007199254740992.0;
+}
+
+static double sim_box_muller(double u1, double u2){
+    if(u1 < 1e-12)
+        u1 = 1e-12;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+double sim_normal(void){
+    double u1 = sim_uniform();
+    return sim_box_muller(u1, sim_uniform());
+}
+
+static uint32_t sim_between(uint32_t lo, uint32_t hi){
+    return hi > lo ? lo + sim_random() % (hi - lo + 1) : lo;
+}
+
+/****************************************** TIEMPO ******************************************/
+
+int64_t sim_now(void){
+    return sim.now;
+}
+
+int64_t sim_tick_deadline(uint32_t ticks){
+    if(ticks == 0)
+        return sim.now;
+    if(ticks == 0xFFFFFFFFu)
+        return INT64_MAX / 2;
+    // Como FreeRTOS: se despierta en un borde de tick, entre ticks - 1 y ticks periodos desde ahora
+    return (sim.now / SIM_TICK_US + (int64_t)ticks) * SIM_TICK_US;
+}
+
+static void sim_push(sim_heap_t * h, int64_t t, sim_ev_type_t type, int node, uint32_t arg){
+    sim_event_t ev = { .t = t, .seq = sim.seq++, .type = type, .node = node, .arg = arg };
+    sim_heap_push(h, ev);
+}
+
+void sim_at(int64_t t_us, sim_app_fn_t fn, void * ctx){
+    sim_event_t ev = { .t = t_us, .seq = sim.seq++, .type = SIM_EV_APP, .fn = fn, .ctx = ctx };
+    sim_heap_push(&sim.apps, ev);
+}
+
+int64_t sim_next_world_event(void){
+    return sim.world.n ? sim.world.v[0].t : INT64_MAX;
+}
+
+static void sim_world_event_raw(const sim_event_t * ev);
+
+static uint64_t sim_cpu_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// El CPU del mundo se cuenta aparte para que los benchmarks lo descuenten del driver
+static void sim_world_event(const sim_event_t * ev){
+    uint64_t t0 = sim_cpu_ns();
+    sim_world_event_raw(ev);
+    sim.world_cpu_ns += sim_cpu_ns() - t0;
+}
+
+uint64_t sim_world_cpu_ns(void){
+    return sim.world_cpu_ns;
+}
+
+/****************************************** TAREAS ******************************************/
+
+#define SIM_CORO_STACK  (256 * 1024)
+
+typedef struct sim_coro {
+    ucontext_t uc;
+    sim_app_fn_t fn;
+    void * ctx;
+    void * stack;
+    bool done;
+    bool wake_on_world;         // esperando algo del mundo: despierta con el proximo evento
+    uint32_t gen;               // una espera nueva invalida los SIM_EV_RESUME de la anterior
+    struct sim_coro * next;
+} sim_coro_t;
+
+static void sim_coro_entry(void){
+    sim_coro_t * c = sim.current;
+    c->fn(c->ctx);
+    c->done = true;
+    swapcontext(&c->uc, &sim.sched);
+}
+
+static void sim_coro_schedule(sim_coro_t * c, int64_t t_us){
+    sim_event_t ev = { .t = t_us, .seq = sim.seq++, .type = SIM_EV_RESUME, .arg = ++c->gen, .ctx = c };
+    sim_heap_push(&sim.apps, ev);
+}
+
+static void sim_coro_resume(sim_coro_t * c){
+    sim.current = c;
+    swapcontext(&sim.sched, &c->uc);
+    sim.current = NULL;
+}
+
+// Despues de cada evento del mundo: las tareas que esperaban algo de el vuelven a mirar
+static void sim_coro_wake_world(void){
+    for(sim_coro_t * c = sim.coros; c; c = c->next){
+        if(c->wake_on_world && !c->done){
+            c->wake_on_world = false;
+            sim_coro_schedule(c, sim.now);
+        }
+    }
+}
+
+void sim_spawn(int64_t t_us, sim_app_fn_t fn, void * ctx){
+    sim_coro_t * c = calloc(1, sizeof(*c));
+    if(c)
+        c->stack = malloc(SIM_CORO_STACK);
+    if(!c || !c->stack || getcontext(&c->uc) != 0){
+        fprintf(stderr, "sim: no se pudo crear la tarea\n");
+        abort();
+    }
+    c->fn = fn;
+    c->ctx = ctx;
+    c->uc.uc_stack.ss_sp = c->stack;
+    c->uc.uc_stack.ss_size = SIM_CORO_STACK;
+    c->uc.uc_link = NULL;
+    makecontext(&c->uc, sim_coro_entry, 0);
+    c->next = sim.coros;
+    sim.coros = c;
+    sim_coro_schedule(c, t_us);
+}
+
+static void sim_coro_free_all(void){
+    while(sim.coros){
+        sim_coro_t * c = sim.coros;
+        sim.coros = c->next;
+        free(c->stack);
+        free(c);
+    }
+}
+
+void * sim_current_task(void){
+    return sim.current;
+}
+
+static void sim_coro_wait(int64_t t_us, bool world){
+    sim_coro_t * c = sim.current;
+    sim_coro_schedule(c, t_us > sim.now ? t_us : sim.now);
+    c->wake_on_world = world;
+    swapcontext(&c->uc, &sim.sched);
+    c->wake_on_world = false;
+}
+
+void sim_wait_event(int64_t t_us){
+    if(sim.current)
+        sim_coro_wait(t_us, true);
+    else
+        sim_wait_until(t_us);
+}
+
+void sim_wait_until(int64_t t_us){
+    // Desde una tarea: sim_run sigue con el mundo y con las demas aplicaciones hasta t_us
+    if(sim.current){
+        sim_coro_wait(t_us, false);
+        return;
+    }
+
+    while(sim.world.n && sim.world.v[0].t <= t_us){
+        sim_event_t ev = sim_heap_pop(&sim.world);
+        if(ev.t > sim.now)
+            sim.now = ev.t;
+        sim_world_event(&ev);
+        sim_coro_wake_world();
+    }
+    if(t_us > sim.now)
+        sim.now = t_us;
+}
+
+void sim_run(int64_t t_us){
+    for(;;){
+        int64_t tw = sim.world.n ? sim.world.v[0].t : INT64_MAX;
+        int64_t ta = sim.apps.n ? sim.apps.v[0].t : INT64_MAX;
+        if(tw > t_us && ta > t_us)
+            break;
+
+        if(tw <= ta){
+            sim_event_t ev = sim_heap_pop(&sim.world);
+            if(ev.t > sim.now)
+                sim.now = ev.t;
+            sim_world_event(&ev);
+            sim_coro_wake_world();
+        } else {
+            // Si otra aplicacion se quedo bloqueada mas alla de ta, esta corre tarde (un solo core)
+            sim_event_t ev = sim_heap_pop(&sim.apps);
+            if(ev.t > sim.now)
+                sim.now = ev.t;
+            if(ev.type != SIM_EV_RESUME)
+                ev.fn(ev.ctx);
+            else if(ev.arg == ((sim_coro_t *)ev.ctx)->gen)
+                sim_coro_resume(ev.ctx);
+        }
+    }
+    if(t_us > sim.now)
+        sim.now = t_us;
+}
+
+/****************************************** MUNDO ******************************************/
+
+void sim_init(const sim_params_t * params){
+    const sim_params_t def = SIM_PARAMS_DEFAULT();
+    sim_free();
+    memset(&sim, 0, sizeof(sim));
+    sim.p = params ? *params : def;
+    sim.rng = sim_splitmix(sim.p.seed) | 1;
+    sim.nodes = calloc(SIM_MAX_NODES, sizeof(sim_node_t));
+}
+
+void sim_free(void){
+    sim_coro_free_all();
+    free(sim.world.v);
+    free(sim.apps.v);
+    free(sim.nodes);
+    sim.world.v = sim.apps.v = NULL;
+    sim.world.n = sim.apps.n = sim.world.cap = sim.apps.cap = 0;
+    sim.nodes = NULL;
+}
+
+int sim_add_node(double x, double y){
+    if(!sim.nodes || sim.n_nodes >= SIM_MAX_NODES)
+        return -1;
+
+    sim_node_t * n = &sim.nodes[sim.n_nodes];
+    memset(n, 0, sizeof(*n));
+    n->x = x;
+    n->y = y;
+    n->host_baud = 9600;
+    n->active = sim_factory;
+    n->pending = sim_factory;
+    n->off_start = n->off_end = -1;
+    return sim.n_nodes++;
+}
+
+int sim_node_count(void){
+    return sim.n_nodes;
+}
+
+bool sim_port_valid(int port){
+    return sim.nodes && port >= 0 && port < sim.n_nodes;
+}
+
+const sim_module_config_t * sim_module_config(int node){
+    return sim_port_valid(node) ? &sim.nodes[node].active : NULL;
+}
+
+const sim_node_stats_t * sim_node_stats(int node){
+    return sim_port_valid(node) ? &sim.nodes[node].stats : NULL;
+}
+
+bool sim_module_in_at(int node){
+    return sim_port_valid(node) && sim.nodes[node].at;
+}
+
+void sim_set_air_hook(sim_air_hook_t hook, void * ctx){
+    sim.air_hook = hook;
+    sim.air_ctx = ctx;
+}
+
+void sim_set_rx_hook(sim_rx_hook_t hook, void * ctx){
+    sim.rx_hook = hook;
+    sim.rx_ctx = ctx;
+}
+
+uint32_t sim_uart_host_baud(int node){
+    return sim_port_valid(node) ? sim.nodes[node].host_baud : 0;
+}
+
+/****************************************** UART ******************************************/
+
+static uint32_t sim_module_baud(const sim_node_t * n){
+    return sim_bauds[n->active.baud];
+}
+
+static int64_t sim_byte_us(const sim_node_t * n, uint32_t baud){
+    uint32_t bits = 10 + (n->active.parity ? 1 : 0) + (n->active.stop ? 1 : 0);
+    return ((int64_t)bits * 1000000 + baud - 1) / baud;
+}
+
+// Modulo -> host, empezando no antes de t
+static void sim_module_out(sim_node_t * n, const void * data, size_t len, int64_t t){
+    if(n->hung)
+        return;
+
+    const uint8_t * p = data;
+    uint32_t baud = sim_module_baud(n);
+    int64_t byte_us = sim_byte_us(n, baud);
+    for(size_t i = 0; i < len; i++){
+        int64_t start = t > n->out_free ? t : n->out_free;
+        n->out_free = start + byte_us;
+
+        if(n->host_baud != baud){
+            n->stats.uart_garbled++;
+            continue;
+        }
+        if(n->rx.count == SIM_UART_BUF){
+            n->stats.uart_overflow++;
+            continue;
+        }
+        size_t k = (n->rx.head + n->rx.count++) % SIM_UART_BUF;
+        n->rx.data[k] = p[i];
+        n->rx.ready[k] = n->out_free;
+    }
+}
+
+static void sim_module_reply(sim_node_t * n, const char * s, int64_t t){
+    sim_module_out(n, s, strlen(s), t);
+}
+
+size_t sim_uart_ready(int port){
+    sim_node_t * n = &sim.nodes[port];
+    size_t k = 0;
+    while(k < n->rx.count && n->rx.ready[(n->rx.head + k) % SIM_UART_BUF] <= sim.now)
+        k++;
+    return k;
+}
+
+int64_t sim_uart_next_ready(int port){
+    sim_node_t * n = &sim.nodes[port];
+    size_t k = sim_uart_ready(port);
+    return k < n->rx.count ? n->rx.ready[(n->rx.head + k) % SIM_UART_BUF] : INT64_MAX;
+}
+
+size_t sim_uart_take(int port, uint8_t * buf, size_t len){
+    sim_node_t * n = &sim.nodes[port];
+    size_t k = 0;
+    while(k < len && n->rx.count && n->rx.ready[n->rx.head] <= sim.now){
+        buf[k++] = n->rx.data[n->rx.head];
+        n->rx.head = (n->rx.head + 1) % SIM_UART_BUF;
+        n->rx.count--;
+    }
+    return k;
+}
+
+void sim_uart_flush(int port){
+    sim_node_t * n = &sim.nodes[port];
+    // Lo que todavia no llego sigue en camino
+    while(n->rx.count && n->rx.ready[n->rx.head] <= sim.now){
+        n->rx.head = (n->rx.head + 1) % SIM_UART_BUF;
+        n->rx.count--;
+    }
+}
+
+void sim_uart_set_baud(int port, uint32_t baud){
+    sim.nodes[port].host_baud = baud;
+}
+
+int64_t sim_uart_tx_done(int port){
+    return sim.nodes[port].host_tx_free;
+}
+
+/****************************************** MODULO ******************************************/
+
+static void sim_restart(sim_node_t * n, int idx, int64_t t){
+    n->restarting = true;
+    n->at = false;
+    n->line_len = 0;
+    n->chunk_len = 0;
+    n->idle_gen++;
+    n->off_start = t;
+    n->off_end = t + sim_between(sim.p.restart_min_us, sim.p.restart_max_us);
+    n->stats.restarts++;
+    sim_push(&sim.world, n->off_end, SIM_EV_RESTART_DONE, idx, 0);
+}
+
+static int sim_hex(char c){
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static bool sim_parse_dec(const char * s, long * v){
+    if(!*s)
+        return false;
+    char * end;
+    *v = strtol(s, &end, 10);
+    return *end == '\0';
+}
+
+// Una linea completa en modo AT (sin "\r\n")
+static void sim_at_command(sim_node_t * n, int idx, const char * line, int64_t t){
+    int64_t tr = t + sim_between(sim.p.cmd_latency_min_us, sim.p.cmd_latency_max_us);
+    char reply[64];
+    long v;
+
+    n->stats.at_commands++;
+    if(strcmp(line, "+++") == 0){
+        n->stats.toggles++;
+        n->stats.at_commands--;
+        sim_module_reply(n, "Exit AT\r\n", tr);
+        sim_restart(n, idx, n->out_free);
+        return;
+    }
+    if(strcmp(line, "AT") == 0){
+        sim_module_reply(n, "OK\r\n", tr);
+        return;
+    }
+    if(strcmp(line, "AT+RESET") == 0 || strcmp(line, "AT+DEFAULT") == 0){
+        if(line[3] == 'D')
+            n->pending = sim_factory;
+        sim_module_reply(n, "OK\r\n", tr);
+        sim_restart(n, idx, n->out_free);
+        return;
+    }
+
+    sim_module_config_t * c = &n->pending;
+    bool ok = false;
+    reply[0] = '\0';
+    if(strncmp(line, "AT+BAUD", 7) == 0 && sim_parse_dec(line + 7, &v) && v >= 1 && v <= 9){
+        c->baud = (uint8_t)v; ok = true;
+    } else if(strncmp(line, "AT+MODE", 7) == 0 && sim_parse_dec(line + 7, &v) && v >= 0 && v <= 2){
+        c->mode = (uint8_t)v; ok = true;
+        snprintf(reply, sizeof(reply), "+MODE=%ld\r\n", v);
+    } else if(strncmp(line, "AT+SLEEP", 8) == 0 && sim_parse_dec(line + 8, &v) && v >= 0 && v <= 2){
+        c->sleep = (uint8_t)v; ok = true;
+    } else if(strncmp(line, "AT+STOP", 7) == 0 && sim_parse_dec(line + 7, &v) && v >= 0 && v <= 1){
+        c->stop = (uint8_t)v; ok = true;
+    } else if(strncmp(line, "AT+PARI", 7) == 0 && sim_parse_dec(line + 7, &v) && v >= 0 && v <= 2){
+        c->parity = (uint8_t)v; ok = true;
+    } else if(strncmp(line, "AT+LEVEL", 8) == 0 && sim_parse_dec(line + 8, &v) && v >= 0 && v <= 7){
+        // Un nivel fija SF = 12 - nivel, BW 125 kHz y CR 4/6 (tabla de la guia del modulo)
+        c->level = (uint8_t)v; c->sf = (uint8_t)(12 - v); c->cr = 2; ok = true;
+    } else if(strncmp(line, "AT+CHANNEL", 10) == 0 && strlen(line) == 12 && sim_hex(line[10]) >= 0 && sim_hex(line[11]) >= 0){
+        v = sim_hex(line[10]) * 16 + sim_hex(line[11]);
+        if(v <= 0x1E){
+            c->channel = (uint8_t)v; ok = true;
+            snprintf(reply, sizeof(reply), "+CHANNEL=%02lX\r\n", v);
+        }
+    } else if(strncmp(line, "AT+MAC", 6) == 0 && strlen(line) == 11 && line[8] == ','){
+        int h0 = sim_hex(line[6]), h1 = sim_hex(line[7]), l0 = sim_hex(line[9]), l1 = sim_hex(line[10]);
+        if(h0 >= 0 && h1 >= 0 && l0 >= 0 && l1 >= 0){
+            c->mac = (uint16_t)((h0 * 16 + h1) << 8 | (l0 * 16 + l1)); ok = true;
+            snprintf(reply, sizeof(reply), "+MAC=%04X\r\n", c->mac);
+        }
+    } else if(strncmp(line, "AT+POWE", 7) == 0 && sim_parse_dec(line + 7, &v) && v >= 0 && v <= 22){
+        c->power_dbm = (uint8_t)v; ok = true;
+        snprintf(reply, sizeof(reply), "+POWE=%ld\r\n", v);
+    } else if(strncmp(line, "AT+CRC", 6) == 0 && sim_parse_dec(line + 6, &v) && v >= 0 && v <= 1){
+        c->crc = v; ok = true;
+    } else if(strncmp(line, "AT+CR", 5) == 0 && sim_parse_dec(line + 5, &v) && v >= 1 && v <= 4){
+        c->cr = (uint8_t)v; ok = true;
+        snprintf(reply, sizeof(reply), "+CR=%ld\r\n", v);
+    } else if(strncmp(line, "AT+SF", 5) == 0 && sim_parse_dec(line + 5, &v) && v >= 5 && v <= 12){
+        c->sf = (uint8_t)v; ok = true;
+        snprintf(reply, sizeof(reply), "+SF=%ld\r\n", v);
+    } else if(strncmp(line, "AT+IQ", 5) == 0 && sim_parse_dec(line + 5, &v) && v >= 0 && v <= 1){
+        c->iq = v; ok = true;
+    }
+
+    if(!ok){
+        n->stats.at_errors++;
+        sim_module_reply(n, "ERROR=1\r\n", tr);
+        return;
+    }
+    strcat(reply, "OK\r\n");
+    sim_module_reply(n, reply, tr);
+}
+
+static void sim_radio_queue(sim_node_t * n, int idx, const uint8_t * data, size_t len, int64_t t);
+
+// Cierra lo acumulado en modo datos: o es el "+++" o es un paquete para el aire
+static void sim_chunk_close(sim_node_t * n, int idx, int64_t t){
+    size_t len = n->chunk_len;
+    n->chunk_len = 0;
+    n->idle_gen++;
+    if(len == 0)
+        return;
+
+    // "+++" pegado al final de datos sin silencio: se toma igual como toggle (supuesto generoso)
+    bool toggle = false;
+    if(len >= 5 && memcmp(n->chunk + len - 5, "+++\r\n", 5) == 0){
+        toggle = true;
+        len -= 5;
+    } else if(len >= 3 && memcmp(n->chunk + len - 3, "+++", 3) == 0){
+        toggle = true;
+        len -= 3;
+    }
+
+    if(len > 0)
+        sim_radio_queue(n, idx, n->chunk, len, t);
+
+    if(toggle){
+        n->stats.toggles++;
+        n->at = true;
+        n->line_len = 0;
+        sim_module_reply(n, "Entry AT\r\n", t + sim_between(sim.p.cmd_latency_min_us, sim.p.cmd_latency_max_us));
+    }
+}
+
+void sim_uart_write(int port, const uint8_t * data, size_t len){
+    sim_node_t * n = &sim.nodes[port];
+    int64_t byte_us = sim_byte_us(n, n->host_baud);
+    uint32_t baud = sim_module_baud(n);
+
+    for(size_t i = 0; i < len; i++){
+        int64_t start = sim.now > n->host_tx_free ? sim.now : n->host_tx_free;
+        int64_t t = start + byte_us;
+        n->host_tx_free = t;
+
+        if(n->hung || (n->restarting && t < n->off_end))
+            continue;
+        if(n->host_baud != baud){
+            n->stats.uart_garbled++;
+            continue;
+        }
+
+        uint8_t c = data[i];
+        if(n->at){
+            if(n->line_len < SIM_LINE_MAX - 1)
+                n->line[n->line_len++] = (char)c;
+            if(c == '\n'){
+                n->line[n->line_len] = '\0';
+                if(n->line_len >= 2 && n->line[n->line_len - 2] == '\r')
+                    n->line[n->line_len - 2] = '\0';
+                else
+                    n->line[n->line_len - 1] = '\0';
+                n->line_len = 0;
+                sim_at_command(n, port, n->line, t);
+            }
+            continue;
+        }
+
+        // Modo datos: un silencio de idle_bytes cierra el paquete anterior
+        if(n->chunk_len > 0 && t - n->chunk_last > (int64_t)sim.p.idle_bytes * byte_us)
+            sim_chunk_close(n, port, n->chunk_last + (int64_t)sim.p.idle_bytes * byte_us);
+
+        n->chunk[n->chunk_len++] = c;
+        n->chunk_last = t;
+        if(n->chunk_len == sizeof(n->chunk))
+            sim_chunk_close(n, port, t);
+    }
+
+    if(!n->at && n->chunk_len > 0)
+        sim_push(&sim.world, n->chunk_last + (int64_t)sim.p.idle_bytes * byte_us, SIM_EV_IDLE, port, ++n->idle_gen);
+}
+
+void sim_module_hang(int node, bool hung){
+    if(sim_port_valid(node))
+        sim.nodes[node].hung = hung;
+}
+
+void sim_module_power_cycle(int node){
+    if(!sim_port_valid(node))
+        return;
+    sim_node_t * n = &sim.nodes[node];
+    n->hung = false;
+    sim_restart(n, node, sim.now);
+}
+
+/****************************************** RADIO ******************************************/
+
+double sim_sensitivity_dbm(uint8_t sf){
+    // BW 125 kHz, del orden de lo que publica Semtech para SX126x
+    static const double sens[13] = { 0, 0, 0, 0, 0, -115.0, -118.0, -123.0, -126.0, -129.0, -132.0, -134.5, -137.0 };
+    return sf >= 5 && sf <= 12 ? sens[sf] : 0.0;
+}
+
+static double sim_snr_min_db(uint8_t sf){
+    // Diferencia minima contra otra senial del mismo SF para decodificar sin captura es capture_db;
+    // contra el ruido alcanza con la sensibilidad
+    (void)sf;
+    return sim.p.capture_db;
+}
+
+// Sombra fija por enlace: no depende del orden de los eventos
+static double sim_shadow(int a, int b){
+    if(a > b){ int t = a; a = b; b = t; }
+    uint64_t h = sim_splitmix((uint64_t)sim.p.seed << 32 ^ (uint64_t)a << 16 ^ (uint64_t)b);
+    double u1 = (double)(h >> 11) / 9007199254740992.0;
+    double u2 = (double)(sim_splitmix(h) >> 11) / 9007199254740992.0;
+    return sim.p.shadowing_db * sim_box_muller(u1, u2);
+}
+
+double sim_link_rssi(int from, int to){
+    if(!sim_port_valid(from) || !sim_port_valid(to))
+        return -1000.0;
+    const sim_node_t * a = &sim.nodes[from];
+    const sim_node_t * b = &sim.nodes[to];
+    double d = hypot(a->x - b->x, a->y - b->y);
+    if(d < 1.0)
+        d = 1.0;
+    double pl = sim.p.path_loss_d0_db + 10.0 * sim.p.path_loss_exp * log10(d) + sim_shadow(from, to);
+    return (double)a->active.power_dbm - pl;
+}
+
+static uint32_t sim_toa_us(const sim_module_config_t * c, size_t len){
+    dxlr02_config_t conf = { .spread_factor = c->sf, .rf_coding_rate = c->cr, .crc = c->crc };
+    return dxlr02_time_on_air_us(&conf, len);
+}
+
+static void sim_radio_kick(sim_node_t * n, int idx){
+    if(n->tx_pending || n->txq_count == 0)
+        return;
+    int64_t ready = n->txq_ready[n->txq_head];
+    int64_t t = ready > n->radio_free ? ready : n->radio_free;
+    if(t < sim.now)
+        t = sim.now;
+    n->tx_pending = true;
+    sim_push(&sim.world, t, SIM_EV_TX_START, idx, 0);
+}
+
+static void sim_radio_queue(sim_node_t * n, int idx, const uint8_t * data, size_t len, int64_t t){
+    sim_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.src = idx;
+    pkt.dest = -1;
+    pkt.channel = n->active.channel;
+
+    // Los prefijos de los modos 1 y 2 los consume el modulo: no viajan
+    if(n->active.mode == 1){
+        if(len <= 3)
+            return;
+        pkt.dest = data[0] << 8 | data[1];
+        pkt.channel = data[2];
+        data += 3;
+        len -= 3;
+    } else if(n->active.mode == 2){
+        if(len <= 1)
+            return;
+        pkt.channel = data[0];
+        data += 1;
+        len -= 1;
+    }
+    if(pkt.channel > 0x1E || len > SIM_MAX_PACKET || n->txq_count == SIM_TXQ_LEN)
+        return;
+
+    pkt.len = len;
+    memcpy(pkt.data, data, len);
+    size_t k = (n->txq_head + n->txq_count++) % SIM_TXQ_LEN;
+    n->txq[k] = pkt;
+    n->txq_ready[k] = t + sim_between(sim.p.tx_latency_min_us, sim.p.tx_latency_max_us);
+    sim_radio_kick(n, idx);
+}
+
+static void sim_tx_start(sim_node_t * n, int idx){
+    n->tx_pending = false;
+    if(n->txq_count == 0)
+        return;
+
+    sim_packet_t pkt = n->txq[n->txq_head];
+    n->txq_head = (n->txq_head + 1) % SIM_TXQ_LEN;
+    n->txq_count--;
+
+    if(n->hung || n->restarting){
+        sim_radio_kick(n, idx);
+        return;
+    }
+
+    pkt.sf = n->active.sf;
+    pkt.iq = n->active.iq;
+    pkt.power_dbm = n->active.power_dbm;
+    pkt.start_us = sim.now;
+    pkt.end_us = sim.now + sim_toa_us(&n->active, pkt.len);
+    n->radio_free = pkt.end_us;
+    n->stats.tx_packets++;
+    n->stats.tx_bytes += pkt.len;
+    n->stats.tx_air_us += (uint64_t)(pkt.end_us - pkt.start_us);
+
+    uint32_t slot = sim.air_next++ % SIM_AIR_LEN;
+    sim.air[slot] = pkt;
+    if(sim.air_hook)
+        sim.air_hook(sim.air_ctx, &sim.air[slot]);
+    sim_push(&sim.world, pkt.end_us, SIM_EV_TX_END, idx, slot);
+    sim_radio_kick(n, idx);
+}
+
+static bool sim_overlaps(const sim_packet_t * a, int64_t start, int64_t end){
+    return a->len > 0 && a->start_us < end && a->end_us > start;
+}
+
+static void sim_receive(const sim_packet_t * pkt, int r){
+    sim_node_t * n = &sim.nodes[r];
+
+    if(n->active.channel != pkt->channel || n->active.sf != pkt->sf || n->active.iq != pkt->iq)
+        return;
+    if(pkt->dest >= 0 && pkt->dest != 0xFFFF && pkt->dest != n->active.mac)
+        return;
+
+    if(n->hung || (n->off_start >= 0 && n->off_start < pkt->end_us && n->off_end > pkt->start_us)){
+        n->stats.rx_deaf++;
+        return;
+    }
+
+    double rssi = sim_link_rssi(pkt->src, r) + sim.p.fading_db * sim_normal();
+    if(rssi < sim_sensitivity_dbm(pkt->sf)){
+        n->stats.rx_weak++;
+        return;
+    }
+
+    uint32_t count = sim.air_next < SIM_AIR_LEN ? sim.air_next : SIM_AIR_LEN;
+    for(uint32_t i = 0; i < count; i++){
+        const sim_packet_t * o = &sim.air[i];
+        if(o == pkt || !sim_overlaps(o, pkt->start_us, pkt->end_us))
+            continue;
+        if(o->src == r){
+            n->stats.rx_half_duplex++;
+            return;
+        }
+        if(o->channel != pkt->channel || o->sf != pkt->sf)
+            continue;
+        double other = sim_link_rssi(o->src, r);
+        if(other < sim.p.noise_floor_dbm)
+            continue;
+        if(rssi - other < sim_snr_min_db(pkt->sf)){
+            n->stats.rx_collision++;
+            return;
+        }
+    }
+
+    if(sim.p.loss > 0 && sim_uniform() < sim.p.loss){
+        n->stats.rx_lost++;
+        return;
+    }
+
+    n->stats.rx_ok++;
+    if(sim.rx_hook)
+        sim.rx_hook(sim.rx_ctx, r, pkt);
+    sim_module_out(n, pkt->data, pkt->len, sim.now + sim_between(sim.p.rx_latency_min_us, sim.p.rx_latency_max_us));
+}
+
+static void sim_tx_end(uint32_t slot){
+    const sim_packet_t * pkt = &sim.air[slot];
+    for(int r = 0; r < sim.n_nodes; r++){
+        if(r != pkt->src)
+            sim_receive(pkt, r);
+    }
+}
+
+static void sim_world_event_raw(const sim_event_t * ev){
+    sim_node_t * n = &sim.nodes[ev->node];
+
+    switch(ev->type){
+        case SIM_EV_IDLE:
+            if(ev->arg == n->idle_gen && !n->at)
+                sim_chunk_close(n, ev->node, sim.now);
+            break;
+
+        case SIM_EV_RESTART_DONE:
+            if(!n->restarting || ev->t != n->off_end)
+                break;
+            n->restarting = false;
+            n->active = n->pending;
+            n->at = false;
+            n->out_free = sim.now;
+            sim_module_reply(n, "Power On\r\n", sim.now);
+            break;
+
+        case SIM_EV_TX_START:
+            sim_tx_start(n, ev->node);
+            break;
+
+        case SIM_EV_TX_END:
+            sim_tx_end(ev->arg);
+            break;
+
+        default:
+            break;
+    }
+}
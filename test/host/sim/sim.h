@@ -0,0 +1,162 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Simulador de eventos discretos para correr el driver en el host.
+//
+//  - Reloj virtual en us. esp_timer_get_time lo lee; las esperas (uart_read_bytes, vTaskDelay, colas) lo
+//    avanzan hasta el borde de tick de FreeRTOS, procesando los eventos del mundo mientras tanto.
+//  - Cada nodo es un modulo DX-LR02 en su propio puerto de UART: modo datos / AT con "+++", reinicio al
+//    salir de AT y con AT+RESET / AT+DEFAULT, configuracion pendiente hasta el reinicio, prefijos de los
+//    modos 1 y 2, paquetizado por silencio en la UART y latencias de procesamiento sorteadas.
+//  - Medio de radio: perdida log-distancia con sombra fija por enlace y desvanecimiento por paquete,
+//    sensibilidad por SF, captura (el mas fuerte sobrevive si le saca capture_db al resto), half-duplex,
+//    canal / SF / IQ tienen que coincidir y perdida aleatoria extra por paquete.
+//  - Las aplicaciones de los nodos corren como callbacks (sim_at); solo se ejecutan desde sim_run, nunca
+//    dentro de una espera de otro nodo. Las que bloquean (como una tarea de FreeRTOS esperando la UART) van
+//    con sim_spawn: corren en su propia pila y mientras esperan sim_run sigue con el resto.
+//
+// Todo sale de una sola semilla: dos corridas con los mismos parametros dan lo mismo.
+
+#define SIM_MAX_NODES       64
+#ifndef SIM_MAX_PACKET
+#define SIM_MAX_PACKET      256         // bytes por paquete en el aire (con el '\0')
+#endif
+#ifndef SIM_UART_BUF
+#define SIM_UART_BUF        1024        // buffer de RX del driver de la UART del host
+#endif
+
+typedef struct {
+    uint32_t seed;
+    double path_loss_d0_db;     // perdida a 1 m
+    double path_loss_exp;
+    double shadowing_db;        // sigma de la sombra, fija por enlace
+    double fading_db;           // sigma por paquete
+    double capture_db;
+    double noise_floor_dbm;     // por debajo no interfiere
+    double loss;                // probabilidad extra de perder cada recepcion (enlaces malos a proposito)
+    uint32_t cmd_latency_min_us;    // comando AT -> respuesta
+    uint32_t cmd_latency_max_us;
+    uint32_t tx_latency_min_us;     // fin del paquete en la UART -> empieza a transmitir
+    uint32_t tx_latency_max_us;
+    uint32_t rx_latency_min_us;     // fin del paquete en el aire -> primer byte en la UART
+    uint32_t rx_latency_max_us;
+    uint32_t restart_min_us;        // "Exit AT" / "OK" -> "Power On"
+    uint32_t restart_max_us;
+    uint32_t idle_bytes;            // silencio en la UART (en tiempos de byte) que cierra un paquete
+} sim_params_t;
+
+#define SIM_PARAMS_DEFAULT() { \
+    .seed = 1, .path_loss_d0_db = 40.0, .path_loss_exp = 3.3, .shadowing_db = 4.0, .fading_db = 1.0, \
+    .capture_db = 6.0, .noise_floor_dbm = -140.0, .loss = 0.0, \
+    .cmd_latency_min_us = 2000, .cmd_latency_max_us = 12000, \
+    .tx_latency_min_us = 1000, .tx_latency_max_us = 6000, \
+    .rx_latency_min_us = 500, .rx_latency_max_us = 3000, \
+    .restart_min_us = 150000, .restart_max_us = 350000, \
+    .idle_bytes = 3 }
+
+// Estado del modulo tal como lo ve la radio
+typedef struct {
+    uint8_t mode;
+    uint8_t level;
+    uint8_t channel;
+    uint16_t mac;
+    uint8_t power_dbm;
+    uint8_t cr;
+    uint8_t sf;
+    bool crc;
+    bool iq;
+    uint8_t baud;               // indice de AT+BAUD
+    uint8_t stop;
+    uint8_t parity;
+    uint8_t sleep;
+} sim_module_config_t;
+
+typedef struct {
+    uint32_t toggles;           // "+++" recibidos
+    uint32_t at_commands;
+    uint32_t at_errors;         // comandos que contestaron ERROR
+    uint32_t restarts;
+    uint32_t uart_garbled;      // bytes perdidos por baud distinto entre host y modulo
+    uint32_t uart_overflow;     // bytes perdidos con el buffer de RX del host lleno
+    uint32_t tx_packets;
+    uint32_t tx_bytes;
+    uint64_t tx_air_us;
+    uint32_t rx_ok;
+    uint32_t rx_collision;
+    uint32_t rx_weak;           // bajo la sensibilidad
+    uint32_t rx_half_duplex;    // el receptor estaba transmitiendo
+    uint32_t rx_deaf;           // reiniciando o colgado
+    uint32_t rx_lost;           // perdida extra de sim_params_t.loss
+} sim_node_stats_t;
+
+// Un paquete en el aire
+typedef struct {
+    int src;
+    uint8_t channel;
+    uint8_t sf;
+    bool iq;
+    int32_t dest;               // -1: sin direccion (modos 0 y 2)
+    int64_t start_us;
+    int64_t end_us;
+    double power_dbm;
+    size_t len;
+    uint8_t data[SIM_MAX_PACKET];
+} sim_packet_t;
+
+typedef void (*sim_air_hook_t)(void * ctx, const sim_packet_t * pkt);
+typedef void (*sim_rx_hook_t)(void * ctx, int node, const sim_packet_t * pkt);
+typedef void (*sim_app_fn_t)(void * ctx);
+
+void sim_init(const sim_params_t * params);      // NULL: SIM_PARAMS_DEFAULT
+void sim_free(void);
+
+// Nodo nuevo en (x, y) metros, con el modulo en fabrica y en modo datos. Devuelve su puerto.
+int sim_add_node(double x, double y);
+int sim_node_count(void);
+
+int64_t sim_now(void);
+// Avanza el mundo (modulos, radio) hasta t sin correr aplicaciones
+void sim_wait_until(int64_t t_us);
+// Agenda una vuelta de aplicacion; sim_run las corre en orden de tiempo
+void sim_at(int64_t t_us, sim_app_fn_t fn, void * ctx);
+// Corre aplicaciones y mundo hasta t
+void sim_run(int64_t t_us);
+// Como sim_at, pero fn corre como tarea: sus esperas (uart_read_bytes, vTaskDelay, ...) ceden el control y
+// vuelve cuando sim_run llega al tiempo pedido. Puede no terminar nunca; sim_free la descarta.
+void sim_spawn(int64_t t_us, sim_app_fn_t fn, void * ctx);
+
+// Distribucion uniforme [0, 1) y normal del generador del simulador
+double sim_uniform(void);
+double sim_normal(void);
+uint32_t sim_random(void);
+
+const sim_module_config_t * sim_module_config(int node);
+const sim_node_stats_t * sim_node_stats(int node);
+bool sim_module_in_at(int node);
+void sim_module_hang(int node, bool hung);          // no contesta, no transmite, no recibe
+void sim_module_power_cycle(int node);              // reinicio espontaneo (vuelve a modo datos)
+double sim_link_rssi(int from, int to);             // dBm medio (sin desvanecimiento)
+double sim_sensitivity_dbm(uint8_t sf);
+
+void sim_set_air_hook(sim_air_hook_t hook, void * ctx);    // cada paquete que sale al aire
+void sim_set_rx_hook(sim_rx_hook_t hook, void * ctx);      // cada recepcion exitosa
+
+// CPU del host gastado procesando el mundo (modulos, radio); los benchmarks lo descuentan
+uint64_t sim_world_cpu_ns(void);
+
+// Baud del host de un puerto (lo que configuro uart_set_baudrate)
+uint32_t sim_uart_host_baud(int node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
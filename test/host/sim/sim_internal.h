@@ -0,0 +1,31 @@
+#ifndef SIM_INTERNAL_H
+#define SIM_INTERNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sim.h"
+
+// Lo que usa idf.c para implementar la UART del host sobre los nodos simulados
+
+#define SIM_TICK_US     10000       // configTICK_RATE_HZ = 100
+
+bool sim_port_valid(int port);
+void sim_uart_write(int port, const uint8_t * data, size_t len);
+size_t sim_uart_ready(int port);                             // bytes que ya llegaron al buffer del host
+int64_t sim_uart_next_ready(int port);                       // cuando llega el proximo que falta (INT64_MAX: nada en camino)
+size_t sim_uart_take(int port, uint8_t * buf, size_t len);   // saca hasta len bytes ya llegados
+void sim_uart_flush(int port);
+void sim_uart_set_baud(int port, uint32_t baud);
+int64_t sim_uart_tx_done(int port);                          // cuando termina de salir lo escrito
+int64_t sim_next_world_event(void);
+// Como sim_wait_until, pero una tarea de sim_spawn despierta tambien con el proximo evento del mundo (algo
+// que llego a la UART mientras esperaba)
+void sim_wait_event(int64_t t_us);
+
+// Tarea de sim_spawn que esta corriendo (NULL desde el test o desde un callback de sim_at)
+void * sim_current_task(void);
+
+// Borde de tick en el que se despierta una espera de ticks desde ahora
+int64_t sim_tick_deadline(uint32_t ticks);
+
+#endif
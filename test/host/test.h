@@ -0,0 +1,34 @@
+#ifndef DXLR02_HOST_TEST_H
+#define DXLR02_HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Lo minimo para los tests de host: cada CHECK que falla se reporta y el test termina con error
+
+static int test_failures;
+
+#define CHECK(cond) do { \
+    if(!(cond)){ \
+        fprintf(stderr, "%s:%d: fallo: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if(_a != _b){ \
+        fprintf(stderr, "%s:%d: fallo: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define RUN(test) do { \
+    int _before = test_failures; \
+    test(); \
+    printf("%-40s %s\n", #test, test_failures == _before ? "ok" : "FALLO"); \
+} while(0)
+
+#define TEST_EXIT() (test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif
@@ -0,0 +1,159 @@
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_airtime.h"
+#include "esp_timer.h"
+
+// Modelo de time-on-air y de canal: valores de referencia, que AT+LEVEL se refleje en la config que usa
+// el modelo y que dxlr02_aloha_delivery_ratio coincida con lo que pasa en el simulador.
+
+static void test_reference_values(void){
+    dxlr02_config_t conf = { .spread_factor = 7, .rf_coding_rate = 1, .crc = true };
+
+    // Calculadora de Semtech: 10 bytes, BW 125 kHz, CR 4/5, CRC, header explicito, preambulo 8
+    uint32_t toa = dxlr02_time_on_air_us(&conf, 10);
+    CHECK(toa >= 41100 && toa <= 41300);
+
+    conf.spread_factor = 12;
+    toa = dxlr02_time_on_air_us(&conf, 10);
+    CHECK(toa >= 991000 && toa <= 991300);
+
+    conf.spread_factor = 4;
+    CHECK_EQ(dxlr02_time_on_air_us(&conf, 10), 0);
+
+    conf = (dxlr02_config_t){ .baudrate = 9600 };
+    CHECK_EQ(dxlr02_uart_time_us(&conf, 96), 100000);
+    CHECK_EQ(dxlr02_channel_freq_khz(0x1E), 475000);
+}
+
+static int64_t last_air_us;
+
+static void record_air(void * ctx, const sim_packet_t * pkt){
+    (void)ctx;
+    last_air_us = pkt->end_us - pkt->start_us;
+}
+
+// El modelo tiene que usar el SF / CR que el modulo realmente aplico
+static void test_level_sets_rate(void){
+    dxlr02_t m;
+    memset(&m, 0, sizeof(m));
+    sim_init(NULL);
+    sim_set_air_hook(record_air, NULL);
+    int port = sim_add_node(0, 0);
+
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    for(uint8_t level = 0; level <= 7; level++){
+        CHECK_EQ(dxlr02_set_level(&m, level), DXLR02_OK);
+        CHECK_EQ(m.config.rate_level, level);
+        CHECK_EQ(m.config.spread_factor, 12 - level);
+        CHECK_EQ(m.config.rf_coding_rate, 2);
+        CHECK_EQ(sim_module_config(port)->sf, m.config.spread_factor);
+
+        last_air_us = 0;
+        CHECK_EQ(dxlr02_send_data(&m, "0123456789", 10), DXLR02_OK);
+        sim_wait_until(sim_now() + 2000000);
+        CHECK_EQ(last_air_us, dxlr02_time_on_air_us(&m.config, 11));
+    }
+
+    // AT+SF despues de AT+LEVEL gana
+    CHECK_EQ(dxlr02_set_spread_factor(&m, 9), DXLR02_OK);
+    CHECK_EQ(m.config.spread_factor, 9);
+    CHECK_EQ(sim_module_config(port)->sf, 9);
+    sim_free();
+}
+
+// ALOHA puro: N nodos mandan a un gateway con llegadas de Poisson. Sin captura, lo entregado tiene que
+// quedar cerca de e^(-2G).
+#define ALOHA_NODES     10
+#define ALOHA_PACKETS   200
+#define ALOHA_PERIOD_MS 2000
+#define ALOHA_PAYLOAD   20
+
+typedef struct {
+    dxlr02_t m;
+    int index;
+    int sent;
+} aloha_node_t;
+
+static dxlr02_t aloha_gw;
+static aloha_node_t aloha_nodes[ALOHA_NODES];
+static uint32_t aloha_received;
+
+static int64_t aloha_interval_us(void){
+    double u = sim_uniform();
+    return (int64_t)(-log(1.0 - u) * ALOHA_PERIOD_MS * 1000.0);
+}
+
+static void aloha_send(void * ctx){
+    aloha_node_t * n = ctx;
+    char msg[ALOHA_PAYLOAD];
+
+    snprintf(msg, sizeof(msg), "%02d:%04d", n->index, n->sent);
+    memset(msg + 7, '-', sizeof(msg) - 7);
+    dxlr02_send_data(&n->m, msg, sizeof(msg));
+    if(++n->sent < ALOHA_PACKETS)
+        sim_at(esp_timer_get_time() + aloha_interval_us(), aloha_send, n);
+}
+
+static void aloha_poll(void * ctx){
+    char buf[512];
+    dxlr02_frame_t frames[16];
+    size_t n = 0;
+
+    dxlr02_receive_batch(&aloha_gw, buf, sizeof(buf), frames, 16, 0, 0, &n);
+    aloha_received += n;
+    sim_at(esp_timer_get_time() + 20000, aloha_poll, ctx);
+}
+
+static void test_aloha_matches_sim(void){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.capture_db = 1000.0;     // el modelo no tiene captura
+    params.fading_db = 0.0;
+    params.seed = 7;
+    sim_init(&params);
+
+    memset(&aloha_gw, 0, sizeof(aloha_gw));
+    int gw = sim_add_node(0, 0);
+    CHECK_EQ(dxlr02_init(&aloha_gw, gw, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_level(&aloha_gw, 5), DXLR02_OK);
+
+    for(int i = 0; i < ALOHA_NODES; i++){
+        double a = 2.0 * M_PI * i / ALOHA_NODES;
+        aloha_node_t * n = &aloha_nodes[i];
+        memset(n, 0, sizeof(*n));
+        n->index = i;
+        int port = sim_add_node(300.0 * cos(a), 300.0 * sin(a));
+        CHECK_EQ(dxlr02_init(&n->m, port, 9600), DXLR02_OK);
+        CHECK_EQ(dxlr02_set_level(&n->m, 5), DXLR02_OK);
+    }
+
+    aloha_received = 0;
+    int64_t t0 = esp_timer_get_time() + 100000;
+    for(int i = 0; i < ALOHA_NODES; i++)
+        sim_at(t0 + aloha_interval_us(), aloha_send, &aloha_nodes[i]);
+    sim_at(t0, aloha_poll, NULL);
+    sim_run(t0 + (int64_t)ALOHA_PACKETS * ALOHA_PERIOD_MS * 1000 * 2);
+
+    uint32_t sent = 0;
+    for(int i = 0; i < ALOHA_NODES; i++)
+        sent += aloha_nodes[i].sent;
+
+    uint32_t toa = dxlr02_time_on_air_us(&aloha_gw.config, ALOHA_PAYLOAD);
+    double expected = dxlr02_aloha_delivery_ratio(ALOHA_NODES, toa, ALOHA_PERIOD_MS);
+    double measured = (double)aloha_received / sent;
+    printf("aloha: %d nodos, toa %u us, G %.3f: modelo %.3f, simulado %.3f (%u/%u)\n", ALOHA_NODES, toa,
+           (double)(ALOHA_NODES - 1) * toa / (ALOHA_PERIOD_MS * 1000.0), expected, measured, aloha_received, sent);
+    CHECK_EQ(sent, ALOHA_NODES * ALOHA_PACKETS);
+    CHECK(fabs(measured - expected) < 0.05);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_reference_values);
+    RUN(test_level_sets_rate);
+    RUN(test_aloha_matches_sim);
+    return TEST_EXIT();
+}
@@ -0,0 +1,290 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_bulk.h"
+#include "dxlr02_fec.h"
+#include "esp_timer.h"
+
+// Transferencia por diferencia de bloques sobre el simulador: reconstruccion con COPY desde la imagen
+// vieja (con el backend de archivo de punta a punta), reenvio de solo lo que marca el bitmap cuando se
+// pierden DATA, un emisor que se reinicia y sigue donde quedo, y bloques del tamanio maximo con el pool
+// por defecto.
+
+#define BULK_BLOCK      128
+#define BULK_POLL_US    5000
+#define BULK_SESSION    0x1234
+#define BULK_OLD_FILE   "test_bulk_old.bin"
+#define BULK_NEW_FILE   "test_bulk_new.bin"
+#define BULK_OUT_FILE   "test_bulk_out.bin"
+
+typedef struct {
+    uint8_t * data;
+    uint32_t size;
+} mem_t;
+
+static dxlr02_status_t mem_read(void * ctx, uint32_t off, void * buf, size_t len){
+    mem_t * m = ctx;
+    if(off > m->size || len > m->size - off)
+        return DXLR02_ERR_STORAGE;
+    memcpy(buf, m->data + off, len);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t mem_begin(void * ctx, uint32_t size){
+    mem_t * m = ctx;
+    free(m->data);
+    m->data = calloc(1, size ? size : 1);
+    m->size = size;
+    return m->data ? DXLR02_OK : DXLR02_ERR_STORAGE;
+}
+
+static dxlr02_status_t mem_write(void * ctx, uint32_t off, const void * buf, size_t len){
+    mem_t * m = ctx;
+    if(off > m->size || len > m->size - off)
+        return DXLR02_ERR_STORAGE;
+    memcpy(m->data + off, buf, len);
+    return DXLR02_OK;
+}
+
+static dxlr02_status_t mem_finish(void * ctx, bool ok){
+    (void)ctx; (void)ok;
+    return DXLR02_OK;
+}
+
+static dxlr02_bulk_image_t mem_image(mem_t * m){
+    dxlr02_bulk_image_t img = { .read = mem_read, .size = m->size, .ctx = m };
+    return img;
+}
+
+// Sin ceros si nonzero (el peor caso de COBS); si no, bytes sin estructura como el codigo de un firmware
+static void fill(uint8_t * p, size_t len, uint32_t seed, bool nonzero){
+    for(size_t i = 0; i < len; i++){
+        seed = seed * 1664525u + 1013904223u;
+        p[i] = (uint8_t)(seed >> 24);
+        if(nonzero && p[i] == 0)
+            p[i] = 1;
+    }
+}
+
+static dxlr02_t tx, rx;
+static dxlr02_bulk_sender_t sender;
+static dxlr02_bulk_receiver_t receiver;
+static uint32_t rx_frames;
+static uint32_t drop_every;         // 0: no se descarta nada
+static uint32_t dropped_data;
+
+static int bulk_setup(void){
+    sim_init(NULL);
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    rx_frames = drop_every = dropped_data = 0;
+    if(dxlr02_init(&tx, sim_add_node(0, 0), 57600) != DXLR02_OK || dxlr02_init(&rx, sim_add_node(100, 0), 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&rx, 7) != DXLR02_OK)
+        return -1;
+    return 0;
+}
+
+static bool bulk_is_data(const char * frame, size_t len){
+    uint8_t raw[DXLR02_POOL_BLOCK_SIZE];
+    size_t n = 0;
+    return dxlr02_cobs_decode((const uint8_t *)frame, len, raw, sizeof(raw), &n) == DXLR02_OK && n > 1 && raw[1] == DXLR02_BULK_DATA;
+}
+
+// Hasta que el emisor termina, o hasta que el receptor tiene stop_at bloques (0: sin corte)
+static void bulk_run(uint16_t stop_at){
+    char buf[1024];
+    dxlr02_frame_t frames[16];
+    int64_t end = esp_timer_get_time() + 600000000LL;
+
+    while(sender.state != DXLR02_BULK_DONE && sender.state != DXLR02_BULK_FAILED && esp_timer_get_time() < end){
+        if(stop_at && receiver.received >= stop_at)
+            return;
+        dxlr02_bulk_sender_poll(&sender);
+        sim_wait_until(esp_timer_get_time() + BULK_POLL_US);
+
+        size_t n = 0;
+        dxlr02_receive_batch(&rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++){
+            // Perdida determinista del lado del receptor: cada drop_every-esima trama no se procesa
+            if(drop_every && ++rx_frames % drop_every == 0){
+                dropped_data += bulk_is_data(frames[k].data, frames[k].len);
+                continue;
+            }
+            dxlr02_bulk_receiver_on_frame(&receiver, frames[k].data, frames[k].len);
+        }
+        n = 0;
+        dxlr02_receive_batch(&tx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_bulk_sender_on_frame(&sender, frames[k].data, frames[k].len);
+    }
+}
+
+static int write_file(const char * path, const uint8_t * data, size_t len){
+    FILE * f = fopen(path, "wb");
+    if(!f)
+        return -1;
+    size_t n = fwrite(data, 1, len, f);
+    fclose(f);
+    return n == len ? 0 : -1;
+}
+
+static bool file_equals(const char * path, const uint8_t * data, size_t len){
+    static uint8_t back[16384];
+    FILE * f = fopen(path, "rb");
+    if(!f)
+        return false;
+    size_t n = fread(back, 1, sizeof(back), f);
+    fclose(f);
+    return n == len && memcmp(back, data, len) == 0;
+}
+
+// Imagen vieja y nueva en archivo, destino en archivo: dos bloques cambiados viajan como DATA, el resto
+// se arma con COPY desde la imagen vieja del receptor
+static void test_copy_with_file_sink(void){
+    static uint8_t old_data[64 * BULK_BLOCK], new_data[64 * BULK_BLOCK];
+    static uint32_t plan[64], work[DXLR02_BULK_DIFF_WORDS(64)];
+    dxlr02_bulk_image_t old_img, new_img, base_img;
+    dxlr02_bulk_sink_t sink;
+    uint32_t copies = 0;
+
+    fill(old_data, sizeof(old_data), 1, false);
+    memcpy(new_data, old_data, sizeof(new_data));
+    fill(new_data + 10 * BULK_BLOCK + 5, 20, 2, false);
+    fill(new_data + 40 * BULK_BLOCK, BULK_BLOCK, 3, false);
+    CHECK_EQ(write_file(BULK_OLD_FILE, old_data, sizeof(old_data)), 0);
+    CHECK_EQ(write_file(BULK_NEW_FILE, new_data, sizeof(new_data)), 0);
+
+    CHECK_EQ(bulk_setup(), 0);
+    CHECK_EQ(dxlr02_bulk_file_image(&old_img, BULK_OLD_FILE), DXLR02_OK);
+    CHECK_EQ(dxlr02_bulk_file_image(&new_img, BULK_NEW_FILE), DXLR02_OK);
+    CHECK_EQ(dxlr02_bulk_file_image(&base_img, BULK_OLD_FILE), DXLR02_OK);
+    CHECK_EQ(dxlr02_bulk_file_sink(&sink, BULK_OUT_FILE), DXLR02_OK);
+
+    CHECK_EQ(dxlr02_bulk_diff(&old_img, &new_img, BULK_BLOCK, plan, work, DXLR02_BULK_DIFF_WORDS(64), &copies), DXLR02_OK);
+    CHECK_EQ(copies, 62);
+    CHECK_EQ(plan[10], DXLR02_BULK_SEND);
+    CHECK_EQ(plan[40], DXLR02_BULK_SEND);
+    CHECK_EQ(plan[11], 11 * BULK_BLOCK);
+
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, &old_img, &new_img, plan, BULK_BLOCK, BULK_SESSION), DXLR02_OK);
+    dxlr02_bulk_receiver_init(&receiver, &rx, &base_img, &sink);
+    bulk_run(0);
+
+    printf("bulk: COPY %u bloques, DATA %u, %u tramas, %u bytes por la UART\n", sender.stats.copy_blocks,
+           sender.stats.data_blocks, sender.stats.frames, sender.stats.bytes);
+    CHECK_EQ(sender.state, DXLR02_BULK_DONE);
+    CHECK_EQ(sender.stats.data_blocks, 2);
+    CHECK_EQ(sender.stats.copy_blocks, 62);
+    CHECK(receiver.has_base);
+    CHECK(receiver.flags & DXLR02_BULK_ACK_DONE);
+
+    dxlr02_bulk_file_sink_close(&sink);
+    dxlr02_bulk_file_image_close(&old_img);
+    dxlr02_bulk_file_image_close(&new_img);
+    dxlr02_bulk_file_image_close(&base_img);
+    CHECK(file_equals(BULK_OUT_FILE, new_data, sizeof(new_data)));
+    remove(BULK_OLD_FILE);
+    remove(BULK_NEW_FILE);
+    remove(BULK_OUT_FILE);
+    sim_free();
+}
+
+// Se pierde una de cada cinco tramas en el receptor: se reenvian exactamente los DATA perdidos
+static void test_bitmap_retransmit(void){
+    static uint8_t data[100 * BULK_BLOCK - 50];
+    static uint32_t plan[100];
+    mem_t img = { data, sizeof(data) }, out = { NULL, 0 };
+    dxlr02_bulk_image_t new_img = mem_image(&img);
+    dxlr02_bulk_sink_t sink = { mem_begin, mem_write, mem_read, mem_finish, &out };
+
+    fill(data, sizeof(data), 4, false);
+    CHECK_EQ(bulk_setup(), 0);
+    drop_every = 5;
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, BULK_BLOCK, BULK_SESSION), DXLR02_OK);
+    dxlr02_bulk_receiver_init(&receiver, &rx, NULL, &sink);
+    bulk_run(0);
+
+    printf("bulk: %u bloques, %u DATA mandados, %u DATA perdidos, %u timeouts\n", sender.n_blocks,
+           sender.stats.data_blocks, dropped_data, sender.stats.timeouts);
+    CHECK_EQ(sender.state, DXLR02_BULK_DONE);
+    CHECK(dropped_data > 0);
+    CHECK_EQ(sender.stats.data_blocks, sender.n_blocks + dropped_data);
+    CHECK(out.size == sizeof(data) && memcmp(out.data, data, sizeof(data)) == 0);
+    free(out.data);
+    sim_free();
+}
+
+// El emisor se reinicia a mitad y repite el START con la misma sesion: el receptor conserva lo que tenia
+// y solo viaja lo que faltaba
+static void test_resume_after_sender_restart(void){
+    static uint8_t data[80 * BULK_BLOCK];
+    static uint32_t plan[80];
+    mem_t img = { data, sizeof(data) }, out = { NULL, 0 };
+    dxlr02_bulk_image_t new_img = mem_image(&img);
+    dxlr02_bulk_sink_t sink = { mem_begin, mem_write, mem_read, mem_finish, &out };
+
+    fill(data, sizeof(data), 5, false);
+    CHECK_EQ(bulk_setup(), 0);
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, BULK_BLOCK, BULK_SESSION), DXLR02_OK);
+    dxlr02_bulk_receiver_init(&receiver, &rx, NULL, &sink);
+    bulk_run(50);
+    CHECK(sender.state != DXLR02_BULK_DONE);
+    uint16_t before = receiver.received;
+
+    // Lo que quedo en el aire del emisor anterior llega igual; el nuevo empieza sin saber nada
+    sim_wait_until(esp_timer_get_time() + 2000000);
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, BULK_BLOCK, BULK_SESSION), DXLR02_OK);
+    bulk_run(0);
+
+    printf("bulk: reinicio con %u de %u bloques, despues %u DATA\n", before, sender.n_blocks, sender.stats.data_blocks);
+    CHECK(before >= 50);
+    CHECK_EQ(sender.state, DXLR02_BULK_DONE);
+    CHECK(sender.stats.data_blocks <= sender.n_blocks - before);
+    CHECK(out.size == sizeof(data) && memcmp(out.data, data, sizeof(data)) == 0);
+
+    // Otra sesion es otra transferencia: vuelve a empezar de cero
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, BULK_BLOCK, BULK_SESSION + 1), DXLR02_OK);
+    bulk_run(0);
+    CHECK_EQ(sender.state, DXLR02_BULK_DONE);
+    CHECK_EQ(sender.stats.data_blocks, sender.n_blocks);
+    free(out.data);
+    sim_free();
+}
+
+// block_size maximo con el pool por defecto y bytes sin ceros: los DATA entran en el ring de RX
+static void test_max_block(void){
+    static uint8_t data[20 * DXLR02_POOL_BLOCK_SIZE];
+    static uint32_t plan[32];
+    uint16_t block = (uint16_t)dxlr02_bulk_max_block();
+    mem_t img = { data, 20u * block + 7 }, out = { NULL, 0 };
+    dxlr02_bulk_image_t new_img = mem_image(&img);
+    dxlr02_bulk_sink_t sink = { mem_begin, mem_write, mem_read, mem_finish, &out };
+
+    fill(data, img.size, 6, true);
+    CHECK_EQ(bulk_setup(), 0);
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, block + 1, BULK_SESSION), DXLR02_ERR_INVALID_PARAMETER);
+    CHECK_EQ(dxlr02_bulk_sender_init(&sender, &tx, NULL, &new_img, plan, block, BULK_SESSION), DXLR02_OK);
+    dxlr02_bulk_receiver_init(&receiver, &rx, NULL, &sink);
+    bulk_run(0);
+
+    printf("bulk: bloques de %u con el pool de %d: %u DATA, %u tramas perdidas en el ring\n", block,
+           DXLR02_POOL_BLOCK_SIZE, sender.stats.data_blocks, rx.stats.frames_lost);
+    CHECK_EQ(sender.state, DXLR02_BULK_DONE);
+    CHECK_EQ(sender.stats.data_blocks, sender.n_blocks);
+    CHECK_EQ(rx.stats.frames_lost, 0);
+    CHECK(out.size == img.size && memcmp(out.data, data, img.size) == 0);
+    free(out.data);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_copy_with_file_sink);
+    RUN(test_bitmap_retransmit);
+    RUN(test_resume_after_sender_restart);
+    RUN(test_max_block);
+    return TEST_EXIT();
+}
@@ -0,0 +1,322 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_chan.h"
+#include "dxlr02_health.h"
+#include "dxlr02_airtime.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+// Agilidad de canal sobre el simulador: el envio va al canal del peer (sin toggles por paquete), lo que
+// llega durante un scan vuelve a la lectura y el LBT ve el canal ocupado aunque una tarea de RX se lleve
+// todo lo que entra por la UART. Con el supervisor, el scan no compite con su tarea de RX.
+
+#define CHAN_MSGS   40
+
+static dxlr02_t a;          // el que usa dxlr02_chan
+static dxlr02_t b;          // el peer
+static dxlr02_t c;          // ruido en el canal
+static int a_port, b_port;
+static dxlr02_chan_t ag;
+
+static int node(dxlr02_t * m, double x, uint8_t mode, uint8_t ch){
+    memset(m, 0, sizeof(*m));
+    int port = sim_add_node(x, 0);
+    if(dxlr02_init(m, port, 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_at_set(m, DXLR02_AT_MODE, mode) != DXLR02_OK || dxlr02_at_set(m, DXLR02_AT_CHANNEL, ch) != DXLR02_OK ||
+       dxlr02_at_set(m, DXLR02_AT_SF, 7) != DXLR02_OK || dxlr02_ensure_data_mode(m) != DXLR02_OK)
+        return -1;
+    return port;
+}
+
+// Manda n mensajes por dxlr02_chan_send y cuenta los que le llegan a b
+static uint32_t send_and_count(int n){
+    char buf[1024];
+    dxlr02_frame_t frames[16];
+    char msg[32];
+    uint32_t got = 0;
+
+    for(int i = 0; i < n; i++){
+        snprintf(msg, sizeof(msg), "msg-%03d", i);
+        CHECK_EQ(dxlr02_chan_send(&ag, 0, msg, strlen(msg)), DXLR02_OK);
+        sim_wait_until(esp_timer_get_time() + 200000);
+
+        size_t k = 0;
+        dxlr02_receive_batch(&b, buf, sizeof(buf), frames, 16, 0, 0, &k);
+        got += k;
+    }
+    return got;
+}
+
+// Broadcast: a escucha en 3 y el peer en 5. Antes el canal de TX rotaba entre los habilitados y b solo
+// recibia lo que caia en el suyo.
+static void test_broadcast_follows_peer(void){
+    sim_init(NULL);
+    a_port = node(&a, 0, 2, 3);
+    b_port = node(&b, 100, 2, 5);
+    CHECK(a_port >= 0 && b_port >= 0);
+    CHECK_EQ(dxlr02_chan_init(&ag, &a, (1u << 3) | (1u << 5) | (1u << 7) | (1u << 9), 0), DXLR02_OK);
+    CHECK_EQ(ag.peer, 3);
+    CHECK_EQ(dxlr02_chan_set_peer(&ag, 5), DXLR02_OK);
+
+    uint32_t toggles = sim_node_stats(a_port)->toggles;
+    uint32_t got = send_and_count(CHAN_MSGS);
+    printf("chan: modo 2, %d envios al canal del peer: %u recibidos, %u toggles\n", CHAN_MSGS, got,
+           sim_node_stats(a_port)->toggles - toggles);
+    CHECK_EQ(got, CHAN_MSGS);
+    CHECK_EQ(sim_node_stats(a_port)->toggles - toggles, 0);
+    CHECK_EQ(ag.stats.sent[5], CHAN_MSGS);
+    sim_free();
+}
+
+// Transparente: el canal de TX es el de RX. Con el peer fijo no hay resintonias; cambiarlo cuesta una.
+static void test_transparent_retunes_once(void){
+    sim_init(NULL);
+    a_port = node(&a, 0, 0, 3);
+    b_port = node(&b, 100, 0, 3);
+    CHECK(a_port >= 0 && b_port >= 0);
+    CHECK_EQ(dxlr02_chan_init(&ag, &a, (1u << 3) | (1u << 5) | (1u << 7) | (1u << 9), 0), DXLR02_OK);
+
+    uint32_t toggles = sim_node_stats(a_port)->toggles;
+    uint32_t restarts = sim_node_stats(a_port)->restarts;
+    uint32_t got = send_and_count(CHAN_MSGS);
+    CHECK_EQ(got, CHAN_MSGS);
+    CHECK_EQ(sim_node_stats(a_port)->toggles - toggles, 0);
+
+    CHECK_EQ(dxlr02_set_channel(&b, 7), DXLR02_OK);
+    CHECK_EQ(dxlr02_chan_set_peer(&ag, 7), DXLR02_OK);
+    got = send_and_count(CHAN_MSGS);
+    printf("chan: modo 0, %d envios + cambio de peer + %d envios: %u toggles, %u reinicios\n", CHAN_MSGS, CHAN_MSGS,
+           sim_node_stats(a_port)->toggles - toggles, sim_node_stats(a_port)->restarts - restarts);
+    CHECK_EQ(got, CHAN_MSGS);
+    CHECK_EQ(sim_node_stats(a_port)->toggles - toggles, 2);
+    CHECK_EQ(sim_node_stats(a_port)->restarts - restarts, 1);
+    CHECK_EQ(ag.stats.switches, 1);
+    CHECK_EQ(a.config.channel, 7);
+    sim_free();
+}
+
+static uint32_t noise_sent;
+static bool noise_on;
+static int64_t noise_period_us;
+
+static void noise(void * ctx){
+    (void)ctx;
+    char msg[16];
+    if(!noise_on)
+        return;
+    snprintf(msg, sizeof(msg), "ruido-%04u", (unsigned)noise_sent++);
+    dxlr02_send_data(&c, msg, strlen(msg));
+    sim_at(esp_timer_get_time() + noise_period_us, noise, NULL);
+}
+
+static bool scan_running;
+static bool scan_done;
+
+static void scan_task(void * ctx){
+    (void)ctx;
+    scan_running = true;
+    CHECK_EQ(dxlr02_chan_scan(&ag, 3000), DXLR02_OK);
+    scan_running = false;
+    scan_done = true;
+}
+
+// c transmite en 5 todo el tiempo; a escucha en 3 y escanea 3, 5 y 7
+static void test_scan_returns_frames(void){
+    sim_init(NULL);
+    a_port = node(&a, 0, 0, 3);
+    CHECK(node(&c, 100, 0, 5) >= 0);
+    CHECK(a_port >= 0);
+    CHECK_EQ(dxlr02_chan_init(&ag, &a, (1u << 3) | (1u << 5) | (1u << 7), 0), DXLR02_OK);
+
+    noise_sent = 0;
+    noise_on = true;
+    noise_period_us = 300000;
+    scan_done = false;
+    int64_t t0 = esp_timer_get_time();
+    sim_at(t0, noise, NULL);
+    sim_spawn(t0, scan_task, NULL);
+    while(!scan_done && esp_timer_get_time() < t0 + 60000000)
+        sim_run(esp_timer_get_time() + 100000);
+    noise_on = false;
+    CHECK(scan_done);
+    CHECK_EQ(a.config.channel, 3);
+
+    // Lo que se conto en el scan se lee despues, en orden
+    char buf[2048];
+    dxlr02_frame_t frames[64];
+    size_t n = 0;
+    dxlr02_receive_batch(&a, buf, sizeof(buf), frames, 64, 0, 0, &n);
+    int last = -1;
+    bool ordered = true;
+    for(size_t i = 0; i < n; i++){
+        int id = -1;
+        ordered &= sscanf(frames[i].data, "ruido-%d", &id) == 1 && id > last;
+        last = id;
+    }
+    printf("chan: scan de 3 canales x 3000 ms: ocupacion %u/%u/%u por mil, %u frames en el scan, %zu devueltos\n",
+           ag.occupancy[3], ag.occupancy[5], ag.occupancy[7], ag.stats.scan_frames, n);
+    CHECK(ag.stats.scan_frames >= 5);
+    CHECK_EQ(ag.stats.scan_dropped, 0);
+    CHECK_EQ(n, ag.stats.scan_frames);
+    CHECK(ordered);
+    CHECK(ag.occupancy[5] > 0);
+    CHECK_EQ(ag.occupancy[3], 0);
+    CHECK_EQ(ag.occupancy[7], 0);
+    CHECK_EQ(dxlr02_chan_pick(&ag), 3);
+    sim_free();
+}
+
+// Tarea de RX como la de dxlr02_health: vacia la UART apenas llega algo
+static uint32_t rx_task_frames;
+static uint32_t rx_task_bad;
+static uint32_t rx_task_overlaps;       // lecturas en medio del scan
+static dxlr02_health_t health;
+
+// Con el lock del supervisor alrededor de cada lectura, como dxlr02_health_rx
+static void locked_rx_task(void * ctx){
+    (void)ctx;
+    char buf[512];
+    dxlr02_frame_t frames[8];
+    for(;;){
+        size_t n = 0;
+        int id;
+        xSemaphoreTake(health.lock, portMAX_DELAY);
+        rx_task_overlaps += scan_running;
+        dxlr02_receive_batch(&a, buf, sizeof(buf), frames, 8, 1, 100, &n);
+        xSemaphoreGive(health.lock);
+        rx_task_frames += n;
+        for(size_t i = 0; i < n; i++)
+            rx_task_bad += sscanf(frames[i].data, "ruido-%d", &id) != 1;
+        vTaskDelay(1);
+    }
+}
+
+static void rx_task(void * ctx){
+    (void)ctx;
+    char buf[512];
+    dxlr02_frame_t frames[8];
+    for(;;){
+        size_t n = 0;
+        dxlr02_receive_batch(&a, buf, sizeof(buf), frames, 8, 1, 1000, &n);
+        rx_task_frames += n;
+    }
+}
+
+typedef struct {
+    int rounds;
+    uint32_t busy;          // dxlr02_chan_lbt
+    uint32_t uart_busy;     // lo que miraba antes: crecimiento del buffer de la UART en la misma ventana
+    bool done;
+} lbt_run_t;
+
+static void lbt_task(void * ctx){
+    lbt_run_t * r = ctx;
+    TickType_t window = pdMS_TO_TICKS((dxlr02_time_on_air_us(&a.config, DXLR02_CHAN_LBT_FRAME_LEN) + 999) / 1000);
+
+    for(int i = 0; i < r->rounds; i++){
+        size_t before = 0, after = 0;
+        uart_get_buffered_data_len((uart_port_t)a.uart_port, &before);
+        vTaskDelay(window);
+        uart_get_buffered_data_len((uart_port_t)a.uart_port, &after);
+        r->uart_busy += after > before;
+
+        r->busy += dxlr02_chan_lbt(&ag) == DXLR02_ERR_CHANNEL_BUSY;
+    }
+    r->done = true;
+}
+
+static void lbt_rounds(lbt_run_t * r, int rounds){
+    memset(r, 0, sizeof(*r));
+    r->rounds = rounds;
+    sim_spawn(esp_timer_get_time(), lbt_task, r);
+    int64_t t0 = esp_timer_get_time();
+    while(!r->done && esp_timer_get_time() < t0 + 60000000)
+        sim_run(esp_timer_get_time() + 100000);
+}
+
+// Con la tarea de RX del supervisor leyendo: el scan toma su lock, asi que la tarea no le saca los frames ni
+// lee en medio de una sesion AT, y despues recibe lo que el scan devolvio
+static void test_scan_with_health_rx(void){
+    sim_init(NULL);
+    a_port = node(&a, 0, 0, 3);
+    CHECK(node(&c, 100, 0, 5) >= 0);
+    CHECK(a_port >= 0);
+    CHECK_EQ(dxlr02_chan_init(&ag, &a, (1u << 3) | (1u << 5) | (1u << 7), 0), DXLR02_OK);
+    CHECK_EQ(dxlr02_health_init(&health, &a, a.uart_port, 57600, NULL, NULL), DXLR02_OK);
+    dxlr02_chan_attach(&ag, &health);
+
+    noise_sent = 0;
+    noise_on = true;
+    noise_period_us = 300000;
+    scan_done = false;
+    rx_task_frames = rx_task_bad = rx_task_overlaps = 0;
+    int64_t t0 = esp_timer_get_time();
+    sim_at(t0, noise, NULL);
+    sim_spawn(t0, locked_rx_task, NULL);
+    sim_spawn(t0, scan_task, NULL);
+    while(!scan_done && esp_timer_get_time() < t0 + 60000000)
+        sim_run(esp_timer_get_time() + 100000);
+    noise_on = false;
+    sim_run(esp_timer_get_time() + 1000000);
+
+    printf("chan: scan con tarea de RX: %u frames en el scan, la tarea leyo %u, %u lecturas en medio del scan\n",
+           ag.stats.scan_frames, rx_task_frames, rx_task_overlaps);
+    CHECK(scan_done);
+    CHECK_EQ(a.config.channel, 3);
+    CHECK(ag.stats.scan_frames >= 5);
+    CHECK(ag.occupancy[5] > 0);
+    CHECK(rx_task_frames >= ag.stats.scan_frames);
+    CHECK_EQ(rx_task_bad, 0);
+    CHECK_EQ(rx_task_overlaps, 0);
+    CHECK_EQ(a.stats.frames_lost, 0);
+    sim_free();
+}
+
+static void test_lbt_with_rx_task(void){
+    sim_init(NULL);
+    a_port = node(&a, 0, 0, 3);
+    CHECK(node(&c, 100, 0, 3) >= 0);
+    CHECK(a_port >= 0);
+    CHECK_EQ(dxlr02_chan_init(&ag, &a, 1u << 3, 1), DXLR02_OK);
+
+    // c manda un frame mas corto que la ventana del LBT apenas termina el anterior
+    noise_sent = 0;
+    noise_on = true;
+    noise_period_us = dxlr02_time_on_air_us(&c.config, 12) + 2000;
+    rx_task_frames = 0;
+    sim_at(esp_timer_get_time(), noise, NULL);
+    sim_spawn(esp_timer_get_time(), rx_task, NULL);
+
+    lbt_run_t busy;
+    lbt_rounds(&busy, 20);
+    noise_on = false;
+    sim_run(esp_timer_get_time() + 1000000);
+
+    lbt_run_t quiet;
+    lbt_rounds(&quiet, 20);
+
+    printf("chan: LBT con tarea de RX, 20 rondas con ruido: ocupado %u (buffer de la UART: %u), en silencio: %u\n",
+           busy.busy, busy.uart_busy, quiet.busy);
+    CHECK(busy.done && quiet.done);
+    CHECK(rx_task_frames > 0);
+    CHECK(busy.busy >= 15);
+    CHECK(busy.uart_busy < busy.busy);
+    CHECK_EQ(quiet.busy, 0);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_broadcast_follows_peer);
+    RUN(test_transparent_retunes_once);
+    RUN(test_scan_returns_frames);
+    RUN(test_scan_with_health_rx);
+    RUN(test_lbt_with_rx_task);
+    return TEST_EXIT();
+}
@@ -0,0 +1,111 @@
+#include <string.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_fec.h"
+#include "esp_timer.h"
+
+// Tamanios maximos con el pool por defecto (bloques de 256): la trama cruda mas grande que acepta
+// dxlr02_cobs_max_raw, en el peor caso de COBS (sin ningun cero) y con su '\0', entra en un bloque y en el
+// ring de RX, y un shard FEC del payload maximo anunciado llega entero por el simulador.
+
+// Sin ceros: el peor caso de COBS
+static void fill_nonzero(uint8_t * data, size_t len, int seed){
+    for(size_t i = 0; i < len; i++)
+        data[i] = (uint8_t)(1 + (i * 7 + (size_t)seed * 31) % 255);
+}
+
+static void test_max_raw_fits(void){
+    uint8_t raw[DXLR02_POOL_BLOCK_SIZE + 1];
+    uint8_t wire[DXLR02_POOL_BLOCK_SIZE + 8];
+    uint8_t back[DXLR02_POOL_BLOCK_SIZE + 1];
+    size_t max = dxlr02_cobs_max_raw(), n = 0;
+
+    fill_nonzero(raw, sizeof(raw), 0);
+    size_t enc = dxlr02_cobs_encode(raw, max, wire);
+    printf("cobs: bloque de %d, trama cruda maxima %zu, codificada %zu + '\\0'\n", DXLR02_POOL_BLOCK_SIZE, max, enc);
+    CHECK(enc + 1 <= DXLR02_POOL_BLOCK_SIZE);
+    CHECK(enc + 1 <= DXLR02_RX_RING_LEN);
+    CHECK_EQ(dxlr02_cobs_decode(wire, enc, back, sizeof(back), &n), DXLR02_OK);
+    CHECK_EQ(n, max);
+    CHECK(memcmp(raw, back, max) == 0);
+
+    // Un byte mas ya no entra: la cota es justa
+    CHECK(dxlr02_cobs_encode(raw, max + 1, wire) + 1 > DXLR02_POOL_BLOCK_SIZE);
+}
+
+typedef struct {
+    size_t count;
+    size_t lens[4];
+    char data[4][DXLR02_POOL_BLOCK_SIZE];
+} delivered_t;
+
+static void deliver(void * ctx, const char * data, size_t len){
+    delivered_t * d = ctx;
+    if(d->count < 4 && len <= sizeof(d->data[0])){
+        memcpy(d->data[d->count], data, len);
+        d->lens[d->count] = len;
+    }
+    d->count++;
+}
+
+// k = 2, m = 1 con el payload maximo: tres tramas del largo maximo; se pierde un dato y la paridad lo arma
+static void test_fec_max_payload(void){
+    static dxlr02_t tx, rx;
+    static delivered_t got;
+    dxlr02_fec_encoder_t enc;
+    dxlr02_fec_decoder_t dec;
+    uint8_t data[2][DXLR02_POOL_BLOCK_SIZE];
+    size_t max = dxlr02_fec_max_payload();
+
+    sim_init(NULL);
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    memset(&got, 0, sizeof(got));
+    CHECK_EQ(dxlr02_init(&tx, sim_add_node(0, 0), 57600), DXLR02_OK);
+    CHECK_EQ(dxlr02_init(&rx, sim_add_node(100, 0), 57600), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_spread_factor(&tx, 7), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_spread_factor(&rx, 7), DXLR02_OK);
+    CHECK_EQ(dxlr02_fec_encoder_init(&enc, &tx, 2, 1, max), DXLR02_OK);
+    CHECK_EQ(dxlr02_fec_encoder_init(&enc, &tx, 2, 1, max + 1), DXLR02_ERR_INVALID_PARAMETER);
+    CHECK_EQ(dxlr02_fec_encoder_init(&enc, &tx, 2, 1, max), DXLR02_OK);
+
+    char buf[1024];
+    dxlr02_frame_t frames[8];
+    size_t lens[4], n_frames = 0;
+    char kept[4][DXLR02_POOL_BLOCK_SIZE];
+    for(int i = 0; i < 2; i++){
+        fill_nonzero(data[i], max, i + 1);
+        CHECK_EQ(dxlr02_fec_send(&enc, (const char *)data[i], max), DXLR02_OK);
+        sim_wait_until(esp_timer_get_time() + 2000000);
+        size_t n = 0;
+        dxlr02_receive_batch(&rx, buf, sizeof(buf), frames, 8, 0, 0, &n);
+        for(size_t k = 0; k < n && n_frames < 4; k++){
+            memcpy(kept[n_frames], frames[k].data, frames[k].len);
+            lens[n_frames++] = frames[k].len;
+        }
+    }
+
+    printf("fec: payload maximo %zu con bloques de %d: %zu tramas de %zu bytes, %u perdidas en el ring\n", max,
+           DXLR02_POOL_BLOCK_SIZE, n_frames, n_frames ? lens[0] : 0, rx.stats.frames_lost);
+    CHECK_EQ(n_frames, 3);
+    CHECK_EQ(rx.stats.frames_lost, 0);
+
+    dxlr02_fec_decoder_init(&dec, deliver, &got);
+    CHECK_EQ(dxlr02_fec_on_frame(&dec, kept[0], lens[0]), DXLR02_OK);
+    CHECK_EQ(dxlr02_fec_on_frame(&dec, kept[2], lens[2]), DXLR02_OK);
+    dxlr02_fec_decoder_flush(&dec);
+    CHECK_EQ(got.count, 2);
+    CHECK_EQ(dec.stats.recovered, 1);
+    CHECK_EQ(dec.stats.crc_errors, 0);
+    for(int i = 0; i < 2; i++)
+        CHECK(got.lens[i] == max && memcmp(got.data[i], data[i], max) == 0);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_max_raw_fits);
+    RUN(test_fec_max_payload);
+    return TEST_EXIT();
+}
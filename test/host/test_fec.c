@@ -0,0 +1,241 @@
+#include <string.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_fec.h"
+#include "esp_timer.h"
+
+// FEC sobre el simulador, con bloques de pool de 1 KiB: payloads de mas de 255 bytes, que el cierre de un
+// bloque corto no cuente como perdidos los datos que nunca salieron y la entrega con perdida en el aire.
+
+#define FEC_MAX_FRAMES  64
+#define FEC_FRAME_LEN   1200
+
+typedef struct {
+    dxlr02_t tx;
+    dxlr02_t rx;
+    char frames[FEC_MAX_FRAMES][FEC_FRAME_LEN];
+    size_t lens[FEC_MAX_FRAMES];
+    size_t n_frames;
+} link_t;
+
+typedef struct {
+    size_t count;
+    size_t lens[FEC_MAX_FRAMES];
+    char data[FEC_MAX_FRAMES][FEC_FRAME_LEN];
+} delivered_t;
+
+static link_t link;
+static delivered_t got;
+
+static void deliver(void * ctx, const char * data, size_t len){
+    delivered_t * d = ctx;
+    if(d->count < FEC_MAX_FRAMES && len <= FEC_FRAME_LEN){
+        memcpy(d->data[d->count], data, len);
+        d->lens[d->count] = len;
+    }
+    d->count++;
+}
+
+static int link_setup(const sim_params_t * params){
+    sim_init(params);
+    memset(&link, 0, sizeof(link));
+    memset(&got, 0, sizeof(got));
+    int tx_port = sim_add_node(0, 0);
+    int rx_port = sim_add_node(100, 0);
+    if(dxlr02_init(&link.tx, tx_port, 57600) != DXLR02_OK || dxlr02_init(&link.rx, rx_port, 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&link.tx, 7) != DXLR02_OK || dxlr02_set_spread_factor(&link.rx, 7) != DXLR02_OK)
+        return -1;
+    return 0;
+}
+
+// Deja correr el aire y guarda lo que llego, tal cual, para dárselo al decoder en el orden que quiera el test
+static void link_collect(int64_t wait_us){
+    char buf[4096];
+    dxlr02_frame_t frames[16];
+    int64_t end = esp_timer_get_time() + wait_us;
+
+    while(esp_timer_get_time() < end){
+        size_t n = 0;
+        sim_wait_until(esp_timer_get_time() + 50000);
+        dxlr02_receive_batch(&link.rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n && link.n_frames < FEC_MAX_FRAMES; k++){
+            memcpy(link.frames[link.n_frames], frames[k].data, frames[k].len);
+            link.lens[link.n_frames++] = frames[k].len;
+        }
+    }
+}
+
+static void fill(char * data, size_t len, int seed){
+    for(size_t i = 0; i < len; i++)
+        data[i] = (char)((i * 7 + (size_t)seed * 31) & 0xFF);     // con ceros adentro: COBS los saca
+}
+
+// Para mandar sin FEC, donde un '\0' cortaria el frame
+static void fill_text(char * data, size_t len, int seed){
+    for(size_t i = 0; i < len; i++)
+        data[i] = (char)('a' + (i + (size_t)seed) % 26);
+}
+
+static void test_large_payload(void){
+    dxlr02_fec_encoder_t enc;
+    dxlr02_fec_decoder_t dec;
+    char data[512];
+
+    CHECK_EQ(link_setup(NULL), 0);
+    CHECK(dxlr02_fec_max_payload() > 400);
+    CHECK_EQ(dxlr02_fec_encoder_init(&enc, &link.tx, 4, 2, 400), DXLR02_OK);
+
+    for(int i = 0; i < 8; i++){
+        fill(data, 300 + 10 * i, i);
+        CHECK_EQ(dxlr02_fec_send(&enc, data, 300 + 10 * i), DXLR02_OK);
+        link_collect(2000000);         // ~650 ms de aire por paquete: que no se llene la cola del modulo
+    }
+    link_collect(10000000);
+    CHECK_EQ(link.n_frames, 12);
+
+    // Dos bloques de 4 + 2: se pierden dos datos de cada uno y la paridad los reconstruye
+    dxlr02_fec_decoder_init(&dec, deliver, &got);
+    static const size_t skip[] = { 1, 2, 6, 9 };
+    for(size_t f = 0; f < link.n_frames; f++){
+        bool skipped = false;
+        for(size_t s = 0; s < sizeof(skip) / sizeof(skip[0]); s++)
+            skipped |= skip[s] == f;
+        if(!skipped)
+            CHECK_EQ(dxlr02_fec_on_frame(&dec, link.frames[f], link.lens[f]), DXLR02_OK);
+    }
+    dxlr02_fec_decoder_flush(&dec);
+
+    CHECK_EQ(got.count, 8);
+    CHECK_EQ(dec.stats.recovered, 4);
+    CHECK_EQ(dec.stats.lost, 0);
+    CHECK_EQ(dec.stats.crc_errors, 0);
+
+    // Llegan fuera de orden (los reconstruidos despues): se buscan por largo
+    for(int i = 0; i < 8; i++){
+        size_t len = 300 + 10 * i;
+        bool found = false;
+        fill(data, len, i);
+        for(size_t k = 0; k < got.count; k++)
+            found |= got.lens[k] == len && memcmp(got.data[k], data, len) == 0;
+        CHECK(found);
+    }
+    sim_free();
+}
+
+// Bloque corto: 3 datos de k = 8, cerrado con dxlr02_fec_flush. Frames: d0 d1 d2 p0 p1.
+static uint32_t short_block_lost(const size_t * feed, size_t n, uint32_t * recovered){
+    dxlr02_fec_decoder_t dec;
+    memset(&got, 0, sizeof(got));
+    dxlr02_fec_decoder_init(&dec, deliver, &got);
+    for(size_t i = 0; i < n; i++)
+        dxlr02_fec_on_frame(&dec, link.frames[feed[i]], link.lens[feed[i]]);
+    dxlr02_fec_decoder_flush(&dec);
+    *recovered = dec.stats.recovered;
+    return dec.stats.lost;
+}
+
+static void test_flush_counts_sent(void){
+    dxlr02_fec_encoder_t enc;
+    char data[64];
+    uint32_t recovered;
+
+    CHECK_EQ(link_setup(NULL), 0);
+    CHECK_EQ(dxlr02_fec_encoder_init(&enc, &link.tx, 8, 2, 64), DXLR02_OK);
+    for(int i = 0; i < 3; i++){
+        fill(data, 40, i);
+        CHECK_EQ(dxlr02_fec_send(&enc, data, 40), DXLR02_OK);
+        link_collect(100000);
+    }
+    CHECK_EQ(dxlr02_fec_flush(&enc), DXLR02_OK);
+    link_collect(1000000);
+    CHECK_EQ(link.n_frames, 5);
+
+    // Todos los datos, ninguna paridad: los 5 indices que nunca salieron no son perdidas
+    static const size_t all_data[] = { 0, 1, 2 };
+    CHECK_EQ(short_block_lost(all_data, 3, &recovered), 0);
+
+    // Falta d1 y no hay paridad: se sabe que salio porque llego d2
+    static const size_t gap[] = { 0, 2 };
+    CHECK_EQ(short_block_lost(gap, 2, &recovered), 1);
+
+    // Con una paridad (k = 3) se sabe cuantos salieron aunque falte el ultimo dato
+    static const size_t parity_only[] = { 0, 3 };
+    CHECK_EQ(short_block_lost(parity_only, 2, &recovered), 2);
+
+    // Y con k shards se reconstruye
+    static const size_t recover[] = { 0, 2, 4 };
+    CHECK_EQ(short_block_lost(recover, 3, &recovered), 0);
+    CHECK_EQ(recovered, 1);
+    sim_free();
+}
+
+// Entrega con perdida aleatoria en el aire: sin FEC y con k = 4, m = 2
+#define SWEEP_PACKETS   200
+#define SWEEP_PAYLOAD   100
+
+static double sweep_run(double loss, bool fec){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.loss = loss;
+    params.seed = 5;
+    if(link_setup(&params) != 0)
+        return 0.0;
+
+    dxlr02_fec_encoder_t enc;
+    dxlr02_fec_decoder_t dec;
+    char data[SWEEP_PAYLOAD];
+    char buf[4096];
+    dxlr02_frame_t frames[16];
+    size_t delivered = 0;
+
+    dxlr02_fec_encoder_init(&enc, &link.tx, 4, 2, SWEEP_PAYLOAD);
+    dxlr02_fec_decoder_init(&dec, deliver, &got);
+
+    for(int i = 0; i < SWEEP_PACKETS + 1; i++){
+        if(i < SWEEP_PACKETS){
+            fill_text(data, SWEEP_PAYLOAD, i);
+            if(fec)
+                dxlr02_fec_send(&enc, data, SWEEP_PAYLOAD);
+            else
+                dxlr02_send_data(&link.tx, data, SWEEP_PAYLOAD);
+        }
+        sim_wait_until(esp_timer_get_time() + 800000);
+
+        size_t n = 0;
+        dxlr02_receive_batch(&link.rx, buf, sizeof(buf), frames, 16, 0, 0, &n);
+        for(size_t k = 0; k < n; k++){
+            if(fec)
+                dxlr02_fec_on_frame(&dec, frames[k].data, frames[k].len);
+            else
+                delivered++;
+        }
+    }
+    if(fec){
+        dxlr02_fec_decoder_flush(&dec);
+        delivered = got.count;
+    }
+    sim_free();
+    return (double)delivered / SWEEP_PACKETS;
+}
+
+static void test_loss_sweep(void){
+    static const double losses[] = { 0.05, 0.1, 0.2 };
+
+    for(size_t i = 0; i < sizeof(losses) / sizeof(losses[0]); i++){
+        double plain = sweep_run(losses[i], false);
+        double coded = sweep_run(losses[i], true);
+        printf("fec: perdida %.2f: entregados sin fec %.3f, con fec (4+2) %.3f\n", losses[i], plain, coded);
+        CHECK(coded >= plain);
+        if(losses[i] <= 0.1)
+            CHECK(coded >= 0.98);
+    }
+}
+
+int main(void){
+    RUN(test_large_payload);
+    RUN(test_flush_counts_sent);
+    RUN(test_loss_sweep);
+    return TEST_EXIT();
+}
@@ -0,0 +1,215 @@
+#include <string.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_flood.h"
+#include "dxlr02_fec.h"
+#include "esp_timer.h"
+
+// Flooding sobre el simulador: el cache de duplicados contra un LRU de referencia, dxlr02_flood_send
+// respetando el aire de la trama anterior y la repeticion por un nodo intermedio, cortada por el TTL.
+
+#define REF_OPS     100000
+#define REF_KEYS    (3 * DXLR02_FLOOD_CACHE_SIZE)
+
+// Trama flood tal como la entrega dxlr02_receive_batch
+static size_t make_frame(uint16_t origin, uint16_t seq, uint8_t ttl, uint8_t hops, char * out){
+    uint8_t p[DXLR02_FLOOD_HEADER_LEN + 1] = { DXLR02_FLOOD_MAGIC, origin >> 8, origin & 0xFF, seq >> 8, seq & 0xFF, ttl, hops, 0, 0, 'x' };
+    uint16_t crc = dxlr02_crc16(p, 7, 0xFFFF);
+    crc = dxlr02_crc16(p + DXLR02_FLOOD_HEADER_LEN, 1, crc);
+    p[7] = crc >> 8;
+    p[8] = crc & 0xFF;
+    return dxlr02_cobs_encode(p, sizeof(p), (uint8_t *)out);
+}
+
+// LRU de referencia: lista por recencia, la mas nueva al principio
+static uint32_t ref[DXLR02_FLOOD_CACHE_SIZE];
+static size_t ref_n;
+
+static bool ref_access(uint32_t key, uint32_t * evictions){
+    size_t i = 0;
+    while(i < ref_n && ref[i] != key)
+        i++;
+    bool hit = i < ref_n;
+    if(!hit){
+        if(ref_n == DXLR02_FLOOD_CACHE_SIZE){
+            (*evictions)++;
+            i = ref_n - 1;
+        } else {
+            i = ref_n++;
+        }
+    }
+    memmove(ref + 1, ref, i * sizeof(ref[0]));
+    ref[0] = key;
+    return hit;
+}
+
+static void test_cache_matches_reference(void){
+    static dxlr02_flood_t fl;
+    dxlr02_t m;
+    char frame[32];
+    uint32_t mismatches = 0, ref_evictions = 0;
+
+    sim_init(NULL);
+    memset(&m, 0, sizeof(m));
+    CHECK_EQ(dxlr02_flood_init(&fl, &m, 0xFFFF, NULL, NULL), DXLR02_OK);
+    ref_n = 0;
+
+    // TTL 1: se entregan y no se agendan, el test solo mira el cache
+    for(int op = 0; op < REF_OPS; op++){
+        uint32_t k = sim_random() % REF_KEYS;
+        uint16_t origin = (uint16_t)(k % 7), seq = (uint16_t)(k / 7);
+        uint32_t dups = fl.stats.duplicates;
+        size_t len = make_frame(origin, seq, 1, (uint8_t)(sim_random() % 4), frame);
+        CHECK_EQ(dxlr02_flood_on_frame(&fl, frame, len), DXLR02_OK);
+
+        bool hit = ref_access((uint32_t)origin << 16 | seq, &ref_evictions);
+        mismatches += hit != (fl.stats.duplicates != dups);
+    }
+
+    printf("flood: cache de %d contra LRU de referencia, %d operaciones: %u diferencias, %u desalojos (referencia %u)\n",
+           DXLR02_FLOOD_CACHE_SIZE, REF_OPS, mismatches, fl.stats.evictions, ref_evictions);
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(fl.stats.evictions, ref_evictions);
+    CHECK_EQ(fl.stats.received + fl.stats.duplicates, REF_OPS);
+    sim_free();
+}
+
+static dxlr02_t nodes[3];
+static dxlr02_flood_t fls[3];
+static uint32_t got[3];
+static size_t got_len[3];
+static int64_t air_start[8], air_end[8];
+static int air_n;
+
+static void on_air(void * ctx, const sim_packet_t * pkt){
+    (void)ctx;
+    if(pkt->src == nodes[0].uart_port && air_n < 8){
+        air_start[air_n] = pkt->start_us;
+        air_end[air_n++] = pkt->end_us;
+    }
+}
+
+static void deliver(void * ctx, uint16_t origin, uint8_t hops, const char * data, size_t len){
+    (void)origin; (void)hops; (void)data;
+    got[(intptr_t)ctx]++;
+    got_len[(intptr_t)ctx] = len;
+}
+
+static int flood_setup(int n, const double * xs){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.shadowing_db = 0.0;
+    sim_init(&params);
+    memset(got, 0, sizeof(got));
+    air_n = 0;
+    for(int i = 0; i < n; i++){
+        memset(&nodes[i], 0, sizeof(nodes[i]));
+        if(dxlr02_init(&nodes[i], sim_add_node(xs[i], 0), 57600) != DXLR02_OK)
+            return -1;
+        if(dxlr02_at_set(&nodes[i], DXLR02_AT_MODE, 2) != DXLR02_OK || dxlr02_at_set(&nodes[i], DXLR02_AT_SF, 7) != DXLR02_OK ||
+           dxlr02_ensure_data_mode(&nodes[i]) != DXLR02_OK)
+            return -1;
+        if(dxlr02_flood_init(&fls[i], &nodes[i], (uint16_t)(i + 1), deliver, (void *)(intptr_t)i) != DXLR02_OK)
+            return -1;
+    }
+    return 0;
+}
+
+static void flood_run(int n, int64_t us){
+    char buf[512];
+    dxlr02_frame_t frames[8];
+    int64_t end = esp_timer_get_time() + us;
+
+    while(esp_timer_get_time() < end){
+        sim_wait_until(esp_timer_get_time() + 5000);
+        for(int i = 0; i < n; i++){
+            size_t k = 0;
+            dxlr02_receive_batch(&nodes[i], buf, sizeof(buf), frames, 8, 0, 0, &k);
+            for(size_t f = 0; f < k; f++)
+                dxlr02_flood_on_frame(&fls[i], frames[f].data, frames[f].len);
+            dxlr02_flood_poll(&fls[i]);
+        }
+    }
+}
+
+// Tres envios seguidos: antes salian los tres a la UART juntos y el modulo los paquetizaba como uno
+static void test_send_waits_for_air(void){
+    static const double xs[] = { 0, 300 };
+    CHECK_EQ(flood_setup(2, xs), 0);
+    fls[1].ttl = 1;
+    sim_set_air_hook(on_air, NULL);
+
+    for(int i = 0; i < 3; i++)
+        CHECK_EQ(dxlr02_flood_send(&fls[0], "hola", 4), DXLR02_OK);
+    CHECK_EQ(fls[0].stats.originated, 3);
+    flood_run(2, 3000000);
+
+    CHECK_EQ(air_n, 3);
+    for(int i = 1; i < air_n; i++)
+        CHECK(air_start[i] >= air_end[i - 1]);
+    CHECK_EQ(got[1], 3);
+    CHECK_EQ(fls[1].stats.crc_errors, 0);
+
+    // La primera sale enseguida y las siguientes llenan las pendientes; despues no hay donde dejarlo
+    for(int i = 0; i <= DXLR02_FLOOD_PENDING; i++)
+        CHECK_EQ(dxlr02_flood_send(&fls[0], "x", 1), DXLR02_OK);
+    CHECK_EQ(dxlr02_flood_send(&fls[0], "x", 1), DXLR02_ERR_OUT_OF_SPACE);
+    sim_set_air_hook(NULL, NULL);
+    dxlr02_flood_deinit(&fls[0]);
+    sim_free();
+}
+
+// A - B - C en linea, A y C fuera de alcance: C lo recibe por B, salvo que el TTL no alcance
+static void test_line_relay(void){
+    static const double xs[] = { 0, 1000, 2000 };
+    CHECK_EQ(flood_setup(3, xs), 0);
+    CHECK(sim_link_rssi(nodes[0].uart_port, nodes[1].uart_port) > sim_sensitivity_dbm(7) + 3.0);
+    CHECK(sim_link_rssi(nodes[0].uart_port, nodes[2].uart_port) < sim_sensitivity_dbm(7) - 3.0);
+
+    CHECK_EQ(dxlr02_flood_send(&fls[0], "lejos", 5), DXLR02_OK);
+    flood_run(3, 3000000);
+    CHECK_EQ(got[1], 1);
+    CHECK_EQ(got[2], 1);
+    CHECK_EQ(fls[1].stats.relayed, 1);
+    CHECK_EQ(got[0], 0);
+
+    fls[0].ttl = 1;
+    CHECK_EQ(dxlr02_flood_send(&fls[0], "corto", 5), DXLR02_OK);
+    flood_run(3, 3000000);
+    CHECK_EQ(got[1], 2);
+    CHECK_EQ(got[2], 1);
+    CHECK_EQ(fls[1].stats.expired, 1);
+    sim_free();
+}
+
+// Payload maximo sin ceros (el peor caso de COBS) con el pool por defecto: llega entero y se repite
+static void test_max_payload(void){
+    static const double xs[] = { 0, 300 };
+    char data[DXLR02_POOL_BLOCK_SIZE];
+    size_t max = dxlr02_flood_max_payload();
+
+    CHECK_EQ(flood_setup(2, xs), 0);
+    for(size_t i = 0; i < max; i++)
+        data[i] = (char)(1 + i % 255);
+    CHECK_EQ(dxlr02_flood_send(&fls[0], data, max + 1), DXLR02_ERR_INVALID_PARAMETER);
+    CHECK_EQ(dxlr02_flood_send(&fls[0], data, max), DXLR02_OK);
+    flood_run(2, 12000000);         // hasta 16 slots de ~500 ms antes de la repeticion
+
+    printf("flood: payload maximo %zu con bloques de %d: %u recibidos, %u perdidos en el ring\n", max,
+           DXLR02_POOL_BLOCK_SIZE, got[1], nodes[1].stats.frames_lost);
+    CHECK_EQ(got[1], 1);
+    CHECK_EQ(got_len[1], max);
+    CHECK_EQ(nodes[1].stats.frames_lost, 0);
+    CHECK_EQ(fls[1].stats.relayed, 1);
+    CHECK_EQ(nodes[0].stats.frames_lost, 0);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_cache_matches_reference);
+    RUN(test_send_waits_for_air);
+    RUN(test_line_relay);
+    RUN(test_max_payload);
+    return TEST_EXIT();
+}
@@ -0,0 +1,204 @@
+#include <string.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_health.h"
+#include "esp_timer.h"
+
+// Supervisor sobre el simulador: el chequeo de vida de un nodo callado no reinicia el modulo, ninguna espera
+// AT pasa de at_deadline_us, un episodio de recuperacion contra un modulo lento no pasa de budget_ms y un
+// modulo colgado se detecta y vuelve a andar.
+
+static dxlr02_t m;
+static dxlr02_t peer;
+static dxlr02_health_t health;
+static int port;
+static int peer_port;
+static uint32_t peer_rx;
+
+static void supervisor(void * ctx){
+    (void)ctx;
+    for(;;)
+        dxlr02_health_poll(&health, DXLR02_HEALTH_POLL_MS);
+}
+
+static void on_rx(void * ctx, const char * data, size_t len){
+    (void)ctx; (void)data; (void)len;
+}
+
+static void peer_poll(void * ctx){
+    char buf[256];
+    dxlr02_frame_t frames[4];
+    size_t n = 0;
+
+    dxlr02_receive_batch(&peer, buf, sizeof(buf), frames, 4, 0, 0, &n);
+    peer_rx += n;
+    sim_at(esp_timer_get_time() + 50000, peer_poll, ctx);
+}
+
+static void send_hello(void * ctx){
+    (void)ctx;
+    CHECK_EQ(dxlr02_health_send(&health, "hola", 4), DXLR02_OK);
+}
+
+static int health_setup(const sim_params_t * params, bool init_module, const dxlr02_health_config_t * conf){
+    sim_init(params);
+    memset(&m, 0, sizeof(m));
+    memset(&peer, 0, sizeof(peer));
+    peer_rx = 0;
+    port = sim_add_node(0, 0);
+    peer_port = sim_add_node(100, 0);
+
+    if(init_module && dxlr02_init(&m, port, 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_init(&peer, peer_port, 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_health_init(&health, &m, port, 57600, NULL, conf) != DXLR02_OK)
+        return -1;
+    dxlr02_health_set_rx(&health, on_rx, NULL);
+    return 0;
+}
+
+// Nodo callado: los chequeos entran a AT y se quedan; el unico reinicio es al salir para mandar
+static void test_idle_check_keeps_module_up(void){
+    dxlr02_health_config_t conf = DXLR02_HEALTH_CONFIG_DEFAULT();
+    conf.check_ms = 5000;
+
+    CHECK_EQ(health_setup(NULL, true, &conf), 0);
+    uint32_t restarts = sim_node_stats(port)->restarts;
+
+    int64_t t0 = esp_timer_get_time();
+    sim_spawn(t0, supervisor, NULL);
+    sim_at(t0, peer_poll, NULL);
+    sim_run(t0 + 120000000LL);
+
+    printf("health: 120 s callado, chequeos cada %u ms: %u chequeos, %u reinicios del modulo\n",
+           conf.check_ms, health.stats.checks, sim_node_stats(port)->restarts - restarts);
+    CHECK(health.stats.checks >= 20);
+    CHECK_EQ(sim_node_stats(port)->restarts - restarts, 0);
+    CHECK_EQ(health.stats.failures, 0);
+    CHECK_EQ(dxlr02_health_get_state(&health), DXLR02_HEALTH_OK);
+    CHECK(sim_module_in_at(port));
+
+    // Mandar sale de AT: un reinicio y el frame llega
+    sim_at(esp_timer_get_time(), send_hello, NULL);
+    sim_run(esp_timer_get_time() + 3000000);
+    CHECK_EQ(sim_node_stats(port)->restarts - restarts, 1);
+    CHECK_EQ(peer_rx, 1);
+    sim_free();
+}
+
+// Modulo que contesta cada respuesta AT justo antes del timeout
+static sim_params_t slow_params(void){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.cmd_latency_min_us = 400000;
+    params.cmd_latency_max_us = 450000;
+    params.restart_min_us = 350000;
+    params.restart_max_us = 430000;
+    return params;
+}
+
+static void test_at_deadline(void){
+    sim_params_t params = slow_params();
+    sim_init(&params);
+    memset(&m, 0, sizeof(m));
+    port = sim_add_node(0, 0);
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+
+    // La configuracion entera son 16 lecturas (~7 s aca): con el deadline a 1,2 s corta en el medio
+    dxlr02_config_t conf = m.config;
+    conf.spread_factor = 9;
+    int64_t t0 = esp_timer_get_time();
+    m.at_deadline_us = t0 + 1200000;
+    CHECK_EQ(dxlr02_set_config(&m, &conf), DXLR02_ERR_TIMEOUT);
+    int64_t elapsed = esp_timer_get_time() - t0;
+    CHECK(elapsed <= 1200000 + 10000);
+
+    // Sin deadline la misma configuracion termina
+    m.at_deadline_us = 0;
+    sim_wait_until(esp_timer_get_time() + 2000000);
+    t0 = esp_timer_get_time();
+    CHECK_EQ(dxlr02_resync(&m), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_config(&m, &conf), DXLR02_OK);
+    printf("health: set_config contra un modulo lento: %lld ms sin deadline, cortado a %lld ms con 1200 ms\n",
+           (long long)(esp_timer_get_time() - t0) / 1000, (long long)elapsed / 1000);
+    sim_free();
+}
+
+// Modulo sin inicializar y lento: solo sirve FACTORY (dos AT+DEFAULT + la configuracion). El episodio tiene que
+// entrar en budget_ms, se complete o no.
+static void test_recovery_bounded(void){
+    static const uint32_t budgets[] = { 5000, 12000, 20000 };
+
+    for(size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++){
+        sim_params_t params = slow_params();
+        dxlr02_health_config_t conf = DXLR02_HEALTH_CONFIG_DEFAULT();
+        dxlr02_config_t desired = { .working_mode = 0, .energy_mode = 2, .baudrate = 57600, .rate_level = 0, .channel = 5,
+                                    .address = 1, .transmit_power = 22, .rf_coding_rate = 2, .spread_factor = 9 };
+        conf.budget_ms = budgets[i];
+
+        sim_init(&params);
+        memset(&m, 0, sizeof(m));
+        port = sim_add_node(0, 0);
+        CHECK_EQ(dxlr02_health_init(&health, &m, port, 57600, &desired, &conf), DXLR02_OK);
+        CHECK_EQ(dxlr02_health_get_state(&health), DXLR02_HEALTH_RECOVERING);
+
+        dxlr02_health_poll(&health, 0);
+        printf("health: recuperacion de fabrica con budget %u ms: %u ms, %s\n", budgets[i], health.stats.last_recovery_ms,
+               health.stats.recoveries ? "ok" : "fallo");
+        CHECK(health.stats.last_recovery_ms <= budgets[i]);
+        CHECK_EQ(m.at_deadline_us, 0);
+        if(budgets[i] >= 20000){
+            CHECK_EQ(health.stats.recoveries, 1);
+            CHECK_EQ(sim_module_config(port)->sf, 9);
+            CHECK_EQ(sim_module_config(port)->channel, 5);
+        }
+        sim_free();
+    }
+}
+
+// Colgado 20 s: se detecta por los chequeos, la recuperacion falla mientras siga colgado y despues vuelve
+static void test_hang_recovers(void){
+    dxlr02_health_config_t conf = DXLR02_HEALTH_CONFIG_DEFAULT();
+    conf.check_ms = 5000;
+    conf.retry_ms = 10000;
+
+    CHECK_EQ(health_setup(NULL, true, &conf), 0);
+    int64_t t0 = esp_timer_get_time();
+    sim_spawn(t0, supervisor, NULL);
+    sim_at(t0, peer_poll, NULL);
+    sim_run(t0 + 10000000);
+
+    sim_module_hang(port, true);
+    int64_t hung_at = esp_timer_get_time();
+    int64_t detected = 0;
+    while(esp_timer_get_time() < hung_at + 20000000){
+        sim_run(esp_timer_get_time() + 100000);
+        if(!detected && dxlr02_health_get_state(&health) >= DXLR02_HEALTH_RECOVERING)
+            detected = esp_timer_get_time();
+    }
+    sim_module_hang(port, false);
+    sim_run(esp_timer_get_time() + 30000000);
+
+    printf("health: colgado detectado en %lld ms, %u recuperaciones fallidas, maximo %u ms por episodio\n",
+           detected ? (long long)(detected - hung_at) / 1000 : -1LL, health.stats.recoveries_failed, health.stats.max_recovery_ms);
+    CHECK(detected != 0);
+    CHECK(health.stats.recoveries_failed >= 1);
+    CHECK_EQ(health.stats.recoveries, 1);
+    CHECK(health.stats.max_recovery_ms <= conf.budget_ms);
+    CHECK_EQ(dxlr02_health_get_state(&health), DXLR02_HEALTH_OK);
+
+    sim_at(esp_timer_get_time(), send_hello, NULL);
+    sim_run(esp_timer_get_time() + 3000000);
+    CHECK_EQ(peer_rx, 1);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_idle_check_keeps_module_up);
+    RUN(test_at_deadline);
+    RUN(test_recovery_bounded);
+    RUN(test_hang_recovers);
+    return TEST_EXIT();
+}
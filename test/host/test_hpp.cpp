@@ -0,0 +1,143 @@
+#include <array>
+#include <cstring>
+#include <cstdio>
+#if __has_include(<span>)
+#include <span>
+#endif
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.hpp"
+#include "esp_timer.h"
+
+// dxlr02.hpp sobre el simulador: los comandos armados en compilacion son los mismos que arma el driver,
+// configure<P>() hace lo mismo que dxlr02_set_config (13 comandos, 2 toggles, misma configuracion en el
+// modulo), at_session corta en el primer error y sale de AT, y el I/O por span no copia.
+
+using link_profile = dxlr02::profile<dxlr02::mode::broadcast, 57600, 0, 0x0A, 0x21, 14, 7, 3, true, false>;
+
+// Lo que se puede chequear sin modulo: en compilacion
+static_assert(dxlr02::detail::equal(link_profile::commands[0].cmd, "AT+BAUD7\r\n"), "BAUD");
+static_assert(dxlr02::detail::equal(link_profile::commands[1].expected, "+MODE=2\r\nOK\r\n"), "MODE");
+static_assert(dxlr02::detail::equal(link_profile::commands[6].cmd, "AT+CHANNEL0A\r\n"), "CHANNEL");
+static_assert(dxlr02::detail::equal(link_profile::commands[7].cmd, "AT+MAC02,21\r\n"), "MAC");
+static_assert(dxlr02::detail::equal(link_profile::commands[10].expected, "+SF=7\r\nOK\r\n"), "SF");
+static_assert(link_profile::config.channel == 0x0A && link_profile::config.spread_factor == 7, "config");
+
+static bool same_config(const sim_module_config_t * a, const sim_module_config_t * b){
+    return a->mode == b->mode && a->level == b->level && a->channel == b->channel && a->mac == b->mac &&
+           a->power_dbm == b->power_dbm && a->cr == b->cr && a->sf == b->sf && a->crc == b->crc && a->iq == b->iq &&
+           a->baud == b->baud && a->stop == b->stop && a->parity == b->parity && a->sleep == b->sleep;
+}
+
+// Cada comando precalculado es byte a byte el que manda dxlr02_at_set: el modulo contesta OK a todos
+static void test_profile_matches_set_config(void){
+    sim_init(nullptr);
+    dxlr02::radio r;
+    dxlr02_t c{};
+    int r_port = sim_add_node(0, 0);
+    int c_port = sim_add_node(10, 0);
+    CHECK_EQ(r.init(static_cast<std::uint8_t>(r_port), 57600), DXLR02_OK);
+    CHECK_EQ(dxlr02_init(&c, static_cast<std::uint8_t>(c_port), 57600), DXLR02_OK);
+
+    sim_node_stats_t r0 = *sim_node_stats(r_port), c0 = *sim_node_stats(c_port);
+    CHECK_EQ(r.configure<link_profile>(), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_config(&c, &link_profile::config), DXLR02_OK);
+    const sim_node_stats_t * r1 = sim_node_stats(r_port), * c1 = sim_node_stats(c_port);
+
+    std::printf("hpp: configure<P>: %u comandos, %u toggles, %u errores; dxlr02_set_config: %u comandos, %u toggles\n",
+                r1->at_commands - r0.at_commands, r1->toggles - r0.toggles, r1->at_errors - r0.at_errors,
+                c1->at_commands - c0.at_commands, c1->toggles - c0.toggles);
+    CHECK_EQ(r1->at_commands - r0.at_commands, DXLR02_AT_COUNT);
+    CHECK_EQ(r1->toggles - r0.toggles, 2);
+    CHECK_EQ(r1->at_errors - r0.at_errors, 0);
+    CHECK_EQ(r1->at_commands - r0.at_commands, c1->at_commands - c0.at_commands);
+    CHECK_EQ(r1->toggles - r0.toggles, c1->toggles - c0.toggles);
+    CHECK(same_config(sim_module_config(r_port), sim_module_config(c_port)));
+    CHECK_EQ(sim_module_config(r_port)->channel, 0x0A);
+    CHECK_EQ(sim_module_config(r_port)->mac, 0x0221);
+    CHECK_EQ(r.config().spread_factor, 7);
+    CHECK_EQ(r.state(), DXLR02_STATE_DATA);
+    sim_free();
+}
+
+// Despues del primer error no sale nada mas al modulo; close() devuelve ese error y deja el modulo en datos
+static void test_session_stops_on_error(void){
+    sim_init(nullptr);
+    dxlr02::radio r;
+    int port = sim_add_node(0, 0);
+    CHECK_EQ(r.init(static_cast<std::uint8_t>(port), 57600), DXLR02_OK);
+
+    std::uint32_t cmds = sim_node_stats(port)->at_commands;
+    dxlr02::status closed;
+    {
+        dxlr02::at_session s(r.handle());
+        CHECK(s);
+        CHECK_EQ((s.set<DXLR02_AT_CHANNEL, 3>()), DXLR02_OK);
+        CHECK_EQ(s.set(DXLR02_AT_SF, 13), DXLR02_ERR_INVALID_PARAMETER);
+        CHECK_EQ((s.set<DXLR02_AT_POWE, 10>()), DXLR02_ERR_INVALID_PARAMETER);
+        CHECK(!s);
+        closed = s.close();
+        CHECK_EQ(s.close(), DXLR02_ERR_INVALID_PARAMETER);
+    }
+    CHECK_EQ(closed, DXLR02_ERR_INVALID_PARAMETER);
+    CHECK_EQ(sim_node_stats(port)->at_commands - cmds, 1);
+    CHECK_EQ(r.state(), DXLR02_STATE_DATA);
+    CHECK(!sim_module_in_at(port));
+    CHECK_EQ(sim_module_config(port)->channel, 3);
+
+    // El destructor tambien sale
+    {
+        dxlr02::at_session s(r.handle());
+        s.set<DXLR02_AT_CHANNEL, 4>();
+    }
+    CHECK(!sim_module_in_at(port));
+    CHECK_EQ(sim_module_config(port)->channel, 4);
+    sim_free();
+}
+
+// send por span (array, std::array, std::span) y receive_batch con los frames apuntando al buffer del llamador
+static void test_span_io(void){
+    sim_init(nullptr);
+    dxlr02::radio tx, rx;
+    CHECK_EQ(tx.init(static_cast<std::uint8_t>(sim_add_node(0, 0)), 57600), DXLR02_OK);
+    CHECK_EQ(rx.init(static_cast<std::uint8_t>(sim_add_node(50, 0)), 57600), DXLR02_OK);
+
+    const char raw[] = { 'h', 'o', 'l', 'a' };
+    std::array<char, 5> arr = { 'c', 'h', 'a', 'u', '!' };
+    CHECK_EQ(tx.send(raw), DXLR02_OK);
+    sim_wait_until(esp_timer_get_time() + 2000000);
+    CHECK_EQ(tx.send(dxlr02::span<const char>(arr)), DXLR02_OK);
+    sim_wait_until(esp_timer_get_time() + 2000000);
+#ifdef __cpp_lib_span
+    std::span<const char> std_span(arr.data(), 3);
+    CHECK_EQ(tx.send(std_span), DXLR02_OK);
+    sim_wait_until(esp_timer_get_time() + 2000000);
+#endif
+
+    char buf[256];
+    std::array<dxlr02_frame_t, 8> frames{};
+    dxlr02::span<dxlr02_frame_t> got;
+    CHECK_EQ(rx.receive_batch(buf, frames, 0, 0, got), DXLR02_OK);
+#ifdef __cpp_lib_span
+    CHECK_EQ(got.size(), 3);
+#else
+    CHECK_EQ(got.size(), 2);
+#endif
+    CHECK(got.data() == frames.data());
+    CHECK(got[0].data == buf);
+    CHECK(got[0].len == 4 && std::memcmp(got[0].data, "hola", 4) == 0);
+    CHECK(got[1].len == 5 && std::memcmp(got[1].data, "chau!", 5) == 0);
+
+    // receive de a uno: sin nada pendiente vence el timeout y el frame queda vacio
+    dxlr02::span<const char> frame(buf, 1);
+    CHECK(rx.receive(buf, frame) != DXLR02_OK);
+    CHECK(frame.empty());
+    sim_free();
+}
+
+int main(void){
+    RUN(test_profile_matches_set_config);
+    RUN(test_session_stops_on_error);
+    RUN(test_span_io);
+    return TEST_EXIT();
+}
@@ -0,0 +1,194 @@
+#include <string.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "esp_timer.h"
+
+// Enlace UART con el modulo: cuantos "+++" cuesta cada operacion, que nada de la resincronizacion salga
+// por aire y que las lecturas respeten su deadline.
+
+static int air_packets;
+
+static void count_air(void * ctx, const sim_packet_t * pkt){
+    (void)ctx;
+    (void)pkt;
+    air_packets++;
+}
+
+static int setup(dxlr02_t * m){
+    sim_init(NULL);
+    sim_set_air_hook(count_air, NULL);
+    air_packets = 0;
+    memset(m, 0, sizeof(*m));
+    return sim_add_node(0, 0);
+}
+
+// Cada "+++" que manda el driver llega al modulo y cada uno es necesario
+static void test_toggle_counts(void){
+    dxlr02_t m;
+    int port = setup(&m);
+
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_get_state(&m), DXLR02_STATE_DATA);
+    CHECK_EQ(m.stats.at_toggles, sim_node_stats(port)->toggles);
+    // probe (entra) + AT+DEFAULT (reinicia solo) + AT+BAUD (entra, sale)
+    CHECK_EQ(m.stats.at_toggles, 3);
+
+    uint32_t before = sim_node_stats(port)->toggles;
+    CHECK_EQ(dxlr02_set_channel(&m, 5), DXLR02_OK);
+    CHECK_EQ(sim_node_stats(port)->toggles - before, 2);
+    CHECK_EQ(sim_module_config(port)->channel, 5);
+
+    before = sim_node_stats(port)->toggles;
+    CHECK_EQ(dxlr02_ensure_at(&m), DXLR02_OK);
+    CHECK_EQ(dxlr02_ensure_at(&m), DXLR02_OK);
+    CHECK_EQ(sim_node_stats(port)->toggles - before, 1);
+    CHECK(sim_module_in_at(port));
+
+    // Desde AT: el probe sale, y despues hay que entrar y volver a salir
+    before = sim_node_stats(port)->toggles;
+    CHECK_EQ(dxlr02_resync(&m), DXLR02_OK);
+    CHECK_EQ(sim_node_stats(port)->toggles - before, 3);
+    CHECK(!sim_module_in_at(port));
+
+    // Desde datos: el probe entra y alcanza con salir
+    before = sim_node_stats(port)->toggles;
+    CHECK_EQ(dxlr02_resync(&m), DXLR02_OK);
+    CHECK_EQ(sim_node_stats(port)->toggles - before, 2);
+
+    CHECK_EQ(m.stats.at_toggles, sim_node_stats(port)->toggles);
+    CHECK_EQ(sim_node_stats(port)->at_errors, 0);
+    CHECK_EQ(air_packets, 0);
+    sim_free();
+}
+
+// El modulo reinicio por su cuenta (queda en modo datos) y el driver cree que sigue en AT
+static void test_probe_after_spontaneous_restart(void){
+    dxlr02_t m;
+    int port = setup(&m);
+
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_ensure_at(&m), DXLR02_OK);
+    sim_module_power_cycle(port);
+    sim_wait_until(sim_now() + 400000);
+    CHECK(!sim_module_in_at(port));
+
+    CHECK_EQ(dxlr02_resync(&m), DXLR02_OK);
+    CHECK_EQ(dxlr02_get_state(&m), DXLR02_STATE_DATA);
+    CHECK(!sim_module_in_at(port));
+    CHECK_EQ(air_packets, 0);
+    sim_free();
+}
+
+// Con el modulo mudo la espera total queda en el timeout de la lectura (mas un tick), no en un
+// multiplo de TIMEOUT_ONE_BYTE_MS
+static void test_read_deadline(void){
+    dxlr02_t m;
+    int port = setup(&m);
+
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    sim_module_hang(port, true);
+
+    int64_t t0 = esp_timer_get_time();
+    CHECK_EQ(dxlr02_ensure_at(&m), DXLR02_ERR_TIMEOUT);
+    int64_t spent = esp_timer_get_time() - t0;
+    CHECK(spent >= DXLR02_AT_TIMEOUT_MS * 1000LL);
+    CHECK(spent <= DXLR02_AT_TIMEOUT_MS * 1000LL + 10000);
+
+    sim_module_hang(port, false);
+    sim_module_power_cycle(port);
+    sim_wait_until(sim_now() + 400000);
+    m.state = DXLR02_STATE_DATA;
+
+    char buf[64];
+    size_t len = 0;
+    t0 = esp_timer_get_time();
+    CHECK_EQ(dxlr02_receive_data(&m, buf, sizeof(buf), &len), DXLR02_ERR_TIMEOUT);
+    spent = esp_timer_get_time() - t0;
+    CHECK(spent <= TIMEOUT_READ_US + 10000);
+    sim_free();
+}
+
+// Un comando AT sin respuesta o con otra deja el estado en UNKNOWN: el siguiente uso hace el probe en lugar
+// de mandar "+++" a ciegas o seguir hablando AT con un modulo que quizas ya no esta ahi
+static void test_at_error_unknown(void){
+    dxlr02_t m;
+    int port = setup(&m);
+
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_ensure_at(&m), DXLR02_OK);
+    sim_module_hang(port, true);
+    CHECK_EQ(dxlr02_at_set(&m, DXLR02_AT_MODE, 1), DXLR02_ERR_TIMEOUT);
+    CHECK_EQ(dxlr02_get_state(&m), DXLR02_STATE_UNKNOWN);
+    CHECK_EQ(m.config.working_mode, 0);
+    sim_module_hang(port, false);
+
+    uint32_t probes = m.stats.probes;
+    CHECK_EQ(dxlr02_at_set(&m, DXLR02_AT_MODE, 1), DXLR02_OK);
+    CHECK_EQ(m.stats.probes, probes + 1);
+    CHECK_EQ(m.config.working_mode, 1);
+
+    // Respuesta distinta de la esperada
+    CHECK_EQ(dxlr02_at_send_encoded(&m, DXLR02_AT_MODE, 2, "AT+MODE2\r\n", "otra cosa\r\n"), DXLR02_ERR_INVALID_RESPONSE);
+    CHECK_EQ(dxlr02_get_state(&m), DXLR02_STATE_UNKNOWN);
+    CHECK_EQ(m.config.working_mode, 1);
+    CHECK_EQ(dxlr02_ensure_data_mode(&m), DXLR02_OK);
+    CHECK_EQ(dxlr02_get_state(&m), DXLR02_STATE_DATA);
+    CHECK(!sim_module_in_at(port));
+    sim_free();
+}
+
+// Frames con '\n' que llegan durante una sesion AT: antes del comando (los vacia rx_drain), mientras se
+// espera la respuesta y uno mas largo que la respuesta. Se recuperan enteros, los '\n' no los cortan.
+static void test_frames_with_newlines_during_at(void){
+    static const char * msgs[] = {
+        "hola\nmundo",
+        "uno\ndos\ntres\n",
+        "linea larga\n..........................................\n..........................................\nfin",
+    };
+    dxlr02_t a, b;
+    int port_a = setup(&a);
+    int port_b = sim_add_node(100, 0);
+    memset(&b, 0, sizeof(b));
+
+    CHECK_EQ(dxlr02_init(&a, port_a, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_init(&b, port_b, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_ensure_data_mode(&a), DXLR02_OK);
+    CHECK_EQ(dxlr02_ensure_at(&b), DXLR02_OK);
+
+    // El primero ya esta en la UART de b cuando sale el comando
+    CHECK_EQ(dxlr02_send_data(&a, msgs[0], strlen(msgs[0])), DXLR02_OK);
+    sim_wait_until(sim_now() + 3000000);
+    CHECK_EQ(dxlr02_at_set(&b, DXLR02_AT_POWE, 22), DXLR02_OK);
+    CHECK_EQ(b.stats.frames_recovered, 1);
+
+    // Los otros llegan mientras b sigue mandando comandos
+    for(int k = 1; k < 3; k++){
+        CHECK_EQ(dxlr02_send_data(&a, msgs[k], strlen(msgs[k])), DXLR02_OK);
+        int64_t end = sim_now() + 10000000;     // SF12: el largo tarda varios segundos en el aire
+        while(sim_now() < end && b.stats.frames_recovered < (uint32_t)k + 1)
+            CHECK_EQ(dxlr02_at_set(&b, DXLR02_AT_POWE, (uint8_t)(20 + k)), DXLR02_OK);
+        CHECK_EQ(b.stats.frames_recovered, (uint32_t)k + 1);
+    }
+    CHECK_EQ(dxlr02_get_state(&b), DXLR02_STATE_AT);
+
+    CHECK_EQ(dxlr02_ensure_data_mode(&b), DXLR02_OK);
+    for(int k = 0; k < 3; k++){
+        char buf[160];
+        size_t len = 0;
+        CHECK_EQ(dxlr02_receive_data(&b, buf, sizeof(buf), &len), DXLR02_OK);
+        CHECK_EQ(len, strlen(msgs[k]));
+        CHECK(memcmp(buf, msgs[k], strlen(msgs[k])) == 0);
+    }
+    CHECK_EQ(b.stats.frames_lost, 0);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_toggle_counts);
+    RUN(test_probe_after_spontaneous_restart);
+    RUN(test_read_deadline);
+    RUN(test_at_error_unknown);
+    RUN(test_frames_with_newlines_during_at);
+    return TEST_EXIT();
+}
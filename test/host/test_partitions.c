@@ -0,0 +1,148 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "test.h"
+
+// partitions.csv del proyecto contra el tamanio de flash de sdkconfig.esp32dev: las particiones no se pisan
+// ni con la tabla, respetan la alineacion de IDF, todo entra en la flash y estan los dos slots OTA y la
+// cola (lora_q) que usa la aplicacion. Los offsets vacios se calculan como gen_esp32part.py.
+
+#define TABLE_END       0x9000          // la tabla va en 0x8000
+#define APP_ALIGN       0x10000
+#define DATA_ALIGN      0x1000
+#define MAX_PARTS       16
+
+typedef struct {
+    char name[17];
+    char type[8];
+    uint32_t offset;
+    uint32_t size;
+} part_t;
+
+static part_t parts[MAX_PARTS];
+static int n_parts;
+static uint32_t flash_size;
+
+static char * trim(char * s){
+    while(isspace((unsigned char)*s))
+        s++;
+    char * end = s + strlen(s);
+    while(end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+// 0x..., decimal, K o M
+static uint32_t parse_size(const char * s){
+    char * end;
+    uint32_t v = (uint32_t)strtoul(s, &end, 0);
+    if(*end == 'K' || *end == 'k')
+        v *= 1024;
+    else if(*end == 'M' || *end == 'm')
+        v *= 1024 * 1024;
+    return v;
+}
+
+static int load_table(const char * path){
+    FILE * f = fopen(path, "r");
+    char line[256];
+    uint32_t next = TABLE_END;
+
+    if(!f)
+        return -1;
+    n_parts = 0;
+    while(fgets(line, sizeof(line), f) && n_parts < MAX_PARTS){
+        char * s = trim(line);
+        if(*s == '\0' || *s == '#')
+            continue;
+
+        char * fields[5] = { 0 };
+        for(int i = 0; i < 5 && s; i++){
+            fields[i] = s;
+            s = strchr(s, ',');
+            if(s)
+                *s++ = '\0';
+        }
+        if(!fields[4])
+            continue;
+
+        part_t * p = &parts[n_parts++];
+        snprintf(p->name, sizeof(p->name), "%s", trim(fields[0]));
+        snprintf(p->type, sizeof(p->type), "%s", trim(fields[1]));
+        uint32_t align = strcmp(p->type, "app") == 0 ? APP_ALIGN : DATA_ALIGN;
+        char * offset = trim(fields[3]);
+        p->offset = *offset ? parse_size(offset) : (next + align - 1) / align * align;
+        p->size = parse_size(trim(fields[4]));
+        next = p->offset + p->size;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int load_flash_size(const char * path){
+    FILE * f = fopen(path, "r");
+    char line[256];
+    unsigned mb;
+
+    if(!f)
+        return -1;
+    flash_size = 0;
+    while(fgets(line, sizeof(line), f))
+        if(sscanf(line, "CONFIG_ESPTOOLPY_FLASHSIZE=\"%uMB\"", &mb) == 1)
+            flash_size = mb * 1024 * 1024;
+    fclose(f);
+    return flash_size ? 0 : -1;
+}
+
+static const part_t * find(const char * name){
+    for(int i = 0; i < n_parts; i++)
+        if(strcmp(parts[i].name, name) == 0)
+            return &parts[i];
+    return NULL;
+}
+
+static void test_fits_in_flash(void){
+    uint32_t prev_end = TABLE_END;
+
+    CHECK_EQ(load_table(PARTITIONS_CSV), 0);
+    CHECK_EQ(load_flash_size(SDKCONFIG), 0);
+    CHECK(n_parts > 0);
+    for(int i = 0; i < n_parts; i++){
+        const part_t * p = &parts[i];
+        uint32_t align = strcmp(p->type, "app") == 0 ? APP_ALIGN : DATA_ALIGN;
+        printf("particion %-9s %-4s 0x%06X - 0x%06X (%u KiB)\n", p->name, p->type, p->offset, p->offset + p->size, p->size / 1024);
+        CHECK(p->size > 0);
+        CHECK_EQ(p->offset % align, 0);
+        CHECK_EQ(p->size % DATA_ALIGN, 0);
+        CHECK(p->offset >= prev_end);
+        prev_end = p->offset + p->size;
+    }
+    printf("flash de %u KiB, libres %d KiB al final\n", flash_size / 1024, ((int)flash_size - (int)prev_end) / 1024);
+    CHECK(prev_end <= flash_size);
+}
+
+static void test_required_partitions(void){
+    const part_t * ota_0 = find("ota_0");
+    const part_t * ota_1 = find("ota_1");
+    const part_t * queue = find("lora_q");
+
+    CHECK(find("otadata") != NULL);
+    CHECK(ota_0 != NULL && ota_1 != NULL);
+    if(ota_0 && ota_1)
+        CHECK_EQ(ota_0->size, ota_1->size);
+
+    // dxlr02_queue_open pide al menos dos sectores
+    CHECK(queue != NULL);
+    if(queue){
+        CHECK(strcmp(queue->type, "data") == 0);
+        CHECK(queue->size >= 2 * DATA_ALIGN);
+    }
+}
+
+int main(void){
+    RUN(test_fits_in_flash);
+    RUN(test_required_partitions);
+    return TEST_EXIT();
+}
@@ -0,0 +1,197 @@
+#include <string.h>
+#include <pthread.h>
+#include "test.h"
+#include "dxlr02_pool.h"
+
+// Pool de bloques: agotamiento, conteo de referencias y estres desde varios hilos (el spinlock del host
+// es real, como portMUX en el target). Un bloque entregado dos veces a la vez pisa el patron del otro.
+
+#define STRESS_THREADS      4
+#define STRESS_ITERATIONS   1000000
+#define STRESS_HOLD         4           // bloques que retiene cada hilo a la vez
+
+static void test_exhaustion(void){
+    dxlr02_buf_t * blocks[DXLR02_POOL_BLOCK_COUNT];
+    dxlr02_buf_t * extra = NULL;
+    dxlr02_pool_stats_t before, stats;
+
+    CHECK_EQ(dxlr02_pool_get_stats(&before), DXLR02_OK);
+    CHECK_EQ(before.in_use, 0);
+
+    for(size_t i = 0; i < DXLR02_POOL_BLOCK_COUNT; i++){
+        CHECK_EQ(dxlr02_pool_acquire(&blocks[i]), DXLR02_OK);
+        CHECK(blocks[i] != NULL);
+        CHECK_EQ(blocks[i]->refs, 1);
+        CHECK_EQ(blocks[i]->len, 0);
+        for(size_t j = 0; j < i; j++)
+            CHECK(blocks[i] != blocks[j]);
+    }
+    CHECK_EQ(dxlr02_pool_acquire(&extra), DXLR02_ERR_OUT_OF_SPACE);
+    CHECK(extra == NULL);
+
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, DXLR02_POOL_BLOCK_COUNT);
+    CHECK_EQ(stats.high_water, DXLR02_POOL_BLOCK_COUNT);
+    CHECK_EQ(stats.failures - before.failures, 1);
+
+    for(size_t i = 0; i < DXLR02_POOL_BLOCK_COUNT; i++)
+        dxlr02_pool_release(blocks[i]);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 0);
+    CHECK_EQ(dxlr02_pool_acquire(NULL), DXLR02_ERR_INVALID_PARAMETER);
+}
+
+// El contador no da la vuelta: en 255 el retain falla y 255 releases devuelven el bloque
+static void test_refcount_overflow(void){
+    dxlr02_buf_t * a = NULL;
+    dxlr02_pool_stats_t stats;
+
+    CHECK_EQ(dxlr02_pool_acquire(&a), DXLR02_OK);
+    for(int i = 1; i < UINT8_MAX; i++)
+        CHECK_EQ(dxlr02_pool_retain(a), DXLR02_OK);
+    CHECK_EQ(a->refs, UINT8_MAX);
+    CHECK_EQ(dxlr02_pool_retain(a), DXLR02_ERR_OUT_OF_SPACE);
+    CHECK_EQ(a->refs, UINT8_MAX);
+
+    for(int i = 1; i < UINT8_MAX; i++)
+        dxlr02_pool_release(a);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 1);
+    dxlr02_pool_release(a);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 0);
+}
+
+static void test_refcount(void){
+    dxlr02_buf_t * a = NULL;
+    dxlr02_pool_stats_t stats;
+
+    CHECK_EQ(dxlr02_pool_acquire(&a), DXLR02_OK);
+    CHECK_EQ(dxlr02_pool_retain(a), DXLR02_OK);
+    CHECK_EQ(dxlr02_pool_retain(a), DXLR02_OK);
+    CHECK_EQ(a->refs, 3);
+
+    dxlr02_pool_release(a);
+    dxlr02_pool_release(a);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 1);
+
+    dxlr02_pool_release(a);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 0);
+
+    // Un release de mas no puede meter el bloque dos veces en la pila de libres
+    dxlr02_pool_release(a);
+    CHECK_EQ(dxlr02_pool_retain(a), DXLR02_ERR_INVALID_PARAMETER);
+    dxlr02_pool_get_stats(&stats);
+    CHECK_EQ(stats.in_use, 0);
+    CHECK_EQ(dxlr02_pool_retain(NULL), DXLR02_ERR_INVALID_PARAMETER);
+
+    dxlr02_buf_t * b = NULL, * c = NULL;
+    CHECK_EQ(dxlr02_pool_acquire(&b), DXLR02_OK);
+    CHECK_EQ(dxlr02_pool_acquire(&c), DXLR02_OK);
+    CHECK(b != c);
+    dxlr02_pool_release(b);
+    dxlr02_pool_release(c);
+}
+
+typedef struct {
+    int id;
+    uint32_t acquired;
+    uint32_t failed;
+    uint32_t corrupted;
+} stress_t;
+
+static void stress_fill(dxlr02_buf_t * buf, uint8_t tag){
+    memset(buf->data, tag, DXLR02_POOL_BLOCK_SIZE);
+    buf->len = tag;
+}
+
+static bool stress_intact(const dxlr02_buf_t * buf, uint8_t tag){
+    if(buf->len != tag)
+        return false;
+    for(size_t i = 0; i < DXLR02_POOL_BLOCK_SIZE; i++){
+        if((uint8_t)buf->data[i] != tag)
+            return false;
+    }
+    return true;
+}
+
+static void * stress_thread(void * arg){
+    stress_t * s = arg;
+    dxlr02_buf_t * held[STRESS_HOLD] = { 0 };
+    uint8_t tags[STRESS_HOLD] = { 0 };
+    uint32_t rng = 0x9E3779B9u * (uint32_t)(s->id + 1);
+
+    for(int it = 0; it < STRESS_ITERATIONS; it++){
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        size_t k = rng % STRESS_HOLD;
+
+        if(held[k]){
+            if(!stress_intact(held[k], tags[k]))
+                s->corrupted++;
+            // A veces se comparte: retain + release de otro "duenio" antes del release final
+            if((rng & 0x100) && dxlr02_pool_retain(held[k]) == DXLR02_OK)
+                dxlr02_pool_release(held[k]);
+            dxlr02_pool_release(held[k]);
+            held[k] = NULL;
+        } else if(dxlr02_pool_acquire(&held[k]) == DXLR02_OK){
+            tags[k] = (uint8_t)(s->id * STRESS_HOLD + k + 1);
+            stress_fill(held[k], tags[k]);
+            s->acquired++;
+        } else {
+            s->failed++;
+        }
+    }
+
+    for(size_t k = 0; k < STRESS_HOLD; k++){
+        if(held[k]){
+            if(!stress_intact(held[k], tags[k]))
+                s->corrupted++;
+            dxlr02_pool_release(held[k]);
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(void){
+    pthread_t threads[STRESS_THREADS];
+    stress_t st[STRESS_THREADS];
+    dxlr02_pool_stats_t before, after;
+
+    dxlr02_pool_get_stats(&before);
+    for(int i = 0; i < STRESS_THREADS; i++){
+        st[i] = (stress_t){ .id = i };
+        pthread_create(&threads[i], NULL, stress_thread, &st[i]);
+    }
+
+    uint32_t acquired = 0, failed = 0;
+    for(int i = 0; i < STRESS_THREADS; i++){
+        pthread_join(threads[i], NULL);
+        CHECK_EQ(st[i].corrupted, 0);
+        acquired += st[i].acquired;
+        failed += st[i].failed;
+    }
+
+    dxlr02_pool_get_stats(&after);
+    CHECK_EQ(after.in_use, 0);
+    CHECK_EQ(after.acquires - before.acquires, acquired);
+    CHECK_EQ(after.failures - before.failures, failed);
+    CHECK(after.high_water <= DXLR02_POOL_BLOCK_COUNT);
+    CHECK(acquired > 0);
+
+    // Despues del estres sigue entregando todos los bloques
+    dxlr02_buf_t * blocks[DXLR02_POOL_BLOCK_COUNT];
+    for(size_t i = 0; i < DXLR02_POOL_BLOCK_COUNT; i++)
+        CHECK_EQ(dxlr02_pool_acquire(&blocks[i]), DXLR02_OK);
+    for(size_t i = 0; i < DXLR02_POOL_BLOCK_COUNT; i++)
+        dxlr02_pool_release(blocks[i]);
+}
+
+int main(void){
+    RUN(test_exhaustion);
+    RUN(test_refcount);
+    RUN(test_refcount_overflow);
+    RUN(test_threads);
+    return TEST_EXIT();
+}
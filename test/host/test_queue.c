@@ -0,0 +1,311 @@
+#include <string.h>
+#include <stdio.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_queue.h"
+#include "esp_timer.h"
+
+// Cola persistente sobre el backend de archivo: lo mandado sin ACK sobrevive a un reinicio, un ACK para otro
+// nodo o sesion no confirma nada, el gateway sigue a cada nodo por separado, la entrega con perdida en el
+// aire (datos y ACKs) termina con todo confirmado y una escritura cortada no rompe el log.
+
+#define QUEUE_FILE      "test_queue.bin"
+#define QUEUE_FILE_B    "test_queue_b.bin"
+#define QUEUE_SIZE      (8 * 4096)
+#define QUEUE_RECORDS   100
+#define QUEUE_NODE      0x0001
+
+static dxlr02_t node_m;
+static dxlr02_t gw_m;
+static dxlr02_queue_t queue;
+static dxlr02_queue_receiver_t receiver;
+static uint8_t seen[QUEUE_RECORDS];
+static uint32_t duplicates;
+static bool node_done;
+
+static int queue_setup(const sim_params_t * params, dxlr02_storage_t * storage){
+    sim_init(params);
+    memset(&node_m, 0, sizeof(node_m));
+    memset(&gw_m, 0, sizeof(gw_m));
+    memset(seen, 0, sizeof(seen));
+    duplicates = 0;
+    node_done = false;
+    remove(QUEUE_FILE);
+
+    if(dxlr02_init(&node_m, sim_add_node(0, 0), 57600) != DXLR02_OK || dxlr02_init(&gw_m, sim_add_node(200, 0), 57600) != DXLR02_OK)
+        return -1;
+    if(dxlr02_set_spread_factor(&node_m, 7) != DXLR02_OK || dxlr02_set_spread_factor(&gw_m, 7) != DXLR02_OK)
+        return -1;
+    if(dxlr02_storage_file(storage, QUEUE_FILE, QUEUE_SIZE) != DXLR02_OK)
+        return -1;
+    return dxlr02_queue_open(&queue, storage, QUEUE_NODE) == DXLR02_OK ? 0 : -1;
+}
+
+static void append_records(int n){
+    char msg[48];
+    for(int i = 0; i < n; i++){
+        snprintf(msg, sizeof(msg), "R%04d-lectura-del-sensor", i);
+        CHECK_EQ(dxlr02_queue_append(&queue, msg, strlen(msg)), DXLR02_OK);
+    }
+}
+
+// El gateway no contesta: nada de lo mandado puede quedar marcado como entregado
+static void test_unacked_survives_restart(void){
+    dxlr02_storage_t storage;
+    uint32_t sent;
+
+    CHECK_EQ(queue_setup(NULL, &storage), 0);
+    append_records(20);
+    CHECK_EQ(dxlr02_queue_drain(&queue, &node_m, 20, &sent), DXLR02_OK);
+    CHECK_EQ(sent, DXLR02_QUEUE_WINDOW);
+
+    // Sin ACK la ventana no avanza; vencido el plazo se repite desde el primero
+    CHECK_EQ(dxlr02_queue_drain(&queue, &node_m, 20, &sent), DXLR02_OK);
+    CHECK_EQ(sent, 0);
+    sim_wait_until(queue.ack_deadline_us + 1000);
+    CHECK_EQ(dxlr02_queue_drain(&queue, &node_m, 20, &sent), DXLR02_OK);
+    CHECK_EQ(sent, DXLR02_QUEUE_WINDOW);
+    CHECK_EQ(queue.stats.timeouts, 1);
+    CHECK_EQ(queue.stats.marks, 0);
+
+    CHECK_EQ(dxlr02_queue_close(&queue), DXLR02_OK);
+    dxlr02_storage_file_close(&storage);
+
+    CHECK_EQ(dxlr02_storage_file(&storage, QUEUE_FILE, QUEUE_SIZE), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_open(&queue, &storage, QUEUE_NODE), DXLR02_OK);
+    CHECK_EQ(queue.stats.recovered, 20);
+    CHECK_EQ(dxlr02_queue_pending(&queue), 20);
+    dxlr02_queue_close(&queue);
+    dxlr02_storage_file_close(&storage);
+    sim_free();
+}
+
+static void node_task(void * ctx){
+    (void)ctx;
+    char buf[256];
+    dxlr02_frame_t frames[4];
+
+    while(dxlr02_queue_pending(&queue) > 0){
+        uint32_t sent;
+        size_t n = 0;
+        dxlr02_queue_drain(&queue, &node_m, DXLR02_QUEUE_WINDOW, &sent);
+        dxlr02_receive_batch(&node_m, buf, sizeof(buf), frames, 4, 1, 100, &n);
+        for(size_t k = 0; k < n; k++)
+            dxlr02_queue_on_frame(&queue, frames[k].data, frames[k].len);
+    }
+    node_done = true;
+}
+
+static void gateway_task(void * ctx){
+    (void)ctx;
+    char buf[256];
+    dxlr02_frame_t frames[4];
+
+    for(;;){
+        size_t n = 0;
+        if(dxlr02_receive_batch(&gw_m, buf, sizeof(buf), frames, 4, 1, 1000, &n) != DXLR02_OK)
+            continue;
+        for(size_t k = 0; k < n; k++){
+            const char * data;
+            size_t len;
+            int id;
+            if(dxlr02_queue_receive(&receiver, &gw_m, frames[k].data, frames[k].len, &data, &len, NULL) != DXLR02_OK || len == 0)
+                continue;
+            if(sscanf(data, "R%4d", &id) == 1 && id >= 0 && id < QUEUE_RECORDS){
+                if(seen[id]++)
+                    duplicates++;
+            }
+        }
+    }
+}
+
+// Frame tal como lo arma dxlr02_queue_drain
+static size_t make_frame(char * out, int type, uint16_t node, uint16_t session, uint16_t seq, const char * data){
+    snprintf(out, DXLR02_QUEUE_FRAME_HDR_LEN + 1, "%c%04X%04X%04X", type, node, session, seq);
+    strcpy(out + DXLR02_QUEUE_FRAME_HDR_LEN, data);
+    return DXLR02_QUEUE_FRAME_HDR_LEN + strlen(data);
+}
+
+// Dos nodos con ventanas abiertas a la vez: el ACK del gateway para uno no mueve la cola del otro
+static void test_ack_for_other_node(void){
+    dxlr02_storage_t storage, other_storage;
+    static dxlr02_queue_t other;
+    char ack[DXLR02_QUEUE_FRAME_HDR_LEN + 1];
+    uint32_t sent;
+
+    CHECK_EQ(queue_setup(NULL, &storage), 0);
+    remove(QUEUE_FILE_B);
+    CHECK_EQ(dxlr02_storage_file(&other_storage, QUEUE_FILE_B, QUEUE_SIZE), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_open(&other, &other_storage, QUEUE_NODE + 1), DXLR02_OK);
+    append_records(4);
+    for(int i = 0; i < 4; i++)
+        CHECK_EQ(dxlr02_queue_append(&other, "otro-nodo", 9), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_drain(&queue, &node_m, 4, &sent), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_drain(&other, &node_m, 4, &sent), DXLR02_OK);
+
+    // Aunque los seq coincidan, el ACK es del primer nodo
+    other.tail_tx_seq = queue.tail_tx_seq;
+    make_frame(ack, DXLR02_QUEUE_TAG_ACK, QUEUE_NODE, queue.session, (uint16_t)(queue.tail_tx_seq + 3), "");
+    CHECK_EQ(dxlr02_queue_on_frame(&other, ack, DXLR02_QUEUE_FRAME_HDR_LEN), DXLR02_OK);
+    CHECK_EQ(other.stats.acked, 0);
+    CHECK_EQ(other.in_flight, 4);
+
+    // Mismo nodo, sesion anterior al reinicio: tampoco
+    make_frame(ack, DXLR02_QUEUE_TAG_ACK, QUEUE_NODE, (uint16_t)(queue.session + 1), (uint16_t)(queue.tail_tx_seq + 3), "");
+    CHECK_EQ(dxlr02_queue_on_frame(&queue, ack, DXLR02_QUEUE_FRAME_HDR_LEN), DXLR02_OK);
+    CHECK_EQ(queue.stats.acked, 0);
+
+    make_frame(ack, DXLR02_QUEUE_TAG_ACK, QUEUE_NODE, queue.session, (uint16_t)(queue.tail_tx_seq + 3), "");
+    CHECK_EQ(dxlr02_queue_on_frame(&queue, ack, DXLR02_QUEUE_FRAME_HDR_LEN), DXLR02_OK);
+    CHECK_EQ(queue.stats.acked, 4);
+    CHECK_EQ(dxlr02_queue_pending(&queue), 0);
+    CHECK_EQ(dxlr02_queue_pending(&other), 4);
+
+    dxlr02_queue_close(&other);
+    dxlr02_storage_file_close(&other_storage);
+    dxlr02_queue_close(&queue);
+    dxlr02_storage_file_close(&storage);
+    remove(QUEUE_FILE_B);
+    sim_free();
+}
+
+// El gateway sigue a cada nodo por separado y se resincroniza cuando cambia la sesion
+static void test_receiver_sources(void){
+    char frame[64];
+    const char * data;
+    size_t len, n;
+    uint16_t from = 0;
+
+    sim_init(NULL);
+    memset(&gw_m, 0, sizeof(gw_m));
+    CHECK_EQ(dxlr02_init(&gw_m, sim_add_node(0, 0), 57600), DXLR02_OK);
+    dxlr02_queue_receiver_init(&receiver);
+
+    // Dos nodos intercalados con seq que no tienen nada que ver: se entrega todo
+    for(uint16_t i = 0; i < 3; i++){
+        n = make_frame(frame, i ? DXLR02_QUEUE_TAG_DATA : DXLR02_QUEUE_TAG_SYNC, 1, 0xA000, (uint16_t)(100 + i), "a");
+        CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, &from), DXLR02_OK);
+        CHECK_EQ(len, 1);
+        CHECK_EQ(from, 1);
+        n = make_frame(frame, i ? DXLR02_QUEUE_TAG_DATA : DXLR02_QUEUE_TAG_SYNC, 2, 0xB000, (uint16_t)(5000 + i), "b");
+        CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, &from), DXLR02_OK);
+        CHECK_EQ(len, 1);
+        CHECK_EQ(from, 2);
+    }
+    CHECK_EQ(receiver.delivered, 6);
+    CHECK_EQ(receiver.sessions, 2);
+
+    // Repeticion de la ventana del nodo 1 en la misma sesion (se perdio el ACK): se descarta
+    n = make_frame(frame, DXLR02_QUEUE_TAG_SYNC, 1, 0xA000, 101, "a");
+    CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, NULL), DXLR02_OK);
+    CHECK_EQ(len, 0);
+
+    // El nodo 1 se reinicia y su SYNC cae justo detras de lo esperado: es nuevo, se entrega
+    n = make_frame(frame, DXLR02_QUEUE_TAG_SYNC, 1, 0xA001, 101, "r");
+    CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, NULL), DXLR02_OK);
+    CHECK_EQ(len, 1);
+    CHECK_EQ(receiver.sessions, 3);
+
+    // DATA de una sesion nueva sin su SYNC: se espera el SYNC
+    n = make_frame(frame, DXLR02_QUEUE_TAG_DATA, 2, 0xB001, 5003, "b");
+    CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, NULL), DXLR02_OK);
+    CHECK_EQ(len, 0);
+    CHECK_EQ(receiver.dropped, 2);
+
+    // Mas nodos que lugares: se desaloja el que hace mas que no manda
+    for(uint16_t node = 10; node < 10 + DXLR02_QUEUE_SOURCES; node++){
+        n = make_frame(frame, DXLR02_QUEUE_TAG_SYNC, node, 0xC000, 0, "c");
+        CHECK_EQ(dxlr02_queue_receive(&receiver, &gw_m, frame, n, &data, &len, NULL), DXLR02_OK);
+        CHECK_EQ(len, 1);
+    }
+    CHECK_EQ(receiver.evictions, 2);
+    sim_free();
+}
+
+// Perdida en el aire para datos y ACKs: todo llega al menos una vez y queda marcado
+static void test_delivery_under_loss(void){
+    static const double losses[] = { 0.0, 0.1, 0.2 };
+
+    for(size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++){
+        sim_params_t params = SIM_PARAMS_DEFAULT();
+        dxlr02_storage_t storage;
+        params.loss = losses[l];
+        params.seed = 3;
+
+        CHECK_EQ(queue_setup(&params, &storage), 0);
+        dxlr02_queue_receiver_init(&receiver);
+        append_records(QUEUE_RECORDS);
+
+        int64_t t0 = esp_timer_get_time();
+        sim_spawn(t0, node_task, NULL);
+        sim_spawn(t0, gateway_task, NULL);
+        int64_t t = t0;
+        while(!node_done && t < t0 + 600000000LL){
+            t += 1000000;
+            sim_run(t);
+        }
+
+        uint32_t missing = 0;
+        for(int i = 0; i < QUEUE_RECORDS; i++)
+            missing += seen[i] == 0;
+        printf("queue: perdida %.2f: %d registros en %.1f s, %u frames, %u ventanas repetidas (%u por timeout), %u duplicados, faltan %u\n",
+               losses[l], QUEUE_RECORDS, (t - t0) / 1e6, queue.stats.drained, queue.stats.rewinds, queue.stats.timeouts, duplicates, missing);
+        CHECK(node_done);
+        CHECK_EQ(missing, 0);
+        CHECK_EQ(duplicates, 0);
+        CHECK_EQ(queue.stats.acked, QUEUE_RECORDS);
+        if(losses[l] == 0.0)
+            CHECK_EQ(queue.stats.timeouts, 0);
+
+        // Todo confirmado: al reabrir no queda nada pendiente
+        CHECK_EQ(dxlr02_queue_close(&queue), DXLR02_OK);
+        dxlr02_storage_file_close(&storage);
+        CHECK_EQ(dxlr02_storage_file(&storage, QUEUE_FILE, QUEUE_SIZE), DXLR02_OK);
+        CHECK_EQ(dxlr02_queue_open(&queue, &storage, QUEUE_NODE), DXLR02_OK);
+        CHECK_EQ(queue.stats.recovered, 0);
+        dxlr02_queue_close(&queue);
+        dxlr02_storage_file_close(&storage);
+        sim_free();
+    }
+}
+
+// Corte de energia a mitad de un commit: el registro cortado se descarta y el log sigue en otro segmento
+static void test_torn_write(void){
+    dxlr02_storage_t storage;
+
+    CHECK_EQ(queue_setup(NULL, &storage), 0);
+    append_records(10);
+    CHECK_EQ(dxlr02_queue_commit(&queue), DXLR02_OK);
+
+    // Header de un registro de 24 bytes con los datos sin escribir
+    const uint8_t torn[] = { 0xFE, 0xFF, 24, 0, 0x12, 0x34, 0x56, 0x78, 'R', '9' };
+    CHECK_EQ(storage.write(storage.ctx, queue.head_off, torn, sizeof(torn)), DXLR02_OK);
+    dxlr02_storage_file_close(&storage);
+
+    CHECK_EQ(dxlr02_storage_file(&storage, QUEUE_FILE, QUEUE_SIZE), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_open(&queue, &storage, QUEUE_NODE), DXLR02_OK);
+    CHECK_EQ(queue.stats.torn, 1);
+    CHECK_EQ(queue.stats.recovered, 10);
+    CHECK_EQ(queue.head_seg, 1);
+
+    append_records(5);
+    CHECK_EQ(dxlr02_queue_close(&queue), DXLR02_OK);
+    dxlr02_storage_file_close(&storage);
+    CHECK_EQ(dxlr02_storage_file(&storage, QUEUE_FILE, QUEUE_SIZE), DXLR02_OK);
+    CHECK_EQ(dxlr02_queue_open(&queue, &storage, QUEUE_NODE), DXLR02_OK);
+    CHECK_EQ(queue.stats.recovered, 15);
+    dxlr02_queue_close(&queue);
+    dxlr02_storage_file_close(&storage);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_unacked_survives_restart);
+    RUN(test_ack_for_other_node);
+    RUN(test_receiver_sources);
+    RUN(test_delivery_under_loss);
+    RUN(test_torn_write);
+    remove(QUEUE_FILE);
+    return TEST_EXIT();
+}
@@ -0,0 +1,268 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "sim.h"
+#include "dxlr02.h"
+#include "dxlr02_airtime.h"
+#include "dxlr02_tdma.h"
+#include "esp_timer.h"
+
+// TDMA sobre el simulador: un gateway y varios nodos corriendo como tareas. Nada se superpone en el aire,
+// un beacon por superframe, el guard se ajusta a lo medido y rx_last_us es la llegada y no la lectura.
+
+#define TDMA_NODES      8
+#define TDMA_PAYLOAD    16
+#define TDMA_RUN_US     (120 * 1000000LL)
+#define TDMA_MAX_AIR    4096
+
+typedef struct {
+    int port;
+    int64_t start_us;
+    int64_t end_us;
+    bool beacon;
+} air_t;
+
+static air_t air[TDMA_MAX_AIR];
+static size_t air_count;
+static int gw_port;
+
+static void record_air(void * ctx, const sim_packet_t * pkt){
+    (void)ctx;
+    if(air_count == TDMA_MAX_AIR)
+        return;
+    air[air_count++] = (air_t){ .port = pkt->src, .start_us = pkt->start_us, .end_us = pkt->end_us,
+                                .beacon = pkt->src == gw_port && pkt->len > 0 && pkt->data[0] == '@' };
+}
+
+static int64_t rx_hook_end_us;
+
+static void record_rx(void * ctx, int node, const sim_packet_t * pkt){
+    (void)ctx;
+    (void)node;
+    rx_hook_end_us = pkt->end_us;
+}
+
+// rx_last_us: llegada del frame si la lectura lo estaba esperando, 0 si ya estaba en el buffer
+static void test_rx_timestamp(void){
+    dxlr02_t tx, rx;
+    char buf[64];
+    dxlr02_frame_t frames[2];
+    size_t n = 0;
+
+    sim_init(NULL);
+    sim_set_rx_hook(record_rx, NULL);
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    int tx_port = sim_add_node(0, 0);
+    int rx_port = sim_add_node(100, 0);
+    CHECK_EQ(dxlr02_init(&tx, tx_port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_init(&rx, rx_port, 9600), DXLR02_OK);
+
+    sim_params_t p = SIM_PARAMS_DEFAULT();
+    uint32_t uart_us = dxlr02_uart_time_us(&rx.config, 6);
+    for(int i = 0; i < 4; i++){
+        CHECK_EQ(dxlr02_send_data(&tx, "hola!", 5), DXLR02_OK);
+        CHECK_EQ(dxlr02_receive_batch(&rx, buf, sizeof(buf), frames, 2, 1, 5000, &n), DXLR02_OK);
+        CHECK_EQ(n, 1);
+        int64_t delay = rx.rx_last_us - rx_hook_end_us;
+        CHECK(delay >= (int64_t)(p.rx_latency_min_us + uart_us) - 2000);
+        CHECK(delay <= (int64_t)(p.rx_latency_max_us + uart_us) + 2000);
+    }
+
+    // Ya estaba en el buffer cuando se leyo: no se sabe cuando llego
+    CHECK_EQ(dxlr02_send_data(&tx, "hola!", 5), DXLR02_OK);
+    sim_wait_until(sim_now() + 2000000);
+    CHECK_EQ(dxlr02_receive_batch(&rx, buf, sizeof(buf), frames, 2, 0, 0, &n), DXLR02_OK);
+    CHECK_EQ(n, 1);
+    CHECK_EQ(rx.rx_last_us, 0);
+    sim_free();
+}
+
+typedef struct {
+    dxlr02_t m;
+    dxlr02_tdma_t tdma;
+    int port;
+    uint16_t gw_addr;
+    uint32_t sent;
+    uint32_t not_synced;
+    uint32_t beacons_unstamped;
+} tdma_node_t;
+
+static dxlr02_t gw_m;
+static dxlr02_tdma_t gw;
+static tdma_node_t nodes[TDMA_NODES];
+static uint32_t gw_received[TDMA_NODES];
+static uint32_t gw_samples_rejected;
+static int64_t run_end_us;
+
+static void gateway_task(void * ctx){
+    (void)ctx;
+    char buf[128];
+    dxlr02_frame_t frame;
+    size_t n;
+
+    while(esp_timer_get_time() < run_end_us){
+        if(dxlr02_tdma_beacon(&gw) != DXLR02_OK)
+            continue;
+
+        // Hasta el proximo superframe: los frames de los nodos, de a uno para tener la llegada de cada uno
+        int64_t end = gw.epoch_us + gw.superframe_us;
+        for(int64_t now = esp_timer_get_time(); now < end; now = esp_timer_get_time()){
+            uint32_t wait_ms = (uint32_t)((end - now + 999) / 1000);
+            if(dxlr02_receive_batch(&gw_m, buf, sizeof(buf), &frame, 1, 1, wait_ms, &n) != DXLR02_OK)
+                continue;
+            if(dxlr02_tdma_gateway_on_frame(&gw, frame.len, gw_m.rx_last_us) != DXLR02_OK)
+gw_samples_rejected++;
+
+            int id = atoi(frame.data + 1);
+            if(frame.data[0] == 'N' && id >= 1 && id <= TDMA_NODES)
+                gw_received[id - 1]++;
+        }
+    }
+}
+
+static void node_task(void * ctx){
+    tdma_node_t * node = ctx;
+    char buf[128];
+    char msg[32];
+    dxlr02_frame_t frame;
+    size_t n;
+
+    while(esp_timer_get_time() < run_end_us){
+        if(dxlr02_receive_batch(&node->m, buf, sizeof(buf), &frame, 1, 1, 1000, &n) != DXLR02_OK)
+            continue;
+
+        dxlr02_status_t st = dxlr02_tdma_on_frame(&node->tdma, frame.data, frame.len, node->m.rx_last_us);
+        if(st == DXLR02_ERR_NOT_SYNCED)
+            node->beacons_unstamped++;
+        if(st != DXLR02_OK)
+            continue;
+
+        snprintf(msg, sizeof(msg), "N%02d:%012lu", node->tdma.slot, (unsigned long)node->sent);
+        st = dxlr02_tdma_send(&node->tdma, node->gw_addr, msg, TDMA_PAYLOAD);
+        if(st == DXLR02_OK)
+            node->sent++;
+        else if(st == DXLR02_ERR_NOT_SYNCED)
+            node->not_synced++;
+    }
+}
+
+static int air_cmp(const void * a, const void * b){
+    const air_t * x = a, * y = b;
+    return (x->start_us > y->start_us) - (x->start_us < y->start_us);
+}
+
+static void test_schedule(void){
+    sim_params_t params = SIM_PARAMS_DEFAULT();
+    params.seed = 11;
+    sim_init(&params);
+    sim_set_air_hook(record_air, NULL);
+    air_count = 0;
+    gw_samples_rejected = 0;
+    memset(gw_received, 0, sizeof(gw_received));
+
+    memset(&gw_m, 0, sizeof(gw_m));
+    gw_port = sim_add_node(0, 0);
+    CHECK_EQ(dxlr02_init(&gw_m, gw_port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_level(&gw_m, 5), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_mac(&gw_m, 0x12), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_mode(&gw_m, 2), DXLR02_OK);
+    CHECK_EQ(dxlr02_tdma_gateway_init(&gw, &gw_m, TDMA_NODES, TDMA_PAYLOAD), DXLR02_OK);
+    uint32_t initial_superframe = gw.superframe_us;
+
+    for(int i = 0; i < TDMA_NODES; i++){
+        tdma_node_t * node = &nodes[i];
+        memset(node, 0, sizeof(*node));
+        node->port = sim_add_node(150.0 + 20.0 * i, 50.0 * (i % 3));
+        node->gw_addr = sim_module_config(gw_port)->mac;
+        CHECK_EQ(dxlr02_init(&node->m, node->port, 9600), DXLR02_OK);
+        CHECK_EQ(dxlr02_set_level(&node->m, 5), DXLR02_OK);
+        CHECK_EQ(dxlr02_set_mac(&node->m, (uint8_t)(0x20 + i)), DXLR02_OK);
+        CHECK_EQ(dxlr02_set_mode(&node->m, 1), DXLR02_OK);
+        CHECK_EQ(dxlr02_tdma_node_init(&node->tdma, &node->m, (uint8_t)(i + 1)), DXLR02_OK);
+    }
+
+    int64_t t0 = esp_timer_get_time() + 100000;
+    run_end_us = t0 + TDMA_RUN_US;
+    for(int i = 0; i < TDMA_NODES; i++)
+        sim_spawn(t0, node_task, &nodes[i]);
+    sim_spawn(t0 + 50000, gateway_task, NULL);
+    sim_run(run_end_us + 5000000);
+
+    // Nada se superpone en el aire
+    qsort(air, air_count, sizeof(air[0]), air_cmp);
+    size_t overlaps = 0, beacons = 0;
+    int64_t min_beacon_gap = INT64_MAX, prev_beacon = -1;
+    for(size_t k = 0; k < air_count; k++){
+        if(k > 0 && air[k].start_us < air[k - 1].end_us)
+            overlaps++;
+        if(air[k].beacon){
+            if(prev_beacon >= 0 && air[k].start_us - prev_beacon < min_beacon_gap)
+                min_beacon_gap = air[k].start_us - prev_beacon;
+            prev_beacon = air[k].start_us;
+            beacons++;
+        }
+    }
+
+    uint32_t sent = 0, received = 0, not_synced = 0, unstamped = 0;
+    for(int i = 0; i < TDMA_NODES; i++){
+        sent += nodes[i].sent;
+        received += gw_received[i];
+        not_synced += nodes[i].not_synced;
+        unstamped += nodes[i].beacons_unstamped;
+        CHECK(nodes[i].sent > 0);
+    }
+
+    printf("tdma: %d nodos, %zu beacons, superframe %u -> %u us, guard %u us (atraso %d +- %u us, %u muestras), "
+           "%u/%u entregados, %zu superpuestos, %u sin sync, %u beacons sin llegada, %u rechazados\n",
+           TDMA_NODES, beacons, initial_superframe, gw.superframe_us, gw.guard_us, gw.late_mean_us, gw.late_dev_us,
+           gw.samples, received, sent, overlaps, not_synced, unstamped, gw_samples_rejected);
+
+    CHECK_EQ(overlaps, 0);
+    CHECK_EQ(gw_samples_rejected, 0);
+    CHECK_EQ(unstamped, 0);
+    CHECK_EQ(sim_node_stats(gw_port)->rx_collision, 0);
+    CHECK(received >= sent * 98 / 100);
+    CHECK(not_synced <= sent / 50);
+    // Un beacon por superframe: ninguno repetido ni antes de tiempo, aun con el guard mas chico posible
+    uint32_t min_superframe = dxlr02_tdma_slot_us(&gw_m.config, TDMA_PAYLOAD, DXLR02_TDMA_GUARD_MIN_US) * (TDMA_NODES + 1);
+    CHECK(beacons >= TDMA_RUN_US / initial_superframe - 1);
+    CHECK(min_beacon_gap >= min_superframe);
+    CHECK(beacons <= TDMA_RUN_US / gw.superframe_us + 2);
+    // El guard salio de lo medido y es menor que el inicial
+    CHECK(gw.samples >= DXLR02_TDMA_MIN_SAMPLES);
+    CHECK(gw.guard_us < DXLR02_TDMA_GUARD_INIT_US);
+    CHECK(gw.guard_us >= DXLR02_TDMA_GUARD_MIN_US);
+    sim_free();
+}
+
+static void test_beacon_without_arrival(void){
+    dxlr02_t m;
+    dxlr02_tdma_t tdma;
+
+    sim_init(NULL);
+    memset(&m, 0, sizeof(m));
+    int port = sim_add_node(0, 0);
+    CHECK_EQ(dxlr02_init(&m, port, 9600), DXLR02_OK);
+    CHECK_EQ(dxlr02_set_mode(&m, 1), DXLR02_OK);
+    CHECK_EQ(dxlr02_tdma_node_init(&tdma, &m, 1), DXLR02_OK);
+
+    const char * beacon = "@0400D6D80030D20064";
+    CHECK_EQ(dxlr02_tdma_on_frame(&tdma, beacon, strlen(beacon), 0), DXLR02_ERR_INVALID_RESPONSE);
+    beacon = "@0400D6D830D20064";
+    CHECK_EQ(dxlr02_tdma_on_frame(&tdma, beacon, strlen(beacon), 0), DXLR02_ERR_NOT_SYNCED);
+    CHECK(!tdma.synced);
+    CHECK_EQ(dxlr02_tdma_on_frame(&tdma, beacon, strlen(beacon), esp_timer_get_time()), DXLR02_OK);
+    CHECK(tdma.synced);
+    CHECK_EQ(tdma.guard_us, 0x30D2);
+    CHECK_EQ(tdma.slot_us, 0x00D6D8);
+    sim_free();
+}
+
+int main(void){
+    RUN(test_rx_timestamp);
+    RUN(test_beacon_without_arrival);
+    RUN(test_schedule);
+    return TEST_EXIT();
+}